@@ -0,0 +1,498 @@
+#include "../src/Parser/parser.h"
+#include "../src/Operations/Selection/ResultFormatter.hpp"
+#include "../src/Storage/morsels.h"
+#include "../src/Storage/tableCache.h"
+#include "../src/Storage/writeAheadLog.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+#include <unistd.h>
+
+using namespace std;
+namespace fs = filesystem;
+using json = nlohmann::json;
+
+// The engine reads these from the command line front end
+bool g_outputJson = false;
+Selection::OutputFormat g_outputFormat = Selection::OutputFormat::NdJson;
+
+namespace {
+    struct Options {
+        size_t rows = 100000;
+        vector<string> columns{"int", "int", "float", "text", "bool"};
+        size_t ops = 1000;
+        size_t scans = 20;
+        size_t range = 1000;
+        size_t distinct = 1000;
+        size_t cacheMegabytes = 0;
+        size_t scanThreads = 0;
+        string sync = "commit";
+        unsigned seed = 42;
+        vector<string> only;
+        string directory;
+        bool keep = false;
+        bool jsonOutput = false;
+    };
+
+    struct Result {
+        string name;
+        vector<double> latencies; // microseconds, one per operation
+        double seconds = 0;
+        size_t rows = 0;
+    };
+
+    const vector<string> BENCHMARKS{
+        "bulk_load", "insert", "point_lookup", "range_scan", "order_by_limit", "update", "delete"
+    };
+
+    /**
+     * Discards statement output, counting its lines: with NDJSON output, one per result row
+     */
+    class LineCounter : public streambuf {
+    public:
+        size_t lines = 0;
+
+    protected:
+        int overflow(int c) override {
+            if (c == '\n') ++lines;
+            return c == EOF ? 0 : c;
+        }
+
+        streamsize xsputn(const char *s, streamsize n) override {
+            lines += static_cast<size_t>(count(s, s + n, '\n'));
+            return n;
+        }
+    };
+
+    void usage(ostream &out) {
+        string names;
+        for (const auto &name: BENCHMARKS) names += (names.empty() ? "" : ",") + name;
+        out << "Usage: mashdb_bench [options]\n"
+                "  --rows N           rows in the generated table (100000)\n"
+                "  --columns LIST     types of the columns besides the int key, e.g. int,float,text,bool\n"
+                "  --ops N            operations of the insert, point_lookup, update and delete runs (1000)\n"
+                "  --scans N          queries of the range_scan and order_by_limit runs (20)\n"
+                "  --range N          rows per range scan (1000)\n"
+                "  --distinct N       distinct values of each text column (1000)\n"
+                "  --only LIST        benchmarks to report: " << names << "\n"
+                "  --sync POLICY      write-ahead log sync: commit, off or milliseconds (commit)\n"
+                "  --cache-mb N       column cache as in --serve; 0 reads columns like the command line (0)\n"
+                "  --scan-threads N   threads per scan, 0 for one per core (0)\n"
+                "  --seed N           seed of the generated data (42)\n"
+                "  --dir PATH         home directory for the database (a new temporary one)\n"
+                "  --keep             keep the database afterwards\n"
+                "  --json             print the results as JSON\n";
+    }
+
+    vector<string> splitList(const string &text) {
+        vector<string> items;
+        stringstream stream(text);
+        string item;
+        while (getline(stream, item, ',')) {
+            if (!item.empty()) items.push_back(item);
+        }
+        return items;
+    }
+
+    /**
+     * @brief Parses the command line.
+     * @throws std::runtime_error If an option is unknown or its value is missing or invalid.
+     */
+    Options parseOptions(int argc, char *argv[]) {
+        Options options;
+        for (int i = 1; i < argc; ++i) {
+            string flag = argv[i];
+            auto value = [&]() -> string {
+                if (i + 1 >= argc) throw runtime_error(flag + " needs a value");
+                return argv[++i];
+            };
+            auto number = [&]() -> size_t {
+                string text = value();
+                if (text.empty() || text.find_first_not_of("0123456789") != string::npos) {
+                    throw runtime_error("invalid " + flag + " value: " + text);
+                }
+                return stoul(text);
+            };
+
+            if (flag == "--rows") options.rows = number();
+            else if (flag == "--columns") options.columns = splitList(value());
+            else if (flag == "--ops") options.ops = number();
+            else if (flag == "--scans") options.scans = number();
+            else if (flag == "--range") options.range = number();
+            else if (flag == "--distinct") options.distinct = number();
+            else if (flag == "--only") options.only = splitList(value());
+            else if (flag == "--sync") options.sync = value();
+            else if (flag == "--cache-mb") options.cacheMegabytes = number();
+            else if (flag == "--scan-threads") options.scanThreads = number();
+            else if (flag == "--seed") options.seed = static_cast<unsigned>(number());
+            else if (flag == "--dir") options.directory = value();
+            else if (flag == "--keep") options.keep = true;
+            else if (flag == "--json") options.jsonOutput = true;
+            else throw runtime_error("unknown option " + flag);
+        }
+
+        if (options.rows == 0) throw runtime_error("--rows must be at least 1");
+        if (options.columns.empty()) throw runtime_error("--columns needs at least one type");
+        for (const auto &type: options.columns) {
+            if (type != "int" && type != "float" && type != "text" && type != "bool") {
+                throw runtime_error("unknown column type " + type + " (int, float, text or bool)");
+            }
+        }
+        for (const auto &name: options.only) {
+            if (find(BENCHMARKS.begin(), BENCHMARKS.end(), name) == BENCHMARKS.end()) {
+                throw runtime_error("unknown benchmark " + name);
+            }
+        }
+        if (options.distinct == 0) options.distinct = 1;
+        options.ops = min(options.ops, options.rows);
+        options.range = max<size_t>(options.range, 1);
+        return options;
+    }
+
+    /**
+     * Generates the table data: an int key `id` numbered from 0 and columns `c1`, `c2`, ...
+     * with uniformly drawn values of the configured types
+     */
+    class DataGenerator {
+    public:
+        explicit DataGenerator(const Options &options) : options(options), random(options.seed) {}
+
+        string value(size_t column, bool quoted) {
+            const string &type = options.columns[column];
+            if (type == "int") {
+                return to_string(uniform_int_distribution<int64_t>(0, 1000000)(random));
+            }
+            if (type == "float") {
+                ostringstream text;
+                text << fixed << setprecision(3) << uniform_real_distribution<double>(0, 1000)(random);
+                return text.str();
+            }
+            if (type == "bool") {
+                return uniform_int_distribution<int>(0, 1)(random) ? "true" : "false";
+            }
+            string text = "value " + to_string(uniform_int_distribution<size_t>(0, options.distinct - 1)(random));
+            return quoted ? "'" + text + "'" : text;
+        }
+
+        string columnList() const {
+            string list = "id";
+            for (size_t c = 0; c < options.columns.size(); ++c) list += ", c" + to_string(c + 1);
+            return list;
+        }
+
+        string schema() const {
+            string list = "id int UNIQUE";
+            for (size_t c = 0; c < options.columns.size(); ++c) {
+                list += ", c" + to_string(c + 1) + " " + options.columns[c];
+            }
+            return list;
+        }
+
+        string insert(const string &table, size_t id) {
+            string query = "INSERT INTO " + table + " (" + columnList() + ") VALUES (" + to_string(id);
+            for (size_t c = 0; c < options.columns.size(); ++c) query += ", " + value(c, true);
+            return query + ")";
+        }
+
+        void writeCsv(const fs::path &path) {
+            ofstream file(path, ios::binary | ios::trunc);
+            if (!file) throw runtime_error("Cannot write " + path.string());
+            string line = "id";
+            for (size_t c = 0; c < options.columns.size(); ++c) line += ",c" + to_string(c + 1);
+            file << line << '\n';
+            for (size_t id = 0; id < options.rows; ++id) {
+                line = to_string(id);
+                for (size_t c = 0; c < options.columns.size(); ++c) line += "," + value(c, false);
+                file << line << '\n';
+            }
+            if (!file) throw runtime_error("Cannot write " + path.string());
+        }
+
+        size_t key() {
+            return below(options.rows);
+        }
+
+        size_t below(size_t limit) {
+            return uniform_int_distribution<size_t>(0, limit - 1)(random);
+        }
+
+        /**
+         * Distinct keys in random order, so each UPDATE and DELETE finds its row
+         */
+        vector<size_t> distinctKeys(size_t count) {
+            vector<size_t> keys(options.rows);
+            iota(keys.begin(), keys.end(), 0);
+            shuffle(keys.begin(), keys.end(), random);
+            keys.resize(min(count, keys.size()));
+            return keys;
+        }
+
+    private:
+        const Options &options;
+        mt19937_64 random;
+    };
+
+    /**
+     * @brief Runs one statement and returns the number of output lines it produced.
+     * @throws std::runtime_error If the statement fails.
+     */
+    size_t run(const string &query) {
+        LineCounter counter;
+        ostream out(&counter);
+        ParseQuery::parse(query, out);
+        return counter.lines;
+    }
+
+    /**
+     * Times `queries` one by one; `rows` counts what each one returned or touched
+     */
+    Result measure(const string &name, const vector<string> &queries,
+                   const function<size_t(size_t lines)> &rows = [](size_t lines) { return lines; }) {
+        Result result;
+        result.name = name;
+        result.latencies.reserve(queries.size());
+        auto started = chrono::steady_clock::now();
+        for (const auto &query: queries) {
+            auto before = chrono::steady_clock::now();
+            size_t lines = run(query);
+            auto after = chrono::steady_clock::now();
+            result.latencies.push_back(chrono::duration<double, micro>(after - before).count());
+            result.rows += rows(lines);
+        }
+        result.seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+        return result;
+    }
+
+    double percentile(const vector<double> &sorted, double share) {
+        if (sorted.empty()) return 0;
+        // Nearest rank: the smallest latency that at least `share` of the operations did not exceed
+        size_t rank = static_cast<size_t>(ceil(share * static_cast<double>(sorted.size())));
+        return sorted[min(sorted.size(), max<size_t>(rank, 1)) - 1];
+    }
+
+    json toJson(const Result &result) {
+        vector<double> sorted = result.latencies;
+        sort(sorted.begin(), sorted.end());
+        double total = accumulate(sorted.begin(), sorted.end(), 0.0);
+        double seconds = result.seconds > 0 ? result.seconds : 1e-9;
+
+        json entry;
+        entry["name"] = result.name;
+        entry["iterations"] = sorted.size();
+        entry["seconds"] = result.seconds;
+        entry["ops_per_second"] = static_cast<double>(sorted.size()) / seconds;
+        entry["rows"] = result.rows;
+        entry["rows_per_second"] = static_cast<double>(result.rows) / seconds;
+        entry["latency_us"] = {
+            {"min", sorted.empty() ? 0 : sorted.front()},
+            {"mean", sorted.empty() ? 0 : total / static_cast<double>(sorted.size())},
+            {"p50", percentile(sorted, 0.50)},
+            {"p90", percentile(sorted, 0.90)},
+            {"p99", percentile(sorted, 0.99)},
+            {"max", sorted.empty() ? 0 : sorted.back()}
+        };
+        return entry;
+    }
+
+    void printText(const json &report, ostream &out) {
+        out << "rows=" << report["config"]["rows"] << " columns=" << report["config"]["columns"].dump()
+            << " sync=" << report["config"]["sync"].get<string>() << "\n\n";
+        out << left << setw(16) << "benchmark" << right << setw(8) << "iters" << setw(12) << "ops/s"
+            << setw(14) << "rows/s" << setw(11) << "p50 us" << setw(11) << "p90 us" << setw(11) << "p99 us"
+            << setw(12) << "max us" << "\n";
+        out << fixed << setprecision(1);
+        for (const auto &entry: report["benchmarks"]) {
+            const json &latency = entry["latency_us"];
+            out << left << setw(16) << entry["name"].get<string>() << right
+                << setw(8) << entry["iterations"].get<size_t>()
+                << setw(12) << entry["ops_per_second"].get<double>()
+                << setw(14) << entry["rows_per_second"].get<double>()
+                << setw(11) << latency["p50"].get<double>()
+                << setw(11) << latency["p90"].get<double>()
+                << setw(11) << latency["p99"].get<double>()
+                << setw(12) << latency["max"].get<double>() << "\n";
+        }
+    }
+
+    /**
+     * @brief Creates the database, loads the generated table and runs every benchmark.
+     * @return The report, with one entry per benchmark selected with --only (all by default).
+     * @throws std::runtime_error If a statement fails.
+     */
+    json runBenchmarks(const Options &options, const fs::path &home) {
+        DataGenerator data(options);
+        auto selected = [&](const string &name) {
+            return options.only.empty() || find(options.only.begin(), options.only.end(), name) != options.only.end();
+        };
+        auto progress = [&](const string &name) {
+            if (selected(name)) cerr << "running " << name << "..." << endl;
+        };
+        const string database = "bench";
+        const string table = "bench";
+
+        run("CREATE DATABASE " + database);
+        run("CHANGE DATABASE " + database);
+        run("CREATE TABLE " + table + " (" + data.schema() + ")");
+
+        vector<Result> results;
+        fs::path csv = home / "bench.csv";
+        cerr << "generating " << options.rows << " rows..." << endl;
+        data.writeCsv(csv);
+        progress("bulk_load");
+        results.push_back(measure("bulk_load", {"LOAD DATA '" + csv.string() + "' INTO " + table},
+                                  [&](size_t) { return options.rows; }));
+        fs::remove(csv);
+
+        vector<string> queries;
+        progress("insert");
+        run("CREATE TABLE " + table + "_insert (" + data.schema() + ")");
+        for (size_t i = 0; i < options.ops; ++i) queries.push_back(data.insert(table + "_insert", i));
+        results.push_back(measure("insert", queries, [](size_t) { return 1; }));
+
+        progress("point_lookup");
+        queries.clear();
+        for (size_t i = 0; i < options.ops; ++i) {
+            queries.push_back("SELECT * FROM " + table + " WHERE id = " + to_string(data.key()));
+        }
+        results.push_back(measure("point_lookup", queries));
+
+        progress("range_scan");
+        queries.clear();
+        size_t width = min(options.range, options.rows);
+        for (size_t i = 0; i <= options.scans; ++i) {
+            size_t start = data.below(options.rows - width + 1);
+            queries.push_back("SELECT * FROM " + table + " WHERE id >= " + to_string(start) +
+                              " AND id < " + to_string(start + width));
+        }
+        run(queries.front()); // warm-up
+        queries.erase(queries.begin());
+        results.push_back(measure("range_scan", queries));
+
+        progress("order_by_limit");
+        queries.assign(options.scans, "SELECT * FROM " + table + " ORDER BY c1 DESC LIMIT 10");
+        run(queries.front());
+        results.push_back(measure("order_by_limit", queries));
+
+        vector<size_t> keys = data.distinctKeys(options.ops);
+        progress("update");
+        queries.clear();
+        for (size_t key: keys) {
+            queries.push_back("UPDATE " + table + " SET c1 = " + data.value(0, true) + " WHERE id = " + to_string(key));
+        }
+        results.push_back(measure("update", queries, [](size_t) { return 1; }));
+
+        progress("delete");
+        queries.clear();
+        for (size_t key: keys) {
+            queries.push_back("DELETE FROM " + table + " WHERE id = " + to_string(key));
+        }
+        results.push_back(measure("delete", queries, [](size_t) { return 1; }));
+
+        json report;
+        report["config"] = {
+            {"rows", options.rows},
+            {"columns", options.columns},
+            {"ops", options.ops},
+            {"scans", options.scans},
+            {"range", width},
+            {"distinct", options.distinct},
+            {"sync", options.sync},
+            {"cache_mb", options.cacheMegabytes},
+            {"scan_threads", options.scanThreads},
+            {"seed", options.seed},
+            {"hardware_threads", thread::hardware_concurrency()},
+            {"timestamp", static_cast<int64_t>(time(nullptr))}
+        };
+        report["benchmarks"] = json::array();
+        for (const auto &result: results) {
+            if (selected(result.name)) report["benchmarks"].push_back(toJson(result));
+        }
+        return report;
+    }
+}
+
+/**
+ * Generates a table with the configured rows and column types in its own home directory and
+ * measures INSERT, LOAD DATA, point lookups, range scans, ORDER BY ... LIMIT, UPDATE and
+ * DELETE through the same entry point as the command line, reporting throughput and latency
+ * percentiles as a text table or, with --json, as a JSON document.
+ */
+int main(int argc, char *argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        if (string(argv[i]) == "--help") {
+            usage(cout);
+            return 0;
+        }
+    }
+
+    Options options;
+    try {
+        options = parseOptions(argc, argv);
+    } catch (const exception &e) {
+        cerr << "Error: " << e.what() << "\n\n";
+        usage(cerr);
+        return 1;
+    }
+
+    optional<SyncPolicy> policy = SyncPolicy::parse(options.sync);
+    if (!policy) {
+        cerr << "Error: --sync needs commit, off or a number of milliseconds" << endl;
+        return 1;
+    }
+
+    bool temporary = options.directory.empty();
+    fs::path home = temporary
+                        ? fs::temp_directory_path() / ("mashdb-bench-" + to_string(getpid()))
+                        : fs::absolute(options.directory);
+    if (fs::exists(home / ".mashdb" / "databases" / "bench")) {
+        cerr << "Error: " << home.string() << " already holds a bench database" << endl;
+        return 1;
+    }
+    fs::create_directories(home);
+    // Must happen before the engine first resolves ~/.mashdb
+    setenv("HOME", home.c_str(), 1);
+
+    WriteAheadLog::configure(*policy);
+    Morsels::setMaxThreads(options.scanThreads);
+    TableCache::configure(options.cacheMegabytes << 20);
+
+    int status = 0;
+    try {
+        json report = runBenchmarks(options, home);
+        if (options.jsonOutput) {
+            cout << report.dump(2) << endl;
+        } else {
+            printText(report, cout);
+        }
+    } catch (const exception &e) {
+        cerr << "Error: " << e.what() << endl;
+        status = 1;
+    }
+
+    if (temporary && !options.keep) {
+        error_code ignored;
+        fs::remove_all(home, ignored);
+    } else {
+        cerr << "database kept in " << (home / ".mashdb").string() << endl;
+    }
+    return status;
+}
@@ -1,4 +1,6 @@
 #include "changeDB.h"
+#include "../../Storage/catalog.h"
+#include "../../Storage/fileIO.h"
 #include <fstream>
 #include <filesystem>
 
@@ -13,10 +15,8 @@ namespace fs = filesystem;
  * @throws std::runtime_error If the specified database does not exist or if the reference file cannot be written.
  */
 void ChangeDB::change(const string &databaseName) {
-    fs::path homeDir = getenv("HOME");
-    if (homeDir.empty()) homeDir = getenv("USERPROFILE");
-    fs::path dbPath = homeDir / ".mashdb" / "databases" / databaseName;
-    fs::path currentDbFile = homeDir / ".mashdb" / "crrtdb.txt";
+    fs::path dbPath = Catalog::databaseDir(databaseName);
+    fs::path currentDbFile = Catalog::root() / "crrtdb.txt";
 
     if (!fs::exists(dbPath)) {
         throw runtime_error("No database with the name '" + databaseName + "' found");
@@ -24,11 +24,15 @@ void ChangeDB::change(const string &databaseName) {
 
     fs::create_directories(fs::path(currentDbFile).parent_path());
 
-    ofstream file(currentDbFile, ios::trunc);
-    if (!file.is_open()) {
-        throw runtime_error("Failed to open file for writing: " + currentDbFile.string());
+    // Replaced in one rename, so a query running concurrently never reads an empty file
+    fs::path tempPath = FileIO::temporaryPath(currentDbFile);
+    {
+        ofstream file(tempPath, ios::trunc);
+        if (!file.is_open()) {
+            throw runtime_error("Failed to open file for writing: " + currentDbFile.string());
+        }
+        file << databaseName;
     }
-
-    file << databaseName;
-    file.close();
+    fs::rename(tempPath, currentDbFile);
+    Catalog::setCurrentDatabase(databaseName);
 }
@@ -1,4 +1,6 @@
 #include "createDatabase.h"
+#include "../../Storage/catalog.h"
+#include "../../Storage/fileIO.h"
 #include <filesystem>
 #include <fstream>
 #include <stdexcept>
@@ -8,9 +10,6 @@ using namespace std;
 namespace fs = filesystem;
 using json = nlohmann::json;
 
-static string currentDatabase;
-
-
 /**
  * Creates a new database with the specified name.
  *
@@ -23,12 +22,9 @@ static string currentDatabase;
  */
 void CreateDatabase::createDatabase(const string &databaseName) {
     try {
-        fs::path homeDir = getenv("HOME");
-        if (homeDir.empty()) homeDir = getenv("USERPROFILE");
-
-        fs::path mashdbDir = homeDir / ".mashdb";
-        fs::path databasesDir = mashdbDir / "databases";
-        fs::path basePath = databasesDir / databaseName;
+        fs::path mashdbDir = Catalog::root();
+        fs::path databasesDir = Catalog::databasesDir();
+        fs::path basePath = Catalog::databaseDir(databaseName);
         fs::path currentDbFile = mashdbDir / "crrtdb.txt";
 
         if (fs::exists(basePath)) {
@@ -51,14 +47,16 @@ void CreateDatabase::createDatabase(const string &databaseName) {
             throw runtime_error("Failed to create database directory: " + basePath.string());
         }
 
-        currentDatabase = databaseName;
-
-        ofstream file(currentDbFile, ios::trunc);
-        if (!file.is_open()) {
-            throw runtime_error("Failed to create/update current database file: " + currentDbFile.string());
+        fs::path tempPath = FileIO::temporaryPath(currentDbFile);
+        {
+            ofstream file(tempPath, ios::trunc);
+            if (!file.is_open()) {
+                throw runtime_error("Failed to create/update current database file: " + currentDbFile.string());
+            }
+            file << databaseName;
         }
-        file << currentDatabase;
-        file.close();
+        fs::rename(tempPath, currentDbFile);
+        Catalog::setCurrentDatabase(databaseName);
     } catch (const fs::filesystem_error &e) {
         throw runtime_error("Filesystem error: " + string(e.what()));
     } catch (const exception &e) {
@@ -0,0 +1,42 @@
+#include "createIndex.h"
+#include <filesystem>
+#include <stdexcept>
+#include <nlohmann/json.hpp>
+
+#include "../../Storage/catalog.h"
+#include "../../Storage/tableStore.h"
+
+using namespace std;
+namespace fs = filesystem;
+using json = nlohmann::json;
+
+
+/**
+ * @brief Creates an ordered index on a column of a table.
+ *
+ * The index is built from the rows currently in the table and is then used by SELECT for
+ * range conditions, LIKE patterns with a fixed prefix and ORDER BY on that column.
+ *
+ * @param databaseName Name of the database
+ * @param tableName Name of the table
+ * @param indexName Name of the new index, unique within the table
+ * @param column Column to index
+ * @throws std::runtime_error If the table or column does not exist, the index name is
+ * already used, or the column is already indexed
+ */
+void CreateIndex::createIndex(const string &databaseName,
+                              const string &tableName,
+                              const string &indexName,
+                              const string &column) {
+    shared_ptr<const TableSchema> schema = Catalog::find(databaseName, tableName);
+    if (!schema) {
+        throw runtime_error("Table doesn't exist");
+    }
+
+    if (!schema->column(column)) {
+        throw runtime_error("Column doesn't exist: " + column);
+    }
+
+    TableStore table(*schema);
+    table.createIndex(indexName, column);
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include <string>
+
+using namespace std;
+
+class CreateIndex {
+public:
+    static void createIndex(const string &databaseName,
+                            const string &tableName,
+                            const string &indexName,
+                            const string &column);
+};
@@ -6,13 +6,13 @@
 #include <nlohmann/json.hpp>
 
 #include "../CurrentDB/currentDB.h"
+#include "../../Storage/catalog.h"
+#include "../../Storage/columnStore.h"
 
 using namespace std;
 namespace fs = filesystem;
 using json = nlohmann::json;
 
-static string currentDatabase = CurrentDB::getCurrentDB();
-
 
 /**
 * @brief Creates a new table in the database.
@@ -29,9 +29,8 @@ void CreateTable::createTable(const std::string &tableName,
     if (columns.size() != dataTypes.size())
         throw runtime_error("Must initialize Data Type for every Column.");
 
-    fs::path homeDir = getenv("HOME");
-    if (homeDir.empty()) homeDir = getenv("USERPROFILE");
-    fs::path basePath = homeDir / ".mashdb" / "databases" / currentDatabase / tableName;
+    string databaseName = CurrentDB::getCurrentDB();
+    fs::path basePath = Catalog::tableDir(databaseName, tableName);
     fs::path tableDir = basePath / "Columns";
     fs::path tableInfoFile = basePath / "Table-info.json";
 
@@ -42,15 +41,10 @@ void CreateTable::createTable(const std::string &tableName,
 
     for (size_t i = 0; i < columns.size(); ++i) {
         const string &column = columns[i];
-        fs::path columnFile = tableDir / (column + ".json");
+        fs::path columnFile = ColumnStore::columnPath(tableDir, column);
 
         if (!fs::exists(columnFile)) {
-            ofstream cfile(columnFile);
-            if (!cfile)
-                throw runtime_error("Failed to create column file: " + column);
-            json emptyCol = {{column, json::array()}};
-            cfile << emptyCol.dump(4);
-            cfile.close();
+            ColumnStore::createColumn(columnFile, ColumnStore::typeFromName(dataTypes[i]));
         }
 
         json columnData = {
@@ -67,4 +61,5 @@ void CreateTable::createTable(const std::string &tableName,
         throw runtime_error("Failed to create table info file.");
     tfile << columnInfoJson.dump(4);
     tfile.close();
+    Catalog::invalidate(databaseName, tableName);
 }
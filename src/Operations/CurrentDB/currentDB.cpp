@@ -1,58 +1,25 @@
 #include "currentDB.h"
-#include <fstream>
-#include <iostream>
+#include "../../Storage/catalog.h"
+
 #include <filesystem>
-#include <algorithm>
+#include <stdexcept>
 
 using namespace std;
 namespace fs = filesystem;
 
 /**
- * Retrieves the name or content of the current database from a predefined file path.
+ * Retrieves the name of the current database, as recorded in `~/.mashdb/crrtdb.txt`.
  *
- * This method reads the database's name or identifier from a text file located in the
- * "crrtdb/crrtdb.txt" file relative to the current working directory.
+ * The file is created empty if it does not exist yet. Its contents are kept by the Catalog
+ * and only read again after the file changed.
  *
- * @return A string containing the name or content of the current database. All newline
- *         and carriage return characters are removed from the content.
- * @throws std::runtime_error If the file cannot be opened, or if the file's content is empty.
+ * @return A string containing the name of the current database, without newline and
+ *         carriage return characters, or an empty string if no database was chosen.
+ * @throws std::runtime_error If the file cannot be created or opened.
  */
 string CurrentDB::getCurrentDB() {
     try {
-        fs::path homeDir = getenv("HOME");
-        if (homeDir.empty()) homeDir = getenv("USERPROFILE");
-
-        fs::path mashdbDir = homeDir / ".mashdb";
-        fs::path path = mashdbDir / "crrtdb.txt";
-
-        if (!fs::exists(path) || fs::is_empty(path)) {
-            if (!fs::exists(mashdbDir)) {
-                if (!fs::create_directories(mashdbDir)) {
-                    throw runtime_error("Failed to create directory: " + mashdbDir.string());
-                }
-            }
-
-            ofstream file(path);
-            if (!file) {
-                throw runtime_error("Failed to create current database file: " + path.string());
-            }
-            file.close();
-
-            return "";
-        }
-
-        ifstream file(path);
-        if (!file.is_open()) {
-            throw runtime_error("Cannot open current database file: " + path.string());
-        }
-
-        string content((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
-        file.close();
-
-        content.erase(remove(content.begin(), content.end(), '\n'), content.end());
-        content.erase(remove(content.begin(), content.end(), '\r'), content.end());
-
-        return content;
+        return Catalog::currentDatabase();
     } catch (const fs::filesystem_error &e) {
         throw runtime_error("Filesystem error: " + string(e.what()));
     } catch (const exception &e) {
@@ -1,9 +1,15 @@
 #pragma once
+#include <cstddef>
 #include <string>
 
+#include "../../Parser/conditionParser.h"
+
 using namespace std;
 
 class DeleteRow {
 public:
-    static void deleteRow(const string &tableName, const string &condition);
+    /**
+     * @return The number of rows deleted
+     */
+    static size_t deleteRow(const string &tableName, const ConditionExpr &condition);
 };
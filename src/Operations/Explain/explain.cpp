@@ -0,0 +1,183 @@
+#include "explain.h"
+
+#include <cstddef>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+using namespace std;
+using json = nlohmann::json;
+
+namespace {
+    using Phase = QueryProfile::Phase;
+
+    const pair<Phase, const char *> phaseNames[] = {
+        {Phase::Parse, "parse"}, {Phase::Load, "load"}, {Phase::Filter, "filter"}, {Phase::Join, "join"},
+        {Phase::Aggregate, "aggregate"}, {Phase::Sort, "sort"}, {Phase::Project, "project"},
+        {Phase::Format, "format"}, {Phase::Write, "write"}
+    };
+    static_assert(sizeof(phaseNames) / sizeof(phaseNames[0]) == static_cast<size_t>(Phase::Count));
+
+    string milliseconds(double value) {
+        ostringstream text;
+        text << fixed << setprecision(3) << value;
+        return text.str();
+    }
+
+    /**
+     * @brief Milliseconds rounded to microseconds, so the JSON does not carry timer noise
+     */
+    double rounded(double value) {
+        return static_cast<double>(static_cast<long long>(value * 1000 + 0.5)) / 1000;
+    }
+
+    json filterJson(const QueryProfile::FilterStep &step, bool analyze) {
+        json filter = {{"condition", step.condition}, {"access", step.access}};
+        if (step.segments > 0) {
+            filter["segments"] = step.segments;
+            filter["segments_skipped"] = step.skippedSegments;
+        }
+        if (analyze) {
+            if (step.rowsChecked) filter["rows_checked"] = *step.rowsChecked;
+            if (step.rowsMatched) filter["rows_matched"] = *step.rowsMatched;
+            filter["ms"] = rounded(step.milliseconds);
+        }
+        return filter;
+    }
+
+    void writeFilter(const QueryProfile::FilterStep &step, bool analyze, ostream &out) {
+        out << "  where " << step.condition << ": " << step.access;
+        if (step.segments > 0) {
+            out << ", " << step.skippedSegments << " of " << step.segments << " segments skipped";
+        }
+        if (analyze) {
+            if (step.rowsChecked) out << ", " << *step.rowsChecked << " rows checked";
+            if (step.rowsMatched) out << ", " << *step.rowsMatched << " matched";
+            out << ", " << milliseconds(step.milliseconds) << " ms";
+        }
+        out << "\n";
+    }
+
+    /**
+     * @brief Time that no phase accounts for, e.g. checking the statement and taking locks
+     */
+    double otherMilliseconds(const QueryProfile &profile, double total) {
+        double other = total;
+        for (const auto &[phase, name]: phaseNames) other -= profile.milliseconds(phase);
+        return other > 0 ? other : 0;
+    }
+
+    void writeJson(const QueryProfile &profile, const string &statement, double total, ostream &out) {
+        bool analyze = profile.analyze();
+        json report = {{"statement", statement}, {"analyze", analyze}};
+
+        json tables = json::array();
+        for (const auto &access: profile.tables()) {
+            json table = {{"table", access.table}, {"rows", access.rows}, {"deleted", access.deleted}};
+            if (!access.access.empty()) table["access"] = access.access;
+            json filters = json::array();
+            for (const auto &step: access.filters) filters.push_back(filterJson(step, analyze));
+            table["filters"] = std::move(filters);
+            if (access.matched) table["rows_matched"] = *access.matched;
+            tables.push_back(std::move(table));
+        }
+        report["tables"] = std::move(tables);
+
+        if (!profile.join().empty()) {
+            report["join"] = profile.join();
+            json filters = json::array();
+            for (const auto &step: profile.joinFilters()) filters.push_back(filterJson(step, analyze));
+            report["join_filters"] = std::move(filters);
+        }
+        if (!profile.order().empty()) {
+            report["order"] = profile.order();
+        }
+
+        if (analyze) {
+            json columns = json::array();
+            for (const auto &read: profile.columns()) {
+                columns.push_back({
+                    {"table", read.table}, {"column", read.column}, {"how", read.how}, {"reads", read.reads},
+                    {"rows", read.rows}, {"ms", rounded(read.milliseconds)}
+                });
+            }
+            report["columns"] = std::move(columns);
+            if (profile.result()) report["rows"] = *profile.result();
+
+            json timings = json::object();
+            for (const auto &[phase, name]: phaseNames) timings[name] = rounded(profile.milliseconds(phase));
+            timings["other"] = rounded(otherMilliseconds(profile, total));
+            timings["total"] = rounded(total);
+            report["timings_ms"] = std::move(timings);
+        }
+
+        out << json{{"status", "success"}, {"explain", std::move(report)}}.dump(4) << endl;
+    }
+
+    void writeText(const QueryProfile &profile, const string &statement, double total, ostream &out) {
+        bool analyze = profile.analyze();
+        out << (analyze ? "EXPLAIN ANALYZE " : "EXPLAIN ") << statement << "\n";
+        for (const auto &access: profile.tables()) {
+            out << "table " << access.table << ": " << access.rows << " rows, " << access.deleted << " deleted\n";
+            if (!access.access.empty()) out << "  access: " << access.access << "\n";
+            for (const auto &step: access.filters) writeFilter(step, analyze, out);
+            if (access.matched) out << "  rows matched: " << *access.matched << "\n";
+        }
+        if (!profile.join().empty()) {
+            out << "join: " << profile.join() << "\n";
+            for (const auto &step: profile.joinFilters()) writeFilter(step, analyze, out);
+        }
+        if (!profile.order().empty()) {
+            out << "order: " << profile.order() << "\n";
+        }
+        if (!analyze) {
+            out.flush();
+            return;
+        }
+
+        if (!profile.columns().empty()) {
+            out << "columns read:\n";
+            for (const auto &read: profile.columns()) {
+                out << "  " << read.table << "." << read.column << ": " << read.how << ", " << read.reads << " read"
+                        << (read.reads != 1 ? "s" : "") << ", " << read.rows << " rows, "
+                        << milliseconds(read.milliseconds) << " ms\n";
+            }
+        }
+        if (profile.result()) {
+            out << "rows " << (statement == "SELECT" ? "returned" : "changed") << ": " << *profile.result() << "\n";
+        }
+        out << "time (ms):";
+        for (const auto &[phase, name]: phaseNames) {
+            if (profile.milliseconds(phase) > 0) out << " " << name << " " << milliseconds(profile.milliseconds(phase));
+        }
+        out << " other " << milliseconds(otherMilliseconds(profile, total)) << ", total " << milliseconds(total)
+                << endl;
+    }
+}
+
+/**
+ * @brief Prints the report of an EXPLAIN or EXPLAIN ANALYZE.
+ *
+ * Tables are listed in the order they were read, each with the WHERE conditions evaluated
+ * against it in evaluation order. Without ANALYZE only the plan is printed: how each table
+ * and condition would be accessed, the join and the ordering. With ANALYZE the rows checked
+ * and matched by every condition, the column reads by how they were served (decoded from the
+ * file, from the table cache, mapped or sliced per segment), the rows returned or changed and
+ * the time of each phase are added. Phases exclude the phases nested in them, so they add up
+ * to the total but for `other`.
+ *
+ * @param profile The profile the statement recorded into.
+ * @param statement The name of the explained statement.
+ * @param totalMilliseconds The time of the whole statement, parsing included.
+ * @param asJson Whether to print one JSON object instead of text.
+ * @param out Where the report is printed.
+ */
+void Explain::write(const QueryProfile &profile, const string &statement, double totalMilliseconds, bool asJson,
+                    ostream &out) {
+    if (asJson) {
+        writeJson(profile, statement, totalMilliseconds, out);
+    } else {
+        writeText(profile, statement, totalMilliseconds, out);
+    }
+}
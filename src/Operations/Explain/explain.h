@@ -0,0 +1,19 @@
+#pragma once
+#include <iostream>
+#include <string>
+
+#include "../../Storage/queryProfile.h"
+
+using namespace std;
+
+class Explain {
+public:
+    /**
+     * @brief Prints what a profile recorded, as JSON or as indented text
+     *
+     * @param statement The name of the explained statement, e.g. SELECT
+     * @param totalMilliseconds The time of the whole statement, parsing included
+     */
+    static void write(const QueryProfile &profile, const string &statement, double totalMilliseconds, bool asJson,
+                      ostream &out);
+};
@@ -1,5 +1,7 @@
 #include "insert.h"
-#include <fstream>
+#include "../../Storage/catalog.h"
+#include "../../Storage/tableStore.h"
+#include <algorithm>
 #include <iostream>
 #include <filesystem>
 #include <nlohmann/json.hpp>
@@ -10,22 +12,22 @@ namespace fs = filesystem;
 
 /**
  * Inserts a new record into the specified table with atomicity guarantees.
- * Uses a temp-file staging strategy to ensure data consistency even in case of failures.
+ * The row is appended to the table's insert log as a single checksummed record, so the
+ * cost of an insert does not depend on the size of the table.
  *
  * Operation Details:
  * 1. Validates input parameters and loads table metadata
  * 2. For each column in the table:
  *    - Validates NOT NULL constraints
- *    - Enforces UNIQUE constraints
+ *    - Enforces UNIQUE constraints (NULL may repeat), before the row is logged
  *    - Validates and converts data types
- *    - Writes to a temporary file
- * 3. On success: Atomically renames all temp files to their final names
- * 4. On failure: Cleans up any temporary files and throws an exception
+ * 3. On success: Durably appends the complete row to the insert log
+ * 4. On failure: Throws an exception before anything is written
  *
  * Type Handling:
- * - Integers: Validates and stores as JSON number_integer
- * - Floats: Validates and stores as JSON number_float
- * - Booleans: Converts from string (true/false) to JSON boolean
+ * - Integers: Validates and stores as 64-bit integers
+ * - Floats: Validates and stores as doubles (integer literals are widened)
+ * - Booleans: Converts from string (true/false) to a boolean
  * - Strings: Preserves content, handles quoted values
  *
  * @param databaseName Name of the target database
@@ -40,43 +42,43 @@ void InsertIntoTable::insert(
     const vector<string> &columns,
     const vector<json> &values
 ) {
-    fs::path homeDir = getenv("HOME");
-    if (homeDir.empty()) homeDir = getenv("USERPROFILE");
-    fs::path basePath = homeDir / ".mashdb" / "databases" / databaseName / tableName;
-
-    if (!fs::exists(basePath)) {
-        fs::create_directories(basePath);
-    }
-
-    fs::path columnsDir = basePath / "Columns";
-    if (!fs::exists(columnsDir)) {
-        fs::create_directories(columnsDir);
-    }
-    fs::path infoFilePath = basePath / "Table-info.json";
-
-    string basePathStr = basePath.string();
-    string infoFilePathStr = infoFilePath.string();
+    insertRows(databaseName, tableName, columns, {values});
+}
 
-    if (!fs::exists(basePath)) {
+/**
+ * Inserts a batch of records into the specified table.
+ *
+ * Every row is validated before anything is written: NOT NULL and type checks run column
+ * by column over the whole batch, and TableStore::appendRows() checks UNIQUE columns before
+ * it logs the batch. The batch is then appended to the table as one atomic record, and large
+ * batches are folded straight into the column files so that each column is written once.
+ *
+ * @param databaseName Name of the target database
+ * @param tableName Name of the target table
+ * @param columns List of column names shared by all rows
+ * @param rows Values of each row, in the order of `columns`
+ * @throws std::runtime_error If any row fails validation or the write fails
+ */
+void InsertIntoTable::insertRows(
+    const string &databaseName,
+    const string &tableName,
+    const vector<string> &columns,
+    const vector<vector<json> > &rows
+) {
+    shared_ptr<const TableSchema> schema = Catalog::find(databaseName, tableName);
+    if (!schema) {
         throw runtime_error("Table doesn't exist");
     }
 
-    ifstream infoFile(infoFilePath);
-    if (!infoFile.is_open()) {
-        throw runtime_error("Table-info.json not found");
-    }
-
-    json tableInfo;
-    infoFile >> tableInfo;
-    infoFile.close();
-
     vector<string> columnsOfTable;
-    for (auto &el: tableInfo.items()) {
-        columnsOfTable.push_back(el.key());
+    for (const auto &column: schema->columns) {
+        columnsOfTable.push_back(column.name);
     }
 
-    if (columns.size() != values.size())
-        throw runtime_error("Must initialize value for every column");
+    for (const auto &values: rows) {
+        if (columns.size() != values.size())
+            throw runtime_error("Must initialize value for every column");
+    }
 
     if (columns.size() > columnsOfTable.size())
         throw runtime_error("Too many columns");
@@ -86,117 +88,77 @@ void InsertIntoTable::insert(
             throw runtime_error("Column doesn't exist: " + col);
     }
 
-    vector<pair<string, string> > staged;
+    TableStore table(*schema);
+    vector<vector<json> > batch(rows.size(), vector<json>(columnsOfTable.size()));
+
+    auto toLower = [](string s) {
+        transform(s.begin(), s.end(), s.begin(),
+                  [](unsigned char c) { return tolower(c); });
+        return s;
+    };
+
+    for (size_t c = 0; c < columnsOfTable.size(); ++c) {
+        const ColumnSchema &columnSchema = schema->columns[c];
+        const string &column = columnSchema.name;
+        bool notNull = columnSchema.notNull;
+        string expectedType = toLower(columnSchema.typeName);
+        ColumnType columnType = columnSchema.type;
+
+        int index = -1;
+        for (size_t i = 0; i < columns.size(); ++i) {
+            if (columns[i] == column) {
+                index = i;
+                break;
+            }
+        }
 
-    try {
-        for (const auto &column: columnsOfTable) {
-            fs::path finalPath = basePath / "Columns" / (column + ".json");
-            if (!fs::exists(finalPath))
-                throw runtime_error("Missing column file: " + column);
+        if (index == -1) {
+            if (notNull && !rows.empty())
+                throw runtime_error("Value cannot be null for column: " + column);
+            continue;
+        }
 
-            ifstream colFile(finalPath);
-            string content((istreambuf_iterator<char>(colFile)), istreambuf_iterator<char>());
-            colFile.close();
+        for (size_t r = 0; r < rows.size(); ++r) {
+            json typedVal = rows[r][index];
 
-            json colJson;
-            if (!content.empty()) {
-                colJson = json::parse(content);
-            } else {
-                colJson = json::object();
-                colJson[column] = json::array();
-            }
+            if (!typedVal.is_null()) {
+                bool typeValid = false;
 
-            json colInfo = tableInfo[column];
-            string type = colInfo["type"];
-            bool isUnique = colInfo["isUnique"];
-            bool notNull = colInfo["notNull"];
-
-            auto &dataArray = colJson[column];
-            int index = -1;
-            for (size_t i = 0; i < columns.size(); ++i) {
-                if (columns[i] == column) {
-                    index = i;
-                    break;
-                }
-            }
-
-            if (index == -1) {
-                if (notNull)
-                    throw runtime_error("Value cannot be null for column: " + column);
-                else
-                    dataArray.push_back(nullptr);
-            } else {
-                const json &typedVal = values[index];
-
-                auto toLower = [](string s) {
-                    transform(s.begin(), s.end(), s.begin(),
-                              [](unsigned char c) { return tolower(c); });
-                    return s;
-                };
-                string expectedType = toLower(type);
-
-                if (!typedVal.is_null()) {
-                    bool typeValid = false;
-
-                    if (expectedType == "int" || expectedType == "integer") {
+                switch (columnType) {
+                    case ColumnType::Integer:
                         typeValid = typedVal.is_number_integer();
-                    } else if (expectedType == "float" || expectedType == "double" || expectedType == "real") {
+                        break;
+                    case ColumnType::Float:
                         typeValid = typedVal.is_number_float() || typedVal.is_number_integer();
-                    } else if (expectedType == "bool" || expectedType == "boolean") {
+                        break;
+                    case ColumnType::Boolean:
                         typeValid = typedVal.is_boolean();
-                    } else {
+                        break;
+                    case ColumnType::Text:
                         typeValid = typedVal.is_string();
-                    }
-
-                    if (!typeValid) {
-                        string typeName;
-                        if (typedVal.is_string()) typeName = "string";
-                        else if (typedVal.is_number_integer()) typeName = "integer";
-                        else if (typedVal.is_number_float()) typeName = "float";
-                        else if (typedVal.is_boolean()) typeName = "boolean";
-                        else typeName = "unknown";
-
-                        throw runtime_error("Type mismatch for column '" + column + "': "
-                                            "expected " + expectedType + ", got " + typeName);
-                    }
+                        break;
                 }
 
-                if (isUnique) {
-                    auto it = find(dataArray.begin(), dataArray.end(), typedVal);
-                    if (it != dataArray.end()) {
-                        throw runtime_error("Duplicate value for unique column: " + column);
-                    }
-                }
+                if (!typeValid) {
+                    string typeName;
+                    if (typedVal.is_string()) typeName = "string";
+                    else if (typedVal.is_number_integer()) typeName = "integer";
+                    else if (typedVal.is_number_float()) typeName = "float";
+                    else if (typedVal.is_boolean()) typeName = "boolean";
+                    else typeName = "unknown";
 
-                dataArray.push_back(typedVal);
-            }
+                    throw runtime_error("Type mismatch for column '" + column + "': "
+                                        "expected " + expectedType + ", got " + typeName);
+                }
 
-            fs::path tempPath = finalPath;
-            tempPath += ".tmp";
-            {
-                ofstream outFile(tempPath, ios::trunc);
-                outFile << colJson.dump(4);
-                outFile.close();
+                if (columnType == ColumnType::Float && typedVal.is_number_integer()) {
+                    typedVal = typedVal.get<double>();
+                }
             }
 
-            staged.emplace_back(tempPath.string(), finalPath.string());
+            batch[r][c] = std::move(typedVal);
         }
-
-        for (const auto &p: staged) {
-            const string &tempPath = p.first;
-            const string &finalPath = p.second;
-            if (fs::exists(finalPath)) {
-                fs::remove(finalPath);
-            }
-            fs::rename(tempPath, finalPath);
-        }
-    } catch (const exception &e) {
-        for (const auto &p: staged) {
-            const string &tempPath = p.first;
-            if (fs::exists(tempPath)) {
-                fs::remove(tempPath);
-            }
-        }
-        throw;
     }
+
+    table.appendRows(batch);
 }
@@ -15,4 +15,11 @@ public:
         const vector<string> &columns,
         const vector<json> &values
     );
+
+    static void insertRows(
+        const string &databaseName,
+        const string &tableName,
+        const vector<string> &columns,
+        const vector<vector<json> > &rows
+    );
 };
@@ -0,0 +1,207 @@
+#include "loadData.h"
+#include "insert.h"
+#include "../../Storage/catalog.h"
+#include "../../Storage/columnStore.h"
+
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <nlohmann/json.hpp>
+
+using namespace std;
+namespace fs = filesystem;
+using json = nlohmann::json;
+
+namespace {
+    struct CsvField {
+        string text;
+        bool quoted = false;
+    };
+
+    /**
+     * Splits CSV content into records. Fields may be enclosed in double quotes, in which case
+     * they can contain commas, line breaks and doubled quotes ("").
+     */
+    vector<pair<size_t, vector<CsvField> > > parseCsv(const string &content) {
+        vector<pair<size_t, vector<CsvField> > > records;
+        vector<CsvField> record;
+        CsvField field;
+        bool inQuotes = false;
+        bool fieldStarted = false;
+        size_t line = 1;
+        size_t recordLine = 1;
+
+        auto endField = [&]() {
+            record.push_back(std::move(field));
+            field = CsvField();
+            fieldStarted = false;
+        };
+        auto endRecord = [&]() {
+            endField();
+            bool blank = record.size() == 1 && record[0].text.empty() && !record[0].quoted;
+            if (!blank) {
+                records.emplace_back(recordLine, std::move(record));
+            }
+            record.clear();
+            recordLine = line;
+        };
+
+        for (size_t i = 0; i < content.size(); ++i) {
+            char c = content[i];
+            if (inQuotes) {
+                if (c == '"') {
+                    if (i + 1 < content.size() && content[i + 1] == '"') {
+                        field.text += '"';
+                        ++i;
+                    } else {
+                        inQuotes = false;
+                    }
+                } else {
+                    if (c == '\n') ++line;
+                    field.text += c;
+                }
+            } else if (c == '"' && !fieldStarted) {
+                inQuotes = true;
+                field.quoted = true;
+                fieldStarted = true;
+            } else if (c == ',') {
+                endField();
+            } else if (c == '\n') {
+                ++line;
+                endRecord();
+            } else if (c != '\r') {
+                field.text += c;
+                fieldStarted = true;
+            }
+        }
+
+        if (inQuotes) {
+            throw runtime_error("Unterminated quoted field in CSV starting on line " + to_string(recordLine));
+        }
+        if (fieldStarted || !record.empty()) {
+            endRecord();
+        }
+        return records;
+    }
+
+    string trim(const string &s) {
+        size_t start = s.find_first_not_of(" \t");
+        if (start == string::npos) return "";
+        size_t end = s.find_last_not_of(" \t");
+        return s.substr(start, end - start + 1);
+    }
+
+    string toLower(string s) {
+        for (auto &ch: s) ch = static_cast<char>(tolower(ch));
+        return s;
+    }
+
+    json convertField(const CsvField &field, ColumnType type, const string &column, size_t line) {
+        string text = field.quoted ? field.text : trim(field.text);
+        if (!field.quoted && (text.empty() || toLower(text) == "null")) {
+            return nullptr;
+        }
+
+        auto invalid = [&](const string &typeName) {
+            return runtime_error("Invalid " + typeName + " value '" + text + "' for column '" + column +
+                                 "' on line " + to_string(line));
+        };
+
+        switch (type) {
+            case ColumnType::Integer: {
+                size_t used = 0;
+                try {
+                    int64_t value = stoll(text, &used);
+                    if (used == text.size()) return value;
+                } catch (const exception &) {
+                }
+                throw invalid("integer");
+            }
+            case ColumnType::Float: {
+                size_t used = 0;
+                try {
+                    double value = stod(text, &used);
+                    if (used == text.size()) return value;
+                } catch (const exception &) {
+                }
+                throw invalid("float");
+            }
+            case ColumnType::Boolean: {
+                string lower = toLower(text);
+                if (lower == "true" || lower == "1") return true;
+                if (lower == "false" || lower == "0") return false;
+                throw invalid("boolean");
+            }
+            case ColumnType::Text:
+                return text;
+        }
+        return nullptr;
+    }
+}
+
+/**
+ * Loads the rows of a CSV file into a table in a single batch.
+ *
+ * The first line of the file names the columns being loaded; columns of the table that are
+ * not listed are set to NULL. Each field is converted according to the declared type of its
+ * column, and unquoted empty fields or NULL are loaded as NULL. The rows are then inserted
+ * with InsertIntoTable::insertRows, so constraints are checked for the whole file before
+ * anything is written.
+ *
+ * @param databaseName Name of the target database
+ * @param tableName Name of the target table
+ * @param filePath Path of the CSV file
+ * @return The number of rows loaded
+ * @throws std::runtime_error If the file cannot be read, a field cannot be converted, or
+ * the rows violate a constraint of the table
+ */
+size_t LoadData::loadCsv(const string &databaseName, const string &tableName, const string &filePath) {
+    shared_ptr<const TableSchema> schema = Catalog::find(databaseName, tableName);
+    if (!schema) {
+        throw runtime_error("Table doesn't exist");
+    }
+
+    ifstream csvFile(filePath, ios::binary);
+    if (!csvFile.is_open()) {
+        throw runtime_error("Failed to open CSV file: " + filePath);
+    }
+    string content((istreambuf_iterator<char>(csvFile)), istreambuf_iterator<char>());
+    csvFile.close();
+
+    auto records = parseCsv(content);
+    if (records.empty()) {
+        throw runtime_error("CSV file is empty: " + filePath);
+    }
+
+    vector<string> columns;
+    vector<ColumnType> types;
+    for (const auto &field: records[0].second) {
+        string name = trim(field.text);
+        const ColumnSchema *column = schema->column(name);
+        if (!column) {
+            throw runtime_error("Column doesn't exist: " + name);
+        }
+        columns.push_back(name);
+        types.push_back(column->type);
+    }
+
+    vector<vector<json> > rows;
+    rows.reserve(records.size() - 1);
+    for (size_t r = 1; r < records.size(); ++r) {
+        const auto &[line, fields] = records[r];
+        if (fields.size() != columns.size()) {
+            throw runtime_error("Expected " + to_string(columns.size()) + " fields on line " + to_string(line) +
+                                ", got " + to_string(fields.size()));
+        }
+
+        vector<json> row;
+        row.reserve(fields.size());
+        for (size_t c = 0; c < fields.size(); ++c) {
+            row.push_back(convertField(fields[c], types[c], columns[c], line));
+        }
+        rows.push_back(std::move(row));
+    }
+
+    InsertIntoTable::insertRows(databaseName, tableName, columns, rows);
+    return rows.size();
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <string>
+
+using namespace std;
+
+class LoadData {
+public:
+    static size_t loadCsv(
+        const string &databaseName,
+        const string &tableName,
+        const string &filePath
+    );
+};
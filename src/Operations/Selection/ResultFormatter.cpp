@@ -1,47 +1,157 @@
 #include "ResultFormatter.hpp"
+#include "../../Storage/queryProfile.h"
 #include <algorithm>
 #include <iomanip>
 #include <sstream>
+#include <string_view>
 #include <nlohmann/json.hpp>
 
 namespace Selection {
-    std::string ResultFormatter::formatAsTable(const json &result, const std::vector<std::string> &columns) {
-        if (result.empty()) {
-            return "No rows returned\n";
+    namespace {
+        /**
+         * @brief Appends a row the way it appears inside the "data" array of json.dump(4)
+         */
+        void appendIndentedRow(std::string &out, const json &row) {
+            std::string text = row.dump(4);
+            out += "        ";
+            for (char c: text) {
+                out += c;
+                if (c == '\n') out += "        ";
+            }
+        }
+
+        void appendCsvField(std::string &out, std::string_view text) {
+            bool quote = !text.empty() && (text.front() == ' ' || text.back() == ' ');
+            quote = quote || text.find_first_of(",\"\r\n") != std::string_view::npos;
+            if (!quote) {
+                out += text;
+                return;
+            }
+            out += '"';
+            for (char c: text) {
+                if (c == '"') out += '"';
+                out += c;
+            }
+            out += '"';
         }
 
-        std::vector<std::string> cols = columns;
-        if (cols.empty() && !result.empty()) {
+        void appendCsvValue(std::string &out, const json &value) {
+            if (value.is_null()) return;
+            if (value.is_string()) {
+                appendCsvField(out, value.get_ref<const std::string &>());
+            } else if (value.is_boolean()) {
+                out += value.get<bool>() ? "true" : "false";
+            } else if (value.is_number_unsigned()) {
+                out += std::to_string(value.get<uint64_t>());
+            } else if (value.is_number_integer()) {
+                out += std::to_string(value.get<int64_t>());
+            } else {
+                out += value.dump();
+            }
+        }
+    }
+
+    RowStream ResultFormatter::streamOf(const json &result, const std::vector<std::string> &columns) {
+        RowStream rows;
+        rows.columns = columns;
+        if (rows.columns.empty() && !result.empty()) {
             for (auto &[key, _]: result[0].items()) {
-                cols.push_back(key);
+                rows.columns.push_back(key);
             }
         }
+        rows.count = result.size();
+        bool done = false;
+        rows.next = [&result, done](json::array_t &batch) mutable {
+            batch.clear();
+            if (done || result.empty()) {
+                return false;
+            }
+            done = true;
+            batch = result.get<json::array_t>();
+            return true;
+        };
+        return rows;
+    }
+
+    std::string ResultFormatter::formatAsTable(const json &result, const std::vector<std::string> &columns) {
+        RowStream rows = streamOf(result, columns);
+        std::ostringstream ss;
+        writeTable(rows, ss);
+        return ss.str();
+    }
 
-        std::vector<size_t> widths = calculateColumnWidths(result, cols);
+    std::string ResultFormatter::formatAsJson(const json &result, const std::vector<std::string> &columns) {
+        RowStream rows = streamOf(result, columns);
+        std::ostringstream ss;
+        writeJson(rows, ss);
+        return ss.str();
+    }
 
-        std::stringstream ss;
-        ss << createHorizontalLine(widths) << "\n";
+    void ResultFormatter::write(RowStream &rows, OutputFormat format, std::ostream &out) {
+        QueryProfile::Timer timer(QueryProfile::Phase::Format);
+        switch (format) {
+            case OutputFormat::Table:
+                writeTable(rows, out);
+                break;
+            case OutputFormat::Json:
+                writeJson(rows, out);
+                break;
+            case OutputFormat::NdJson:
+                writeNdJson(rows, out);
+                break;
+            case OutputFormat::Csv:
+                writeCsv(rows, out);
+                break;
+        }
+    }
 
-        for (size_t i = 0; i < cols.size(); ++i) {
-            ss << "|" << std::left << std::setw(widths[i]) << std::setfill(' ')
-                    << " " + cols[i] + " ";
+    /**
+     * @brief Writes rows as an aligned table.
+     *
+     * Column widths are measured on the header and the first TABLE_SAMPLE_ROWS rows, so the
+     * table can be written while later rows are still being produced.
+     *
+     * @param rows The rows to write.
+     * @param out The stream to write to.
+     */
+    void ResultFormatter::writeTable(RowStream &rows, std::ostream &out) {
+        json::array_t batch;
+        if (!rows.next(batch)) {
+            out << "No rows returned\n";
+            return;
         }
-        ss << "|\n";
 
-        ss << createHorizontalLine(widths) << "\n";
+        const std::vector<std::string> &cols = rows.columns;
+        std::vector<size_t> widths = calculateColumnWidths(batch, cols);
 
-        for (const auto &row: result) {
-            ss << formatRow(row, cols, widths) << "\n";
+        out << createHorizontalLine(widths) << "\n";
+        for (size_t i = 0; i < cols.size(); ++i) {
+            out << "|" << std::left << std::setw(widths[i]) << std::setfill(' ')
+                    << " " + cols[i] + " ";
         }
+        out << "|\n";
+        out << createHorizontalLine(widths) << "\n";
 
-        ss << createHorizontalLine(widths) << "\n";
-        ss << result.size() << " row" << (result.size() != 1 ? "s" : "") << " in set\n";
+        // One buffer holds the lines of a whole batch, so its memory is reused from batch to batch
+        size_t written = 0;
+        std::string lines;
+        do {
+            lines.clear();
+            for (const auto &row: batch) {
+                formatRow(row, cols, widths, lines);
+                lines += '\n';
+            }
+            out << lines;
+            written += batch.size();
+            out.flush();
+        } while (rows.next(batch));
 
-        return ss.str();
+        out << createHorizontalLine(widths) << "\n";
+        out << written << " row" << (written != 1 ? "s" : "") << " in set\n";
     }
 
     std::vector<size_t> ResultFormatter::calculateColumnWidths(
-        const json &result,
+        const json::array_t &rows,
         const std::vector<std::string> &columns
     ) {
         std::vector<size_t> widths(columns.size(), 0);
@@ -49,18 +159,21 @@ namespace Selection {
         for (size_t i = 0; i < columns.size(); ++i) {
             widths[i] = columns[i].length() + 2;
         }
-        for (const auto &row: result) {
+        size_t sampled = std::min(rows.size(), TABLE_SAMPLE_ROWS);
+        for (size_t r = 0; r < sampled; ++r) {
+            const json &row = rows[r];
             for (size_t i = 0; i < columns.size(); ++i) {
-                const auto &col = columns[i];
-                std::string value;
-
-                if (row.contains(col)) {
-                    value = valueToString(row[col]);
+                auto value = row.find(columns[i]);
+                size_t length;
+                if (value == row.end()) {
+                    length = 4; // NULL
+                } else if (value->is_string()) {
+                    length = value->get_ref<const std::string &>().size();
                 } else {
-                    value = "NULL";
+                    length = valueToString(*value).size();
                 }
 
-                widths[i] = std::max(widths[i], value.length() + 2);
+                widths[i] = std::max(widths[i], length + 2);
             }
         }
 
@@ -76,60 +189,116 @@ namespace Selection {
         return line;
     }
 
-    std::string ResultFormatter::formatRow(
+    void ResultFormatter::appendValue(std::string &line, const json &value) {
+        if (value.is_string()) {
+            line += value.get_ref<const std::string &>();
+        } else {
+            line += valueToString(value);
+        }
+    }
+
+    void ResultFormatter::formatRow(
         const json &row,
         const std::vector<std::string> &columns,
-        const std::vector<size_t> &columnWidths
+        const std::vector<size_t> &columnWidths,
+        std::string &line
     ) {
-        std::stringstream ss;
-
         for (size_t i = 0; i < columns.size(); ++i) {
-            const auto &col = columns[i];
-            std::string value;
-
-            if (row.contains(col)) {
-                value = valueToString(row[col]);
+            size_t start = line.size();
+            line += "| ";
+            auto value = row.find(columns[i]);
+            if (value != row.end()) {
+                appendValue(line, *value);
             } else {
-                value = "NULL";
+                line += "NULL";
             }
+            line += ' ';
 
-            ss << "|" << std::left << std::setw(columnWidths[i]) << std::setfill(' ')
-                    << " " + value + " ";
+            // Padded on the right to the column width, like std::setw with std::left
+            size_t length = line.size() - start - 1;
+            if (length < columnWidths[i]) {
+                line.append(columnWidths[i] - length, ' ');
+            }
         }
 
-        ss << "|";
-        return ss.str();
+        line += '|';
     }
 
-    std::string ResultFormatter::formatAsJson(const json &result, const std::vector<std::string> &columns) {
-        if (result.empty()) {
-            return "{\"status\":\"success\",\"data\":[]}";
+    /**
+     * @brief Writes rows as the JSON document `{"count": ..., "data": [...], "status": "success"}`.
+     *
+     * The document is laid out exactly like json::dump(4) of the whole result, but each row
+     * is dumped on its own as it arrives. An empty result is the compact
+     * `{"status":"success","data":[]}`.
+     *
+     * @param rows The rows to write.
+     * @param out The stream to write to.
+     */
+    void ResultFormatter::writeJson(RowStream &rows, std::ostream &out) {
+        json::array_t batch;
+        if (!rows.next(batch)) {
+            out << "{\"status\":\"success\",\"data\":[]}";
+            return;
         }
 
-        json output;
-        output["status"] = "success";
+        out << "{\n    \"count\": " << rows.count << ",\n    \"data\": [\n";
+        bool first = true;
+        std::string text;
+        do {
+            text.clear();
+            for (const auto &row: batch) {
+                text += first ? "" : ",\n";
+                first = false;
+                if (row.size() == rows.columns.size()) {
+                    appendIndentedRow(text, row);
+                    continue;
+                }
+                json filteredRow;
+                for (const auto &col: rows.columns) {
+                    auto value = row.find(col);
+                    if (value != row.end()) {
+                        filteredRow[col] = *value;
+                    }
+                }
+                appendIndentedRow(text, filteredRow);
+            }
+            out << text;
+            out.flush();
+        } while (rows.next(batch));
+        out << "\n    ],\n    \"status\": \"success\"\n}";
+    }
 
-        std::vector<std::string> cols = columns;
-        if (cols.empty() && !result.empty()) {
-            for (auto &[key, _]: result[0].items()) {
-                cols.push_back(key);
+    void ResultFormatter::writeNdJson(RowStream &rows, std::ostream &out) {
+        json::array_t batch;
+        while (rows.next(batch)) {
+            for (const auto &row: batch) {
+                out << row << "\n";
             }
+            out.flush();
         }
+    }
+
+    void ResultFormatter::writeCsv(RowStream &rows, std::ostream &out) {
+        std::string text;
+        for (size_t i = 0; i < rows.columns.size(); ++i) {
+            if (i > 0) text += ',';
+            appendCsvField(text, rows.columns[i]);
+        }
+        out << text << "\n";
 
-        json filteredResults = json::array();
-        for (const auto &row: result) {
-            json filteredRow;
-            for (const auto &col: cols) {
-                if (row.contains(col)) {
-                    filteredRow[col] = row[col];
+        json::array_t batch;
+        while (rows.next(batch)) {
+            text.clear();
+            for (const auto &row: batch) {
+                for (size_t i = 0; i < rows.columns.size(); ++i) {
+                    if (i > 0) text += ',';
+                    auto value = row.find(rows.columns[i]);
+                    if (value != row.end()) appendCsvValue(text, *value);
                 }
+                text += '\n';
             }
-            filteredResults.push_back(filteredRow);
+            out << text;
+            out.flush();
         }
-
-        output["data"] = filteredResults;
-        output["count"] = result.size();
-
-        return output.dump(4);
     }
 }
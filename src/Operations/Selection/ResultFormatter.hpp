@@ -1,6 +1,8 @@
 #pragma once
 
 #include <nlohmann/json.hpp>
+#include <functional>
+#include <ostream>
 #include <string>
 #include <vector>
 #include <iomanip>
@@ -9,8 +11,52 @@
 using json = nlohmann::json;
 
 namespace Selection {
+    /**
+     * @brief How query results are printed: an aligned table, one JSON document, one JSON
+     * object per line (NDJSON) or CSV with a header line
+     */
+    enum class OutputFormat { Table, Json, NdJson, Csv };
+
+    /**
+     * @brief Result rows handed to a writer batch by batch
+     *
+     * `next` replaces its argument with the next batch and returns false once there are no
+     * more rows. `count` is the total number of rows.
+     */
+    struct RowStream {
+        std::vector<std::string> columns;
+        size_t count = 0;
+        std::function<bool(json::array_t &)> next;
+    };
+
     class ResultFormatter {
     public:
+        /**
+         * @brief Number of leading rows the table writer measures to size its columns; wider
+         * values further down overflow their column instead of being cut
+         */
+        static constexpr size_t TABLE_SAMPLE_ROWS = 10000;
+
+        /**
+         * @brief Writes rows in the given format as they come, flushing after every batch
+         */
+        static void write(RowStream &rows, OutputFormat format, std::ostream &out);
+
+        static void writeTable(RowStream &rows, std::ostream &out);
+
+        /**
+         * @brief Writes the same document as formatAsJson() without building it in memory
+         */
+        static void writeJson(RowStream &rows, std::ostream &out);
+
+        static void writeNdJson(RowStream &rows, std::ostream &out);
+
+        /**
+         * @brief Writes CSV (RFC 4180): NULL is an empty field, and fields holding a comma,
+         * quote, line break or surrounding spaces are quoted
+         */
+        static void writeCsv(RowStream &rows, std::ostream &out);
+
         /**
          * @brief Formats the query results in a tabular format
          *
@@ -33,24 +79,35 @@ namespace Selection {
          * @brief Calculates the maximum width needed for each column
          */
         static std::vector<size_t> calculateColumnWidths(
-            const json &result,
+            const json::array_t &rows,
             const std::vector<std::string> &columns
         );
 
+        /**
+         * @brief Wraps a materialized result, deriving the columns from its first row if none are given
+         */
+        static RowStream streamOf(const json &result, const std::vector<std::string> &columns);
+
         /**
          * @brief Creates a horizontal line for the table
          */
         static std::string createHorizontalLine(const std::vector<size_t> &columnWidths);
 
         /**
-         * @brief Formats a single row of data
+         * @brief Appends a single row of data to `line`
          */
-        static std::string formatRow(
+        static void formatRow(
             const json &row,
             const std::vector<std::string> &columns,
-            const std::vector<size_t> &columnWidths
+            const std::vector<size_t> &columnWidths,
+            std::string &line
         );
 
+        /**
+         * @brief Appends a value the way valueToString() prints it, without copying text
+         */
+        static void appendValue(std::string &line, const json &value);
+
         /**
          * @brief Converts any value to a string with proper formatting
          */
@@ -0,0 +1,492 @@
+#include "aggregate.h"
+#include "select.h"
+#include "../../Parser/predicate.h"
+#include "../../Storage/catalog.h"
+#include "../../Storage/morsels.h"
+#include "../../Storage/queryProfile.h"
+#include "../../Storage/tableStore.h"
+#include "../../Storage/zoneMap.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <unordered_map>
+
+using namespace std;
+using json = nlohmann::json;
+namespace fs = filesystem;
+
+namespace Selection {
+    namespace {
+        using Function = SelectItem::Function;
+
+        constexpr size_t NO_ROW = numeric_limits<size_t>::max();
+
+        /**
+         * @brief The running state of one aggregate over one group
+         */
+        struct Accumulator {
+            int64_t count = 0; // rows for COUNT(*), non-NULL values otherwise
+            int64_t integerSum = 0;
+            double realSum = 0; // also kept for integers, for AVG once integerSum overflowed
+            bool overflow = false;
+            size_t minRow = NO_ROW;
+            size_t maxRow = NO_ROW;
+        };
+
+        /**
+         * @brief The groups a morsel of rows fell into, in the order of their first row, and
+         * the accumulators of every aggregate for each of them
+         */
+        struct Partial {
+            vector<string> keys;
+            vector<size_t> firstRows;
+            vector<vector<Accumulator> > accumulators; // [aggregate][group]
+        };
+
+        template<typename T>
+        void appendRaw(string &out, const T &value) {
+            out.append(reinterpret_cast<const char *>(&value), sizeof(T));
+        }
+
+        /**
+         * @brief Appends the value of a row to a group key; equal values append equal bytes
+         *
+         * Dictionary-encoded texts append their code instead of the text.
+         */
+        void appendKey(string &key, const Column &column, size_t row) {
+            if (column.nulls[row]) {
+                key += '\0';
+                return;
+            }
+            key += '\1';
+            switch (column.type) {
+                case ColumnType::Integer:
+                    appendRaw(key, column.ints[row]);
+                    break;
+                case ColumnType::Float: {
+                    double value = column.floats[row];
+                    appendRaw(key, value == 0 ? 0.0 : value); // -0.0 groups with 0.0
+                    break;
+                }
+                case ColumnType::Boolean:
+                    key += static_cast<char>(column.bools[row]);
+                    break;
+                case ColumnType::Text:
+                    if (column.dictionary) {
+                        appendRaw(key, column.codes[row]);
+                    } else {
+                        appendRaw(key, static_cast<uint32_t>(column.texts[row].size()));
+                        key += column.texts[row];
+                    }
+                    break;
+            }
+        }
+
+        /**
+         * @brief Folds rows into the accumulators of one aggregate, one loop per function
+         *
+         * @param function The aggregate function.
+         * @param column The aggregated column, or nullptr for COUNT(*).
+         * @param rows The rows to fold.
+         * @param groups The group of each row.
+         * @param accumulators One accumulator per group.
+         */
+        void accumulate(Function function, const Column *column, const size_t *rows, const vector<uint32_t> &groups,
+                        vector<Accumulator> &accumulators) {
+            size_t count = groups.size();
+            if (!column) {
+                for (size_t i = 0; i < count; ++i) ++accumulators[groups[i]].count;
+                return;
+            }
+
+            const vector<uint8_t> &nulls = column->nulls;
+            switch (function) {
+                case Function::Sum:
+                case Function::Avg:
+                    if (column->type == ColumnType::Integer) {
+                        const vector<int64_t> &values = column->ints;
+                        for (size_t i = 0; i < count; ++i) {
+                            if (nulls[rows[i]]) continue;
+                            Accumulator &acc = accumulators[groups[i]];
+                            int64_t value = values[rows[i]];
+                            ++acc.count;
+                            acc.overflow = acc.overflow || __builtin_add_overflow(acc.integerSum, value, &acc.integerSum);
+                            acc.realSum += static_cast<double>(value);
+                        }
+                    } else {
+                        const vector<double> &values = column->floats;
+                        for (size_t i = 0; i < count; ++i) {
+                            if (nulls[rows[i]]) continue;
+                            Accumulator &acc = accumulators[groups[i]];
+                            ++acc.count;
+                            acc.realSum += values[rows[i]];
+                        }
+                    }
+                    return;
+                case Function::Min:
+                case Function::Max:
+                    for (size_t i = 0; i < count; ++i) {
+                        size_t row = rows[i];
+                        if (nulls[row]) continue;
+                        Accumulator &acc = accumulators[groups[i]];
+                        ++acc.count;
+                        if (function == Function::Min && (acc.minRow == NO_ROW || column->less(row, acc.minRow))) {
+                            acc.minRow = row;
+                        }
+                        if (function == Function::Max && (acc.maxRow == NO_ROW || column->less(acc.maxRow, row))) {
+                            acc.maxRow = row;
+                        }
+                    }
+                    return;
+                default:
+                    for (size_t i = 0; i < count; ++i) {
+                        if (!nulls[rows[i]]) ++accumulators[groups[i]].count;
+                    }
+                    return;
+            }
+        }
+
+        /**
+         * @brief Adds the accumulator of a later morsel to that of the same group so far
+         */
+        void combine(Accumulator &into, const Accumulator &from, const Column *column) {
+            into.count += from.count;
+            into.overflow = into.overflow || from.overflow ||
+                            __builtin_add_overflow(into.integerSum, from.integerSum, &into.integerSum);
+            into.realSum += from.realSum;
+            if (from.minRow != NO_ROW && (into.minRow == NO_ROW || column->less(from.minRow, into.minRow))) {
+                into.minRow = from.minRow;
+            }
+            if (from.maxRow != NO_ROW && (into.maxRow == NO_ROW || column->less(into.maxRow, from.maxRow))) {
+                into.maxRow = from.maxRow;
+            }
+        }
+
+        /**
+         * @brief The value of an aggregate over a group; an overflowed SUM was rejected before
+         */
+        json finish(const SelectItem &item, const Column *column, const Accumulator &acc) {
+            switch (item.function) {
+                case Function::Count:
+                    return acc.count;
+                case Function::Sum:
+                    if (acc.count == 0) return nullptr;
+                    if (column->type == ColumnType::Float) return acc.realSum;
+                    return acc.integerSum;
+                case Function::Avg:
+                    if (acc.count == 0) return nullptr;
+                    if (column->type == ColumnType::Integer && !acc.overflow) {
+                        return static_cast<double>(acc.integerSum) / static_cast<double>(acc.count);
+                    }
+                    return acc.realSum / static_cast<double>(acc.count);
+                case Function::Min:
+                    return acc.minRow == NO_ROW ? json(nullptr) : column->at(acc.minRow);
+                case Function::Max:
+                    return acc.maxRow == NO_ROW ? json(nullptr) : column->at(acc.maxRow);
+                default:
+                    return nullptr;
+            }
+        }
+
+        /**
+         * @brief The bound of a zone as a value of its column
+         */
+        json zoneBound(const Zone &zone, ColumnType type, bool maximum) {
+            switch (type) {
+                case ColumnType::Integer:
+                    return maximum ? zone.maxInteger : zone.minInteger;
+                case ColumnType::Boolean:
+                    return (maximum ? zone.maxInteger : zone.minInteger) != 0;
+                case ColumnType::Float:
+                    return maximum ? zone.maxReal : zone.minReal;
+                case ColumnType::Text:
+                    return maximum ? zone.maxText : zone.minText;
+            }
+            return nullptr;
+        }
+
+        /**
+         * @brief Answers COUNT and MIN/MAX over a whole table from its zone maps, without
+         * reading the column files.
+         *
+         * COUNT(*) is the row count minus the deleted rows. The other aggregates combine the
+         * zones of the column with one computed over its logged rows, so they need a table
+         * without deleted rows (a deleted row may hold the minimum) and bounded zones.
+         *
+         * @param table The table.
+         * @param items The aggregates of the select list.
+         * @return The value of every item, or nullopt if one of them cannot be answered so.
+         */
+        optional<vector<json> > answerFromZones(TableStore &table, const vector<SelectItem> &items) {
+            vector<json> values;
+            for (const auto &item: items) {
+                if (item.function == Function::Count && item.column.empty()) {
+                    values.emplace_back(table.rowCount() - table.deletions().count());
+                    continue;
+                }
+                if ((item.function != Function::Count && item.function != Function::Min &&
+                     item.function != Function::Max) || !table.deletions().empty()) {
+                    return nullopt;
+                }
+
+                ColumnType type = table.columnType(item.column);
+                vector<Zone> zones = table.zones(item.column);
+                size_t covered = zones.empty() ? 0 : zones.back().firstRow + zones.back().rows;
+                size_t rowCount = table.rowCount();
+                if (covered < rowCount) {
+                    Column logged = table.sliceColumn(item.column, covered, rowCount);
+                    zones.push_back(ZoneMaps::compute(logged, 0, logged.size()));
+                }
+
+                size_t nonNull = 0;
+                json bound = nullptr;
+                bool maximum = item.function == Function::Max;
+                for (const auto &zone: zones) {
+                    nonNull += zone.rows - zone.nulls;
+                    if (item.function == Function::Count || zone.nulls == zone.rows) continue;
+                    if (!zone.bounded) return nullopt;
+                    json value = zoneBound(zone, type, maximum);
+                    if (bound.is_null() || (maximum ? bound < value : value < bound)) bound = std::move(value);
+                }
+                values.push_back(item.function == Function::Count ? json(nonNull) : bound);
+            }
+            return values;
+        }
+    }
+
+    string itemName(const SelectItem &item) {
+        const char *function = "";
+        switch (item.function) {
+            case Function::None:
+                return item.column;
+            case Function::Count:
+                function = "COUNT";
+                break;
+            case Function::Sum:
+                function = "SUM";
+                break;
+            case Function::Avg:
+                function = "AVG";
+                break;
+            case Function::Min:
+                function = "MIN";
+                break;
+            case Function::Max:
+                function = "MAX";
+                break;
+        }
+        return string(function) + "(" + (item.column.empty() ? "*" : item.column) + ")";
+    }
+
+    /**
+     * @brief Implements aggregate queries with a hash aggregation over the decoded columns
+     *
+     * The rows matching the WHERE condition are found like in openSelect(). They are then cut
+     * into morsels: each one hashes its rows' GROUP BY values into groups of its own and folds
+     * them into per-group accumulators, column by column, and the partial groups are merged
+     * in morsel order, so the result does not depend on the number of threads. Only the
+     * grouped and aggregated columns are read. Unfiltered COUNT(*), COUNT, MIN and MAX
+     * without GROUP BY are answered from the zone maps instead when possible.
+     */
+    json aggregateTable(
+        const string &databaseName,
+        const string &tableName,
+        const vector<SelectItem> &items,
+        const vector<string> &groupBy,
+        const optional<ConditionExpr> &whereCondition,
+        const optional<SelectItem> &orderBy,
+        bool ascending,
+        optional<size_t> limit,
+        size_t offset
+    ) {
+        shared_ptr<const TableSchema> schema = Catalog::find(databaseName, tableName);
+        if (!schema) {
+            throw runtime_error("Table doesn't exist");
+        }
+        const json &tableInfo = *schema->info;
+        TableStore table(*schema);
+        QueryProfile::beginTable(tableName, table.rowCount(), table.deletions().count());
+
+        for (const auto &column: groupBy) {
+            if (!tableInfo.contains(column)) throw runtime_error("Column doesn't exist: " + column);
+        }
+        auto check = [&](const SelectItem &item) {
+            if (!item.column.empty() && !tableInfo.contains(item.column)) {
+                throw runtime_error("Column doesn't exist: " + item.column);
+            }
+            if (item.function == Function::None &&
+                find(groupBy.begin(), groupBy.end(), item.column) == groupBy.end()) {
+                throw runtime_error("Column must appear in GROUP BY or be used in an aggregate: " + item.column);
+            }
+            if ((item.function == Function::Sum || item.function == Function::Avg) &&
+                table.columnType(item.column) != ColumnType::Integer &&
+                table.columnType(item.column) != ColumnType::Float) {
+                throw runtime_error(itemName(item) + " needs a numeric column");
+            }
+        };
+
+        // The groups are ordered by the last computed item, which is only output if selected
+        vector<SelectItem> computed = items;
+        for (const auto &item: computed) check(item);
+        optional<size_t> orderItem;
+        if (orderBy) {
+            check(*orderBy);
+            auto it = find(computed.begin(), computed.end(), *orderBy);
+            orderItem = it - computed.begin();
+            if (it == computed.end()) computed.push_back(*orderBy);
+        }
+
+        map<string, shared_ptr<const Column> > loadedColumns;
+        function<const Column &(const string &)> columnData = [&](const string &col) -> const Column & {
+            auto it = loadedColumns.find(col);
+            if (it == loadedColumns.end()) {
+                it = loadedColumns.emplace(col, table.sharedColumn(col)).first;
+            }
+            return *it->second;
+        };
+
+        // Values are only built for the groups that are sorted or returned
+        size_t groupCount = 1;
+        function<json(size_t group, size_t item)> valueOf;
+        optional<vector<json> > fromZones;
+        if (!whereCondition && groupBy.empty()) {
+            fromZones = answerFromZones(table, computed);
+        }
+        vector<const Column *> itemColumns;
+        vector<size_t> firstRows;
+        vector<vector<Accumulator> > totals(computed.size());
+
+        if (fromZones) {
+            QueryProfile::setAccess("zone maps (no rows read)");
+            if (QueryProfile::planning()) {
+                return json::array();
+            }
+            valueOf = [&](size_t, size_t item) { return (*fromZones)[item]; };
+        } else {
+
+            optional<PredicateTree> predicate;
+            if (whereCondition) {
+                predicate = PredicateTree::compile(*whereCondition,
+                                                   [&](const string &col) { return table.columnType(col); });
+            }
+            vector<size_t> rows = matchingRows(table, predicate ? &*predicate : nullptr, columnData);
+            if (QueryProfile::planning()) {
+                return json::array();
+            }
+            QueryProfile::Timer timer(QueryProfile::Phase::Aggregate);
+
+            // Every column is loaded up front, as the morsels read them concurrently
+            vector<string> needed = groupBy;
+            for (const auto &item: computed) {
+                if (!item.column.empty() && !rows.empty()) needed.push_back(item.column);
+            }
+            table.loadColumns(needed, loadedColumns);
+
+            vector<const Column *> keyColumns;
+            for (const auto &column: groupBy) keyColumns.push_back(&columnData(column));
+            for (const auto &item: computed) {
+                itemColumns.push_back(item.column.empty() || rows.empty() ? nullptr : &columnData(item.column));
+            }
+
+            vector<Partial> partials((rows.size() + Morsels::MORSEL_ROWS - 1) / Morsels::MORSEL_ROWS);
+            Morsels::forEach(rows.size(), [&](size_t first, size_t last) {
+                Partial &partial = partials[first / Morsels::MORSEL_ROWS];
+                vector<uint32_t> groups(last - first, 0);
+                if (keyColumns.empty()) {
+                    partial.keys.emplace_back();
+                    partial.firstRows.push_back(rows[first]);
+                } else {
+                    unordered_map<string, uint32_t> ids;
+                    string key;
+                    for (size_t i = first; i < last; ++i) {
+                        key.clear();
+                        for (const Column *column: keyColumns) appendKey(key, *column, rows[i]);
+                        auto [it, inserted] = ids.try_emplace(key, static_cast<uint32_t>(partial.keys.size()));
+                        if (inserted) {
+                            partial.keys.push_back(key);
+                            partial.firstRows.push_back(rows[i]);
+                        }
+                        groups[i - first] = it->second;
+                    }
+                }
+
+                partial.accumulators.assign(computed.size(), vector<Accumulator>(partial.keys.size()));
+                for (size_t a = 0; a < computed.size(); ++a) {
+                    if (computed[a].function == Function::None) continue;
+                    accumulate(computed[a].function, itemColumns[a], rows.data() + first, groups,
+                               partial.accumulators[a]);
+                }
+            });
+
+            size_t partialGroups = 0;
+            for (const auto &partial: partials) partialGroups += partial.keys.size();
+            unordered_map<string, uint32_t> ids;
+            ids.reserve(partialGroups);
+            for (auto &partial: partials) {
+                for (size_t g = 0; g < partial.keys.size(); ++g) {
+                    auto [it, inserted] = ids.try_emplace(std::move(partial.keys[g]),
+                                                          static_cast<uint32_t>(firstRows.size()));
+                    if (inserted) {
+                        firstRows.push_back(partial.firstRows[g]);
+                        for (auto &accumulators: totals) accumulators.emplace_back();
+                    }
+                    for (size_t a = 0; a < computed.size(); ++a) {
+                        combine(totals[a][it->second], partial.accumulators[a][g], itemColumns[a]);
+                    }
+                }
+            }
+            // Without GROUP BY there is one group even if no row matched
+            if (groupBy.empty() && firstRows.empty()) {
+                firstRows.push_back(NO_ROW);
+                for (auto &accumulators: totals) accumulators.emplace_back();
+            }
+
+            for (size_t a = 0; a < computed.size(); ++a) {
+                if (computed[a].function != Function::Sum) continue;
+                for (const auto &total: totals[a]) {
+                    if (total.overflow) throw runtime_error("Integer overflow in " + itemName(computed[a]));
+                }
+            }
+
+            groupCount = firstRows.size();
+            valueOf = [&](size_t group, size_t item) {
+                return computed[item].function == Function::None
+                           ? columnData(computed[item].column).at(firstRows[group])
+                           : finish(computed[item], itemColumns[item], totals[item][group]);
+            };
+        }
+
+        vector<size_t> order(groupCount);
+        for (size_t g = 0; g < order.size(); ++g) order[g] = g;
+        if (orderItem) {
+            // NULLs first in ascending order and last in descending order, like in openSelect()
+            vector<json> keys(groupCount);
+            for (size_t g = 0; g < groupCount; ++g) keys[g] = valueOf(g, *orderItem);
+            stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+                const json &x = keys[a];
+                const json &y = keys[b];
+                if (x.is_null() != y.is_null()) return ascending ? x.is_null() : y.is_null();
+                return ascending ? x < y : y < x;
+            });
+        }
+
+        json result = json::array();
+        size_t first = min(offset, order.size());
+        size_t count = order.size() - first;
+        if (limit.has_value()) count = min(count, *limit);
+        QueryProfile::setResult(count);
+        for (size_t i = first; i < first + count; ++i) {
+            json row = json::object();
+            for (size_t a = 0; a < items.size(); ++a) {
+                row[itemName(items[a])] = valueOf(order[i], a);
+            }
+            result.push_back(std::move(row));
+        }
+        return result;
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+#include "../../Parser/conditionParser.h"
+#include "../../Parser/statement.h"
+
+using namespace std;
+using json = nlohmann::json;
+
+namespace Selection {
+    /**
+     * @brief The result column of a select list item: `COUNT(*)`, `SUM(price)`, or the
+     * column itself for a GROUP BY column
+     */
+    string itemName(const SelectItem &item);
+
+    /**
+     * @brief Executes an aggregate query on the specified table
+     *
+     * Rows that match the WHERE condition are grouped by the GROUP BY columns (all into one
+     * group without them), and every row of the result describes one group; without GROUP BY
+     * there is exactly one. COUNT counts rows, or non-NULL values of a column; SUM, AVG, MIN
+     * and MAX skip NULLs and are NULL for a group without values. SUM and AVG take numeric
+     * columns only. Without ORDER BY, groups come in the order of their first row.
+     *
+     * @param databaseName Name of the database
+     * @param tableName Name of the table to query
+     * @param items The select list; columns that are not aggregated must be GROUP BY columns
+     * @param groupBy The GROUP BY columns
+     * @param whereCondition Optional condition expression to filter rows; its columns must name columns of the table
+     * @param orderBy Optional select list item or GROUP BY column to order the groups by
+     * @param ascending Sort order (true = ascending, false = descending)
+     * @param limit Optional maximum number of groups to return
+     * @param offset Optional number of groups to skip
+     * @return json Array of result rows, keyed by itemName()
+     * @throws std::runtime_error if a column does not exist or cannot be aggregated, or a SUM overflows
+     */
+    json aggregateTable(
+        const string &databaseName,
+        const string &tableName,
+        const vector<SelectItem> &items,
+        const vector<string> &groupBy = {},
+        const optional<ConditionExpr> &whereCondition = nullopt,
+        const optional<SelectItem> &orderBy = nullopt,
+        bool ascending = true,
+        optional<size_t> limit = nullopt,
+        size_t offset = 0
+    );
+}
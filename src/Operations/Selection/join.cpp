@@ -0,0 +1,523 @@
+#include "join.h"
+#include "select.h"
+#include "../../Parser/predicate.h"
+#include "../../Storage/catalog.h"
+#include "../../Storage/morsels.h"
+#include "../../Storage/queryProfile.h"
+#include "../../Storage/tableStore.h"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+
+using namespace std;
+using json = nlohmann::json;
+namespace fs = filesystem;
+
+namespace Selection {
+    namespace {
+        constexpr size_t NO_ROW = numeric_limits<size_t>::max();
+
+        /**
+         * @brief One table of the join: its storage, the columns loaded so far, the WHERE
+         * conditions that only read it and the rows that pass them
+         */
+        struct Side {
+            JoinTable name;
+            unique_ptr<TableStore> table;
+            map<string, shared_ptr<const Column> > loaded;
+            vector<ConditionExpr> pushed;
+            vector<size_t> rows;
+
+            const Column &column(const string &col) {
+                auto it = loaded.find(col);
+                if (it == loaded.end()) {
+                    it = loaded.emplace(col, table->sharedColumn(col)).first;
+                }
+                return *it->second;
+            }
+
+            /**
+             * @brief The table's spelling of a column name, which is matched case-insensitively
+             * like in single-table WHERE conditions
+             */
+            optional<string> spelling(const string &col) const {
+                const json &info = table->info();
+                if (info.contains(col)) return col;
+                for (auto it = info.begin(); it != info.end(); ++it) {
+                    if (it.key().size() == col.size() &&
+                        equal(col.begin(), col.end(), it.key().begin(), [](char a, char b) {
+                            return tolower(static_cast<unsigned char>(a)) == tolower(static_cast<unsigned char>(b));
+                        })) {
+                        return it.key();
+                    }
+                }
+                return nullopt;
+            }
+        };
+
+        /**
+         * @brief A column reference resolved to one of the two tables
+         */
+        struct ColumnRef {
+            size_t side = 0;
+            string column;
+        };
+
+        ColumnRef resolve(const string &name, Side (&sides)[2]) {
+            size_t dot = name.find('.');
+            if (dot != string::npos) {
+                string qualifier = name.substr(0, dot);
+                for (size_t s = 0; s < 2; ++s) {
+                    if (sides[s].name.qualifier() != qualifier) continue;
+                    if (auto column = sides[s].spelling(name.substr(dot + 1))) return {s, *column};
+                    throw runtime_error("Column doesn't exist: " + name);
+                }
+                throw runtime_error("Unknown table in column reference: " + name);
+            }
+
+            optional<ColumnRef> found;
+            for (size_t s = 0; s < 2; ++s) {
+                if (auto column = sides[s].spelling(name)) {
+                    if (found) throw runtime_error("Column reference is ambiguous: " + name);
+                    found = ColumnRef{s, *column};
+                }
+            }
+            if (!found) throw runtime_error("Column doesn't exist: " + name);
+            return *found;
+        }
+
+        string qualified(const ColumnRef &ref, Side (&sides)[2]) {
+            return sides[ref.side].name.qualifier() + "." + ref.column;
+        }
+
+        /**
+         * @brief Resolves the columns of a condition, marking the tables it reads in `used` and
+         * renaming each column to its bare name or, with `qualify`, to `qualifier.column`
+         */
+        void resolveLeaves(ConditionExpr &expr, Side (&sides)[2], bool (&used)[2], bool qualify) {
+            for (auto &child: expr.children) {
+                resolveLeaves(child, sides, used, qualify);
+            }
+            if (expr.kind == ConditionExpr::Kind::Leaf) {
+                ColumnRef ref = resolve(expr.condition.column, sides);
+                used[ref.side] = true;
+                expr.condition.column = qualify ? qualified(ref, sides) : ref.column;
+            }
+        }
+
+        void collectColumns(const ConditionExpr &expr, vector<string> &columns) {
+            for (const auto &child: expr.children) {
+                collectColumns(child, columns);
+            }
+            if (expr.kind == ConditionExpr::Kind::Leaf) {
+                columns.push_back(expr.condition.column);
+            }
+        }
+
+        ConditionExpr conjunction(vector<ConditionExpr> operands) {
+            if (operands.size() == 1) {
+                return std::move(operands[0]);
+            }
+            ConditionExpr expr;
+            expr.kind = ConditionExpr::Kind::And;
+            expr.children = std::move(operands);
+            return expr;
+        }
+
+        /**
+         * @brief Copies the values of a column at the given rows into a new column, so
+         * predicates and sorting can run over the joined rows
+         */
+        Column gather(const Column &column, const vector<size_t> &rows) {
+            Column out;
+            out.type = column.type;
+            size_t count = rows.size();
+            out.nulls.resize(count);
+            auto copy = [&](const auto &from, auto &to) {
+                to.resize(count);
+                Morsels::forEach(count, [&](size_t first, size_t last) {
+                    for (size_t i = first; i < last; ++i) {
+                        out.nulls[i] = column.nulls[rows[i]];
+                        to[i] = from[rows[i]];
+                    }
+                });
+            };
+            switch (column.type) {
+                case ColumnType::Integer:
+                    copy(column.ints, out.ints);
+                    break;
+                case ColumnType::Float:
+                    copy(column.floats, out.floats);
+                    break;
+                case ColumnType::Boolean:
+                    copy(column.bools, out.bools);
+                    break;
+                case ColumnType::Text:
+                    copy(column.texts, out.texts);
+                    if (column.dictionary) {
+                        out.dictionary = column.dictionary;
+                        out.codes.resize(count);
+                        for (size_t i = 0; i < count; ++i) out.codes[i] = column.codes[rows[i]];
+                    }
+                    break;
+            }
+            return out;
+        }
+
+        /**
+         * @brief Key readers for the hash table: each stores the join key of a row in `key`
+         * and returns false for rows that cannot match anything (NULL, or NaN)
+         */
+        auto integerKey(const Column &column) {
+            return [&column](size_t row, int64_t &key) {
+                if (column.nulls[row]) return false;
+                key = column.type == ColumnType::Integer ? column.ints[row] : column.bools[row];
+                return true;
+            };
+        }
+
+        auto realKey(const Column &column) {
+            return [&column](size_t row, double &key) {
+                if (column.nulls[row]) return false;
+                double value = column.type == ColumnType::Integer ? static_cast<double>(column.ints[row])
+                                                                  : column.floats[row];
+                key = value == 0 ? 0.0 : value; // -0.0 matches 0.0
+                return !std::isnan(value);
+            };
+        }
+
+        auto textKey(const Column &column) {
+            return [&column](size_t row, string_view &key) {
+                if (column.nulls[row]) return false;
+                key = column.texts[row];
+                return true;
+            };
+        }
+
+        /**
+         * @brief Hashes the build rows by key and looks every probe row up.
+         *
+         * Rows with equal keys are chained in ascending order, and probe morsels run in
+         * parallel and are concatenated in order, so the pairs come in probe row order and,
+         * for each probe row, in build row order.
+         *
+         * @param buildRows The rows of the table the hash table is built from.
+         * @param probeRows The rows of the other table.
+         * @param buildKey Reads the key of a build row.
+         * @param probeKey Reads the key of a probe row.
+         * @return The matching pairs, flattened as probe row, build row, probe row, ...
+         */
+        template<typename Key, typename BuildKey, typename ProbeKey>
+        vector<size_t> matchPairs(const vector<size_t> &buildRows, const vector<size_t> &probeRows,
+                                  const BuildKey &buildKey, const ProbeKey &probeKey) {
+            unordered_map<Key, size_t> heads;
+            heads.reserve(buildRows.size());
+            vector<size_t> next(buildRows.size(), NO_ROW);
+            Key key{};
+            for (size_t i = buildRows.size(); i-- > 0;) {
+                if (!buildKey(buildRows[i], key)) continue;
+                auto [it, inserted] = heads.try_emplace(key, i);
+                if (!inserted) {
+                    next[i] = it->second;
+                    it->second = i;
+                }
+            }
+
+            return Morsels::collect(probeRows.size(), [&](size_t first, size_t last, vector<size_t> &out) {
+                Key probe{};
+                for (size_t i = first; i < last; ++i) {
+                    if (!probeKey(probeRows[i], probe)) continue;
+                    auto it = heads.find(probe);
+                    if (it == heads.end()) continue;
+                    for (size_t b = it->second; b != NO_ROW; b = next[b]) {
+                        out.push_back(probeRows[i]);
+                        out.push_back(buildRows[b]);
+                    }
+                }
+            });
+        }
+
+        /**
+         * @brief Reorders the pairs by a permutation of their positions, keeping only those listed
+         */
+        void permute(vector<size_t> (&pairs)[2], const vector<size_t> &order) {
+            for (auto &rows: pairs) {
+                vector<size_t> reordered(order.size());
+                for (size_t i = 0; i < order.size(); ++i) reordered[i] = rows[order[i]];
+                rows = std::move(reordered);
+            }
+        }
+    }
+
+    struct JoinResult::State {
+        Side sides[2];
+        vector<size_t> pairs[2]; // the row of each table in every joined row
+        vector<pair<size_t, const Column *> > projected;
+        size_t first = 0;
+        size_t produced = 0;
+    };
+
+    JoinResult::JoinResult() : state(make_unique<State>()) {
+    }
+
+    JoinResult::~JoinResult() = default;
+
+    /**
+     * @brief Builds the next rows of the result, in morsels on several threads.
+     *
+     * @param rows Replaced with the next batch of at most SelectResult::batchRows() rows,
+     * overwriting the rows of the previous batch in place.
+     * @return false if every row was already produced, in which case `rows` is left empty.
+     */
+    bool JoinResult::next(json::array_t &rows) {
+        size_t begin = state->produced;
+        size_t batch = min(SelectResult::batchRows(), count - begin);
+        if (batch == 0) {
+            rows.clear();
+            return false;
+        }
+
+        QueryProfile::Timer timer(QueryProfile::Phase::Project);
+        rows.resize(batch);
+        const auto &pairs = state->pairs;
+        const auto &projected = state->projected;
+        size_t first = state->first + begin;
+        Morsels::forEach(batch, [&](size_t from, size_t to) {
+            for (size_t i = from; i < to; ++i) {
+                json &row = rows[i];
+                for (size_t c = 0; c < selected.size(); ++c) {
+                    projected[c].second->assignTo(pairs[projected[c].first][first + i], row[selected[c]]);
+                }
+            }
+        });
+        state->produced += batch;
+        return true;
+    }
+
+    /**
+     * @brief Implements SELECT over an inner equijoin of two tables with a hash join
+     *
+     * The conjuncts of the WHERE condition that read a single table are pushed down to it,
+     * so each table is filtered on its own, with its indexes and zone maps, before the join.
+     * The hash table is built from the side with fewer remaining rows and probed with the
+     * other in parallel morsels. Conjuncts that read both tables are checked on the joined
+     * rows, followed by ORDER BY and LIMIT; only then are the selected columns read.
+     */
+    unique_ptr<JoinResult> openJoin(
+        const string &databaseName,
+        const JoinTable &left,
+        const JoinTable &right,
+        const string &leftKey,
+        const string &rightKey,
+        const vector<string> &columns,
+        const optional<ConditionExpr> &whereCondition,
+        const string &orderByColumn,
+        bool ascending,
+        optional<size_t> limit,
+        size_t offset
+    ) {
+        if (left.qualifier() == right.qualifier()) {
+            throw runtime_error("Both tables of the JOIN are called " + left.qualifier() + "; give one an alias");
+        }
+
+        auto joinResult = unique_ptr<JoinResult>(new JoinResult());
+        JoinResult::State &state = *joinResult->state;
+        Side (&sides)[2] = state.sides;
+        const JoinTable *names[2] = {&left, &right};
+        for (size_t s = 0; s < 2; ++s) {
+            shared_ptr<const TableSchema> schema = Catalog::find(databaseName, names[s]->table);
+            if (!schema) {
+                throw runtime_error("Table doesn't exist: " + names[s]->table);
+            }
+            sides[s].name = *names[s];
+            sides[s].table = make_unique<TableStore>(*schema);
+        }
+
+        // The ON columns, turned around if they were written right table first
+        ColumnRef keys[2] = {resolve(leftKey, sides), resolve(rightKey, sides)};
+        if (keys[0].side == keys[1].side) {
+            throw runtime_error("The JOIN condition must compare a column of each table");
+        }
+        if (keys[0].side == 1) {
+            swap(keys[0], keys[1]);
+        }
+
+        // Output columns, resolved before any data is read so mistakes fail fast
+        vector<ColumnRef> outputs;
+        if (columns.empty()) {
+            for (size_t s = 0; s < 2; ++s) {
+                for (const auto &column: sides[s].table->columnNames()) {
+                    outputs.push_back({s, column});
+                    joinResult->selected.push_back(qualified(outputs.back(), sides));
+                }
+            }
+        } else {
+            for (const auto &column: columns) {
+                outputs.push_back(resolve(column, sides));
+                joinResult->selected.push_back(column);
+            }
+        }
+        optional<ColumnRef> orderRef;
+        if (!orderByColumn.empty()) {
+            orderRef = resolve(orderByColumn, sides);
+        }
+
+        vector<ConditionExpr> residual;
+        if (whereCondition) {
+            vector<ConditionExpr> conjuncts;
+            if (whereCondition->kind == ConditionExpr::Kind::And) {
+                conjuncts = whereCondition->children;
+            } else {
+                conjuncts.push_back(*whereCondition);
+            }
+            for (auto &conjunct: conjuncts) {
+                bool used[2] = {false, false};
+                ConditionExpr bare = conjunct;
+                resolveLeaves(bare, sides, used, false);
+                if (used[0] != used[1]) {
+                    sides[used[0] ? 0 : 1].pushed.push_back(std::move(bare));
+                } else {
+                    resolveLeaves(conjunct, sides, used, true);
+                    residual.push_back(std::move(conjunct));
+                }
+            }
+        }
+
+        for (auto &side: sides) {
+            TableStore &table = *side.table;
+            QueryProfile::beginTable(side.name.table, table.rowCount(), table.deletions().count());
+            optional<PredicateTree> predicate;
+            if (!side.pushed.empty()) {
+                predicate = PredicateTree::compile(conjunction(std::move(side.pushed)),
+                                                   [&](const string &col) { return table.columnType(col); });
+            }
+            side.rows = matchingRows(table, predicate ? &*predicate : nullptr,
+                                     [&side](const string &col) -> const Column & { return side.column(col); });
+        }
+
+        ColumnType keyTypes[2] = {sides[0].table->columnType(keys[0].column),
+                                  sides[1].table->columnType(keys[1].column)};
+        auto numeric = [](ColumnType type) { return type == ColumnType::Integer || type == ColumnType::Float; };
+        if (keyTypes[0] != keyTypes[1] && !(numeric(keyTypes[0]) && numeric(keyTypes[1]))) {
+            throw runtime_error("JOIN columns cannot be compared: " + qualified(keys[0], sides) + " and " +
+                                qualified(keys[1], sides));
+        }
+
+        auto joinedType = [&](const string &col) {
+            ColumnRef ref = resolve(col, sides);
+            return sides[ref.side].table->columnType(ref.column);
+        };
+        string joinOn = "hash join on " + qualified(keys[0], sides) + " = " + qualified(keys[1], sides);
+        auto describeOrder = [&]() {
+            if (!orderRef) return;
+            QueryProfile::setOrder((limit ? "top " + to_string(offset + *limit) + " by " : "sorted by ") +
+                                   qualified(*orderRef, sides) + (ascending ? " ASC" : " DESC"));
+        };
+        if (QueryProfile::planning()) {
+            QueryProfile::beginJoinFilter(joinOn + ", hashing the side with fewer rows");
+            if (!residual.empty()) {
+                PredicateTree predicate = PredicateTree::compile(conjunction(std::move(residual)), joinedType);
+                predicate.matchingRows(PredicateTree::Source());
+            }
+            describeOrder();
+            return joinResult;
+        }
+
+        vector<size_t> (&pairs)[2] = state.pairs;
+        if (sides[0].rows.empty() || sides[1].rows.empty()) {
+            QueryProfile::beginJoinFilter(joinOn + ", skipped as a side has no rows");
+        } else {
+            QueryProfile::Timer timer(QueryProfile::Phase::Join);
+            size_t build = sides[1].rows.size() <= sides[0].rows.size() ? 1 : 0;
+            QueryProfile::beginJoinFilter(joinOn + ", hashing " + sides[build].name.qualifier());
+            size_t probe = 1 - build;
+            const Column &buildColumn = sides[build].column(keys[build].column);
+            const Column &probeColumn = sides[probe].column(keys[probe].column);
+            const vector<size_t> &buildRows = sides[build].rows;
+            const vector<size_t> &probeRows = sides[probe].rows;
+
+            vector<size_t> matches;
+            if (keyTypes[0] == ColumnType::Text) {
+                matches = matchPairs<string_view>(buildRows, probeRows, textKey(buildColumn), textKey(probeColumn));
+            } else if (keyTypes[0] == ColumnType::Float || keyTypes[1] == ColumnType::Float) {
+                matches = matchPairs<double>(buildRows, probeRows, realKey(buildColumn), realKey(probeColumn));
+            } else {
+                matches = matchPairs<int64_t>(buildRows, probeRows, integerKey(buildColumn),
+                                              integerKey(probeColumn));
+            }
+
+            size_t count = matches.size() / 2;
+            pairs[probe].resize(count);
+            pairs[build].resize(count);
+            for (size_t i = 0; i < count; ++i) {
+                pairs[probe][i] = matches[2 * i];
+                pairs[build][i] = matches[2 * i + 1];
+            }
+
+            // Probing with the right table yields right-major order; put the left rows first
+            if (probe == 1) {
+                vector<size_t> order(count);
+                for (size_t i = 0; i < count; ++i) order[i] = i;
+                const vector<size_t> &leftRows = pairs[0];
+                Morsels::sort(order, [&](size_t a, size_t b) { return leftRows[a] < leftRows[b]; });
+                permute(pairs, order);
+            }
+        }
+
+        if (!residual.empty() && !pairs[0].empty()) {
+            ConditionExpr condition = conjunction(std::move(residual));
+            vector<string> names;
+            collectColumns(condition, names);
+            map<string, Column> gathered;
+            for (const auto &name: names) {
+                if (gathered.count(name)) continue;
+                ColumnRef ref = resolve(name, sides);
+                gathered.emplace(name, gather(sides[ref.side].column(ref.column), pairs[ref.side]));
+            }
+
+            PredicateTree predicate = PredicateTree::compile(condition, joinedType);
+            PredicateTree::Source source;
+            source.rowCount = pairs[0].size();
+            source.column = [&](const string &col) -> const Column & { return gathered.at(col); };
+            permute(pairs, predicate.matchingRows(source));
+        }
+
+        describeOrder();
+        if (orderRef && !pairs[0].empty()) {
+            Column key = gather(sides[orderRef->side].column(orderRef->column), pairs[orderRef->side]);
+            vector<size_t> order(pairs[0].size());
+            for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+            optional<size_t> needed;
+            if (limit.has_value()) needed = offset + *limit;
+            sortRows(order, key, ascending, needed);
+            permute(pairs, order);
+        }
+
+        state.first = min(offset, pairs[0].size());
+        size_t count = pairs[0].size() - state.first;
+        if (limit.has_value()) count = min(count, *limit);
+        joinResult->count = count;
+        QueryProfile::setResult(count);
+        if (count == 0) {
+            return joinResult;
+        }
+
+        vector<string> outputColumns[2];
+        for (const auto &output: outputs) outputColumns[output.side].push_back(output.column);
+        for (size_t side = 0; side < 2; ++side) {
+            sides[side].table->loadColumns(outputColumns[side], sides[side].loaded);
+        }
+        for (const auto &output: outputs) {
+            state.projected.emplace_back(output.side, &sides[output.side].column(output.column));
+        }
+        return joinResult;
+    }
+}
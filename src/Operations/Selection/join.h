@@ -0,0 +1,99 @@
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+#include "../../Parser/conditionParser.h"
+
+using namespace std;
+using json = nlohmann::json;
+
+namespace Selection {
+    /**
+     * @brief A table of a join and the name its columns are qualified with: the alias if
+     * it has one, the table name otherwise
+     */
+    struct JoinTable {
+        string table;
+        string alias;
+
+        const string &qualifier() const { return alias.empty() ? table : alias; }
+    };
+
+    /**
+     * @brief The rows of a join, built batch by batch like a SelectResult
+     *
+     * Opening the join filters both tables, matches their rows and sorts and paginates the
+     * pairs; the values are fetched when next() asks for a batch. Both tables must stay
+     * locked until the last batch was read.
+     */
+    class JoinResult {
+    public:
+        ~JoinResult();
+
+        const vector<string> &columns() const { return selected; }
+
+        size_t size() const { return count; }
+
+        /**
+         * @brief Replaces `rows` with the next batch; returns false once all rows were produced
+         *
+         * The rows already in `rows` are overwritten rather than freed, so passing the same
+         * array on every call reuses their keys and strings; it must be empty or hold rows of
+         * this result.
+         */
+        bool next(json::array_t &rows);
+
+    private:
+        struct State;
+
+        vector<string> selected;
+        size_t count = 0;
+        unique_ptr<State> state;
+
+        JoinResult();
+
+        friend unique_ptr<JoinResult> openJoin(const string &, const JoinTable &, const JoinTable &, const string &,
+                                               const string &, const vector<string> &,
+                                               const optional<ConditionExpr> &, const string &, bool,
+                                               optional<size_t>, size_t);
+    };
+
+    /**
+     * @brief Plans an inner equijoin of two tables and returns its rows as a JoinResult
+     *
+     * Column references are `qualifier.column` or, if only one of the tables has the column,
+     * just `column`. The pairs come in the order of the left table's rows, and for each of
+     * them in the order of the right table's, unless ORDER BY says otherwise.
+     *
+     * @param databaseName Name of the database
+     * @param left The FROM table
+     * @param right The JOIN table
+     * @param leftKey One column of the ON condition
+     * @param rightKey The other column of the ON condition, from the other table
+     * @param columns Columns to select (empty for all columns of both tables, named `qualifier.column`)
+     * @param whereCondition Optional condition expression to filter the joined rows
+     * @param orderByColumn Optional column to order the rows by
+     * @param ascending Sort order (true = ascending, false = descending)
+     * @param limit Optional maximum number of rows to return
+     * @param offset Optional number of rows to skip
+     * @throws std::runtime_error if a table or column does not exist, a column reference is
+     * ambiguous, or the ON columns cannot be compared
+     */
+    unique_ptr<JoinResult> openJoin(
+        const string &databaseName,
+        const JoinTable &left,
+        const JoinTable &right,
+        const string &leftKey,
+        const string &rightKey,
+        const vector<string> &columns = {},
+        const optional<ConditionExpr> &whereCondition = nullopt,
+        const string &orderByColumn = "",
+        bool ascending = true,
+        optional<size_t> limit = nullopt,
+        size_t offset = 0
+    );
+}
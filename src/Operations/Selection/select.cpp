@@ -1,7 +1,16 @@
 #include "select.h"
+#include "../../Parser/predicate.h"
+#include "../../Storage/catalog.h"
+#include "../../Storage/morsels.h"
+#include "../../Storage/queryProfile.h"
+#include "../../Storage/tableCache.h"
+#include "../../Storage/tableStore.h"
 #include <fstream>
 #include <filesystem>
 #include <algorithm>
+#include <cmath>
+#include <functional>
+#include <memory>
 #include <stdexcept>
 
 using namespace std;
@@ -10,66 +19,486 @@ namespace fs = filesystem;
 
 namespace Selection {
     /**
-     * @brief Helper function to load a column from disk
+     * @brief A projection reads mapped cells instead of whole columns when fewer than one in
+     * this many rows is returned
      */
-    static json loadColumn(const string &filePath) {
-        ifstream file(filePath);
-        if (!file.is_open()) {
-            throw runtime_error("Failed to open column file: " + filePath);
+    static constexpr size_t SPARSE_PROJECTION = 16;
+
+    struct KeyRange {
+        optional<OrderedIndex::Bound> lower;
+        optional<OrderedIndex::Bound> upper;
+    };
+
+    /**
+     * @brief Range of all strings starting with the given prefix
+     */
+    static KeyRange prefixRange(const string &prefix) {
+        KeyRange range;
+        range.lower = OrderedIndex::Bound{prefix, true};
+        string next = prefix;
+        while (!next.empty() && static_cast<unsigned char>(next.back()) == 0xFF) {
+            next.pop_back();
+        }
+        if (!next.empty()) {
+            next.back() = static_cast<char>(static_cast<unsigned char>(next.back()) + 1);
+            range.upper = OrderedIndex::Bound{next, false};
+        }
+        return range;
+    }
+
+    /**
+     * @brief Computes the index ranges holding every non-NULL row a predicate can accept
+     *
+     * The ranges may hold a few extra rows (LIKE ranges only cover the pattern's literal
+     * prefix), so the caller still checks each candidate. Returns nullopt when the predicate
+     * cannot be narrowed down, e.g. `!=` or a LIKE pattern starting with a wildcard.
+     */
+    static optional<vector<KeyRange> > indexRangesFor(const Predicate &predicate) {
+        using Op = Predicate::Op;
+        Op op = predicate.op();
+
+        if (op == Op::IsNull) {
+            return vector<KeyRange>();
+        }
+        if (op == Op::NotEqual || op == Op::IsNotNull) {
+            return nullopt;
+        }
+
+        if (op == Op::Like) {
+            if (predicate.type() != ColumnType::Text || predicate.like().literalPrefix().empty()) {
+                return nullopt;
+            }
+            // Letters match in either case, so cover every case combination of the first few
+            string prefix;
+            size_t letters = 0;
+            for (char c: predicate.like().literalPrefix()) {
+                prefix += c;
+                if (isalpha(static_cast<unsigned char>(c)) && ++letters == 6) break;
+            }
+            vector<string> variants{""};
+            for (char c: prefix) {
+                auto uc = static_cast<unsigned char>(c);
+                vector<string> extended;
+                for (const auto &variant: variants) {
+                    if (isalpha(uc)) {
+                        extended.push_back(variant + static_cast<char>(tolower(uc)));
+                        extended.push_back(variant + static_cast<char>(toupper(uc)));
+                    } else {
+                        extended.push_back(variant + c);
+                    }
+                }
+                variants = std::move(extended);
+            }
+
+            vector<KeyRange> ranges;
+            for (const auto &variant: variants) {
+                ranges.push_back(prefixRange(variant));
+            }
+            return ranges;
         }
 
-        string content((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
-        file.close();
+        json low = predicate.value();
+        json high = predicate.value();
+        if (predicate.type() == ColumnType::Integer && predicate.value().is_number_float()) {
+            // Compare whole numbers against a fractional constant by rounding it inwards
+            double target = predicate.value().get<double>();
+            const double limit = 9.2e18;
+            if ((target > limit && op != Op::Less && op != Op::LessEqual) ||
+                (target < -limit && op != Op::Greater && op != Op::GreaterEqual)) {
+                return vector<KeyRange>();
+            }
+            if (target > limit || target < -limit) {
+                return nullopt;
+            }
+            low = static_cast<int64_t>(ceil(target));
+            high = static_cast<int64_t>(floor(target));
+        }
 
-        return content.empty() ? json::object() : json::parse(content);
+        KeyRange range;
+        if (op == Op::Equal || op == Op::Greater || op == Op::GreaterEqual) {
+            range.lower = OrderedIndex::Bound{low, op != Op::Greater || low != predicate.value()};
+        }
+        if (op == Op::Equal || op == Op::Less || op == Op::LessEqual) {
+            range.upper = OrderedIndex::Bound{high, op != Op::Less || high != predicate.value()};
+        }
+        return vector<KeyRange>{range};
     }
 
     /**
-     * @brief Gets all column names for a table
+     * @brief Resolves key ranges to sorted, disjoint runs of index positions
+     *
+     * The NULL entries at the start of the index are included for IS NULL only.
      */
-    static vector<string> getTableColumns(const string &tableInfoPath) {
-        ifstream infoFile(tableInfoPath);
-        if (!infoFile.is_open()) {
-            throw runtime_error("Table-info.json not found");
+    static vector<pair<size_t, size_t> > positionsFor(OrderedIndex &index, const vector<KeyRange> &ranges,
+                                                      bool includeNulls) {
+        vector<pair<size_t, size_t> > spans;
+        if (includeNulls && index.nullCount() > 0) {
+            spans.emplace_back(0, index.nullCount());
+        }
+        for (const auto &range: ranges) {
+            auto span = index.range(range.lower, range.upper);
+            if (span.first < span.second) {
+                spans.push_back(span);
+            }
         }
+        sort(spans.begin(), spans.end());
 
-        json tableInfo;
-        infoFile >> tableInfo;
-        infoFile.close();
+        vector<pair<size_t, size_t> > merged;
+        for (const auto &span: spans) {
+            if (!merged.empty() && span.first <= merged.back().second) {
+                merged.back().second = max(merged.back().second, span.second);
+            } else {
+                merged.push_back(span);
+            }
+        }
+        return merged;
+    }
 
-        vector<string> columns;
-        for (auto &el: tableInfo.items()) {
-            columns.push_back(el.key());
+    /**
+     * @brief Returns the rows that can satisfy a predicate, in row order, using an index on its column
+     *
+     * Returns nullopt when no index applies to the predicate, in which case every row has to
+     * be checked. The returned rows still have to be checked against the predicate.
+     */
+    static optional<vector<size_t> > indexedCandidates(TableStore &table, const Predicate &predicate,
+                                                       size_t rowCount) {
+        using Op = Predicate::Op;
+        const string &column = predicate.column();
+
+        // NULL is not in the hash index, as UNIQUE columns may hold it in any number of rows
+        if (predicate.op() == Op::Equal && table.isUnique(column)) {
+            json key = predicate.value();
+            if (predicate.type() == ColumnType::Integer && key.is_number_float()) {
+                double target = key.get<double>();
+                if (target != floor(target) || fabs(target) > 9.2e18) {
+                    return vector<size_t>();
+                }
+                key = static_cast<int64_t>(target);
+            }
+            optional<size_t> row = table.uniqueIndex(column).find(key);
+            if (row.has_value() && *row < rowCount) {
+                return vector<size_t>{*row};
+            }
+            return vector<size_t>();
         }
-        return columns;
+
+        OrderedIndex *index = table.orderedIndex(column);
+        if (!index) {
+            return nullopt;
+        }
+        optional<vector<KeyRange> > ranges = indexRangesFor(predicate);
+        if (!ranges) {
+            return nullopt;
+        }
+
+        vector<size_t> rows;
+        for (const auto &[first, last]: positionsFor(*index, *ranges, predicate.op() == Op::IsNull)) {
+            for (size_t position = first; position < last; ++position) {
+                rows.push_back(index->rowAt(position));
+            }
+        }
+        for (size_t row = index->coveredRows(); row < rowCount; ++row) {
+            rows.push_back(row);
+        }
+        sort(rows.begin(), rows.end());
+        return rows;
     }
 
     /**
-     * @brief Implements the SELECT operation with filtering, sorting, and pagination
+     * @brief Whether `indexedCandidates` can answer a predicate from an index
+     */
+    static bool isIndexed(TableStore &table, const Predicate &predicate) {
+        using Op = Predicate::Op;
+        if (predicate.op() == Op::Equal && table.isUnique(predicate.column())) {
+            return true;
+        }
+        return table.orderedIndex(predicate.column()) && indexRangesFor(predicate).has_value();
+    }
+
+    /**
+     * @brief Whether every row `indexedCandidates` returns for a predicate satisfies it: a
+     * hash index lookup finds exactly the rows holding the key
+     */
+    static bool isExact(TableStore &table, const Predicate &predicate) {
+        return predicate.op() == Predicate::Op::Equal && table.isUnique(predicate.column());
+    }
+
+    /**
+     * @brief Reads the cells of a column at some rows from its mapping, so checking a few
+     * index candidates does not decode the whole column
+     */
+    static Column cellsAt(TableStore &table, const string &column, const vector<size_t> &rows) {
+        ColumnCells cells = table.mappedColumn(column);
+        Column values;
+        values.type = table.columnType(column);
+        values.reserve(rows.size());
+        for (size_t row: rows) {
+            values.append(cells.at(row));
+        }
+        return values;
+    }
+
+    /**
+     * @brief Produces matching rows in ORDER BY order by walking an ordered index instead of sorting
+     *
+     * Only the given runs of index positions are visited. Equal keys stay in row order, as
+     * in sortRows(), so the result does not depend on whether the index exists. Rows the index
+     * does not cover yet are filtered, sorted and merged in. When `needed` is set, the walk stops as soon as that
+     * many matching rows were found.
+     */
+    static vector<size_t> orderedRows(OrderedIndex &index, const vector<pair<size_t, size_t> > &spans,
+                                      const function<const Column &()> &orderColumn, size_t rowCount,
+                                      bool ascending, const function<bool(size_t)> &matches,
+                                      optional<size_t> needed) {
+        vector<size_t> rows;
+        auto visit = [&](size_t position) {
+            size_t row = index.rowAt(position);
+            if (matches(row)) rows.push_back(row);
+            return !needed || rows.size() < *needed;
+        };
+
+        bool more = true;
+        if (ascending) {
+            for (auto span = spans.begin(); more && span != spans.end(); ++span) {
+                for (size_t position = span->first; more && position < span->second; ++position) {
+                    more = visit(position);
+                }
+            }
+        } else {
+            // Keys come out backwards, but the rows of each run of equal keys still in row order
+            for (auto span = spans.rbegin(); more && span != spans.rend(); ++span) {
+                for (size_t end = span->second; more && end > span->first;) {
+                    size_t start = end - 1;
+                    while (start > span->first && index.sameKey(start - 1, end - 1)) --start;
+                    for (size_t position = start; more && position < end; ++position) {
+                        more = visit(position);
+                    }
+                    end = start;
+                }
+            }
+        }
+
+        vector<size_t> tail;
+        for (size_t row = index.coveredRows(); row < rowCount; ++row) {
+            if (matches(row)) tail.push_back(row);
+        }
+        if (tail.empty()) {
+            return rows;
+        }
+        const Column &values = orderColumn();
+        auto before = [&](size_t a, size_t b) {
+            return ascending ? values.less(a, b) : values.less(b, a);
+        };
+        stable_sort(tail.begin(), tail.end(), before);
+
+        vector<size_t> merged;
+        merged.reserve(rows.size() + tail.size());
+        merge(rows.begin(), rows.end(), tail.begin(), tail.end(), back_inserter(merged), before);
+        if (needed && merged.size() > *needed) {
+            merged.resize(*needed);
+        }
+        return merged;
+    }
+
+    /**
+     * @brief Orders rows by one column with a comparator specialised for its type
+     *
+     * NULLs come first in ascending order and last in descending order, and rows with equal
+     * keys stay in row order, as a stable sort of the ascending rows would leave them. When
+     * only the first `needed` rows are wanted, a bounded heap per morsel keeps just those.
+     */
+    void sortRows(vector<size_t> &rows, const Column &key, bool ascending, optional<size_t> needed) {
+        QueryProfile::Timer timer(QueryProfile::Phase::Sort);
+        auto run = [&](const auto &values) {
+            const vector<uint8_t> &nulls = key.nulls;
+            auto before = [&](size_t a, size_t b) {
+                if (nulls[a] != nulls[b]) {
+                    return ascending ? nulls[a] != 0 : nulls[b] != 0;
+                }
+                if (!nulls[a] && values[a] != values[b]) {
+                    return ascending ? values[a] < values[b] : values[b] < values[a];
+                }
+                return a < b;
+            };
+            if (needed.has_value()) {
+                Morsels::topK(rows, *needed, before);
+            } else {
+                Morsels::sort(rows, before);
+            }
+        };
+
+        switch (key.type) {
+            case ColumnType::Integer:
+                return run(key.ints);
+            case ColumnType::Float:
+                return run(key.floats);
+            case ColumnType::Boolean:
+                return run(key.bools);
+            case ColumnType::Text:
+                return run(key.texts);
+        }
+    }
+
+    /**
+     * @brief Finds the rows a WHERE predicate accepts, using indexes and zone maps where they apply.
+     *
+     * @param table The table to read.
+     * @param predicate The compiled WHERE condition, or nullptr to take every row.
+     * @param columnData Returns a decoded column, loading it on first use.
+     * @return The matching rows that are not deleted, in row order.
+     */
+    vector<size_t> matchingRows(TableStore &table, const PredicateTree *predicate,
+                                const function<const Column &(const string &)> &columnData) {
+        size_t rowCount = table.rowCount();
+        const DeletionVector &deleted = table.deletions();
+        vector<size_t> rows;
+        if (predicate) {
+            PredicateTree::Source source;
+            source.rowCount = rowCount;
+            source.column = columnData;
+            source.candidates = [&](const Predicate &leaf) { return indexedCandidates(table, leaf, rowCount); };
+            source.indexed = [&](const Predicate &leaf) { return isIndexed(table, leaf); };
+            source.exact = [&](const Predicate &leaf) { return isExact(table, leaf); };
+            source.cells = [&](const string &col, const vector<size_t> &at) { return cellsAt(table, col, at); };
+            source.zones = [&](const string &col) { return &table.zones(col); };
+            if (!TableCache::enabled()) {
+                source.slice = [&](const string &col, size_t first, size_t last) {
+                    return table.sliceColumn(col, first, last);
+                };
+            }
+            rows = predicate->matchingRows(source);
+            deleted.dropFrom(rows);
+        } else {
+            QueryProfile::setAccess("full scan");
+            if (QueryProfile::planning()) {
+                return rows;
+            }
+            rows.reserve(rowCount - min(rowCount, deleted.count()));
+            for (size_t i = 0; i < rowCount; ++i) {
+                if (!deleted.contains(i)) rows.push_back(i);
+            }
+        }
+        QueryProfile::setMatched(rows.size());
+        return rows;
+    }
+
+    struct SelectResult::State {
+        unique_ptr<TableStore> table;
+        map<string, shared_ptr<const Column> > loadedColumns;
+        vector<const Column *> projected;
+        vector<unique_ptr<ColumnCells> > mapped;
+        vector<size_t> rowIndices;
+        size_t first = 0;
+        size_t produced = 0;
+    };
+
+    SelectResult::SelectResult() : state(make_unique<State>()) {
+    }
+
+    SelectResult::~SelectResult() = default;
+
+    size_t SelectResult::batchRows() {
+        return Morsels::MORSEL_ROWS * Morsels::maxThreads();
+    }
+
+    /**
+     * @brief Builds the next rows of the result, in morsels on several threads.
+     *
+     * @param rows Replaced with the next batch of at most batchRows() rows, overwriting the
+     * rows of the previous batch in place.
+     * @return false if every row was already produced, in which case `rows` is left empty.
+     * @throws std::runtime_error If a column file turns out to be corrupt.
+     */
+    bool SelectResult::next(json::array_t &rows) {
+        size_t begin = state->produced;
+        size_t batch = min(batchRows(), count - begin);
+        if (batch == 0) {
+            rows.clear();
+            return false;
+        }
+
+        QueryProfile::Timer timer(QueryProfile::Phase::Project);
+        rows.resize(batch);
+        const vector<size_t> &rowIndices = state->rowIndices;
+        const auto &projected = state->projected;
+        const auto &mapped = state->mapped;
+        size_t first = state->first + begin;
+        Morsels::forEach(batch, [&](size_t from, size_t to) {
+            for (size_t i = from; i < to; ++i) {
+                size_t rowIdx = rowIndices[first + i];
+                json &row = rows[i];
+                for (size_t c = 0; c < selected.size(); ++c) {
+                    json &cell = row[selected[c]];
+                    if (projected[c]) {
+                        projected[c]->assignTo(rowIdx, cell);
+                    } else {
+                        mapped[c]->assignTo(rowIdx, cell);
+                    }
+                }
+            }
+        });
+        state->produced += batch;
+        return true;
+    }
+
+    /**
+     * @brief Runs a SELECT and collects every row of the result in one array.
      */
     json selectFromTable(
         const string &databaseName,
         const string &tableName,
         const vector<string> &columns,
-        const function<bool(const json &)> &whereCondition,
+        const optional<ConditionExpr> &whereCondition,
         const string &orderByColumn,
         bool ascending,
         optional<size_t> limit,
         size_t offset
     ) {
-        fs::path homeDir = getenv("HOME");
-        if (homeDir.empty()) homeDir = getenv("USERPROFILE");
-        fs::path basePath = homeDir / ".mashdb" / "databases" / databaseName / tableName;
-        fs::path infoFilePath = basePath / "Table-info.json";
-
-        string basePathStr = basePath.string();
-        string infoFilePathStr = infoFilePath.string();
+        unique_ptr<SelectResult> selection = openSelect(databaseName, tableName, columns, whereCondition,
+                                                        orderByColumn, ascending, limit, offset);
+        json result = json::array();
+        json::array_t &rows = result.get_ref<json::array_t &>();
+        rows.reserve(selection->size());
+        json::array_t batch;
+        while (selection->next(batch)) {
+            move(batch.begin(), batch.end(), back_inserter(rows));
+        }
+        return result;
+    }
 
-        if (!fs::exists(basePath) || !fs::exists(infoFilePath)) {
+    /**
+     * @brief Implements the SELECT operation with filtering, sorting, and pagination
+     *
+     * An equality condition on a UNIQUE column is answered with the column's hash index, so
+     * only the matching row is evaluated instead of every row of the table. If the ORDER BY
+     * column has an ordered index, rows are produced by walking it and the walk stops once
+     * LIMIT + OFFSET rows matched; otherwise an ordered index on a WHERE column narrows the
+     * rows to check to the key ranges its condition can match. Compound conditions run their
+     * indexed and most selective operands first, and the rest only check surviving rows.
+     * Otherwise rows are filtered first and only the matches are sorted; with a LIMIT only the
+     * first OFFSET + LIMIT of them are kept. Full scans, sorting and building the result rows
+     * are split into morsels processed in parallel (see Morsels).
+     */
+    unique_ptr<SelectResult> openSelect(
+        const string &databaseName,
+        const string &tableName,
+        const vector<string> &columns,
+        const optional<ConditionExpr> &whereCondition,
+        const string &orderByColumn,
+        bool ascending,
+        optional<size_t> limit,
+        size_t offset
+    ) {
+        shared_ptr<const TableSchema> schema = Catalog::find(databaseName, tableName);
+        if (!schema) {
             throw runtime_error("Table doesn't exist");
         }
 
-        auto allColumns = getTableColumns(infoFilePath.string());
+        const json &tableInfo = *schema->info;
+        vector<string> allColumns;
+        for (const auto &column: schema->columns) {
+            allColumns.push_back(column.name);
+        }
         vector<string> selectedColumns = columns.empty() ? allColumns : columns;
 
         for (const auto &col: selectedColumns) {
@@ -78,83 +507,116 @@ namespace Selection {
             }
         }
 
-        map<string, json> allColumnData;
-        for (const auto &col: allColumns) {
-            fs::path colPath = basePath / "Columns" / (col + ".json");
-            allColumnData[col] = loadColumn(colPath.string())[col];
+        if (!orderByColumn.empty() && !tableInfo.contains(orderByColumn)) {
+            throw runtime_error("Column doesn't exist: " + orderByColumn);
         }
 
-        map<string, json> columnData;
-        for (const auto &col: selectedColumns) {
-            columnData[col] = allColumnData[col];
-        }
-
-        if (!orderByColumn.empty() && allColumnData.find(orderByColumn) == allColumnData.end()) {
-            fs::path orderColPath = basePath / "Columns" / (orderByColumn + ".json");
-            allColumnData[orderByColumn] = loadColumn(orderColPath.string())[orderByColumn];
-        }
+        // Columns are loaded on first use, so only the projection, WHERE and ORDER BY columns
+        // are read, and not even those when no row qualifies
+        auto selection = unique_ptr<SelectResult>(new SelectResult());
+        SelectResult::State &state = *selection->state;
+        selection->selected = selectedColumns;
+        state.table = make_unique<TableStore>(*schema);
+        TableStore &table = *state.table;
+        map<string, shared_ptr<const Column> > &loadedColumns = state.loadedColumns;
+        function<const Column &(const string &)> columnData = [&](const string &col) -> const Column & {
+            auto it = loadedColumns.find(col);
+            if (it == loadedColumns.end()) {
+                it = loadedColumns.emplace(col, table.sharedColumn(col)).first;
+            }
+            return *it->second;
+        };
 
-        size_t rowCount = 0;
-        if (!columnData.empty()) {
-            rowCount = columnData.begin()->second.size();
-        }
+        size_t rowCount = table.rowCount();
+        QueryProfile::beginTable(tableName, rowCount, table.deletions().count());
 
-        json result = json::array();
-        vector<size_t> rowIndices(rowCount);
-
-        for (size_t i = 0; i < rowCount; ++i) {
-            rowIndices[i] = i;
+        optional<PredicateTree> predicate;
+        if (whereCondition) {
+            predicate = PredicateTree::compile(*whereCondition,
+                                               [&](const string &col) { return table.columnType(col); });
         }
 
-        if (!orderByColumn.empty()) {
-            auto &orderColumn = columnData[orderByColumn];
-            sort(rowIndices.begin(), rowIndices.end(),
-                 [&](size_t a, size_t b) {
-                     return ascending ? orderColumn[a] < orderColumn[b] : orderColumn[a] > orderColumn[b];
-                 });
-        }
+        const DeletionVector &deleted = table.deletions();
+        auto matches = [&](size_t rowIdx) -> bool {
+            return !deleted.contains(rowIdx) && (!predicate || predicate->matches(columnData, rowIdx));
+        };
 
-        size_t skipped = 0;
-        size_t returned = 0;
+        vector<size_t> &rowIndices = state.rowIndices;
+        OrderedIndex *orderIndex = orderByColumn.empty() ? nullptr : table.orderedIndex(orderByColumn);
 
-        for (size_t i = 0; i < rowCount; ++i) {
-            size_t rowIdx = rowIndices[i];
-            bool includeRow = true;
-
-            if (whereCondition) {
-                json completeRow;
-                for (const auto &[col, data]: allColumnData) {
-                    completeRow[col] = data[rowIdx];
-                }
-
-                if (!whereCondition(completeRow)) {
-                    includeRow = false;
+        if (orderIndex) {
+            // A condition on the ORDER BY column that every match satisfies limits the walk
+            optional<vector<KeyRange> > ranges;
+            bool includeNulls = false;
+            if (predicate) {
+                for (const Predicate *conjunct: predicate->conjuncts()) {
+                    if (conjunct->column() == orderByColumn && (ranges = indexRangesFor(*conjunct))) {
+                        includeNulls = conjunct->op() == Predicate::Op::IsNull;
+                        break;
+                    }
                 }
             }
+            vector<pair<size_t, size_t> > spans =
+                    ranges.has_value()
+                        ? positionsFor(*orderIndex, *ranges, includeNulls)
+                        : vector<pair<size_t, size_t> >{{0, orderIndex->size()}};
+            optional<size_t> needed;
+            if (limit.has_value()) needed = offset + *limit;
 
-            if (!includeRow) {
-                continue;
+            QueryProfile::setAccess("ordered index on " + orderByColumn + (ranges ? ", within the WHERE range" : "") +
+                                    (predicate ? ", checking WHERE per row" : ""));
+            QueryProfile::setOrder("ORDER BY " + orderByColumn + (ascending ? " ASC" : " DESC") +
+                                   " from the index" +
+                                   (needed ? ", stopping after " + to_string(*needed) + " rows" : ""));
+            if (QueryProfile::planning()) {
+                return selection;
             }
+            rowIndices = orderedRows(*orderIndex, spans, [&]() -> const Column & { return columnData(orderByColumn); },
+                                     rowCount, ascending, matches, needed);
+            QueryProfile::setMatched(rowIndices.size());
+        } else {
+            rowIndices = matchingRows(table, predicate ? &*predicate : nullptr, columnData);
 
-            if (skipped < offset) {
-                skipped++;
-                continue;
+            if (!orderByColumn.empty()) {
+                optional<size_t> needed;
+                if (limit.has_value()) needed = offset + *limit;
+                QueryProfile::setOrder((needed ? "top " + to_string(*needed) + " by " : "sorted by ") + orderByColumn +
+                                       (ascending ? " ASC" : " DESC"));
+                if (QueryProfile::planning()) {
+                    return selection;
+                }
+                sortRows(rowIndices, columnData(orderByColumn), ascending, needed);
             }
-
-            if (limit.has_value() && returned >= limit.value()) {
-                break;
+            if (QueryProfile::planning()) {
+                return selection;
             }
+        }
 
-            json row;
+        state.first = min(offset, rowIndices.size());
+        size_t count = rowIndices.size() - state.first;
+        if (limit.has_value()) count = min(count, *limit);
+        selection->count = count;
+        QueryProfile::setResult(count);
+        if (count == 0) {
+            return selection;
+        }
 
-            for (const auto &col: selectedColumns) {
-                row[col] = columnData[col][rowIdx];
+        // When few rows qualify, columns not read so far are mapped rather than decoded, so only
+        // the pages holding those rows are touched; the server decodes them into its cache instead
+        bool sparse = !TableCache::enabled() && count * SPARSE_PROJECTION < rowCount;
+        if (!sparse) {
+            // The remaining columns are read together rather than one decode at a time
+            table.loadColumns(selectedColumns, loadedColumns);
+        }
+        for (const auto &col: selectedColumns) {
+            if (sparse && loadedColumns.count(col) == 0) {
+                state.projected.push_back(nullptr);
+                state.mapped.push_back(make_unique<ColumnCells>(table.mappedColumn(col)));
+            } else {
+                state.projected.push_back(&columnData(col));
+                state.mapped.push_back(nullptr);
             }
-
-            result.push_back(row);
-            returned++;
         }
-
-        return result;
+        return selection;
     }
 }
@@ -1,22 +1,95 @@
 #pragma once
 
+#include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 #include <nlohmann/json.hpp>
 #include <optional>
-#include <functional>
+
+#include "../../Parser/conditionParser.h"
 
 using namespace std;
 using json = nlohmann::json;
 
+class PredicateTree;
+class TableStore;
+struct Column;
+
 namespace Selection {
+    /**
+     * @brief The rows of a SELECT, built batch by batch as they are read
+     *
+     * Opening the query selects, sorts and paginates the row numbers. The values are only
+     * fetched from the columns when next() asks for a batch, so a writer that streams each
+     * batch out holds one batch of rows at a time instead of the whole result. The table must
+     * stay locked until the last batch was read.
+     */
+    class SelectResult {
+    public:
+        ~SelectResult();
+
+        /**
+         * @brief Maximum number of rows next() produces at once
+         */
+        static size_t batchRows();
+
+        /**
+         * @brief Names of the result columns, in output order
+         */
+        const vector<string> &columns() const { return selected; }
+
+        /**
+         * @brief Number of rows in the result
+         */
+        size_t size() const { return count; }
+
+        /**
+         * @brief Replaces `rows` with the next batch; returns false once all rows were produced
+         *
+         * The rows already in `rows` are overwritten rather than freed, so passing the same
+         * array on every call reuses their keys and strings; it must be empty or hold rows of
+         * this result.
+         */
+        bool next(json::array_t &rows);
+
+    private:
+        struct State;
+
+        vector<string> selected;
+        size_t count = 0;
+        unique_ptr<State> state;
+
+        SelectResult();
+
+        friend unique_ptr<SelectResult> openSelect(const string &, const string &, const vector<string> &,
+                                                   const optional<ConditionExpr> &, const string &, bool,
+                                                   optional<size_t>, size_t);
+    };
+
+    /**
+     * @brief Plans a SELECT query on the specified table and returns its rows as a SelectResult
+     *
+     * Takes the same arguments as selectFromTable().
+     */
+    unique_ptr<SelectResult> openSelect(
+        const string &databaseName,
+        const string &tableName,
+        const vector<string> &columns = {},
+        const optional<ConditionExpr> &whereCondition = nullopt,
+        const string &orderByColumn = "",
+        bool ascending = true,
+        optional<size_t> limit = nullopt,
+        size_t offset = 0
+    );
+
     /**
      * @brief Executes a SELECT query on the specified table
      *
      * @param databaseName Name of the database
      * @param tableName Name of the table to query
      * @param columns List of columns to select (empty for all columns)
-     * @param whereCondition Optional condition function to filter rows
+     * @param whereCondition Optional condition expression to filter rows; its columns must name columns of the table
      * @param orderByColumn Optional column name to order results by
      * @param ascending Sort order (true = ascending, false = descending)
      * @param limit Optional maximum number of rows to return
@@ -27,10 +100,26 @@ namespace Selection {
         const string &databaseName,
         const string &tableName,
         const vector<string> &columns = {},
-        const function<bool(const json &)> &whereCondition = nullptr,
+        const optional<ConditionExpr> &whereCondition = nullopt,
         const string &orderByColumn = "",
         bool ascending = true,
         optional<size_t> limit = nullopt,
         size_t offset = 0
     );
+
+    /**
+     * @brief Returns the rows of a table that are not deleted and match a WHERE predicate
+     * (every such row if it is nullptr), in row order
+     *
+     * Indexes and zone maps narrow the rows to check like in openSelect(); `columnData`
+     * supplies the decoded columns the predicate reads.
+     */
+    vector<size_t> matchingRows(TableStore &table, const PredicateTree *predicate,
+                                const function<const Column &(const string &)> &columnData);
+
+    /**
+     * @brief Orders rows by the values of `key` at those rows, NULLs first when ascending and
+     * equal keys in row order; with `needed`, only the first that many rows are kept
+     */
+    void sortRows(vector<size_t> &rows, const Column &key, bool ascending, optional<size_t> needed);
 }
@@ -1,183 +1,536 @@
 #include "updateRow.h"
 #include "../../Parser/conditionParser.h"
+#include "../../Parser/predicate.h"
 #include "../CurrentDB/currentDB.h"
+#include "../Selection/select.h"
+#include "../../Storage/catalog.h"
+#include "../../Storage/morsels.h"
+#include "../../Storage/queryProfile.h"
+#include "../../Storage/tableStore.h"
 
+#include <algorithm>
+#include <cstdint>
 #include <filesystem>
-#include <fstream>
 #include <stdexcept>
 #include <nlohmann/json.hpp>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <set>
+#include <tuple>
+#include <unordered_set>
 
 using namespace std;
 namespace fs = filesystem;
 using json = nlohmann::json;
 
-static string currentDatabase = CurrentDB::getCurrentDB();
+namespace {
+    using UpdateOperation::SetExpression;
+
+    /**
+     * One row's value of a SetExpression; which member holds it depends on the expression type
+     */
+    struct Cell {
+        bool null = false;
+        int64_t integer = 0;
+        double real = 0;
+        uint8_t flag = 0;
+        const string *text = nullptr;
+    };
+
+    /**
+     * Rows to update are read from the column mappings instead of decoding their columns when
+     * fewer than one in this many rows of the table are updated
+     */
+    constexpr size_t SPARSE_ROWS = 16;
+
+    /**
+     * A SetExpression type-checked once against the columns of the table, then bound to their
+     * values and evaluated per row straight from the typed column vectors
+     */
+    class Evaluator {
+    public:
+        Evaluator(const SetExpression &expression, const function<ColumnType(const string &)> &typeOf)
+            : kind(expression.kind) {
+            switch (kind) {
+                case SetExpression::Kind::Constant: {
+                    const json &value = expression.constant;
+                    if (value.is_null()) {
+                        constant.null = true;
+                    } else if (value.is_number_integer()) {
+                        resultType = ColumnType::Integer;
+                        constant.integer = value.get<int64_t>();
+                    } else if (value.is_number()) {
+                        resultType = ColumnType::Float;
+                        constant.real = value.get<double>();
+                    } else if (value.is_boolean()) {
+                        resultType = ColumnType::Boolean;
+                        constant.flag = value.get<bool>();
+                    } else if (value.is_string()) {
+                        resultType = ColumnType::Text;
+                        constantText = value.get<string>();
+                    } else {
+                        throw runtime_error("Unsupported value in SET: " + value.dump());
+                    }
+                    return;
+                }
+                case SetExpression::Kind::Column:
+                    columnName = expression.column;
+                    resultType = typeOf(columnName);
+                    return;
+                default:
+                    break;
+            }
+
+            if (expression.operands.size() != 2) {
+                throw runtime_error("Arithmetic in SET needs two operands");
+            }
+            for (const auto &operand: expression.operands) {
+                operands.emplace_back(operand, typeOf);
+            }
+            bool isNull = false;
+            bool isInteger = true;
+            for (const auto &operand: operands) {
+                if (!operand.resultType) {
+                    isNull = true;
+                } else if (*operand.resultType == ColumnType::Float) {
+                    isInteger = false;
+                } else if (*operand.resultType != ColumnType::Integer) {
+                    throw runtime_error("Arithmetic in SET needs numeric operands");
+                }
+            }
+            if (!isNull) {
+                resultType = isInteger ? ColumnType::Integer : ColumnType::Float;
+            }
+        }
+
+        /**
+         * The type of every value, or nullopt if the value is always NULL
+         */
+        optional<ColumnType> type() const { return resultType; }
+
+        /**
+         * Reads the columns of the expression from `columnOf`; rows passed to operator() are
+         * rows of those columns
+         */
+        void bind(const function<shared_ptr<const Column>(const string &)> &columnOf) {
+            if (kind == SetExpression::Kind::Column) {
+                column = columnOf(columnName);
+            }
+            for (auto &operand: operands) {
+                operand.bind(columnOf);
+            }
+        }
+
+        Cell operator()(size_t row) const {
+            Cell cell;
+            switch (kind) {
+                case SetExpression::Kind::Constant:
+                    cell = constant;
+                    if (resultType == ColumnType::Text) cell.text = &constantText;
+                    return cell;
+                case SetExpression::Kind::Column:
+                    cell.null = column->nulls[row] != 0;
+                    switch (column->type) {
+                        case ColumnType::Integer:
+                            cell.integer = column->ints[row];
+                            break;
+                        case ColumnType::Float:
+                            cell.real = column->floats[row];
+                            break;
+                        case ColumnType::Boolean:
+                            cell.flag = column->bools[row];
+                            break;
+                        case ColumnType::Text:
+                            cell.text = &column->texts[row];
+                            break;
+                    }
+                    return cell;
+                default:
+                    break;
+            }
+
+            cell.null = true;
+            if (!resultType) {
+                return cell;
+            }
+            Cell left = operands[0](row);
+            Cell right = operands[1](row);
+            if (left.null || right.null) {
+                return cell;
+            }
+            cell.null = false;
+
+            if (*resultType == ColumnType::Integer) {
+                int64_t a = left.integer;
+                int64_t b = right.integer;
+                bool overflow = false;
+                switch (kind) {
+                    case SetExpression::Kind::Add:
+                        overflow = __builtin_add_overflow(a, b, &cell.integer);
+                        break;
+                    case SetExpression::Kind::Subtract:
+                        overflow = __builtin_sub_overflow(a, b, &cell.integer);
+                        break;
+                    case SetExpression::Kind::Multiply:
+                        overflow = __builtin_mul_overflow(a, b, &cell.integer);
+                        break;
+                    default:
+                        if (b == 0) throw runtime_error("Division by zero in SET");
+                        overflow = a == INT64_MIN && b == -1;
+                        if (!overflow) cell.integer = a / b;
+                        break;
+                }
+                if (overflow) {
+                    throw runtime_error("Integer overflow in SET");
+                }
+                return cell;
+            }
+
+            double a = operands[0].resultType == ColumnType::Integer ? static_cast<double>(left.integer) : left.real;
+            double b = operands[1].resultType == ColumnType::Integer ? static_cast<double>(right.integer) : right.real;
+            switch (kind) {
+                case SetExpression::Kind::Add:
+                    cell.real = a + b;
+                    break;
+                case SetExpression::Kind::Subtract:
+                    cell.real = a - b;
+                    break;
+                case SetExpression::Kind::Multiply:
+                    cell.real = a * b;
+                    break;
+                default:
+                    if (b == 0) throw runtime_error("Division by zero in SET");
+                    cell.real = a / b;
+                    break;
+            }
+            return cell;
+        }
+
+    private:
+        SetExpression::Kind kind;
+        optional<ColumnType> resultType;
+        Cell constant;
+        string constantText;
+        string columnName;
+        shared_ptr<const Column> column;
+        vector<Evaluator> operands;
+    };
+
+    Column emptyColumn(ColumnType type, size_t rows) {
+        Column column;
+        column.type = type;
+        column.nulls.resize(rows, 0);
+        switch (type) {
+            case ColumnType::Integer:
+                column.ints.resize(rows);
+                break;
+            case ColumnType::Float:
+                column.floats.resize(rows);
+                break;
+            case ColumnType::Boolean:
+                column.bools.resize(rows);
+                break;
+            case ColumnType::Text:
+                column.texts.resize(rows);
+                break;
+        }
+        return column;
+    }
+
+    /**
+     * Stores a value of the given type in a column; integers widen to float columns
+     */
+    void store(Column &column, size_t row, const Cell &cell, optional<ColumnType> valueType) {
+        column.nulls[row] = cell.null ? 1 : 0;
+        if (cell.null) {
+            return;
+        }
+        switch (column.type) {
+            case ColumnType::Integer:
+                column.ints[row] = cell.integer;
+                break;
+            case ColumnType::Float:
+                column.floats[row] = valueType == ColumnType::Integer ? static_cast<double>(cell.integer) : cell.real;
+                break;
+            case ColumnType::Boolean:
+                column.bools[row] = cell.flag;
+                break;
+            case ColumnType::Text:
+                column.texts[row] = *cell.text;
+                break;
+        }
+    }
+
+    /**
+     * Copies the value at row `from` of one column to row `to` of another of the same type
+     */
+    void copyCell(Column &target, size_t to, const Column &source, size_t from) {
+        target.nulls[to] = source.nulls[from];
+        switch (target.type) {
+            case ColumnType::Integer:
+                target.ints[to] = source.ints[from];
+                break;
+            case ColumnType::Float:
+                target.floats[to] = source.floats[from];
+                break;
+            case ColumnType::Boolean:
+                target.bools[to] = source.bools[from];
+                break;
+            case ColumnType::Text:
+                target.texts[to] = source.texts[from];
+                break;
+        }
+    }
+
+    bool sameCell(const Column &a, size_t i, const Column &b, size_t j) {
+        if (a.nulls[i] || b.nulls[j]) {
+            return a.nulls[i] && b.nulls[j];
+        }
+        switch (a.type) {
+            case ColumnType::Integer:
+                return a.ints[i] == b.ints[j];
+            case ColumnType::Float:
+                return a.floats[i] == b.floats[j];
+            case ColumnType::Boolean:
+                return a.bools[i] == b.bools[j];
+            case ColumnType::Text:
+                return a.texts[i] == b.texts[j];
+        }
+        return false;
+    }
+}
 
 namespace UpdateOperation {
     /**
      * @brief Updates rows in a table based on a given condition.
      *
-     * If a condition string is provided, this function will update all rows in the table
-     * that satisfy the condition. If no condition string is provided, all rows in the table
-     * will be updated.
+     * If a condition is provided, this function will update all rows in the table that
+     * satisfy the condition, found like the rows of a SELECT through indexes and zone maps.
+     * If no condition is provided, all rows in the table will be updated.
+     *
+     * Every assignment is evaluated against the values the rows had before the statement.
+     * When few rows are updated those values are read from the mapped column files, and a
+     * column is decoded only when it has to be rewritten.
+     * Only rows whose value actually changes are written: cells of integer, float and boolean
+     * columns are patched in place, text columns are rewritten to a staging file that is
+     * renamed over the old one. Both are applied together through the write-ahead log, so a
+     * crash never leaves only some of the columns updated.
      *
      * @param tableName The name of the table to be updated.
-     * @param updates A map of column names to the values to be written to those columns.
-     * @param conditionStr An optional condition string to filter which rows are updated.
+     * @param assignments The columns to write and the expressions computing their values.
+     * @param condition An optional condition expression to filter which rows are updated.
+     * Values written to a UNIQUE column are checked against the column's hash index, which
+     * is updated together with the column file.
+     *
      * @return The number of rows updated.
-     * @throws std::runtime_error If the table does not exist, if the column specified in the condition
-     * does not exist, if the format of the target column or table information is invalid, if
-     * opening or writing files associated with the table fails, or if errors occur during condition
-     * evaluation or deletion processing.
+     * @throws std::runtime_error If the table does not exist, if a UNIQUE value would be duplicated, if the column specified in the condition
+     * does not exist, if a value does not match the type of its column, if an expression overflows or divides by zero, if the format of the
+     * target column or table information is invalid, if opening or writing files associated with the table fails, or if errors occur during
+     * condition evaluation.
      */
     int updateTable(
         const string &tableName,
-        const unordered_map<string, json> &updates,
-        const string &conditionStr
+        const vector<pair<string, SetExpression> > &assignments,
+        const optional<ConditionExpr> &condition
     ) {
+        string currentDatabase = CurrentDB::getCurrentDB();
         if (currentDatabase.empty()) {
             throw runtime_error("No database selected. Use 'USE DATABASE' first.");
         }
 
-        fs::path homeDir = getenv("HOME");
-        if (homeDir.empty()) homeDir = getenv("USERPROFILE");
-        fs::path basePath = homeDir / ".mashdb" / "databases" / currentDatabase / tableName;
-        fs::path tableDir = basePath / "Columns";
-        fs::path tableInfoFile = basePath / "Table-info.json";
-
-        vector<pair<string, string> > staged;
-        int updatedCount = 0;
-
-        if (!fs::exists(tableDir)) {
+        shared_ptr<const TableSchema> schema = Catalog::find(currentDatabase, tableName);
+        if (!schema) {
             throw runtime_error("Table does not exist: " + tableName);
         }
+        const json &tableInfo = *schema->info;
 
-        Condition condition;
-        if (!conditionStr.empty()) {
-            try {
-                condition = ConditionParser::parseCondition(conditionStr);
-            } catch (const exception &e) {
-                throw runtime_error("Invalid condition: " + string(e.what()));
+        set<string> assigned;
+        for (const auto &[colName, _]: assignments) {
+            if (!tableInfo.contains(colName)) {
+                throw runtime_error("Column not found in table: " + colName);
+            }
+            if (!assigned.insert(colName).second) {
+                throw runtime_error("Column assigned more than once: " + colName);
             }
         }
 
-        json tableInfo;
-        {
-            ifstream tfile(tableInfoFile);
-            if (!tfile) throw runtime_error("Failed to open table info file");
-            tfile >> tableInfo;
+        TableStore table(*schema);
+        if (!QueryProfile::planning()) {
+            table.checkpoint();
         }
+        QueryProfile::beginTable(tableName, table.rowCount(), table.deletions().count());
 
-        for (const auto &[colName, _]: updates) {
-            if (!tableInfo.contains(colName)) {
-                throw runtime_error("Column not found in table: " + colName);
+        map<string, shared_ptr<const Column> > loaded;
+        auto columnOf = [&](const string &col) {
+            shared_ptr<const Column> &column = loaded[col];
+            if (!column) column = table.sharedColumn(col);
+            return column;
+        };
+
+        vector<Evaluator> evaluators;
+        for (const auto &[colName, expression]: assignments) {
+            evaluators.emplace_back(expression, [&](const string &col) {
+                if (!tableInfo.contains(col)) {
+                    throw runtime_error("Column not found in table: " + col);
+                }
+                return table.columnType(col);
+            });
+            optional<ColumnType> valueType = evaluators.back().type();
+            ColumnType target = table.columnType(colName);
+            if (valueType && *valueType != target && !(target == ColumnType::Float && *valueType == ColumnType::Integer)) {
+                throw runtime_error("Type mismatch for column '" + colName + "': expected " +
+                                    tableInfo.at(colName).at("type").get<string>());
             }
         }
 
-        vector<bool> rowsToUpdate;
-        size_t totalRows = 0;
-
-        if (!conditionStr.empty()) {
-            fs::path condColPath = tableDir / (condition.column + ".json");
-            if (!fs::exists(condColPath)) {
-                throw runtime_error("Condition column not found: " + condition.column);
-            }
+        optional<PredicateTree> predicate;
+        if (condition) {
+            predicate = PredicateTree::compile(*condition, [&](const string &col) {
+                if (!tableInfo.contains(col)) {
+                    throw runtime_error("Condition column not found: " + col);
+                }
+                return table.columnType(col);
+            });
+        }
+        vector<size_t> rowsToUpdate = Selection::matchingRows(table, predicate ? &*predicate : nullptr,
+                                                              [&](const string &col) -> const Column & {
+                                                                  return *columnOf(col);
+                                                              });
+        if (QueryProfile::planning()) {
+            return 0;
+        }
+        QueryProfile::setResult(rowsToUpdate.size());
+        QueryProfile::Timer timer(QueryProfile::Phase::Write);
+        int updatedCount = static_cast<int>(rowsToUpdate.size());
 
-            json condColData;
-            {
-                ifstream cfile(condColPath);
-                if (!cfile) throw runtime_error("Failed to open condition column file: " + condition.column);
-                cfile >> condColData;
+        // Few updated rows are read from the column mappings, so `touched` then holds the values
+        // of the updated rows only and row i of it is rowsToUpdate[i]
+        bool sparse = rowsToUpdate.size() * SPARSE_ROWS < table.rowCount();
+        map<string, shared_ptr<const Column> > gathered;
+        auto touched = [&](const string &col) {
+            if (!sparse) return columnOf(col);
+            shared_ptr<const Column> &values = gathered[col];
+            if (!values) {
+                ColumnCells cells = table.mappedColumn(col);
+                auto column = make_shared<Column>();
+                column->type = table.columnType(col);
+                column->reserve(rowsToUpdate.size());
+                for (size_t row: rowsToUpdate) {
+                    column->append(cells.at(row));
+                }
+                values = std::move(column);
             }
+            return values;
+        };
+        auto touchedRow = [&](size_t i) { return sparse ? i : rowsToUpdate[i]; };
 
-            if (!condColData.contains(condition.column) || !condColData[condition.column].is_array()) {
-                throw runtime_error("Invalid condition column data format");
-            }
+        // Every value is computed and checked before anything is written
+        vector<Column> results;
+        for (size_t a = 0; a < assignments.size(); ++a) {
+            const string &colName = assignments[a].first;
+            Evaluator &evaluate = evaluators[a];
+            evaluate.bind(touched);
 
-            const auto &condValues = condColData[condition.column];
-            totalRows = condValues.size();
-            rowsToUpdate.resize(totalRows, false);
+            Column computed = emptyColumn(table.columnType(colName), rowsToUpdate.size());
+            Morsels::forEach(rowsToUpdate.size(), [&](size_t first, size_t last) {
+                for (size_t i = first; i < last; ++i) {
+                    store(computed, i, evaluate(touchedRow(i)), evaluate.type());
+                }
+            });
 
-            for (size_t i = 0; i < totalRows; ++i) {
-                try {
-                    rowsToUpdate[i] = ConditionParser::evaluateCondition(condValues[i], condition);
-                    if (rowsToUpdate[i]) {
-                        updatedCount++;
-                    }
-                } catch (const exception &e) {
-                    cerr << "Error evaluating condition for row " << i
-                            << " in column " << condition.column << ": " << e.what() << endl;
-                    rowsToUpdate[i] = false;
-                }
-            }
-        } else {
-            fs::path firstColPath = tableDir / (tableInfo.begin().key() + ".json");
-            if (fs::exists(firstColPath)) {
-                json firstColData;
-                ifstream ffile(firstColPath);
-                if (ffile) {
-                    ffile >> firstColData;
-                    if (firstColData.contains(tableInfo.begin().key()) &&
-                        firstColData[tableInfo.begin().key()].is_array()) {
-                        totalRows = firstColData[tableInfo.begin().key()].size();
-                        rowsToUpdate.resize(totalRows, true);
-                        updatedCount = totalRows;
+            if (table.isUnique(colName)) {
+                HashIndex &index = table.uniqueIndex(colName);
+                unordered_set<json> seen;
+                for (size_t i = 0; i < rowsToUpdate.size(); ++i) {
+                    json value = computed.at(i);
+                    if (value.is_null()) continue; // any number of rows may hold NULL
+                    optional<size_t> holder = index.find(value);
+                    if (!seen.insert(value).second ||
+                        (holder.has_value() && !binary_search(rowsToUpdate.begin(), rowsToUpdate.end(), *holder))) {
+                        throw runtime_error("Duplicate value for unique column: " + colName);
                     }
                 }
             }
+            results.push_back(std::move(computed));
         }
 
-        for (const auto &colName: updates) {
-            fs::path colPath = tableDir / (colName.first + ".json");
-            if (!fs::exists(colPath)) {
-                throw runtime_error("Column not found: " + colName.first);
-            }
+        vector<CellPatch> patches;
+        vector<string> staged;
+        // Previous and new values of changed rows in UNIQUE columns, used to maintain their indexes
+        map<string, vector<tuple<size_t, json, json> > > replacedUnique;
 
-            json colData;
-            {
-                ifstream cfile(colPath);
-                if (!cfile) throw runtime_error("Failed to open column file: " + colName.first);
-                cfile >> colData;
-            }
+        for (size_t a = 0; a < assignments.size(); ++a) {
+            const string &colName = assignments[a].first;
+            const Column &computed = results[a];
+            const Column &current = *touched(colName);
 
-            if (!colData.contains(colName.first) || !colData[colName.first].is_array()) {
-                throw runtime_error("Invalid column data format for: " + colName.first);
+            vector<size_t> changed = Morsels::collect(rowsToUpdate.size(), [&](size_t first, size_t last, vector<size_t> &out) {
+                for (size_t i = first; i < last; ++i) {
+                    if (!sameCell(current, touchedRow(i), computed, i)) out.push_back(i);
+                }
+            });
+            if (changed.empty()) {
+                continue;
             }
 
-            auto &values = colData[colName.first];
-            bool isUpdated = false;
-
-            for (size_t i = 0; i < values.size() && i < rowsToUpdate.size(); ++i) {
-                if (rowsToUpdate[i]) {
-                    if (values[i] != colName.second) {
-                        values[i] = colName.second;
-                        isUpdated = true;
-                    }
+            if (table.isUnique(colName)) {
+                auto &replaced = replacedUnique[colName];
+                for (size_t i: changed) {
+                    replaced.emplace_back(rowsToUpdate[i], current.at(touchedRow(i)), computed.at(i));
                 }
             }
 
-            if (isUpdated) {
-                fs::path tempPath = colPath.string() + ".tmp";
-                {
-                    ofstream outFile(tempPath, ios::trunc);
-                    if (!outFile) throw runtime_error("Failed to create temporary file for column: " + colName.first);
-                    outFile << colData.dump(4);
+            fs::path colPath = ColumnStore::columnPath(schema->columnsDir(), colName);
+            bool inPlace = false;
+            if (ColumnStore::fixedWidth(current.type) != 0) {
+                CellPatch patch;
+                patch.column = colName;
+                patch.values = emptyColumn(current.type, changed.size());
+                for (size_t p = 0; p < changed.size(); ++p) {
+                    patch.rows.push_back(rowsToUpdate[changed[p]]);
+                    copyCell(patch.values, p, computed, changed[p]);
                 }
-                staged.emplace_back(tempPath.string(), colPath.string());
+                // A value outside the encoding of its segment re-encodes the whole column instead
+                inPlace = ColumnStore::canPatch(colPath, patch.rows, patch.values);
+                if (inPlace) patches.push_back(std::move(patch));
             }
+            if (!inPlace) {
+                // Only a rewrite needs the whole column
+                Column values = *columnOf(colName);
+                values.dropDictionary();
+                for (size_t i: changed) {
+                    copyCell(values, rowsToUpdate[i], computed, i);
+                }
+                ColumnStore::writeColumn(table.stagingPath(colName), values);
+                staged.push_back(colName);
+            }
+            table.invalidateOrderedIndex(colName);
         }
 
-        if (!staged.empty()) {
+        if (!staged.empty() || !patches.empty()) {
             try {
-                for (const auto &[tempPath, finalPath]: staged) {
-                    fs::rename(tempPath, finalPath);
+                for (const auto &[colName, _]: replacedUnique) {
+                    table.uniqueIndex(colName).setDirty(true);
+                }
+                table.updateColumns(patches, staged);
+                for (const auto &[colName, replaced]: replacedUnique) {
+                    HashIndex &index = table.uniqueIndex(colName);
+                    // Values may move between rows (SET id = id + 1), so drop them all first
+                    for (const auto &[row, previous, _]: replaced) {
+                        index.erase(previous);
+                    }
+                    for (const auto &[row, _, value]: replaced) {
+                        index.insert(value, row);
+                    }
+                    index.setDirty(false);
                 }
                 return updatedCount;
             } catch (const exception &e) {
-                for (const auto &[tempPath, _]: staged) {
-                    if (fs::exists(tempPath)) {
-                        fs::remove(tempPath);
+                for (const auto &colName: staged) {
+                    if (fs::exists(table.stagingPath(colName))) {
+                        fs::remove(table.stagingPath(colName));
                     }
                 }
                 throw runtime_error("Failed to apply updates: " + string(e.what()));
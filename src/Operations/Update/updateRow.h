@@ -4,24 +4,44 @@
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <utility>
 #include <nlohmann/json.hpp>
 #include <functional>
+#include <optional>
+
+#include "../../Parser/conditionParser.h"
 
 using namespace std;
 using json = nlohmann::json;
 
 namespace UpdateOperation {
+    /**
+     * @brief The value a SET assignment writes: a constant, a column of the same row, or
+     * `+ - * /` over two operands
+     *
+     * Arithmetic takes integer and float operands and is NULL if either operand is; it stays
+     * integer only if both operands are, and integer division truncates.
+     */
+    struct SetExpression {
+        enum class Kind { Constant, Column, Add, Subtract, Multiply, Divide };
+
+        Kind kind = Kind::Constant;
+        json constant;                  // Constant
+        string column;                  // Column
+        vector<SetExpression> operands; // left and right side of Add ... Divide
+    };
+
     /**
      * @brief Updates rows in a table that match the given conditions
      * @param tableName Name of the table to update
-     * @param updates Map of column names to their new values
-     * @param condition Optional condition string to filter which rows to update
+     * @param assignments Column names and the expressions computing their new values
+     * @param condition Optional condition expression to filter which rows to update
      * @return int Number of rows updated, or -1 on error
      */
     int updateTable(
         const string &tableName,
-        const unordered_map<string, json> &updates,
-        const string &condition = ""
+        const vector<pair<string, SetExpression> > &assignments,
+        const optional<ConditionExpr> &condition = nullopt
     );
 
     /**
@@ -0,0 +1,119 @@
+#include "vacuum.h"
+#include "../../Storage/catalog.h"
+#include "../../Storage/deletionVector.h"
+#include "../../Storage/tableLock.h"
+#include "../../Storage/tableStore.h"
+
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+using namespace std;
+namespace fs = filesystem;
+using json = nlohmann::json;
+
+/**
+ * @brief Rewrites the columns of a table without its deleted rows.
+ *
+ * Every column is compacted in a single pass and written to its staging file; once all of
+ * them were written, TableStore::replaceColumns() renames them into place and clears the
+ * deletion bitmap in one step of the write-ahead log. Since the remaining rows move, the hash
+ * and ordered indexes are dropped before the renames and rebuilt afterwards.
+ *
+ * @param databaseName The database holding the table.
+ * @param tableName The table to compact.
+ * @return The number of rows removed, 0 if the table had no deleted rows.
+ * @throws std::runtime_error If the table does not exist or a file cannot be written; the
+ * temporary files are removed and the table is left as it was.
+ */
+size_t Vacuum::vacuumTable(const string &databaseName, const string &tableName) {
+    shared_ptr<const TableSchema> schema = Catalog::find(databaseName, tableName);
+    if (!schema)
+        throw runtime_error("Table does not exist.");
+
+    TableStore table(*schema);
+    if (table.deletions().empty()) {
+        return 0;
+    }
+    table.checkpoint();
+
+    vector<size_t> rows = table.deletions().rows();
+    size_t rowCount = table.rowCount();
+    while (!rows.empty() && rows.back() >= rowCount) {
+        rows.pop_back();
+    }
+
+    vector<string> staged;
+    try {
+        for (const auto &colName: table.columnNames()) {
+            Column columnData = table.loadColumn(colName);
+            columnData.eraseRows(rows);
+
+            ColumnStore::writeColumn(table.stagingPath(colName), columnData);
+            staged.push_back(colName);
+        }
+
+        table.invalidateIndexes();
+        table.replaceColumns(staged);
+        table.rebuildIndexes();
+    } catch (const exception &) {
+        for (const auto &colName: staged) {
+            if (fs::exists(table.stagingPath(colName))) {
+                fs::remove(table.stagingPath(colName));
+            }
+        }
+        throw;
+    }
+    return rows.size();
+}
+
+/**
+ * @brief Background compaction pass over all databases.
+ *
+ * Only the header of each deletion bitmap is read to find candidates, so a pass over tables
+ * without deleted rows costs a directory listing. A table that fails to vacuum is reported
+ * on stderr and skipped.
+ *
+ * @param threshold Share of deleted rows (0 to 1) from which a table is vacuumed; 0 or less
+ * disables the pass.
+ * @return The number of tables vacuumed.
+ */
+size_t Vacuum::vacuumDeadTables(double threshold) {
+    if (threshold <= 0) {
+        return 0;
+    }
+    fs::path databasesDir = Catalog::databasesDir();
+    if (!fs::is_directory(databasesDir)) {
+        return 0;
+    }
+
+    size_t vacuumed = 0;
+    for (const auto &database: fs::directory_iterator(databasesDir)) {
+        if (!database.is_directory()) continue;
+        for (const auto &tableDir: fs::directory_iterator(database.path())) {
+            if (!tableDir.is_directory()) continue;
+            string databaseName = database.path().filename().string();
+            string tableName = tableDir.path().filename().string();
+            try {
+                auto stats = DeletionVector::peek(tableDir.path() / "deleted.bin");
+                if (!stats || stats->first == 0) continue;
+
+                TableLock lock(databaseName, tableName, TableLock::Mode::Exclusive);
+                shared_ptr<const TableSchema> schema = Catalog::find(databaseName, tableName);
+                if (!schema) continue;
+                TableStore table(*schema);
+                size_t rows = table.rowCount();
+                if (rows > 0 && static_cast<double>(table.deletions().count()) < threshold * rows) continue;
+
+                size_t removed = vacuumTable(databaseName, tableName);
+                if (removed > 0) ++vacuumed;
+            } catch (const exception &e) {
+                cerr << "Warning: VACUUM of " << databaseName << "." << tableName << " failed: " << e.what() << endl;
+            }
+        }
+    }
+    return vacuumed;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+using namespace std;
+
+class Vacuum {
+public:
+    /**
+     * @brief Dead ratio from which the server's compactor vacuums a table by default
+     */
+    static constexpr double DEFAULT_THRESHOLD = 0.25;
+
+    /**
+     * @brief Drops the rows marked as deleted from the column files of a table
+     *
+     * The caller holds the table's lock exclusively.
+     *
+     * @return The number of rows removed
+     */
+    static size_t vacuumTable(const string &databaseName, const string &tableName);
+
+    /**
+     * @brief Vacuums every table of every database whose share of deleted rows reached the
+     * threshold, locking each table while it is rewritten
+     *
+     * @return The number of tables vacuumed
+     */
+    static size_t vacuumDeadTables(double threshold);
+};
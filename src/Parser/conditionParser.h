@@ -1,7 +1,11 @@
 #ifndef MASHDB_CONDITION_PARSER_H
 #define MASHDB_CONDITION_PARSER_H
 
+#include "tokenizer.h"
+
+#include <optional>
 #include <string>
+#include <vector>
 #include <nlohmann/json.hpp>
 
 using json = nlohmann::json;
@@ -10,48 +14,39 @@ struct Condition {
     std::string column;
     std::string op; // =, !=, >, <, >=, <=, LIKE
     std::string value;
+    std::optional<size_t> parameter; // set when the value is a `?` placeholder
+};
+
+/**
+ * @brief A WHERE expression: Condition leaves combined with AND, OR and NOT
+ */
+struct ConditionExpr {
+    enum class Kind { Leaf, And, Or, Not };
+
+    Kind kind = Kind::Leaf;
+    Condition condition; // Leaf only
+    std::vector<ConditionExpr> children; // And/Or: two or more operands, Not: one
 };
 
 class ConditionParser {
 public:
     /**
-     * @brief Parses a condition string into its components
+     * @brief Parses a WHERE expression of conditions joined by AND, OR and NOT
      *
-     * @param condition The condition string (e.g., "name = 'John'")
-     * @return Condition struct with parsed components
-     * @throws std::runtime_error if the condition is invalid
+     * NOT binds tighter than AND, which binds tighter than OR; parentheses group.
+     * `column IS NULL` and `column IS NOT NULL` are accepted as `= NULL` and `!= NULL`.
+     *
+     * @param expression The expression string (e.g., "age >= 25 AND (name LIKE 'J%' OR vip = true)")
+     * @return The expression tree, with And/Or chains flattened into one node
+     * @throws std::runtime_error if the expression is empty or malformed
      */
-    static Condition parseCondition(const std::string &condition);
+    static ConditionExpr parseExpression(const std::string &expression);
 
     /**
-     * @brief Evaluates a value against a parsed condition
-     *
-     * @param value The value to evaluate
-     * @param condition The parsed condition
-     * @return true if the condition is true for the given value
+     * @brief Parses a WHERE expression from a statement's tokens, stopping at the first token
+     * that does not belong to it
      */
-    static bool evaluateCondition(const json &value, const Condition &condition);
-
-private:
-    static bool compareEqual(const std::string &fieldValue, const std::string &conditionValue);
-
-    static bool compareNotEqual(const std::string &fieldValue, const std::string &conditionValue);
-
-    static bool compareGreaterThan(const std::string &fieldValue, const std::string &conditionValue);
-
-    static bool compareLessThan(const std::string &fieldValue, const std::string &conditionValue);
-
-    static bool compareGreaterEqual(const std::string &fieldValue, const std::string &conditionValue);
-
-    static bool compareLessEqual(const std::string &fieldValue, const std::string &conditionValue);
-
-    static bool compareLike(const std::string &fieldValue, const std::string &pattern);
-
-    static std::string trim(const std::string &str);
-
-    static std::string toLower(const std::string &str);
-
-    static bool evaluate(const std::string &condition, const json &value);
+    static ConditionExpr parseExpression(TokenStream &tokens);
 };
 
 #endif
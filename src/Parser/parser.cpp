@@ -7,453 +7,852 @@ extern bool g_outputJson;
 #include "../Operations/Creation/createDatabase.h"
 #include "../Operations/ChangeDB/changeDB.h"
 #include "../Operations/Insertion/insert.h"
+#include "../Operations/Insertion/loadData.h"
+#include "../Operations/Selection/aggregate.h"
+#include "../Operations/Selection/join.h"
 #include "../Operations/Selection/select.h"
 #include "../Operations/Selection/ResultFormatter.hpp"
 #include "../Operations/CurrentDB/currentDB.h"
 #include "../Operations/Creation/createTable.h"
+#include "../Operations/Creation/createIndex.h"
 #include "../Operations/Deletion/deleteRow.h"
+#include "../Operations/Explain/explain.h"
 #include "../Operations/Update/updateRow.h"
-
-#include <regex>
+#include "../Operations/Vacuum/vacuum.h"
+#include "../Storage/catalog.h"
+#include "../Storage/metrics.h"
+#include "../Storage/queryProfile.h"
+#include "../Storage/tableCache.h"
+#include "../Storage/tableLock.h"
+#include "../Storage/tableStore.h"
+#include "../Storage/writeAheadLog.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <chrono>
+#include <exception>
+#include <filesystem>
+#include <functional>
 #include <iostream>
-#include <sstream>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <streambuf>
+#include <variant>
+#include <nlohmann/json.hpp>
 
 #include "conditionParser.h"
+#include "statementParser.h"
 
 using namespace std;
+using json = nlohmann::json;
 namespace fs = filesystem;
 
-
-/**
- * Parse a SQL query and execute the corresponding the appropriate operation.
- *
- * The following operations are supported:
- *   - INSERT INTO table_name (column1, column2, ...) VALUES (value1, value2, ...)
- *   - SELECT columns FROM table_name WHERE condition
- *   - DELETE FROM table_name WHERE condition
- *   - CREATE TABLE table_name (column1 type, column2 type, ...)
- *   - CREATE DATABASE database_name
- *   - CHANGE DATABASE database_name
- *   - UPDATE table_name SET column1=value1, column2=value2, ... WHERE condition
- *
- * @param query The SQL query to parse and execute.
- */
-void ParseQuery::parse(const string &query) {
-    if (query.empty()) {
-        throw runtime_error("Empty query");
+// How SELECT results are printed; set from the command line in main.cpp
+extern Selection::OutputFormat g_outputFormat;
+
+namespace {
+    // Statements prepared in this process, by name; shared by all server connections
+    mutex preparedMutex;
+    map<string, shared_ptr<const Statement> > preparedStatements;
+
+    // Names of the statement types, in the order of Statement::Node
+    const char *const statementNames[] = {
+        "INSERT", "LOAD DATA", "SELECT", "UPDATE", "DELETE", "CREATE TABLE", "CREATE INDEX",
+        "CREATE DATABASE", "CHANGE DATABASE", "VACUUM", "PREPARE", "EXECUTE", "DEALLOCATE", "BEGIN",
+        "EXPLAIN", "SHOW STATS"
+    };
+    static_assert(sizeof(statementNames) / sizeof(statementNames[0]) == variant_size_v<Statement::Node>);
+
+    bool equalsIgnoreCase(const string &a, const char *b) {
+        size_t i = 0;
+        for (; b[i] != '\0'; ++i) {
+            if (i >= a.size() || tolower(static_cast<unsigned char>(a[i])) != tolower(static_cast<unsigned char>(b[i]))) {
+                return false;
+            }
+        }
+        return i == a.size();
     }
 
-    regex insertRegex(
-        R"(^\s*INSERT\s+INTO\s+([a-zA-Z_][a-zA-Z0-9_$]*)\s*\(([^)]+)\)\s*VALUES\s*\(([^)]+)\)\s*;$)",
-        regex_constants::icase
-    );
-
-    regex createDbRegex(
-        R"(^\s*CREATE\s+DATABASE\s+([a-zA-Z_][a-zA-Z0-9_]*)\s*;$)",
-        regex_constants::icase
-    );
-
-    regex changeDbRegex(
-        R"(^\s*CHANGE\s+DATABASE\s+([a-zA-Z_][a-zA-Z0-9_]*)\s*;$)",
-        regex_constants::icase
-    );
-
-    // SELECT statement patterns
-    regex selectBasicRegex(
-        R"(^\s*SELECT\s+(\*|(?:\s*[a-zA-Z_][a-zA-Z0-9_]*(?:\s*,\s*[a-zA-Z_][a-zA-Z0-9_]*)*))\s+FROM\s+([a-zA-Z_][a-zA-Z0-9_]*)(?:\s*;)?\s*$)",
-        regex_constants::icase
-    );
-
-    regex selectWhereRegex(
-        R"(^\s*SELECT\s+(\*|(?:\s*[a-zA-Z_][a-zA-Z0-9_]*(?:\s*,\s*[a-zA-Z_][a-zA-Z0-9_]*)*))\s+FROM\s+([a-zA-Z_][a-zA-Z0-9_]*)\s+WHERE\s+(.+?)(?:\s*;)?\s*$)",
-        regex_constants::icase
-    );
-
-    regex selectOrderByRegex(
-        R"(^\s*SELECT\s+(\*|(?:\s*[a-zA-Z_][a-zA-Z0-9_]*(?:\s*,\s*[a-zA-Z_][a-zA-Z0-9_]*)*))\s+FROM\s+([a-zA-Z_][a-zA-Z0-9_]*)\s+ORDER BY\s+([a-zA-Z_][a-zA-Z0-9_]*)(?:\s+(ASC|DESC))?(?:\s*;)?\s*$)",
-        regex_constants::icase
-    );
-
-    regex selectLimitRegex(
-        R"(^\s*SELECT\s+(\*|(?:\s*[a-zA-Z_][a-zA-Z0-9_]*(?:\s*,\s*[a-zA-Z_][a-zA-Z0-9_]*)*))\s+FROM\s+([a-zA-Z_][a-zA-Z0-9_]*)(?:\s+LIMIT\s+(\d+)(?:\s+OFFSET\s+(\d+))?)?(?:\s*;)?\s*$)",
-        regex_constants::icase
-    );
-
-    regex selectFullRegex(
-        R"(^\s*SELECT\s+(\*|(?:\s*[a-zA-Z_][a-zA-Z0-9_]*(?:\s*,\s*[a-zA-Z_][a-zA-Z0-9_]*)*))\s+FROM\s+([a-zA-Z_][a-zA-Z0-9_]*)(?:\s+WHERE\s+(.+?))?(?:\s+ORDER BY\s+([a-zA-Z_][a-zA-Z0-9_]*)(?:\s+(ASC|DESC))?)?(?:\s+LIMIT\s+(\d+)(?:\s+OFFSET\s+(\d+))?)?(?:\s*;)?\s*$)",
-        regex_constants::icase
-    );
-
-    regex createTableRegex(
-        R"(^\s*CREATE\s+TABLE\s+([a-zA-Z_][a-zA-Z0-9_$]*)\s*\((.+)\)\s*;\s*$)",
-        regex_constants::icase
-    );
-
-    regex deleteRegex(
-        R"(^\s*DELETE\s+FROM\s+([a-zA-Z_][a-zA-Z0-9_$]*)(?:\s+WHERE\s+(.+?))?\s*;\s*$)",
-        regex_constants::icase
-    );
-
-    regex updateRegex(
-        R"(^\s*UPDATE\s+([a-zA-Z_][a-zA-Z0-9_$]*)\s+SET\s+([^;]+?)(?:\s+WHERE\s+(.+?))?\s*;\s*$)",
-        regex_constants::icase
-    );
-
-    smatch match;
-
-    if (regex_match(query, match, insertRegex)) {
-        string tableName = match[1].str();
-        string columnsStr = match[2].str();
-        string valuesStr = match[3].str();
+    /**
+     * @brief Converts a literal to the value stored in a column: NULL, true and false are
+     * keywords, quoted text is a string, numbers are integers or doubles and any other word is
+     * taken as text
+     */
+    json literalValue(const Literal &literal) {
+        if (literal.parameter) {
+            throw runtime_error("No value bound to parameter " + to_string(*literal.parameter + 1));
+        }
+        const string &text = literal.text;
+        if (equalsIgnoreCase(text, "NULL")) return nullptr;
+        if (equalsIgnoreCase(text, "true")) return true;
+        if (equalsIgnoreCase(text, "false")) return false;
+        if (text.size() >= 2 && (text.front() == '\'' || text.front() == '"') && text.back() == text.front()) {
+            return text.substr(1, text.size() - 2);
+        }
 
-        vector<string> columns;
-        stringstream ssCol(columnsStr);
-        string col;
-        while (getline(ssCol, col, ',')) {
-            col.erase(0, col.find_first_not_of(" \t\n\r\f\v"));
-            col.erase(col.find_last_not_of(" \t\n\r\f\v") + 1);
-            if (!col.empty()) {
-                columns.push_back(col);
+        size_t digits = text[0] == '-' ? 1 : 0;
+        if (digits < text.size() && isdigit(static_cast<unsigned char>(text[digits]))) {
+            size_t used = 0;
+            try {
+                if (text.find_first_of(".eE") == string::npos) {
+                    int64_t value = stoll(text, &used);
+                    if (used == text.size()) return value;
+                } else {
+                    double value = stod(text, &used);
+                    if (used == text.size()) return value;
+                }
+            } catch (const exception &) {
+                // Out of range: keep the text as written
             }
         }
+        return text;
+    }
 
-        vector<json> values;
-        stringstream ssVal(valuesStr);
-        string val;
-
-        auto trim = [](string s) -> string {
-            s.erase(0, s.find_first_not_of(" \t\n\r\f\v"));
-            s.erase(s.find_last_not_of(" \t\n\r\f\v") + 1);
-            return s;
-        };
+    Literal bindLiteral(const Literal &literal, const vector<Literal> &arguments) {
+        return literal.parameter ? arguments[*literal.parameter] : literal;
+    }
 
-        while (getline(ssVal, val, ',')) {
-            val = trim(val);
-            if (val.empty()) continue; // Skip empty values
-
-            if (val == "NULL" || val == "null") {
-                values.emplace_back(nullptr);
-            } else if (val == "true" || val == "TRUE") {
-                values.emplace_back(true);
-            } else if (val == "false" || val == "FALSE") {
-                values.emplace_back(false);
-            } else if ((val[0] == '\'' && val.back() == '\'') ||
-                       (val[0] == '"' && val.back() == '"')) {
-                values.emplace_back(val.substr(1, val.length() - 2));
-            } else if (regex_match(val, regex("^-?\\d+$"))) {
-                values.emplace_back(stoi(val));
-            } else if (regex_match(val, regex(R"(^-?\d+\.\d+$)"))) {
-                values.emplace_back(stod(val));
-            } else {
-                values.emplace_back(val);
-            }
+    void bindValue(ValueExpr &expr, const vector<Literal> &arguments) {
+        for (auto &operand: expr.operands) {
+            bindValue(operand, arguments);
         }
+        expr.literal = bindLiteral(expr.literal, arguments);
+    }
 
-        InsertIntoTable::insert(CurrentDB::getCurrentDB(), tableName, columns, values);
-    } else if (regex_match(query, match, selectFullRegex)) {
-        string columnsStr = match[1].str();
-        string tableName = match[2].str();
+    void bindCondition(ConditionExpr &expr, const vector<Literal> &arguments) {
+        for (auto &child: expr.children) {
+            bindCondition(child, arguments);
+        }
+        if (expr.kind == ConditionExpr::Kind::Leaf && expr.condition.parameter) {
+            expr.condition.value = arguments[*expr.condition.parameter].text;
+            expr.condition.parameter.reset();
+        }
+    }
 
-        vector<string> columns;
-        if (columnsStr != "*") {
-            stringstream ss(columnsStr);
-            string col;
-            while (getline(ss, col, ',')) {
-                col.erase(0, col.find_first_not_of(" \t\n\r\f\v"));
-                col.erase(col.find_last_not_of(" \t\n\r\f\v") + 1);
-                if (!col.empty()) {
-                    columns.push_back(col);
-                }
+    /**
+     * @brief Copies a prepared statement with its `?` placeholders replaced by the arguments
+     */
+    Statement bindStatement(const Statement &prepared, const vector<Literal> &arguments) {
+        Statement bound = prepared;
+        bound.parameters = 0;
+        if (auto *insert = get_if<InsertStatement>(&bound.node)) {
+            for (auto &row: insert->rows) {
+                for (auto &value: row) value = bindLiteral(value, arguments);
+            }
+        } else if (auto *select = get_if<SelectStatement>(&bound.node)) {
+            if (select->where) bindCondition(*select->where, arguments);
+        } else if (auto *update = get_if<UpdateStatement>(&bound.node)) {
+            for (auto &assignment: update->assignments) {
+                bindValue(assignment.second, arguments);
             }
+            if (update->where) bindCondition(*update->where, arguments);
+        } else if (auto *remove = get_if<DeleteStatement>(&bound.node)) {
+            bindCondition(remove->where, arguments);
+        } else if (auto *explain = get_if<ExplainStatement>(&bound.node)) {
+            explain->body = make_shared<Statement>(bindStatement(*explain->body, arguments));
         }
+        return bound;
+    }
 
-        string whereConditionStr;
-        string orderByColumn;
-        bool ascending = true;
-        optional<size_t> limit = nullopt;
-        size_t offset = 0;
+    /**
+     * @brief Replaces the column names of a WHERE expression with the table's spelling
+     * @throws std::runtime_error if the table or one of the columns does not exist
+     */
+    void resolveColumns(const string &tableName, ConditionExpr &condition) {
+        shared_ptr<const TableSchema> schema = Catalog::find(CurrentDB::getCurrentDB(), tableName);
+        if (!schema) {
+            throw runtime_error("Table info not found");
+        }
 
-        if (match.size() > 3) {
-            if (match[3].matched) {
-                whereConditionStr = match[3].str();
+        function<void(ConditionExpr &)> resolve = [&](ConditionExpr &expr) {
+            for (auto &child: expr.children) {
+                resolve(child);
             }
-            if (match[4].matched) {
-                orderByColumn = match[4].str();
-                if (match[5].matched) {
-                    string order = match[5].str();
-                    ascending = (order != "DESC" && order != "desc");
-                }
+            if (expr.kind != ConditionExpr::Kind::Leaf) {
+                return;
             }
-            if (match[6].matched) {
-                limit = stoul(match[6].str());
-                if (match[7].matched) {
-                    offset = stoul(match[7].str());
+            for (const auto &column: schema->columns) {
+                if (equalsIgnoreCase(column.name, expr.condition.column.c_str())) {
+                    expr.condition.column = column.name;
+                    return;
                 }
             }
-        }
-
-        function<bool(const json &)> whereCondition = nullptr;
-        if (!whereConditionStr.empty()) {
-            try {
-                Condition condition = ConditionParser::parseCondition(whereConditionStr);
-
-                fs::path homeDir = getenv("HOME");
-                if (homeDir.empty()) homeDir = getenv("USERPROFILE");
-                fs::path basePath = homeDir / ".mashdb" / "databases" / CurrentDB::getCurrentDB() / tableName;
-                fs::path tableInfoFile = basePath / "Table-info.json";
+            throw runtime_error("Column not found in table: " + expr.condition.column);
+        };
+        resolve(condition);
+    }
 
-                if (!fs::exists(tableInfoFile)) {
-                    throw runtime_error("Table info not found");
-                }
+    void runInsert(const InsertStatement &insert) {
+        vector<vector<json> > rows;
+        rows.reserve(insert.rows.size());
+        for (const auto &tuple: insert.rows) {
+            vector<json> values;
+            values.reserve(tuple.size());
+            for (const auto &literal: tuple) {
+                values.push_back(literalValue(literal));
+            }
+            rows.push_back(std::move(values));
+        }
 
-                json tableInfo;
-                {
-                    ifstream tfile(tableInfoFile);
-                    if (!tfile) throw runtime_error("Failed to open table info file");
-                    tfile >> tableInfo;
-                }
+        if (rows.size() == 1) {
+            InsertIntoTable::insert(CurrentDB::getCurrentDB(), insert.table, insert.columns, rows[0]);
+        } else {
+            InsertIntoTable::insertRows(CurrentDB::getCurrentDB(), insert.table, insert.columns, rows);
+        }
+    }
 
-                bool columnExists = false;
-                for (auto it = tableInfo.begin(); it != tableInfo.end(); ++it) {
-                    if (strcasecmp(it.key().c_str(), condition.column.c_str()) == 0) {
-                        condition.column = it.key();
-                        columnExists = true;
-                        break;
-                    }
-                }
+    /**
+     * @brief Drops the `table.` of column names qualified with the name or alias of the only
+     * table of a query
+     */
+    SelectStatement unqualified(SelectStatement select) {
+        auto strip = [&](string &column) {
+            size_t dot = column.find('.');
+            if (dot == string::npos) return;
+            string qualifier = column.substr(0, dot);
+            if (qualifier == (select.alias.empty() ? select.table : select.alias)) column.erase(0, dot + 1);
+        };
+        function<void(ConditionExpr &)> stripCondition = [&](ConditionExpr &expr) {
+            for (auto &child: expr.children) stripCondition(child);
+            if (expr.kind == ConditionExpr::Kind::Leaf) strip(expr.condition.column);
+        };
+        for (auto &column: select.columns) strip(column);
+        for (auto &item: select.items) strip(item.column);
+        for (auto &column: select.groupBy) strip(column);
+        strip(select.orderBy);
+        if (select.orderByAggregate) strip(select.orderByAggregate->column);
+        if (select.where) stripCondition(*select.where);
+        return select;
+    }
 
-                if (!columnExists) {
-                    throw runtime_error("Column not found in table: " + condition.column);
-                }
+    void runJoin(const SelectStatement &select, ostream &out) {
+        if (!select.items.empty()) {
+            throw runtime_error("Aggregates and GROUP BY are not supported with JOIN");
+        }
+        unique_ptr<Selection::JoinResult> result = Selection::openJoin(
+            CurrentDB::getCurrentDB(),
+            {select.table, select.alias},
+            {select.join->table, select.join->alias},
+            select.join->leftColumn,
+            select.join->rightColumn,
+            select.columns,
+            select.where,
+            select.orderBy,
+            select.ascending,
+            select.limit,
+            select.offset
+        );
 
-                whereCondition = [condition](const json &row) -> bool {
-                    try {
-                        if (!row.contains(condition.column)) {
-                            throw runtime_error("Column '" + condition.column + "' not found in row");
-                        }
+        Selection::RowStream rows;
+        rows.columns = result->columns();
+        rows.count = result->size();
+        rows.next = [&result](json::array_t &batch) { return result->next(batch); };
+        Selection::ResultFormatter::write(rows, g_outputFormat, out);
+    }
 
-                        return ConditionParser::evaluateCondition(row[condition.column], condition);
-                    } catch (const exception &e) {
-                        cerr << "Error evaluating condition: " << e.what() << endl;
-                        return false;
-                    }
-                };
+    void runSelect(const SelectStatement &statement, ostream &out) {
+        if (statement.join) {
+            runJoin(statement, out);
+            return;
+        }
+        SelectStatement select = unqualified(statement);
+        optional<ConditionExpr> whereCondition = select.where;
+        if (whereCondition) {
+            try {
+                resolveColumns(select.table, *whereCondition);
             } catch (const exception &e) {
                 throw runtime_error("Invalid WHERE condition: " + string(e.what()));
             }
         }
 
-        json result = Selection::selectFromTable(
+        if (!select.items.empty()) {
+            optional<SelectItem> orderBy = select.orderByAggregate;
+            if (!select.orderBy.empty()) orderBy = SelectItem{SelectItem::Function::None, select.orderBy};
+            json result = Selection::aggregateTable(CurrentDB::getCurrentDB(), select.table, select.items,
+                                                    select.groupBy, whereCondition, orderBy, select.ascending,
+                                                    select.limit, select.offset);
+
+            json::array_t &groups = result.get_ref<json::array_t &>();
+            Selection::RowStream rows;
+            for (const auto &item: select.items) rows.columns.push_back(Selection::itemName(item));
+            rows.count = groups.size();
+            rows.next = [&groups](json::array_t &batch) {
+                batch.swap(groups);
+                groups.clear();
+                return !batch.empty();
+            };
+            Selection::ResultFormatter::write(rows, g_outputFormat, out);
+            return;
+        }
+
+        unique_ptr<Selection::SelectResult> result = Selection::openSelect(
             CurrentDB::getCurrentDB(),
-            tableName,
-            columns,
+            select.table,
+            select.columns,
             whereCondition,
-            orderByColumn,
-            ascending,
-            limit,
-            offset
+            select.orderBy,
+            select.ascending,
+            select.limit,
+            select.offset
         );
 
-        vector<string> selectedCols;
-        if (columnsStr != "*") {
-            selectedCols = columns;
+        // Rows are written batch by batch while the table is still locked
+        Selection::RowStream rows;
+        rows.columns = result->columns();
+        rows.count = result->size();
+        rows.next = [&result](json::array_t &batch) { return result->next(batch); };
+        Selection::ResultFormatter::write(rows, g_outputFormat, out);
+    }
+
+    /**
+     * @brief Converts the right-hand side of a SET assignment, resolving words that name a
+     * column of the table to that column
+     */
+    UpdateOperation::SetExpression setExpression(const ValueExpr &expr, const json &tableInfo, bool isOperand = false) {
+        using Kind = UpdateOperation::SetExpression::Kind;
+        UpdateOperation::SetExpression converted;
+        switch (expr.kind) {
+            case ValueExpr::Kind::Value:
+                converted.constant = literalValue(expr.literal);
+                return converted;
+            case ValueExpr::Kind::Name:
+                for (auto it = tableInfo.begin(); it != tableInfo.end(); ++it) {
+                    if (equalsIgnoreCase(it.key(), expr.literal.text.c_str())) {
+                        converted.kind = Kind::Column;
+                        converted.column = it.key();
+                        return converted;
+                    }
+                }
+                converted.constant = literalValue(expr.literal);
+                if (isOperand && converted.constant.is_string()) {
+                    throw runtime_error("Column not found in table: " + expr.literal.text);
+                }
+                return converted;
+            case ValueExpr::Kind::Add:
+                converted.kind = Kind::Add;
+                break;
+            case ValueExpr::Kind::Subtract:
+                converted.kind = Kind::Subtract;
+                break;
+            case ValueExpr::Kind::Multiply:
+                converted.kind = Kind::Multiply;
+                break;
+            case ValueExpr::Kind::Divide:
+                converted.kind = Kind::Divide;
+                break;
         }
-        if (g_outputJson) {
-            cout << Selection::ResultFormatter::formatAsJson(result, selectedCols);
-        } else {
-            cout << Selection::ResultFormatter::formatAsTable(result, selectedCols);
+        for (const auto &operand: expr.operands) {
+            converted.operands.push_back(setExpression(operand, tableInfo, true));
         }
-    } else if (regex_match(query, match, deleteRegex)) {
-        string tableName = match[1].str();
-        string condition = match[2].matched ? match[2].str() : "";
+        return converted;
+    }
 
-        if (condition.empty()) {
-            throw runtime_error("DELETE without WHERE clause is not supported for safety");
+    void runUpdate(const UpdateStatement &update) {
+        string database = CurrentDB::getCurrentDB();
+        if (database.empty()) {
+            throw runtime_error("No database selected. Use 'USE DATABASE' first.");
         }
-
-        string normalizedCondition = condition;
-
-        size_t pos = 0;
-        while ((pos = normalizedCondition.find("==", pos)) != string::npos) {
-            normalizedCondition.replace(pos, 2, "=");
-            pos += 1;
+        shared_ptr<const TableSchema> schema = Catalog::find(database, update.table);
+        if (!schema) {
+            throw runtime_error("Table does not exist: " + update.table);
         }
+        const shared_ptr<const json> &tableInfo = schema->info;
 
-        regex ws_re("\\s*([=!<>]+)\\s*");
-        normalizedCondition = regex_replace(normalizedCondition, ws_re, " $1 ");
-
-        auto trim = [](string s) -> string {
-            s.erase(0, s.find_first_not_of(" \t\n\r\f\v"));
-            s.erase(s.find_last_not_of(" \t\n\r\f\v") + 1);
-            return s;
-        };
-
-        string formattedCondition = trim(normalizedCondition);
-
-        DeleteRow::deleteRow(tableName, formattedCondition);
-    } else if (regex_match(query, match, createTableRegex)) {
-        string tableName = match[1].str();
-        string defsStr = match[2].str();
+        vector<pair<string, UpdateOperation::SetExpression> > assignments;
+        for (const auto &[column, value]: update.assignments) {
+            assignments.emplace_back(column, setExpression(value, *tableInfo));
+        }
 
-        vector<string> rawDefs;
-        string part;
-        stringstream ssDefs(defsStr);
-        while (getline(ssDefs, part, ',')) {
-            part.erase(part.find_last_not_of(" \t\n\r\f\v") + 1);
-            if (!part.empty()) rawDefs.push_back(part);
+        int updated = UpdateOperation::updateTable(update.table, assignments, update.where);
+        if (updated < 0) {
+            throw runtime_error("Failed to update rows in table " + update.table);
         }
+    }
 
+    void runCreateTable(const CreateTableStatement &create) {
         vector<string> columns;
         vector<string> dataTypes;
         vector<bool> isUnique;
         vector<bool> notNull;
+        for (const auto &column: create.columns) {
+            columns.push_back(column.name);
+            dataTypes.push_back(column.type);
+            isUnique.push_back(column.unique);
+            notNull.push_back(column.notNull);
+        }
+        CreateTable::createTable(create.table, columns, dataTypes, isUnique, notNull);
+    }
 
-        for (auto &def: rawDefs) {
-            stringstream ts(def);
-            string name;
-            if (!(ts >> name)) continue;
-            string rest;
-            getline(ts, rest);
-            rest.erase(0, rest.find_first_not_of(" \t\n\r\f\v"));
-            rest.erase(rest.find_last_not_of(" \t\n\r\f\v") + 1);
-
-            bool uniqueFlag = false;
-            bool notNullFlag = false;
-
-            string restLower = rest;
-            for (auto &ch: restLower) ch = static_cast<char>(tolower(ch));
-
-            if (restLower.find("unique") != string::npos) uniqueFlag = true;
-            if (restLower.find("not null") != string::npos) notNullFlag = true;
-            else if (restLower.find(" null") != string::npos) notNullFlag = false;
-
-            string typePart = rest;
-            {
-                string tmp = typePart;
-                // To remove case-insensitively, iterate through possibilities
-                // First remove NOT NULL then UNIQUE
-                // Simple approach: build lowercase copies for search, but erase from original indexes is complex.
-                // Instead, replace occurrences by scanning tokens.
-                string out;
-                string token;
-                stringstream rts(typePart);
-                while (rts >> token) {
-                    string tl = token;
-                    for (auto &c: tl) c = static_cast<char>(tolower(c));
-                    if (tl == "unique") {
-                        continue;
-                    }
-                    if (tl == "not") {
-                        streampos p = rts.tellg();
-                        string nxt;
-                        if (rts >> nxt) {
-                            string nl = nxt;
-                            for (auto &c: nl) c = static_cast<char>(tolower(c));
-                            if (nl == "null") {
-                                continue;
-                            } else {
-                                rts.seekg(p);
-                            }
-                        }
-                        if (!out.empty()) out.push_back(' ');
-                        out += token;
-                    } else {
-                        if (!out.empty()) out.push_back(' ');
-                        out += token;
-                    }
-                }
-                typePart = out;
+    void runExecute(const ExecuteStatement &execute, ostream &out) {
+        shared_ptr<const Statement> prepared;
+        {
+            lock_guard<mutex> guard(preparedMutex);
+            auto it = preparedStatements.find(execute.name);
+            if (it == preparedStatements.end()) {
+                throw runtime_error("Prepared statement not found: " + execute.name);
             }
+            prepared = it->second;
+        }
+        ParseQuery::execute(*prepared, execute.arguments, out);
+    }
+
+    /**
+     * @brief The table a statement reads or changes, and whether it changes it
+     */
+    optional<pair<string, TableLock::Mode> > lockedTable(const Statement::Node &node) {
+        if (auto *select = get_if<SelectStatement>(&node)) return make_pair(select->table, TableLock::Mode::Shared);
+        if (auto *insert = get_if<InsertStatement>(&node)) return make_pair(insert->table, TableLock::Mode::Exclusive);
+        if (auto *load = get_if<LoadDataStatement>(&node)) return make_pair(load->table, TableLock::Mode::Exclusive);
+        if (auto *update = get_if<UpdateStatement>(&node)) return make_pair(update->table, TableLock::Mode::Exclusive);
+        if (auto *remove = get_if<DeleteStatement>(&node)) return make_pair(remove->table, TableLock::Mode::Exclusive);
+        if (auto *create = get_if<CreateTableStatement>(&node)) return make_pair(create->table, TableLock::Mode::Exclusive);
+        if (auto *index = get_if<CreateIndexStatement>(&node)) return make_pair(index->table, TableLock::Mode::Exclusive);
+        if (auto *vacuum = get_if<VacuumStatement>(&node)) return make_pair(vacuum->table, TableLock::Mode::Exclusive);
+        if (auto *explain = get_if<ExplainStatement>(&node)) {
+            // Without ANALYZE nothing is changed, so reading the table is enough
+            auto table = lockedTable(explain->body->node);
+            if (table && !explain->analyze) table->second = TableLock::Mode::Shared;
+            return table;
+        }
+        return nullopt;
+    }
 
-            typePart.erase(0, typePart.find_first_not_of(" \t\n\r\f\v"));
-            typePart.erase(typePart.find_last_not_of(" \t\n\r\f\v") + 1);
-            if (typePart.empty()) {
-                typePart = "TEXT";
+    /**
+     * @brief Prints SHOW STATS: one (metric, value) row per metric that is not zero
+     */
+    void showStats(ostream &out) {
+        json::array_t metrics;
+        for (auto &[name, value]: Metrics::summary()) {
+            metrics.push_back({{"metric", name}, {"value", std::move(value)}});
+        }
+        Selection::RowStream rows;
+        rows.columns = {"metric", "value"};
+        rows.count = metrics.size();
+        rows.next = [&metrics](json::array_t &batch) {
+            batch.swap(metrics);
+            metrics.clear();
+            return !batch.empty();
+        };
+        Selection::ResultFormatter::write(rows, g_outputFormat, out);
+    }
+
+    void runExplain(const ExplainStatement &explain, ostream &out);
+
+    /**
+     * @brief Runs a statement whose table is already locked
+     */
+    void runStatement(const Statement::Node &node, ostream &out) {
+        if (auto *insert = get_if<InsertStatement>(&node)) {
+            runInsert(*insert);
+        } else if (auto *load = get_if<LoadDataStatement>(&node)) {
+            size_t loaded = LoadData::loadCsv(CurrentDB::getCurrentDB(), load->table, load->file);
+            out << "Loaded " << loaded << " row" << (loaded != 1 ? "s" : "") << " into " << load->table << "." << endl;
+        } else if (auto *select = get_if<SelectStatement>(&node)) {
+            runSelect(*select, out);
+        } else if (auto *remove = get_if<DeleteStatement>(&node)) {
+            size_t deleted = DeleteRow::deleteRow(remove->table, remove->where);
+            if (deleted == 0) {
+                out << "No rows match the condition. Nothing to delete." << endl;
+            } else {
+                out << "Found " << deleted << " rows to delete." << endl;
+            }
+        } else if (auto *update = get_if<UpdateStatement>(&node)) {
+            runUpdate(*update);
+        } else if (auto *createTable = get_if<CreateTableStatement>(&node)) {
+            runCreateTable(*createTable);
+        } else if (auto *createIndex = get_if<CreateIndexStatement>(&node)) {
+            CreateIndex::createIndex(CurrentDB::getCurrentDB(), createIndex->table, createIndex->index,
+                                     createIndex->column);
+        } else if (auto *createDb = get_if<CreateDatabaseStatement>(&node)) {
+            CreateDatabase::createDatabase(createDb->database);
+        } else if (auto *changeDb = get_if<ChangeDatabaseStatement>(&node)) {
+            ChangeDB::change(changeDb->database);
+        } else if (auto *vacuum = get_if<VacuumStatement>(&node)) {
+            size_t removed = Vacuum::vacuumTable(CurrentDB::getCurrentDB(), vacuum->table);
+            out << "Vacuumed " << vacuum->table << ": removed " << removed << " deleted row" << (removed != 1 ? "s" : "")
+                    << "." << endl;
+        } else if (auto *prepare = get_if<PrepareStatement>(&node)) {
+            lock_guard<mutex> guard(preparedMutex);
+            preparedStatements[prepare->name] = prepare->body;
+        } else if (auto *execute = get_if<ExecuteStatement>(&node)) {
+            runExecute(*execute, out);
+        } else if (auto *deallocate = get_if<DeallocateStatement>(&node)) {
+            lock_guard<mutex> guard(preparedMutex);
+            if (preparedStatements.erase(deallocate->name) == 0) {
+                throw runtime_error("Prepared statement not found: " + deallocate->name);
             }
+        } else if (auto *explain = get_if<ExplainStatement>(&node)) {
+            runExplain(*explain, out);
+        } else if (holds_alternative<ShowStatsStatement>(node)) {
+            showStats(out);
+        } else if (holds_alternative<TransactionStatement>(node)) {
+            throw runtime_error("BEGIN, COMMIT and ROLLBACK can only be sent as queries");
+        }
+    }
+
+    /**
+     * @brief Whether a statement is run at COMMIT when it is part of a transaction
+     */
+    bool isBuffered(const Statement::Node &node) {
+        return holds_alternative<InsertStatement>(node) || holds_alternative<UpdateStatement>(node) ||
+               holds_alternative<DeleteStatement>(node) || holds_alternative<LoadDataStatement>(node);
+    }
+
+    string statementName(const Statement::Node &node) {
+        return statementNames[node.index()];
+    }
+
+    /**
+     * @brief The metrics a statement is counted in; COMMIT and ROLLBACK apart from BEGIN
+     */
+    Metrics::StatementStats &statementStats(const Statement::Node &node) {
+        static const auto byType = [] {
+            array<Metrics::StatementStats *, variant_size_v<Statement::Node> > stats{};
+            for (size_t i = 0; i < stats.size(); ++i) stats[i] = &Metrics::statement(statementNames[i]);
+            return stats;
+        }();
+        static Metrics::StatementStats &commits = Metrics::statement("COMMIT");
+        static Metrics::StatementStats &rollbacks = Metrics::statement("ROLLBACK");
+        if (auto *control = get_if<TransactionStatement>(&node)) {
+            if (control->action == TransactionStatement::Action::Commit) return commits;
+            if (control->action == TransactionStatement::Action::Rollback) return rollbacks;
+        }
+        return *byType[node.index()];
+    }
+
+    /**
+     * @brief Records the time until it is destroyed into a statement's metrics, as a failure
+     * if an exception is leaving the statement
+     */
+    class StatementClock {
+    public:
+        explicit StatementClock(Metrics::StatementStats &stats)
+            : stats(stats), started(chrono::steady_clock::now()), exceptions(uncaught_exceptions()) {
+        }
 
-            columns.push_back(name);
-            dataTypes.push_back(typePart);
-            isUnique.push_back(uniqueFlag);
-            notNull.push_back(notNullFlag);
+        ~StatementClock() {
+            stats.record(chrono::duration<double, milli>(chrono::steady_clock::now() - started).count(),
+                         uncaught_exceptions() > exceptions);
         }
 
-        CreateTable::createTable(tableName, columns, dataTypes, isUnique, notNull);
-    } else if (regex_match(query, match, createDbRegex)) {
-        string dbName = match[1].str();
-        CreateDatabase::createDatabase(dbName);
-    } else if (regex_match(query, match, updateRegex)) {
-        string tableName = match[1].str();
-        string setClause = match[2].str();
-        string whereClause = match[3].matched ? match[3].str() : "";
+        StatementClock(const StatementClock &) = delete;
 
-        unordered_map<string, json> updates;
-        stringstream ssSet(setClause);
-        string setItem;
+        StatementClock &operator=(const StatementClock &) = delete;
 
-        while (getline(ssSet, setItem, ',')) {
-            setItem.erase(0, setItem.find_first_not_of(" \t\n\r\f\v"));
-            setItem.erase(setItem.find_last_not_of(" \t\n\r\f\v") + 1);
+    private:
+        Metrics::StatementStats &stats;
+        chrono::steady_clock::time_point started;
+        int exceptions;
+    };
 
-            size_t eqPos = setItem.find('=');
-            if (eqPos == string::npos) {
-                throw runtime_error("Invalid SET clause: " + setItem);
-            }
+    /**
+     * @brief Counts a query once it is done, failed or not, for the slow-query log
+     */
+    class QueryClock {
+    public:
+        explicit QueryClock(const string &query) : query(query), started(chrono::steady_clock::now()) {
+        }
+
+        ~QueryClock() {
+            Metrics::finishQuery(query, chrono::duration<double, milli>(chrono::steady_clock::now() - started).count());
+        }
+
+        QueryClock(const QueryClock &) = delete;
+
+        QueryClock &operator=(const QueryClock &) = delete;
+
+    private:
+        const string &query;
+        chrono::steady_clock::time_point started;
+    };
+
+    /**
+     * @brief Output that is produced in full and thrown away, so EXPLAIN ANALYZE formats its
+     * rows like the statement would without printing them
+     */
+    class DiscardBuffer : public streambuf {
+    protected:
+        int_type overflow(int_type c) override { return traits_type::not_eof(c); }
+
+        streamsize xsputn(const char *, streamsize count) override { return count; }
+    };
+
+    /**
+     * @brief Runs the body of an EXPLAIN with a profile current and prints what it recorded
+     *
+     * Without ANALYZE the operations only record their plan and return before reading rows.
+     * With ANALYZE the statement really runs, so an UPDATE or DELETE changes the table; its
+     * rows and messages are discarded.
+     */
+    void runExplain(const ExplainStatement &explain, ostream &out) {
+        auto started = chrono::steady_clock::now();
+        QueryProfile profile(explain.analyze);
+        profile.add(QueryProfile::Phase::Parse, explain.parseMilliseconds);
+        {
+            QueryProfile::Scope scope(profile);
+            DiscardBuffer discarded;
+            ostream results(&discarded);
+            runStatement(explain.body->node, results);
+        }
+        double total = explain.parseMilliseconds +
+                       chrono::duration<double, milli>(chrono::steady_clock::now() - started).count();
+        Explain::write(profile, statementName(explain.body->node), total, g_outputJson, out);
+    }
+}
 
-            string column = setItem.substr(0, eqPos);
-            column.erase(0, column.find_first_not_of(" \t\n\r\f\v"));
-            column.erase(column.find_last_not_of(" \t\n\r\f\v") + 1);
-
-            string valueStr = setItem.substr(eqPos + 1);
-            valueStr.erase(0, valueStr.find_first_not_of(" \t\n\r\f\v"));
-            valueStr.erase(valueStr.find_last_not_of(" \t\n\r\f\v") + 1);
-
-            json value;
-            if (valueStr == "NULL" || valueStr == "null") {
-                value = nullptr;
-            } else if (valueStr == "true" || valueStr == "TRUE") {
-                value = true;
-            } else if (valueStr == "false" || valueStr == "FALSE") {
-                value = false;
-            } else if ((valueStr[0] == '\'' && valueStr.back() == '\'') ||
-                       (valueStr[0] == '"' && valueStr.back() == '"')) {
-                value = valueStr.substr(1, valueStr.length() - 2);
-            } else if (regex_match(valueStr, regex("^-?\\d+$"))) {
-                value = stoi(valueStr);
-            } else if (regex_match(valueStr, regex(R"(^-?\d+\.\d+$)"))) {
-                value = stod(valueStr);
+/**
+ * Parse a SQL query and execute the corresponding the appropriate operation.
+ *
+ * The following operations are supported:
+ *   - INSERT INTO table_name (column1, column2, ...) VALUES (value1, value2, ...), (...), ...
+ *   - LOAD DATA 'file.csv' INTO table_name
+ *   - SELECT columns FROM table_name WHERE condition
+ *   - DELETE FROM table_name WHERE condition
+ *   - CREATE TABLE table_name (column1 type, column2 type, ...)
+ *   - CREATE INDEX index_name ON table_name (column)
+ *   - CREATE DATABASE database_name
+ *   - CHANGE DATABASE database_name
+ *   - UPDATE table_name SET column1=value1, column2=value2, ... WHERE condition
+ *   - VACUUM [TABLE] table_name
+ *   - PREPARE name AS statement (or PREPARE name FROM 'statement'), with ? for values
+ *   - EXECUTE name [USING value1, value2, ...]
+ *   - DEALLOCATE [PREPARE] name
+ *   - BEGIN [TRANSACTION], COMMIT, ROLLBACK
+ *   - EXPLAIN [ANALYZE] followed by a SELECT, UPDATE or DELETE
+ *   - SHOW STATS
+ *
+ * Several statements can be given separated by semicolons; they are all parsed before the
+ * first one runs. Between BEGIN and COMMIT, statements are buffered (see buffer()) instead of
+ * run; PREPARE, DEALLOCATE and SHOW STATS still run right away. Every statement that runs is
+ * timed into the Metrics of its type, and the whole query is counted for the slow-query log.
+ *
+ * @param query The SQL query to parse and execute.
+ * @param out Where results and messages are printed.
+ * @param session The session's transaction, which BEGIN opens and stays open between
+ * queries; without one, a transaction that the query leaves open is rolled back.
+ * @throws std::runtime_error If a statement fails, or a transaction without a session is
+ * not committed.
+ */
+void ParseQuery::parse(const string &query, ostream &out, Transaction *session) {
+    if (query.empty()) {
+        throw runtime_error("Empty query");
+    }
+
+    QueryClock queryClock(query);
+    auto started = chrono::steady_clock::now();
+    vector<Statement> statements = StatementParser::parse(query);
+    double parseMilliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - started).count();
+    for (Statement &statement: statements) {
+        if (auto *explain = get_if<ExplainStatement>(&statement.node)) explain->parseMilliseconds = parseMilliseconds;
+    }
+    Transaction local;
+    Transaction &transaction = session ? *session : local;
+    for (Statement &statement: statements) {
+        if (transaction.open && !holds_alternative<TransactionStatement>(statement.node) &&
+            !holds_alternative<PrepareStatement>(statement.node) &&
+            !holds_alternative<DeallocateStatement>(statement.node) &&
+            !holds_alternative<ShowStatsStatement>(statement.node)) {
+            // Timed with the COMMIT that runs it
+            buffer(transaction, std::move(statement));
+            continue;
+        }
+        StatementClock statementClock(statementStats(statement.node));
+        if (auto *control = get_if<TransactionStatement>(&statement.node)) {
+            if (control->action == TransactionStatement::Action::Begin) {
+                if (transaction.open) {
+                    throw runtime_error("A transaction is already open");
+                }
+                transaction.open = true;
+                continue;
+            }
+            if (!transaction.open) {
+                throw runtime_error("No transaction is open");
+            }
+            if (control->action == TransactionStatement::Action::Commit) {
+                commit(transaction, out);
             } else {
-                value = valueStr;
+                transaction.open = false;
+                transaction.statements.clear();
             }
+        } else {
+            execute(statement, {}, out);
+        }
+    }
+
+    if (local.open) {
+        throw runtime_error("Transaction rolled back: COMMIT is missing");
+    }
+}
 
-            updates[column] = value;
+/**
+ * @brief Adds a statement to an open transaction.
+ *
+ * Only INSERT, UPDATE, DELETE and LOAD DATA can be buffered, directly or through EXECUTE,
+ * which binds its arguments now. Their table must exist. An INSERT into the same table and
+ * columns as the table's previous buffered statement is merged into it, so a transaction of
+ * single-row INSERTs becomes one batch per table.
+ *
+ * @param transaction The open transaction.
+ * @param statement The statement to buffer.
+ * @throws std::runtime_error If the statement cannot be part of a transaction; the
+ * transaction stays open without it.
+ */
+void ParseQuery::buffer(Transaction &transaction, Statement statement) {
+    if (auto *execute = get_if<ExecuteStatement>(&statement.node)) {
+        shared_ptr<const Statement> prepared;
+        {
+            lock_guard<mutex> guard(preparedMutex);
+            auto it = preparedStatements.find(execute->name);
+            if (it == preparedStatements.end()) {
+                throw runtime_error("Prepared statement not found: " + execute->name);
+            }
+            prepared = it->second;
+        }
+        vector<Literal> arguments = std::move(execute->arguments);
+        statement = *prepared;
+        if (arguments.size() != statement.parameters) {
+            throw runtime_error("Expected " + to_string(statement.parameters) + " parameter" +
+                                (statement.parameters != 1 ? "s" : "") + ", got " + to_string(arguments.size()));
+        }
+        if (statement.parameters > 0) {
+            statement = bindStatement(statement, arguments);
         }
+    } else if (statement.parameters > 0) {
+        throw runtime_error("Expected " + to_string(statement.parameters) + " parameter" +
+                            (statement.parameters != 1 ? "s" : "") + ", got 0");
+    }
+
+    if (!isBuffered(statement.node)) {
+        throw runtime_error(statementName(statement.node) + " is not allowed in a transaction; COMMIT or ROLLBACK first");
+    }
+    string table = lockedTable(statement.node)->first;
+    if (!Catalog::find(CurrentDB::getCurrentDB(), table)) {
+        throw runtime_error("Table does not exist: " + table);
+    }
 
-        string normalizedWhere = whereClause;
-        if (!whereClause.empty()) {
-            size_t pos = 0;
-            while ((pos = normalizedWhere.find("==", pos)) != string::npos) {
-                normalizedWhere.replace(pos, 2, "=");
-                pos += 1;
+    if (auto *insert = get_if<InsertStatement>(&statement.node)) {
+        for (auto it = transaction.statements.rbegin(); it != transaction.statements.rend(); ++it) {
+            if (lockedTable(it->node)->first != table) continue;
+            auto *previous = get_if<InsertStatement>(&it->node);
+            if (previous && previous->columns == insert->columns) {
+                move(insert->rows.begin(), insert->rows.end(), back_inserter(previous->rows));
+                return;
             }
+            break;
+        }
+    }
+    transaction.statements.push_back(std::move(statement));
+}
 
-            regex ws_re("\\s*([=!<>]+)\\s*");
-            normalizedWhere = regex_replace(normalizedWhere, ws_re, " $1 ");
+/**
+ * @brief Runs the statements of a transaction and closes it.
+ *
+ * All tables of the transaction are locked exclusively for the whole COMMIT, in name order
+ * like the tables of a join, so other sessions see either none or all of its changes. The
+ * write-ahead log is synced once at the end, after unlocking.
+ *
+ * The statements run under a TableStore::Journal: if one fails, the changes of the ones
+ * before it, and whatever the failing one changed, are reverted before the tables are
+ * unlocked, and the rest are dropped.
+ *
+ * @param transaction The open transaction.
+ * @param out Where the statements print their messages.
+ * @throws std::runtime_error If a statement fails, after the transaction is rolled back.
+ */
+void ParseQuery::commit(Transaction &transaction, ostream &out) {
+    vector<Statement> statements = std::move(transaction.statements);
+    transaction.statements.clear();
+    transaction.open = false;
+
+    set<string> tables;
+    for (const Statement &statement: statements) {
+        tables.insert(lockedTable(statement.node)->first);
+    }
 
-            normalizedWhere.erase(0, normalizedWhere.find_first_not_of(" \t\n\r\f\v"));
-            normalizedWhere.erase(normalizedWhere.find_last_not_of(" \t\n\r\f\v") + 1);
+    WriteAheadLog::CommitScope commits;
+    string failure;
+    {
+        string database = CurrentDB::getCurrentDB();
+        list<TableLock> locks;
+        for (const string &table: tables) {
+            locks.emplace_back(database, table, TableLock::Mode::Exclusive);
+        }
+        TableStore::Journal journal;
+        for (const Statement &statement: statements) {
+            try {
+                runStatement(statement.node, out);
+            } catch (const exception &e) {
+                failure = "COMMIT failed on " + statementName(statement.node) + " (table " +
+                          lockedTable(statement.node)->first + "), the transaction was rolled back: " + e.what();
+                break;
+            }
+        }
+        if (!failure.empty()) {
+            try {
+                journal.rollback();
+            } catch (const exception &e) {
+                failure += "; rolling back failed too, some of its changes stay applied: " + string(e.what());
+            }
         }
+    }
+    commits.wait();
+    if (!failure.empty()) {
+        throw runtime_error(failure);
+    }
+}
 
-        int updated = UpdateOperation::updateTable(
-            tableName,
-            updates,
-            normalizedWhere
-        );
+/**
+ * @brief Runs a parsed statement.
+ *
+ * Prepared statements are kept for the lifetime of the process, so an interactive session
+ * parses a PREPAREd statement once and every EXECUTE only binds its arguments.
+ *
+ * The table the statement touches is locked while it runs: shared for SELECT, exclusive for
+ * statements that change it (see TableLock). A statement that changed it waits for its
+ * write-ahead log records to be synced after unlocking, so the next writer of the table can
+ * log its changes meanwhile and share the sync.
+ *
+ * @param statement The statement to run.
+ * @param arguments Values for the statement's `?` placeholders, in order.
+ * @param out Where results and messages are printed.
+ * @throws std::runtime_error If the number of arguments does not match the placeholders, or
+ * the operation fails.
+ */
+void ParseQuery::execute(const Statement &statement, const vector<Literal> &arguments, ostream &out) {
+    if (arguments.size() != statement.parameters) {
+        throw runtime_error("Expected " + to_string(statement.parameters) + " parameter" +
+                            (statement.parameters != 1 ? "s" : "") + ", got " + to_string(arguments.size()));
+    }
+    if (statement.parameters > 0) {
+        execute(bindStatement(statement, arguments), {}, out);
+        return;
+    }
 
-        if (updated < 0) {
-            throw runtime_error("Failed to update rows in table " + tableName);
+    const Statement::Node &node = statement.node;
+    WriteAheadLog::CommitScope commits;
+    optional<TableLock> lock;
+    optional<TableLock> joinLock;
+    if (auto table = lockedTable(node)) {
+        // A join locks both of its tables, in name order so two joins cannot wait on each other
+        auto *explain = get_if<ExplainStatement>(&node);
+        auto *select = get_if<SelectStatement>(explain ? &explain->body->node : &node);
+        if (select && select->join && select->join->table != select->table) {
+            auto [first, second] = minmax(select->table, select->join->table);
+            lock.emplace(CurrentDB::getCurrentDB(), first, TableLock::Mode::Shared);
+            joinLock.emplace(CurrentDB::getCurrentDB(), second, TableLock::Mode::Shared);
+        } else {
+            lock.emplace(CurrentDB::getCurrentDB(), table->first, table->second);
         }
-    } else if (regex_match(query, match, changeDbRegex)) {
-        string dbName = match[1].str();
-        ChangeDB::change(dbName);
     }
+
+    runStatement(node, out);
+
+    lock.reset();
+    joinLock.reset();
+    commits.wait();
 }
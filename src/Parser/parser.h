@@ -1,10 +1,44 @@
 #pragma once
 
+#include <iostream>
 #include <string>
+#include <vector>
+
+#include "statement.h"
 
 using namespace std;
 
+/**
+ * @brief The transaction of one session (a server connection or the interactive console)
+ *
+ * Between BEGIN and COMMIT, INSERT, UPDATE, DELETE and LOAD DATA are only checked and kept
+ * here; COMMIT runs them all at once, or none of them if one fails, and ROLLBACK drops them.
+ */
+class Transaction {
+public:
+    bool active() const {
+        return open;
+    }
+
+private:
+    bool open = false;
+    vector<Statement> statements;
+
+    friend class ParseQuery;
+};
+
 class ParseQuery {
 public:
-    static void parse(const string &query);
+    /**
+     * @param session The transaction of the caller's session; without one, a transaction
+     * must be committed or rolled back within the query
+     */
+    static void parse(const string &query, ostream &out = cout, Transaction *session = nullptr);
+
+    static void execute(const Statement &statement, const vector<Literal> &arguments = {}, ostream &out = cout);
+
+private:
+    static void buffer(Transaction &transaction, Statement statement);
+
+    static void commit(Transaction &transaction, ostream &out);
 };
@@ -0,0 +1,964 @@
+#include "predicate.h"
+#include "../Storage/filterKernels.h"
+#include "../Storage/morsels.h"
+#include "../Storage/queryProfile.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <iterator>
+#include <stdexcept>
+
+using namespace std;
+using json = nlohmann::json;
+
+namespace {
+    /**
+     * Rows left over from earlier operands are checked on their own cells, if the source can
+     * read them, when fewer than one in this many rows of the table remain
+     */
+    constexpr size_t SPARSE_ROWS = 16;
+
+    char lowerChar(char c) {
+        return static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    }
+
+    string toLower(string s) {
+        transform(s.begin(), s.end(), s.begin(), lowerChar);
+        return s;
+    }
+
+    bool equalsAt(string_view text, size_t pos, const string &lowered) {
+        if (pos + lowered.size() > text.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < lowered.size(); ++i) {
+            if (lowerChar(text[pos + i]) != lowered[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    string typeName(ColumnType type) {
+        switch (type) {
+            case ColumnType::Integer:
+                return "integer";
+            case ColumnType::Float:
+                return "float";
+            case ColumnType::Boolean:
+                return "boolean";
+            case ColumnType::Text:
+                return "text";
+        }
+        return "unknown";
+    }
+
+    string textOf(const Column &column, size_t row) {
+        switch (column.type) {
+            case ColumnType::Integer:
+                return to_string(column.ints[row]);
+            case ColumnType::Float:
+                return json(column.floats[row]).dump();
+            case ColumnType::Boolean:
+                return column.bools[row] ? "true" : "false";
+            case ColumnType::Text:
+                return column.texts[row];
+        }
+        return "";
+    }
+
+    /**
+     * @brief Matches a cell against a LIKE pattern; text cells are matched where they are
+     * instead of being copied
+     */
+    bool likeMatches(const LikePattern &pattern, const Column &column, size_t row) {
+        if (column.type == ColumnType::Text) {
+            return pattern.matches(column.texts[row]);
+        }
+        return pattern.matches(textOf(column, row));
+    }
+}
+
+/**
+ * @brief Prepares a LIKE pattern.
+ *
+ * The pattern is lowered once, and the common shapes 'abc', 'abc%', '%abc' and '%abc%' are
+ * recognised so they are matched without backtracking.
+ *
+ * @param likePattern The pattern, with the quotes already removed.
+ */
+LikePattern::LikePattern(const string &likePattern) : pattern(toLower(likePattern)) {
+    size_t firstWildcard = likePattern.find_first_of("%_");
+    prefix = likePattern.substr(0, firstWildcard);
+
+    if (pattern.find('_') != string::npos) {
+        shape = Shape::General;
+        return;
+    }
+
+    bool leading = !pattern.empty() && pattern.front() == '%';
+    bool trailing = pattern.size() > (leading ? 1 : 0) && pattern.back() == '%';
+    literal = pattern.substr(leading ? 1 : 0, pattern.size() - (leading ? 1 : 0) - (trailing ? 1 : 0));
+    if (literal.find('%') != string::npos) {
+        shape = Shape::General;
+    } else if (leading && trailing) {
+        shape = Shape::Contains;
+    } else if (leading) {
+        shape = Shape::Suffix;
+    } else if (trailing) {
+        shape = Shape::Prefix;
+    } else {
+        shape = Shape::Exact;
+    }
+}
+
+bool LikePattern::matches(string_view text) const {
+    switch (shape) {
+        case Shape::Exact:
+            return text.size() == literal.size() && equalsAt(text, 0, literal);
+        case Shape::Prefix:
+            return equalsAt(text, 0, literal);
+        case Shape::Suffix:
+            return text.size() >= literal.size() && equalsAt(text, text.size() - literal.size(), literal);
+        case Shape::Contains:
+            for (size_t pos = 0; pos + literal.size() <= text.size(); ++pos) {
+                if (equalsAt(text, pos, literal)) return true;
+            }
+            return false;
+        case Shape::General:
+            break;
+    }
+
+    // Greedy matching that backtracks to the most recent '%'
+    size_t t = 0, p = 0;
+    size_t starPattern = string::npos, starText = 0;
+    while (t < text.size()) {
+        if (p < pattern.size() && (pattern[p] == '_' || pattern[p] == lowerChar(text[t]))) {
+            ++p;
+            ++t;
+        } else if (p < pattern.size() && pattern[p] == '%') {
+            starPattern = p++;
+            starText = t;
+        } else if (starPattern != string::npos) {
+            p = starPattern + 1;
+            t = ++starText;
+        } else {
+            return false;
+        }
+    }
+    while (p < pattern.size() && pattern[p] == '%') {
+        ++p;
+    }
+    return p == pattern.size();
+}
+
+/**
+ * @brief Compiles a condition for a column of the given type.
+ *
+ * Quoted values are taken literally; an unquoted NULL turns `=` and `!=` into IS NULL and
+ * IS NOT NULL. For numeric columns the value must be a number, for boolean columns one of
+ * true, false, 1 or 0.
+ *
+ * @param condition The parsed condition.
+ * @param type The type of the condition's column.
+ * @return The compiled predicate.
+ * @throws std::runtime_error If the operator is not supported, NULL is used with an ordering
+ * operator, the value cannot be converted to the column type, or it is an unbound `?`.
+ */
+Predicate Predicate::compile(const Condition &condition, ColumnType type) {
+    if (condition.parameter) {
+        throw runtime_error("No value bound to parameter " + to_string(*condition.parameter + 1));
+    }
+    Predicate predicate;
+    predicate.columnName = condition.column;
+    predicate.columnType = type;
+
+    const string &raw = condition.value;
+    bool quoted = raw.size() >= 2 && (raw.front() == '\'' || raw.front() == '"') && raw.back() == raw.front();
+    string value = quoted ? raw.substr(1, raw.size() - 2) : raw;
+    string op = toLower(condition.op);
+
+    if (!quoted && toLower(value) == "null") {
+        if (op == "=" || op == "==") {
+            predicate.operation = Op::IsNull;
+        } else if (op == "!=" || op == "<>") {
+            predicate.operation = Op::IsNotNull;
+        } else {
+            throw runtime_error("NULL can only be compared with = or !=");
+        }
+        return predicate;
+    }
+
+    if (op == "=" || op == "==") predicate.operation = Op::Equal;
+    else if (op == "!=" || op == "<>") predicate.operation = Op::NotEqual;
+    else if (op == "<") predicate.operation = Op::Less;
+    else if (op == "<=") predicate.operation = Op::LessEqual;
+    else if (op == ">") predicate.operation = Op::Greater;
+    else if (op == ">=") predicate.operation = Op::GreaterEqual;
+    else if (op == "like") predicate.operation = Op::Like;
+    else throw runtime_error("Unsupported operator: " + condition.op);
+
+    if (predicate.operation == Op::Like) {
+        predicate.pattern = LikePattern(value);
+        predicate.constant = value;
+        return predicate;
+    }
+
+    auto mismatch = [&]() {
+        return runtime_error("Cannot compare " + typeName(type) + " column '" + condition.column + "' with '" +
+                             value + "'");
+    };
+
+    switch (type) {
+        case ColumnType::Integer:
+        case ColumnType::Float: {
+            if (value.empty() || isspace(static_cast<unsigned char>(value[0]))) {
+                throw mismatch();
+            }
+            size_t used = 0;
+            try {
+                if (value.find_first_of(".eE") != string::npos) {
+                    predicate.doubleValue = stod(value, &used);
+                    predicate.doubleConstant = true;
+                } else {
+                    predicate.intValue = stoll(value, &used);
+                }
+            } catch (const exception &) {
+                throw mismatch();
+            }
+            if (used != value.size()) {
+                throw mismatch();
+            }
+            if (type == ColumnType::Float && !predicate.doubleConstant) {
+                predicate.doubleValue = static_cast<double>(predicate.intValue);
+                predicate.doubleConstant = true;
+            }
+            predicate.constant = predicate.doubleConstant ? json(predicate.doubleValue) : json(predicate.intValue);
+            break;
+        }
+        case ColumnType::Boolean: {
+            string lower = toLower(value);
+            if (lower == "true" || lower == "1") predicate.boolValue = true;
+            else if (lower == "false" || lower == "0") predicate.boolValue = false;
+            else throw mismatch();
+            predicate.constant = predicate.boolValue;
+            break;
+        }
+        case ColumnType::Text:
+            predicate.textValue = value;
+            predicate.constant = value;
+            break;
+    }
+    return predicate;
+}
+
+/**
+ * @brief Spells the predicate as SQL, e.g. `price >= 10` or `name LIKE 'J%'`.
+ */
+string Predicate::describe() const {
+    switch (operation) {
+        case Op::IsNull:
+            return columnName + " IS NULL";
+        case Op::IsNotNull:
+            return columnName + " IS NOT NULL";
+        default:
+            break;
+    }
+    static const char *const symbols[] = {"=", "!=", "<", "<=", ">", ">=", "LIKE"};
+    string value = constant.is_string() ? "'" + constant.get<string>() + "'" : constant.dump();
+    return columnName + " " + symbols[static_cast<size_t>(operation)] + " " + value;
+}
+
+template<typename T>
+bool Predicate::compare(const T &cell, const T &target) const {
+    switch (operation) {
+        case Op::Equal:
+            return cell == target;
+        case Op::NotEqual:
+            return cell != target;
+        case Op::Less:
+            return cell < target;
+        case Op::LessEqual:
+            return cell <= target;
+        case Op::Greater:
+            return cell > target;
+        case Op::GreaterEqual:
+            return cell >= target;
+        default:
+            return false;
+    }
+}
+
+bool Predicate::matches(const Column &column, size_t row) const {
+    if (column.isNull(row)) {
+        return operation == Op::IsNull;
+    }
+    switch (operation) {
+        case Op::IsNull:
+            return false;
+        case Op::IsNotNull:
+            return true;
+        case Op::Like:
+            return likeMatches(pattern, column, row);
+        default:
+            break;
+    }
+
+    switch (columnType) {
+        case ColumnType::Integer:
+            return doubleConstant
+                       ? compare(static_cast<double>(column.ints[row]), doubleValue)
+                       : compare(column.ints[row], intValue);
+        case ColumnType::Float:
+            return compare(column.floats[row], doubleValue);
+        case ColumnType::Boolean:
+            return compare(column.bools[row] != 0, boolValue);
+        case ColumnType::Text:
+            return compare(column.texts[row], textValue);
+    }
+    return false;
+}
+
+/**
+ * @brief Checks a segment's statistics against the predicate.
+ *
+ * Only answers false when no row of the segment can match; a segment without bounds (all
+ * NULL aside) may always match.
+ */
+bool Predicate::mayMatch(const Zone &zone) const {
+    switch (operation) {
+        case Op::IsNull:
+            return zone.nulls > 0;
+        case Op::IsNotNull:
+        case Op::Like:
+            return zone.nulls < zone.rows;
+        default:
+            break;
+    }
+    if (zone.nulls == zone.rows) {
+        return false;
+    }
+    if (!zone.bounded || (doubleConstant && std::isnan(doubleValue))) {
+        return true;
+    }
+
+    auto overlaps = [&](const auto &low, const auto &high, const auto &target) {
+        switch (operation) {
+            case Op::Equal:
+                return !(target < low) && !(high < target);
+            case Op::NotEqual:
+                return low < target || target < high;
+            case Op::Less:
+                return low < target;
+            case Op::LessEqual:
+                return !(target < low);
+            case Op::Greater:
+                return target < high;
+            case Op::GreaterEqual:
+                return !(high < target);
+            default:
+                return true;
+        }
+    };
+    switch (columnType) {
+        case ColumnType::Integer:
+            return doubleConstant
+                       ? overlaps(static_cast<double>(zone.minInteger), static_cast<double>(zone.maxInteger), doubleValue)
+                       : overlaps(zone.minInteger, zone.maxInteger, intValue);
+        case ColumnType::Float:
+            return overlaps(zone.minReal, zone.maxReal, doubleValue);
+        case ColumnType::Boolean:
+            return overlaps(zone.minInteger, zone.maxInteger, static_cast<int64_t>(boolValue));
+        case ColumnType::Text:
+            return overlaps(zone.minText, zone.maxText, textValue);
+    }
+    return true;
+}
+
+template<typename Test>
+void Predicate::collect(const Column &column, size_t first, size_t last, vector<size_t> &rows, Test test) const {
+    for (size_t row = first; row < last; ++row) {
+        if (!column.nulls[row] && test(row)) {
+            rows.push_back(row);
+        }
+    }
+}
+
+/**
+ * @brief Runs a comparison on an integer or float column through the batch filter kernels.
+ *
+ * A fractional constant compared with an integer column is first turned into the equivalent
+ * integer comparison (a > 2.5 is a >= 3). Returns false if that is not possible.
+ */
+bool Predicate::numericScan(const Column &column, size_t first, size_t last, vector<size_t> &rows) const {
+    using FilterKernels::Compare;
+    Compare compare;
+    switch (operation) {
+        case Op::Equal: compare = Compare::Equal; break;
+        case Op::NotEqual: compare = Compare::NotEqual; break;
+        case Op::Less: compare = Compare::Less; break;
+        case Op::LessEqual: compare = Compare::LessEqual; break;
+        case Op::Greater: compare = Compare::Greater; break;
+        case Op::GreaterEqual: compare = Compare::GreaterEqual; break;
+        default: return false;
+    }
+
+    size_t count = last - first;
+    vector<uint64_t> bitmap(FilterKernels::wordsFor(count));
+
+    if (columnType == ColumnType::Float) {
+        FilterKernels::compareDouble(column.floats.data() + first, count, doubleValue, compare, bitmap.data());
+    } else {
+        int64_t target = intValue;
+        if (doubleConstant) {
+            if (std::isnan(doubleValue) || fabs(doubleValue) > 9.2e18) {
+                return false;
+            }
+            if (doubleValue != floor(doubleValue)) {
+                switch (compare) {
+                    case Compare::Equal:
+                        return true;
+                    case Compare::NotEqual:
+                        collect(column, first, last, rows, [](size_t) { return true; });
+                        return true;
+                    case Compare::Less:
+                    case Compare::LessEqual:
+                        compare = Compare::LessEqual;
+                        target = static_cast<int64_t>(floor(doubleValue));
+                        break;
+                    case Compare::Greater:
+                    case Compare::GreaterEqual:
+                        compare = Compare::GreaterEqual;
+                        target = static_cast<int64_t>(ceil(doubleValue));
+                        break;
+                }
+            } else {
+                target = static_cast<int64_t>(doubleValue);
+            }
+        }
+        FilterKernels::compareInt64(column.ints.data() + first, count, target, compare, bitmap.data());
+    }
+
+    FilterKernels::clearNulls(column.nulls.data() + first, count, bitmap.data());
+    for (size_t row: FilterKernels::selectedRows(bitmap.data(), count)) {
+        rows.push_back(first + row);
+    }
+    return true;
+}
+
+/**
+ * @brief Runs = or != on a dictionary-encoded text column by comparing the codes of the rows
+ * with the code of the constant, which is looked up once. Returns false for other operators.
+ */
+bool Predicate::codeScan(const Column &column, size_t first, size_t last, vector<size_t> &rows) const {
+    if (operation != Op::Equal && operation != Op::NotEqual) {
+        return false;
+    }
+    optional<uint32_t> code = column.dictionary->find(textValue);
+    if (!code) {
+        if (operation == Op::NotEqual) collect(column, first, last, rows, [](size_t) { return true; });
+        return true;
+    }
+    const uint32_t *codes = column.codes.data();
+    uint32_t target = *code;
+    if (operation == Op::Equal) {
+        collect(column, first, last, rows, [&](size_t row) { return codes[row] == target; });
+    } else {
+        collect(column, first, last, rows, [&](size_t row) { return codes[row] != target; });
+    }
+    return true;
+}
+
+/**
+ * @brief Evaluates the predicate over a whole column.
+ *
+ * The column is scanned in morsels on several threads (see Morsels). Within a morsel the
+ * operator and the column type are dispatched once, outside the loop over the rows; numeric
+ * comparisons produce a selection bitmap with the vectorised filter kernels.
+ *
+ * @param column The column the predicate refers to.
+ * @return The matching row indices in ascending order.
+ */
+vector<size_t> Predicate::matchingRows(const Column &column) const {
+    return Morsels::collect(column.size(), [&](size_t first, size_t last, vector<size_t> &rows) {
+        scanRange(column, first, last, rows);
+    });
+}
+
+vector<size_t> Predicate::matchingRows(const Column &column, size_t first, size_t last) const {
+    return Morsels::collect(last - first, [&](size_t from, size_t to, vector<size_t> &rows) {
+        scanRange(column, first + from, first + to, rows);
+    });
+}
+
+void Predicate::scanRange(const Column &column, size_t first, size_t last, vector<size_t> &rows) const {
+    if (operation == Op::IsNull) {
+        for (size_t row = first; row < last; ++row) {
+            if (column.nulls[row]) rows.push_back(row);
+        }
+        return;
+    }
+    if (operation == Op::IsNotNull) {
+        collect(column, first, last, rows, [](size_t) { return true; });
+        return;
+    }
+    if (operation == Op::Like) {
+        collect(column, first, last, rows, [&](size_t row) { return likeMatches(pattern, column, row); });
+        return;
+    }
+
+    if ((columnType == ColumnType::Integer || columnType == ColumnType::Float) &&
+        numericScan(column, first, last, rows)) {
+        return;
+    }
+    if (columnType == ColumnType::Text && column.dictionary && codeScan(column, first, last, rows)) {
+        return;
+    }
+
+    auto scan = [&](const auto &values, const auto &target) {
+        switch (operation) {
+            case Op::Equal:
+                return collect(column, first, last, rows, [&](size_t row) { return values[row] == target; });
+            case Op::NotEqual:
+                return collect(column, first, last, rows, [&](size_t row) { return values[row] != target; });
+            case Op::Less:
+                return collect(column, first, last, rows, [&](size_t row) { return values[row] < target; });
+            case Op::LessEqual:
+                return collect(column, first, last, rows, [&](size_t row) { return values[row] <= target; });
+            case Op::Greater:
+                return collect(column, first, last, rows, [&](size_t row) { return values[row] > target; });
+            case Op::GreaterEqual:
+                return collect(column, first, last, rows, [&](size_t row) { return values[row] >= target; });
+            default:
+                return;
+        }
+    };
+
+    switch (columnType) {
+        case ColumnType::Integer:
+            return doubleConstant ? scan(column.ints, doubleValue) : scan(column.ints, intValue);
+        case ColumnType::Float:
+            return scan(column.floats, doubleValue);
+        case ColumnType::Boolean:
+            return scan(column.bools, static_cast<uint8_t>(boolValue ? 1 : 0));
+        case ColumnType::Text:
+            return scan(column.texts, textValue);
+    }
+}
+
+/**
+ * @brief Compiles an expression tree.
+ *
+ * @param expr The parsed expression.
+ * @param typeOf Returns the type of a column named by a condition; it throws for unknown
+ * columns.
+ * @return The compiled expression.
+ * @throws std::runtime_error If a condition cannot be compiled.
+ */
+PredicateTree PredicateTree::compile(const ConditionExpr &expr, const function<ColumnType(const string &)> &typeOf) {
+    PredicateTree tree;
+    tree.kind = expr.kind;
+    if (expr.kind == ConditionExpr::Kind::Leaf) {
+        tree.leaf = Predicate::compile(expr.condition, typeOf(expr.condition.column));
+        return tree;
+    }
+    for (const auto &child: expr.children) {
+        tree.children.push_back(compile(child, typeOf));
+    }
+    return tree;
+}
+
+vector<const Predicate *> PredicateTree::conjuncts() const {
+    vector<const Predicate *> predicates;
+    if (kind == ConditionExpr::Kind::Leaf) {
+        predicates.push_back(&*leaf);
+    } else if (kind == ConditionExpr::Kind::And) {
+        for (const auto &child: children) {
+            if (child.kind == ConditionExpr::Kind::Leaf) predicates.push_back(&*child.leaf);
+        }
+    }
+    return predicates;
+}
+
+bool PredicateTree::matches(const function<const Column &(const string &)> &column, size_t row) const {
+    switch (kind) {
+        case ConditionExpr::Kind::Leaf:
+            return leaf->matches(column(leaf->column()), row);
+        case ConditionExpr::Kind::And:
+            return all_of(children.begin(), children.end(),
+                          [&](const PredicateTree &child) { return child.matches(column, row); });
+        case ConditionExpr::Kind::Or:
+            return any_of(children.begin(), children.end(),
+                          [&](const PredicateTree &child) { return child.matches(column, row); });
+        case ConditionExpr::Kind::Not:
+            return !children[0].matches(column, row);
+    }
+    return false;
+}
+
+/**
+ * @brief Estimates how expensive and how unselective a subtree is; lower runs first.
+ */
+int PredicateTree::cost(const Source &source) const {
+    using Op = Predicate::Op;
+    switch (kind) {
+        case ConditionExpr::Kind::Leaf:
+            if (source.indexed && source.indexed(*leaf)) return 0;
+            switch (leaf->op()) {
+                case Op::Equal:
+                case Op::IsNull:
+                    return 1;
+                case Op::Less:
+                case Op::LessEqual:
+                case Op::Greater:
+                case Op::GreaterEqual:
+                    return 2;
+                case Op::Like:
+                    return 3;
+                default:
+                    return 4;
+            }
+        case ConditionExpr::Kind::And: {
+            int cheapest = 4;
+            for (const auto &child: children) cheapest = min(cheapest, child.cost(source));
+            return cheapest;
+        }
+        case ConditionExpr::Kind::Or: {
+            int dearest = 0;
+            for (const auto &child: children) dearest = max(dearest, child.cost(source));
+            return dearest;
+        }
+        case ConditionExpr::Kind::Not:
+            return 4;
+    }
+    return 4;
+}
+
+/**
+ * @brief Looks up the zones of a predicate's column and keeps the segments that can match.
+ *
+ * Rows after the last zone (still in the insert log) are always kept. Adjacent kept segments
+ * are merged into one range.
+ */
+optional<vector<pair<size_t, size_t> > > PredicateTree::zoneRanges(const Source &source, const Predicate &predicate) {
+    const vector<Zone> *zones = source.zones ? source.zones(predicate.column()) : nullptr;
+    if (!zones || zones->empty()) {
+        return nullopt;
+    }
+
+    vector<pair<size_t, size_t> > ranges;
+    bool pruned = false;
+    auto keep = [&](size_t first, size_t last) {
+        if (!ranges.empty() && ranges.back().second == first) ranges.back().second = last;
+        else ranges.emplace_back(first, last);
+    };
+    for (const auto &zone: *zones) {
+        if (predicate.mayMatch(zone)) keep(zone.firstRow, zone.firstRow + zone.rows);
+        else pruned = true;
+    }
+    size_t covered = zones->back().firstRow + zones->back().rows;
+    if (covered < source.rowCount) {
+        keep(covered, source.rowCount);
+    }
+    if (!pruned) {
+        return nullopt;
+    }
+    return ranges;
+}
+
+/**
+ * @brief Evaluates the expression over every row, or when the statement is only planned
+ * (see QueryProfile::planning()), records how it would and returns no rows.
+ */
+vector<size_t> PredicateTree::matchingRows(const Source &source) const {
+    if (QueryProfile::planning()) {
+        plan(source, false);
+        return {};
+    }
+    return evaluate(source, nullptr);
+}
+
+/**
+ * @brief Evaluates a single condition over a selection of rows.
+ *
+ * Rows from an index are taken as they are when the index matched the exact key, and are
+ * otherwise checked on their own cells where the source can read them, not on the column;
+ * so are the few rows left by earlier operands of an AND.
+ *
+ * @param source The table.
+ * @param rows The ascending rows to consider, or nullptr for every row of the table.
+ * @param step Filled with how the rows were found and how many were checked, if not nullptr.
+ * @return The rows among them that satisfy the condition, in ascending order.
+ */
+vector<size_t> PredicateTree::evaluateLeaf(const Source &source, const vector<size_t> *rows,
+                                           QueryProfile::FilterStep *step) const {
+    const Predicate &predicate = *leaf;
+    vector<size_t> selected;
+    if (!rows && source.candidates) {
+        if (optional<vector<size_t> > candidates = source.candidates(predicate)) {
+            if (step) {
+                step->access = "index lookup";
+                step->rowsChecked = candidates->size();
+            }
+            if (source.exact && source.exact(predicate)) {
+                return std::move(*candidates);
+            }
+            if (source.cells) {
+                Column values = source.cells(predicate.column(), *candidates);
+                for (size_t i = 0; i < candidates->size(); ++i) {
+                    if (predicate.matches(values, i)) selected.push_back((*candidates)[i]);
+                }
+                return selected;
+            }
+            const Column &values = source.column(predicate.column());
+            for (size_t row: *candidates) {
+                if (predicate.matches(values, row)) selected.push_back(row);
+            }
+            return selected;
+        }
+    }
+
+    // Rows in segments the zone maps rule out are never looked at
+    optional<vector<pair<size_t, size_t> > > ranges = zoneRanges(source, predicate);
+    if (step) {
+        countSegments(source, predicate, *step);
+        step->rowsChecked = 0;
+    }
+    vector<size_t> inRanges;
+    if (ranges && rows) {
+        auto range = ranges->begin();
+        for (size_t row: *rows) {
+            while (range != ranges->end() && range->second <= row) ++range;
+            if (range == ranges->end()) break;
+            if (row >= range->first) inRanges.push_back(row);
+        }
+        rows = &inRanges;
+        if (rows->empty()) {
+            if (step) step->access = "zone maps";
+            return selected;
+        }
+    }
+
+    if (ranges && source.slice) {
+        size_t candidates = 0;
+        for (const auto &[first, last]: *ranges) candidates += last - first;
+        if (candidates * 2 <= source.rowCount) {
+            if (step) {
+                step->access = "decoded matching segments";
+                step->rowsChecked = rows ? rows->size() : candidates;
+            }
+            // Few segments are left, so decode just those instead of the whole column
+            auto row = rows ? rows->begin() : vector<size_t>::const_iterator();
+            for (const auto &[first, last]: *ranges) {
+                if (rows && (row == rows->end() || *row >= last)) continue;
+                Column part = source.slice(predicate.column(), first, last);
+                if (!rows) {
+                    for (size_t match: predicate.matchingRows(part)) selected.push_back(first + match);
+                    continue;
+                }
+                for (; row != rows->end() && *row < last; ++row) {
+                    if (predicate.matches(part, *row - first)) selected.push_back(*row);
+                }
+            }
+            return selected;
+        }
+    }
+
+    if (rows && source.cells && rows->size() * SPARSE_ROWS < source.rowCount) {
+        if (step) {
+            step->access = "remaining rows";
+            step->rowsChecked = rows->size();
+        }
+        Column values = source.cells(predicate.column(), *rows);
+        for (size_t i = 0; i < rows->size(); ++i) {
+            if (predicate.matches(values, i)) selected.push_back((*rows)[i]);
+        }
+        return selected;
+    }
+
+    const Column &values = source.column(predicate.column());
+    auto scan = [&]() {
+        if (step) {
+            step->access = "column scan";
+            step->rowsChecked = source.rowCount;
+            if (ranges) {
+                step->rowsChecked = 0;
+                for (const auto &[first, last]: *ranges) *step->rowsChecked += last - first;
+            }
+        }
+        if (!ranges) {
+            return predicate.matchingRows(values);
+        }
+        vector<size_t> matched;
+        for (const auto &[first, last]: *ranges) {
+            vector<size_t> part = predicate.matchingRows(values, first, last);
+            matched.insert(matched.end(), part.begin(), part.end());
+        }
+        return matched;
+    };
+    if (!rows) {
+        return scan();
+    }
+    if (rows->size() * 4 >= source.rowCount) {
+        // Most rows are still in play, so a full scan with the batch kernels is cheaper
+        vector<size_t> all = scan();
+        set_intersection(all.begin(), all.end(), rows->begin(), rows->end(), back_inserter(selected));
+        return selected;
+    }
+    if (step) {
+        step->access = "remaining rows";
+        step->rowsChecked = rows->size();
+    }
+    return Morsels::collect(rows->size(), [&](size_t first, size_t last, vector<size_t> &out) {
+        for (size_t i = first; i < last; ++i) {
+            if (predicate.matches(values, (*rows)[i])) out.push_back((*rows)[i]);
+        }
+    });
+}
+
+/**
+ * @brief Counts the zone-mapped segments of a predicate's column and those it rules out.
+ */
+void PredicateTree::countSegments(const Source &source, const Predicate &predicate, QueryProfile::FilterStep &step) {
+    const vector<Zone> *zones = source.zones ? source.zones(predicate.column()) : nullptr;
+    step.segments = zones ? zones->size() : 0;
+    step.skippedSegments = 0;
+    if (zones) {
+        for (const auto &zone: *zones) {
+            if (!predicate.mayMatch(zone)) ++step.skippedSegments;
+        }
+    }
+}
+
+/**
+ * @brief Records how evaluate() would find the rows of each condition, without reading them.
+ *
+ * The decisions are the ones evaluate() makes before it looks at any row; one that depends
+ * on how many rows earlier conditions left is reported as `remaining rows`.
+ *
+ * @param source The table.
+ * @param restricted Whether earlier conditions narrow the rows this subtree is given.
+ */
+void PredicateTree::plan(const Source &source, bool restricted) const {
+    switch (kind) {
+        case ConditionExpr::Kind::Leaf: {
+            QueryProfile::FilterStep step;
+            step.condition = leaf->describe();
+            if (!restricted && source.candidates && source.indexed && source.indexed(*leaf)) {
+                step.access = "index lookup";
+                QueryProfile::addFilter(std::move(step));
+                return;
+            }
+            optional<vector<pair<size_t, size_t> > > ranges = zoneRanges(source, *leaf);
+            countSegments(source, *leaf, step);
+            size_t candidates = source.rowCount;
+            if (ranges) {
+                candidates = 0;
+                for (const auto &[first, last]: *ranges) candidates += last - first;
+            }
+            if (ranges && source.slice && candidates * 2 <= source.rowCount) {
+                step.access = "decoded matching segments";
+            } else {
+                step.access = restricted ? "remaining rows" : "column scan";
+            }
+            QueryProfile::addFilter(std::move(step));
+            return;
+        }
+        case ConditionExpr::Kind::And:
+        case ConditionExpr::Kind::Or: {
+            vector<const PredicateTree *> ordered;
+            for (const auto &child: children) ordered.push_back(&child);
+            stable_sort(ordered.begin(), ordered.end(), [&](const PredicateTree *a, const PredicateTree *b) {
+                return a->cost(source) < b->cost(source);
+            });
+            // Later operands of an AND only see the rows the earlier ones left
+            bool conjunction = kind == ConditionExpr::Kind::And;
+            for (size_t i = 0; i < ordered.size(); ++i) {
+                ordered[i]->plan(source, restricted || (conjunction && i > 0));
+            }
+            return;
+        }
+        case ConditionExpr::Kind::Not:
+            children[0].plan(source, restricted);
+            return;
+    }
+}
+
+/**
+ * @brief Evaluates the subtree over a selection of rows.
+ *
+ * @param source The table.
+ * @param rows The ascending rows to consider, or nullptr for every row of the table.
+ * @return The rows among them that satisfy the subtree, in ascending order.
+ */
+vector<size_t> PredicateTree::evaluate(const Source &source, const vector<size_t> *rows) const {
+    auto everyRow = [&]() {
+        vector<size_t> all(source.rowCount);
+        for (size_t i = 0; i < all.size(); ++i) all[i] = i;
+        return all;
+    };
+    auto byCost = [&]() {
+        vector<const PredicateTree *> ordered;
+        for (const auto &child: children) ordered.push_back(&child);
+        stable_sort(ordered.begin(), ordered.end(), [&](const PredicateTree *a, const PredicateTree *b) {
+            return a->cost(source) < b->cost(source);
+        });
+        return ordered;
+    };
+
+    switch (kind) {
+        case ConditionExpr::Kind::Leaf: {
+            if (!QueryProfile::current()) {
+                return evaluateLeaf(source, rows, nullptr);
+            }
+            QueryProfile::FilterStep step;
+            step.condition = leaf->describe();
+            QueryProfile::Timer timer(QueryProfile::Phase::Filter);
+            vector<size_t> selected = evaluateLeaf(source, rows, &step);
+            step.rowsMatched = selected.size();
+            step.milliseconds = timer.milliseconds();
+            QueryProfile::addFilter(std::move(step));
+            return selected;
+        }
+        case ConditionExpr::Kind::And: {
+            vector<size_t> surviving;
+            const vector<size_t> *input = rows;
+            for (const PredicateTree *child: byCost()) {
+                surviving = child->evaluate(source, input);
+                input = &surviving;
+                if (surviving.empty()) break;
+            }
+            return surviving;
+        }
+        case ConditionExpr::Kind::Or: {
+            vector<size_t> selected;
+            for (const PredicateTree *child: byCost()) {
+                vector<size_t> part;
+                if (rows) {
+                    // Only rows no earlier operand accepted are left to check
+                    vector<size_t> remaining;
+                    set_difference(rows->begin(), rows->end(), selected.begin(), selected.end(),
+                                   back_inserter(remaining));
+                    if (remaining.empty()) break;
+                    part = child->evaluate(source, &remaining);
+                } else {
+                    part = child->evaluate(source, nullptr);
+                }
+                vector<size_t> merged;
+                set_union(selected.begin(), selected.end(), part.begin(), part.end(), back_inserter(merged));
+                selected = std::move(merged);
+            }
+            return selected;
+        }
+        case ConditionExpr::Kind::Not: {
+            vector<size_t> excluded = children[0].evaluate(source, rows);
+            vector<size_t> all = rows ? vector<size_t>() : everyRow();
+            const vector<size_t> &universe = rows ? *rows : all;
+            vector<size_t> selected;
+            set_difference(universe.begin(), universe.end(), excluded.begin(), excluded.end(),
+                           back_inserter(selected));
+            return selected;
+        }
+    }
+    return {};
+}
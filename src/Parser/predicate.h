@@ -0,0 +1,199 @@
+#pragma once
+
+#include "conditionParser.h"
+#include "../Storage/columnStore.h"
+#include "../Storage/queryProfile.h"
+#include "../Storage/zoneMap.h"
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+/**
+ * @brief A LIKE pattern prepared once for matching many values
+ *
+ * `%` matches any sequence and `_` a single character; letters match case-insensitively.
+ */
+class LikePattern {
+public:
+    explicit LikePattern(const std::string &pattern = "");
+
+    bool matches(std::string_view text) const;
+
+    /**
+     * @brief Characters before the first wildcard, in their original case
+     */
+    const std::string &literalPrefix() const { return prefix; }
+
+private:
+    enum class Shape { Exact, Prefix, Suffix, Contains, General };
+
+    std::string pattern;
+    std::string literal;
+    std::string prefix;
+    Shape shape = Shape::General;
+};
+
+/**
+ * @brief A WHERE condition compiled against the type of its column
+ *
+ * The condition value is converted to the column type once, so rows are compared as native
+ * int64, double, bool or string values. NULL cells only satisfy `= NULL`; every other
+ * comparison with a NULL cell is false.
+ */
+class Predicate {
+public:
+    enum class Op { Equal, NotEqual, Less, LessEqual, Greater, GreaterEqual, Like, IsNull, IsNotNull };
+
+    /**
+     * @brief Compiles a parsed condition for a column of the given type
+     * @throws std::runtime_error if the operator is unknown or the value cannot be compared
+     * with the column type
+     */
+    static Predicate compile(const Condition &condition, ColumnType type);
+
+    const std::string &column() const { return columnName; }
+
+    Op op() const { return operation; }
+
+    ColumnType type() const { return columnType; }
+
+    /**
+     * @brief The condition value converted to the column type (an int64 or a double for
+     * integer columns); null for IS NULL and IS NOT NULL
+     */
+    const json &value() const { return constant; }
+
+    const LikePattern &like() const { return pattern; }
+
+    /**
+     * @brief The condition as SQL, for EXPLAIN
+     */
+    std::string describe() const;
+
+    bool matches(const Column &column, size_t row) const;
+
+    /**
+     * @brief Whether a row of a segment with the given statistics can satisfy the predicate
+     */
+    bool mayMatch(const Zone &zone) const;
+
+    /**
+     * @brief Returns the rows of the column that satisfy the predicate, in ascending order
+     */
+    std::vector<size_t> matchingRows(const Column &column) const;
+
+    /**
+     * @brief Returns the rows among [first, last) that satisfy the predicate, in ascending order
+     */
+    std::vector<size_t> matchingRows(const Column &column, size_t first, size_t last) const;
+
+private:
+    std::string columnName;
+    Op operation = Op::Equal;
+    ColumnType columnType = ColumnType::Text;
+    json constant;
+    LikePattern pattern;
+    bool doubleConstant = false;
+    int64_t intValue = 0;
+    double doubleValue = 0;
+    bool boolValue = false;
+    std::string textValue;
+
+    template<typename T>
+    bool compare(const T &cell, const T &target) const;
+
+    template<typename Test>
+    void collect(const Column &column, size_t first, size_t last, std::vector<size_t> &rows, Test test) const;
+
+    bool numericScan(const Column &column, size_t first, size_t last, std::vector<size_t> &rows) const;
+
+    bool codeScan(const Column &column, size_t first, size_t last, std::vector<size_t> &rows) const;
+
+    /**
+     * @brief Appends the matching rows among [first, last) to `rows`
+     */
+    void scanRange(const Column &column, size_t first, size_t last, std::vector<size_t> &rows) const;
+};
+
+/**
+ * @brief A WHERE expression compiled against the types of its columns
+ *
+ * The expression is evaluated one column at a time over a selection of rows. The operands of
+ * an AND run cheapest first (indexed, then equality, ranges, LIKE and inequality), and each
+ * later operand only checks the rows that survived the earlier ones. NOT is the complement of
+ * its operand within the rows it is given. A condition skips the segments its column's zone
+ * maps rule out, and only decodes the others when the source can slice columns.
+ */
+class PredicateTree {
+public:
+    /**
+     * @brief The table an expression is evaluated against
+     */
+    struct Source {
+        size_t rowCount = 0;
+        std::function<const Column &(const std::string &)> column;
+        // Optional: the rows an index says can satisfy a predicate, or nullopt if none applies
+        std::function<std::optional<std::vector<size_t> >(const Predicate &)> candidates;
+        // Optional: whether `candidates` can answer a predicate
+        std::function<bool(const Predicate &)> indexed;
+        // Optional: whether every row `candidates` returns for a predicate satisfies it
+        std::function<bool(const Predicate &)> exact;
+        // Optional: the values of a column at some ascending rows, without decoding the rest
+        std::function<Column(const std::string &, const std::vector<size_t> &)> cells;
+        // Optional: the zone maps of a column, or nullptr if it has none
+        std::function<const std::vector<Zone> *(const std::string &)> zones;
+        // Optional: decodes rows [first, last) of a column without loading the rest of it
+        std::function<Column(const std::string &, size_t first, size_t last)> slice;
+    };
+
+    /**
+     * @brief Compiles every condition of the expression against the type of its column
+     * @throws std::runtime_error if a condition cannot be compiled or `typeOf` rejects a column
+     */
+    static PredicateTree compile(const ConditionExpr &expr,
+                                 const std::function<ColumnType(const std::string &)> &typeOf);
+
+    /**
+     * @brief The predicates every matching row satisfies: the expression itself if it is a
+     * single condition, or the conditions directly under a top-level AND
+     */
+    std::vector<const Predicate *> conjuncts() const;
+
+    bool matches(const std::function<const Column &(const std::string &)> &column, size_t row) const;
+
+    /**
+     * @brief Returns the rows that satisfy the expression, in ascending order; while a
+     * statement is only planned, records how they would be found and returns none
+     */
+    std::vector<size_t> matchingRows(const Source &source) const;
+
+private:
+    ConditionExpr::Kind kind = ConditionExpr::Kind::Leaf;
+    std::optional<Predicate> leaf;
+    std::vector<PredicateTree> children;
+
+    int cost(const Source &source) const;
+
+    /**
+     * @brief The ascending row ranges that zone maps do not rule out for a predicate, or
+     * nullopt if they rule out nothing
+     */
+    static std::optional<std::vector<std::pair<size_t, size_t> > > zoneRanges(const Source &source,
+                                                                            const Predicate &predicate);
+
+    std::vector<size_t> evaluate(const Source &source, const std::vector<size_t> *rows) const;
+
+    std::vector<size_t> evaluateLeaf(const Source &source, const std::vector<size_t> *rows,
+                                     QueryProfile::FilterStep *step) const;
+
+    static void countSegments(const Source &source, const Predicate &predicate, QueryProfile::FilterStep &step);
+
+    void plan(const Source &source, bool restricted) const;
+};
@@ -0,0 +1,194 @@
+#pragma once
+
+#include "conditionParser.h"
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+
+/**
+ * @brief A literal value as written in a query, or a `?` placeholder
+ *
+ * `text` follows the convention of Condition::value: quoted strings keep their quotes, so an
+ * unquoted NULL can be told apart from the string 'NULL'.
+ */
+struct Literal {
+    std::string text;
+    std::optional<size_t> parameter;
+};
+
+struct InsertStatement {
+    std::string table;
+    std::vector<std::string> columns;
+    std::vector<std::vector<Literal> > rows;
+};
+
+struct LoadDataStatement {
+    std::string file;
+    std::string table;
+};
+
+/**
+ * @brief An entry of an aggregate query's select list: a GROUP BY column, COUNT(*), or
+ * COUNT, SUM, AVG, MIN or MAX of a column
+ */
+struct SelectItem {
+    enum class Function { None, Count, Sum, Avg, Min, Max };
+
+    Function function = Function::None;
+    std::string column; // empty for COUNT(*)
+
+    bool operator==(const SelectItem &other) const {
+        return function == other.function && column == other.column;
+    }
+};
+
+/**
+ * @brief `[INNER] JOIN table [alias] ON left = right` after the FROM table; the ON columns
+ * are kept as written, qualified or not
+ */
+struct JoinClause {
+    std::string table;
+    std::string alias; // empty if the table has none
+    std::string leftColumn;
+    std::string rightColumn;
+};
+
+struct SelectStatement {
+    std::string table;
+    std::string alias; // of `table`, empty if none
+    std::optional<JoinClause> join;
+    std::vector<std::string> columns; // empty for *
+    // The select list of an aggregate query (one with an aggregate or a GROUP BY), which
+    // leaves `columns` empty
+    std::vector<SelectItem> items;
+    std::vector<std::string> groupBy;
+    std::optional<ConditionExpr> where;
+    std::string orderBy;
+    std::optional<SelectItem> orderByAggregate; // ORDER BY COUNT(*) and the like
+    bool ascending = true;
+    std::optional<size_t> limit;
+    size_t offset = 0;
+};
+
+/**
+ * @brief The right-hand side of a SET assignment: a literal, a word, or `+ - * /` over two
+ * of them, with `*` and `/` binding tighter and parentheses grouping
+ *
+ * Only the table knows whether a word names one of its columns, so words are kept as Name;
+ * one that names no column is read as a literal, like in INSERT.
+ */
+struct ValueExpr {
+    enum class Kind { Value, Name, Add, Subtract, Multiply, Divide };
+
+    Kind kind = Kind::Value;
+    Literal literal;                 // Value and Name
+    std::vector<ValueExpr> operands; // left and right side of Add ... Divide
+};
+
+struct UpdateStatement {
+    std::string table;
+    std::vector<std::pair<std::string, ValueExpr> > assignments;
+    std::optional<ConditionExpr> where;
+};
+
+struct DeleteStatement {
+    std::string table;
+    ConditionExpr where;
+};
+
+struct ColumnDefinition {
+    std::string name;
+    std::string type;
+    bool unique = false;
+    bool notNull = false;
+};
+
+struct CreateTableStatement {
+    std::string table;
+    std::vector<ColumnDefinition> columns;
+};
+
+struct CreateIndexStatement {
+    std::string index;
+    std::string table;
+    std::string column;
+};
+
+struct CreateDatabaseStatement {
+    std::string database;
+};
+
+struct ChangeDatabaseStatement {
+    std::string database;
+};
+
+/**
+ * @brief VACUUM [TABLE] name: drops the table's deleted rows from its column files
+ */
+struct VacuumStatement {
+    std::string table;
+};
+
+struct Statement;
+
+/**
+ * @brief PREPARE name AS statement: the statement is parsed once and run by EXECUTE
+ */
+struct PrepareStatement {
+    std::string name;
+    std::shared_ptr<const Statement> body;
+};
+
+/**
+ * @brief EXECUTE name [USING value, ...]: runs a prepared statement with its `?` bound in order
+ */
+struct ExecuteStatement {
+    std::string name;
+    std::vector<Literal> arguments;
+};
+
+struct DeallocateStatement {
+    std::string name;
+};
+
+/**
+ * @brief BEGIN, COMMIT or ROLLBACK of the session's transaction
+ */
+struct TransactionStatement {
+    enum class Action { Begin, Commit, Rollback };
+
+    Action action = Action::Begin;
+};
+
+/**
+ * @brief EXPLAIN [ANALYZE] statement: reports how a SELECT, UPDATE or DELETE finds its rows,
+ * and with ANALYZE runs it and reports what it read and where the time went
+ */
+struct ExplainStatement {
+    bool analyze = false;
+    std::shared_ptr<const Statement> body;
+    double parseMilliseconds = 0; // of the whole query the statement was parsed from
+};
+
+/**
+ * @brief SHOW STATS: the counters of this process (see Metrics), one row per metric
+ */
+struct ShowStatsStatement {
+};
+
+/**
+ * @brief A parsed statement
+ */
+struct Statement {
+    using Node = std::variant<InsertStatement, LoadDataStatement, SelectStatement, UpdateStatement,
+        DeleteStatement, CreateTableStatement, CreateIndexStatement, CreateDatabaseStatement,
+        ChangeDatabaseStatement, VacuumStatement, PrepareStatement, ExecuteStatement, DeallocateStatement,
+        TransactionStatement, ExplainStatement, ShowStatsStatement>;
+
+    Node node;
+    size_t parameters = 0; // number of `?` placeholders
+};
@@ -0,0 +1,492 @@
+#include "statementParser.h"
+#include "tokenizer.h"
+
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+    class Parser {
+    public:
+        explicit Parser(const string &query) : tokens(Tokenizer::tokenize(query)) {}
+
+        vector<Statement> parseScript() {
+            vector<Statement> statements;
+            while (!tokens.atEnd()) {
+                if (tokens.acceptSymbol(";")) {
+                    continue;
+                }
+                statements.push_back(parseStatement());
+                if (!tokens.atEnd() && !tokens.acceptSymbol(";")) {
+                    throw tokens.error("Unexpected token");
+                }
+            }
+            return statements;
+        }
+
+    private:
+        TokenStream tokens;
+
+        Statement parseStatement() {
+            tokens.restartParameters();
+            Statement statement;
+            statement.node = parseNode();
+            // The placeholders of a PREPARE belong to its body, bound by each EXECUTE
+            statement.parameters = holds_alternative<PrepareStatement>(statement.node) ? 0 : tokens.parametersSeen();
+            return statement;
+        }
+
+        Statement::Node parseNode() {
+            if (tokens.acceptKeyword("SELECT")) return parseSelect();
+            if (tokens.acceptKeyword("INSERT")) return parseInsert();
+            if (tokens.acceptKeyword("UPDATE")) return parseUpdate();
+            if (tokens.acceptKeyword("DELETE")) return parseDelete();
+            if (tokens.acceptKeyword("LOAD")) return parseLoadData();
+            if (tokens.acceptKeyword("CREATE")) {
+                if (tokens.acceptKeyword("TABLE")) return parseCreateTable();
+                if (tokens.acceptKeyword("INDEX")) return parseCreateIndex();
+                if (tokens.acceptKeyword("DATABASE")) {
+                    return CreateDatabaseStatement{tokens.expectIdentifier("database name")};
+                }
+                throw tokens.error("Expected TABLE, INDEX or DATABASE");
+            }
+            if (tokens.acceptKeyword("CHANGE")) {
+                tokens.expectKeyword("DATABASE");
+                return ChangeDatabaseStatement{tokens.expectIdentifier("database name")};
+            }
+            if (tokens.acceptKeyword("PREPARE")) return parsePrepare();
+            if (tokens.acceptKeyword("EXPLAIN")) return parseExplain();
+            if (tokens.acceptKeyword("EXECUTE")) return parseExecute();
+            if (tokens.acceptKeyword("VACUUM")) {
+                tokens.acceptKeyword("TABLE");
+                return VacuumStatement{tokens.expectIdentifier("table name")};
+            }
+            if (tokens.acceptKeyword("DEALLOCATE")) {
+                tokens.acceptKeyword("PREPARE");
+                return DeallocateStatement{tokens.expectIdentifier("prepared statement name")};
+            }
+            if (tokens.acceptKeyword("BEGIN")) return parseTransaction(TransactionStatement::Action::Begin);
+            if (tokens.acceptKeyword("START")) {
+                tokens.expectKeyword("TRANSACTION");
+                return TransactionStatement{TransactionStatement::Action::Begin};
+            }
+            if (tokens.acceptKeyword("SHOW")) {
+                tokens.expectKeyword("STATS");
+                return ShowStatsStatement{};
+            }
+            if (tokens.acceptKeyword("COMMIT")) return parseTransaction(TransactionStatement::Action::Commit);
+            if (tokens.acceptKeyword("ROLLBACK")) return parseTransaction(TransactionStatement::Action::Rollback);
+            throw tokens.error("Unsupported statement");
+        }
+
+        Literal parseLiteral() {
+            const Token &token = tokens.peek();
+            Literal literal;
+            switch (token.kind) {
+                case Token::Kind::Parameter:
+                    literal.text = "?";
+                    literal.parameter = tokens.parameterIndex(token);
+                    break;
+                case Token::Kind::String:
+                case Token::Kind::Number:
+                case Token::Kind::Word:
+                    literal.text = token.text;
+                    break;
+                case Token::Kind::Symbol:
+                    if (token.text == "-" && tokens.peek(1).kind == Token::Kind::Number) {
+                        tokens.next();
+                        literal.text = "-" + tokens.peek().text;
+                        break;
+                    }
+                    throw tokens.error("Expected a value");
+                default:
+                    throw tokens.error("Expected a value");
+            }
+            tokens.next();
+            return literal;
+        }
+
+        ValueExpr parseOperand() {
+            if (tokens.acceptSymbol("(")) {
+                ValueExpr inner = parseSum();
+                tokens.expectSymbol(")");
+                return inner;
+            }
+            ValueExpr operand;
+            if (tokens.peek().kind == Token::Kind::Word) {
+                operand.kind = ValueExpr::Kind::Name;
+            }
+            operand.literal = parseLiteral();
+            return operand;
+        }
+
+        ValueExpr parseBinary(bool additive) {
+            ValueExpr left = additive ? parseBinary(false) : parseOperand();
+            for (;;) {
+                ValueExpr::Kind kind;
+                if (additive && tokens.acceptSymbol("+")) {
+                    kind = ValueExpr::Kind::Add;
+                } else if (additive && tokens.acceptSymbol("-")) {
+                    kind = ValueExpr::Kind::Subtract;
+                } else if (!additive && tokens.acceptSymbol("*")) {
+                    kind = ValueExpr::Kind::Multiply;
+                } else if (!additive && tokens.acceptSymbol("/")) {
+                    kind = ValueExpr::Kind::Divide;
+                } else {
+                    return left;
+                }
+                ValueExpr combined;
+                combined.kind = kind;
+                combined.operands.push_back(std::move(left));
+                combined.operands.push_back(additive ? parseBinary(false) : parseOperand());
+                left = std::move(combined);
+            }
+        }
+
+        ValueExpr parseSum() {
+            return parseBinary(true);
+        }
+
+        size_t parseCount(const char *what) {
+            const Token &token = tokens.peek();
+            if (token.kind != Token::Kind::Number || token.text.find_first_not_of("0123456789") != string::npos) {
+                throw tokens.error(string("Expected a non-negative integer for ") + what);
+            }
+            size_t value = stoul(token.text);
+            tokens.next();
+            return value;
+        }
+
+        vector<string> parseIdentifierList(const char *what) {
+            vector<string> names{tokens.expectIdentifier(what)};
+            while (tokens.acceptSymbol(",")) {
+                names.push_back(tokens.expectIdentifier(what));
+            }
+            return names;
+        }
+
+        /**
+         * @brief Parses an aggregate call such as `COUNT(*)` or `SUM(price)`, or returns nullopt
+         * if the next tokens are not one
+         */
+        optional<SelectItem> parseAggregate() {
+            static const pair<const char *, SelectItem::Function> functions[] = {
+                {"COUNT", SelectItem::Function::Count}, {"SUM", SelectItem::Function::Sum},
+                {"AVG", SelectItem::Function::Avg}, {"MIN", SelectItem::Function::Min},
+                {"MAX", SelectItem::Function::Max},
+            };
+            if (!tokens.isSymbol("(", 1)) {
+                return nullopt;
+            }
+            for (const auto &[name, function]: functions) {
+                if (!tokens.isKeyword(name)) continue;
+                tokens.next();
+                tokens.expectSymbol("(");
+                SelectItem item;
+                item.function = function;
+                if (function != SelectItem::Function::Count || !tokens.acceptSymbol("*")) {
+                    item.column = tokens.expectColumn("column name");
+                }
+                tokens.expectSymbol(")");
+                return item;
+            }
+            return nullopt;
+        }
+
+        /**
+         * @brief Parses the optional `[AS] alias` after a table name
+         */
+        string parseAlias() {
+            static const char *const clauses[] = {"INNER", "JOIN", "ON", "WHERE", "GROUP", "ORDER", "LIMIT"};
+            if (tokens.acceptKeyword("AS")) {
+                return tokens.expectIdentifier("table alias");
+            }
+            if (tokens.peek().kind != Token::Kind::Word) {
+                return "";
+            }
+            for (const char *clause: clauses) {
+                if (tokens.isKeyword(clause)) return "";
+            }
+            return tokens.next().text;
+        }
+
+        JoinClause parseJoin() {
+            JoinClause join;
+            join.table = tokens.expectIdentifier("table name");
+            join.alias = parseAlias();
+            tokens.expectKeyword("ON");
+            join.leftColumn = tokens.expectColumn("JOIN column");
+            if (!tokens.acceptSymbol("=") && !tokens.acceptSymbol("==")) {
+                throw tokens.error("Expected '=' in JOIN condition");
+            }
+            join.rightColumn = tokens.expectColumn("JOIN column");
+            return join;
+        }
+
+        SelectStatement parseSelect() {
+            SelectStatement select;
+            if (!tokens.acceptSymbol("*")) {
+                bool aggregated = false;
+                do {
+                    optional<SelectItem> aggregate = parseAggregate();
+                    aggregated = aggregated || aggregate.has_value();
+                    select.items.push_back(aggregate ? *aggregate
+                                                     : SelectItem{SelectItem::Function::None,
+                                                                  tokens.expectColumn("column name")});
+                } while (tokens.acceptSymbol(","));
+                if (!aggregated) {
+                    for (const auto &item: select.items) select.columns.push_back(item.column);
+                    select.items.clear();
+                }
+            }
+            tokens.expectKeyword("FROM");
+            select.table = tokens.expectIdentifier("table name");
+            select.alias = parseAlias();
+            if (tokens.acceptKeyword("INNER")) {
+                tokens.expectKeyword("JOIN");
+                select.join = parseJoin();
+            } else if (tokens.acceptKeyword("JOIN")) {
+                select.join = parseJoin();
+            }
+
+            if (tokens.acceptKeyword("WHERE")) {
+                select.where = ConditionParser::parseExpression(tokens);
+            }
+            if (tokens.acceptKeyword("GROUP")) {
+                tokens.expectKeyword("BY");
+                select.groupBy = {tokens.expectColumn("GROUP BY column")};
+                while (tokens.acceptSymbol(",")) {
+                    select.groupBy.push_back(tokens.expectColumn("GROUP BY column"));
+                }
+                if (select.items.empty()) {
+                    if (select.columns.empty()) throw tokens.error("GROUP BY needs a select list");
+                    for (const auto &column: select.columns) select.items.push_back({SelectItem::Function::None, column});
+                    select.columns.clear();
+                }
+            }
+            if (tokens.acceptKeyword("ORDER")) {
+                tokens.expectKeyword("BY");
+                if (auto aggregate = parseAggregate()) {
+                    if (select.items.empty()) throw tokens.error("ORDER BY an aggregate needs an aggregate query");
+                    select.orderByAggregate = aggregate;
+                } else {
+                    select.orderBy = tokens.expectColumn("ORDER BY column");
+                }
+                if (tokens.acceptKeyword("DESC")) {
+                    select.ascending = false;
+                } else {
+                    tokens.acceptKeyword("ASC");
+                }
+            }
+            if (tokens.acceptKeyword("LIMIT")) {
+                select.limit = parseCount("LIMIT");
+                if (tokens.acceptKeyword("OFFSET")) {
+                    select.offset = parseCount("OFFSET");
+                }
+            }
+            return select;
+        }
+
+        InsertStatement parseInsert() {
+            InsertStatement insert;
+            tokens.expectKeyword("INTO");
+            insert.table = tokens.expectIdentifier("table name");
+            tokens.expectSymbol("(");
+            insert.columns = parseIdentifierList("column name");
+            tokens.expectSymbol(")");
+            tokens.expectKeyword("VALUES");
+            do {
+                tokens.expectSymbol("(");
+                vector<Literal> row{parseLiteral()};
+                while (tokens.acceptSymbol(",")) {
+                    row.push_back(parseLiteral());
+                }
+                tokens.expectSymbol(")");
+                insert.rows.push_back(std::move(row));
+            } while (tokens.acceptSymbol(","));
+            return insert;
+        }
+
+        UpdateStatement parseUpdate() {
+            UpdateStatement update;
+            update.table = tokens.expectIdentifier("table name");
+            tokens.expectKeyword("SET");
+            do {
+                string column = tokens.expectIdentifier("column name");
+                tokens.expectSymbol("=");
+                update.assignments.emplace_back(column, parseSum());
+            } while (tokens.acceptSymbol(","));
+            if (tokens.acceptKeyword("WHERE")) {
+                update.where = ConditionParser::parseExpression(tokens);
+            }
+            return update;
+        }
+
+        DeleteStatement parseDelete() {
+            DeleteStatement remove;
+            tokens.expectKeyword("FROM");
+            remove.table = tokens.expectIdentifier("table name");
+            if (!tokens.acceptKeyword("WHERE")) {
+                throw runtime_error("DELETE without WHERE clause is not supported for safety");
+            }
+            remove.where = ConditionParser::parseExpression(tokens);
+            return remove;
+        }
+
+        LoadDataStatement parseLoadData() {
+            LoadDataStatement load;
+            tokens.expectKeyword("DATA");
+            tokens.acceptKeyword("INFILE");
+            const Token &file = tokens.peek();
+            if (file.kind != Token::Kind::String) {
+                throw tokens.error("Expected a quoted file path");
+            }
+            load.file = file.text.substr(1, file.text.size() - 2);
+            tokens.next();
+            tokens.expectKeyword("INTO");
+            tokens.acceptKeyword("TABLE");
+            load.table = tokens.expectIdentifier("table name");
+            return load;
+        }
+
+        /**
+         * Column definitions are `name [type words] [(arguments)] [UNIQUE] [NOT NULL] [NULL]`;
+         * the type defaults to TEXT.
+         */
+        CreateTableStatement parseCreateTable() {
+            CreateTableStatement create;
+            create.table = tokens.expectIdentifier("table name");
+            tokens.expectSymbol("(");
+            do {
+                ColumnDefinition column;
+                column.name = tokens.expectIdentifier("column name");
+                while (!tokens.isSymbol(",") && !tokens.isSymbol(")") && !tokens.atEnd()) {
+                    if (tokens.acceptKeyword("UNIQUE")) {
+                        column.unique = true;
+                    } else if (tokens.isKeyword("NOT") && tokens.isKeyword("NULL", 1)) {
+                        tokens.next();
+                        tokens.next();
+                        column.notNull = true;
+                    } else if (tokens.acceptKeyword("NULL")) {
+                        column.notNull = false;
+                    } else if (tokens.acceptSymbol("(")) {
+                        string arguments;
+                        while (!tokens.acceptSymbol(")")) {
+                            if (tokens.atEnd()) throw tokens.error("Expected ')'");
+                            arguments += tokens.next().text;
+                        }
+                        column.type += "(" + arguments + ")";
+                    } else if (tokens.peek().kind == Token::Kind::Word) {
+                        if (!column.type.empty()) column.type += " ";
+                        column.type += tokens.next().text;
+                    } else {
+                        throw tokens.error("Unexpected token in column definition");
+                    }
+                }
+                if (column.type.empty()) {
+                    column.type = "TEXT";
+                }
+                create.columns.push_back(std::move(column));
+            } while (tokens.acceptSymbol(","));
+            tokens.expectSymbol(")");
+            return create;
+        }
+
+        CreateIndexStatement parseCreateIndex() {
+            CreateIndexStatement create;
+            create.index = tokens.expectIdentifier("index name");
+            tokens.expectKeyword("ON");
+            create.table = tokens.expectIdentifier("table name");
+            tokens.expectSymbol("(");
+            create.column = tokens.expectIdentifier("column name");
+            tokens.expectSymbol(")");
+            return create;
+        }
+
+        PrepareStatement parsePrepare() {
+            PrepareStatement prepare;
+            prepare.name = tokens.expectIdentifier("prepared statement name");
+            if (tokens.acceptKeyword("FROM")) {
+                // PREPARE name FROM 'statement': the quoted text holds exactly one statement
+                const Token &text = tokens.peek();
+                if (text.kind != Token::Kind::String) {
+                    throw tokens.error("Expected the statement text in quotes");
+                }
+                vector<Statement> body = StatementParser::parse(text.text.substr(1, text.text.size() - 2));
+                if (body.size() != 1) {
+                    throw tokens.error("PREPARE expects exactly one statement");
+                }
+                tokens.next();
+                prepare.body = make_shared<Statement>(std::move(body[0]));
+            } else {
+                tokens.expectKeyword("AS");
+                size_t base = tokens.parametersSeen();
+                Statement body;
+                body.node = parseNode();
+                body.parameters = tokens.parametersSeen() - base;
+                prepare.body = make_shared<Statement>(std::move(body));
+            }
+            if (holds_alternative<PrepareStatement>(prepare.body->node) ||
+                holds_alternative<ExecuteStatement>(prepare.body->node) ||
+                holds_alternative<DeallocateStatement>(prepare.body->node) ||
+                holds_alternative<TransactionStatement>(prepare.body->node)) {
+                throw runtime_error("Cannot prepare PREPARE, EXECUTE, DEALLOCATE, BEGIN, COMMIT or ROLLBACK");
+            }
+            return prepare;
+        }
+
+        ExplainStatement parseExplain() {
+            ExplainStatement explain;
+            explain.analyze = tokens.acceptKeyword("ANALYZE");
+            if (!tokens.isKeyword("SELECT") && !tokens.isKeyword("UPDATE") && !tokens.isKeyword("DELETE")) {
+                throw tokens.error("EXPLAIN expects SELECT, UPDATE or DELETE");
+            }
+            size_t base = tokens.parametersSeen();
+            Statement body;
+            body.node = parseNode();
+            body.parameters = tokens.parametersSeen() - base;
+            explain.body = make_shared<Statement>(std::move(body));
+            return explain;
+        }
+
+        /**
+         * @brief BEGIN, COMMIT or ROLLBACK, each with an optional TRANSACTION or WORK
+         */
+        TransactionStatement parseTransaction(TransactionStatement::Action action) {
+            if (!tokens.acceptKeyword("TRANSACTION")) tokens.acceptKeyword("WORK");
+            return TransactionStatement{action};
+        }
+
+        ExecuteStatement parseExecute() {
+            ExecuteStatement execute;
+            execute.name = tokens.expectIdentifier("prepared statement name");
+            bool parenthesized = tokens.acceptSymbol("(");
+            if (parenthesized || tokens.acceptKeyword("USING")) {
+                if (!parenthesized || !tokens.isSymbol(")")) {
+                    do {
+                        execute.arguments.push_back(parseLiteral());
+                        if (execute.arguments.back().parameter) {
+                            throw runtime_error("EXECUTE arguments must be values, not '?'");
+                        }
+                    } while (tokens.acceptSymbol(","));
+                }
+                if (parenthesized) tokens.expectSymbol(")");
+            }
+            return execute;
+        }
+    };
+}
+
+/**
+ * @brief Parses a query into statements.
+ *
+ * The query is tokenized once and parsed by recursive descent; WHERE clauses are handed to
+ * ConditionParser on the same tokens. `?` placeholders are numbered per statement.
+ *
+ * @param query The query text.
+ * @return The parsed statements.
+ * @throws std::runtime_error If the query is malformed or uses an unsupported statement.
+ */
+vector<Statement> StatementParser::parse(const string &query) {
+    return Parser(query).parseScript();
+}
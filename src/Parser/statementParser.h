@@ -0,0 +1,21 @@
+#pragma once
+
+#include "statement.h"
+
+#include <string>
+#include <vector>
+
+/**
+ * @brief Recursive-descent parser from query text to statements
+ */
+class StatementParser {
+public:
+    /**
+     * @brief Parses one or more statements separated by semicolons
+     *
+     * @param query The query text; the final semicolon is optional
+     * @return The statements in order
+     * @throws std::runtime_error with the offending position if the query is malformed
+     */
+    static std::vector<Statement> parse(const std::string &query);
+};
@@ -0,0 +1,215 @@
+#include "tokenizer.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+using namespace std;
+
+namespace {
+    bool isWordStart(char c) {
+        return isalpha(static_cast<unsigned char>(c)) || c == '_';
+    }
+
+    bool isWordChar(char c) {
+        return isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '$';
+    }
+
+    bool isDigit(char c) {
+        return isdigit(static_cast<unsigned char>(c)) != 0;
+    }
+
+    bool endsValue(const vector<Token> &tokens) {
+        if (tokens.empty()) {
+            return false;
+        }
+        const Token &last = tokens.back();
+        return last.kind == Token::Kind::Word || last.kind == Token::Kind::Number ||
+               last.kind == Token::Kind::String || last.kind == Token::Kind::Parameter || last.text == ")";
+    }
+}
+
+/**
+ * @brief Splits a query into tokens.
+ *
+ * Numbers are digits with an optional fraction and exponent. Every `?` gets the next
+ * parameter index. The result always ends with an End token.
+ *
+ * @param query The query text.
+ * @return The tokens of the query.
+ * @throws std::runtime_error If a string is not terminated or a character cannot start a token.
+ */
+vector<Token> Tokenizer::tokenize(const string &query) {
+    vector<Token> tokens;
+    size_t parameters = 0;
+    size_t i = 0;
+    const size_t n = query.size();
+
+    while (i < n) {
+        char c = query[i];
+        if (isspace(static_cast<unsigned char>(c))) {
+            ++i;
+            continue;
+        }
+
+        Token token;
+        token.offset = i;
+
+        if (isWordStart(c)) {
+            size_t end = i + 1;
+            while (end < n && isWordChar(query[end])) ++end;
+            token.kind = Token::Kind::Word;
+            token.text = query.substr(i, end - i);
+            i = end;
+        } else if (isDigit(c) || (c == '.' && i + 1 < n && isDigit(query[i + 1])) ||
+                   (c == '-' && i + 1 < n && (isDigit(query[i + 1]) || query[i + 1] == '.') && !endsValue(tokens))) {
+            size_t end = i + (c == '-' ? 1 : 0);
+            while (end < n && isDigit(query[end])) ++end;
+            if (end < n && query[end] == '.') {
+                ++end;
+                while (end < n && isDigit(query[end])) ++end;
+            }
+            if (end < n && (query[end] == 'e' || query[end] == 'E')) {
+                size_t exponent = end + 1;
+                if (exponent < n && (query[exponent] == '+' || query[exponent] == '-')) ++exponent;
+                if (exponent < n && isDigit(query[exponent])) {
+                    end = exponent;
+                    while (end < n && isDigit(query[end])) ++end;
+                }
+            }
+            token.kind = Token::Kind::Number;
+            token.text = query.substr(i, end - i);
+            i = end;
+        } else if (c == '\'' || c == '"') {
+            size_t close = query.find(c, i + 1);
+            if (close == string::npos) {
+                throw runtime_error("Unterminated string starting at position " + to_string(i));
+            }
+            token.kind = Token::Kind::String;
+            token.text = query.substr(i, close - i + 1);
+            i = close + 1;
+        } else if (c == '?') {
+            token.kind = Token::Kind::Parameter;
+            token.text = "?";
+            token.parameter = parameters++;
+            ++i;
+        } else {
+            static const char *const symbols[] = {"==", "!=", "<>", "<=", ">=", "(", ")", ",", ";", "*", ".", "=",
+                                                  "<", ">", "+", "-", "/"};
+            for (const char *symbol: symbols) {
+                if (query.compare(i, strlen(symbol), symbol) == 0) {
+                    token.text = symbol;
+                    break;
+                }
+            }
+            if (token.text.empty()) {
+                throw runtime_error(string("Unexpected character '") + c + "' at position " + to_string(i));
+            }
+            token.kind = Token::Kind::Symbol;
+            i += token.text.size();
+        }
+        tokens.push_back(std::move(token));
+    }
+
+    Token end;
+    end.offset = n;
+    tokens.push_back(end);
+    return tokens;
+}
+
+TokenStream::TokenStream(vector<Token> input) : tokens(std::move(input)) {
+    if (tokens.empty() || tokens.back().kind != Token::Kind::End) {
+        tokens.push_back(Token());
+    }
+}
+
+size_t TokenStream::parametersBefore() const {
+    for (size_t i = pos; i > 0; --i) {
+        if (tokens[i - 1].kind == Token::Kind::Parameter) {
+            return tokens[i - 1].parameter + 1;
+        }
+    }
+    return 0;
+}
+
+const Token &TokenStream::peek(size_t ahead) const {
+    return tokens[min(pos + ahead, tokens.size() - 1)];
+}
+
+const Token &TokenStream::next() {
+    const Token &token = peek();
+    if (pos + 1 < tokens.size()) ++pos;
+    return token;
+}
+
+bool TokenStream::isKeyword(const char *keyword, size_t ahead) const {
+    const Token &token = peek(ahead);
+    if (token.kind != Token::Kind::Word) {
+        return false;
+    }
+    size_t i = 0;
+    for (; keyword[i] != '\0'; ++i) {
+        if (i >= token.text.size() ||
+            toupper(static_cast<unsigned char>(token.text[i])) != toupper(static_cast<unsigned char>(keyword[i]))) {
+            return false;
+        }
+    }
+    return i == token.text.size();
+}
+
+bool TokenStream::isSymbol(const char *symbol, size_t ahead) const {
+    const Token &token = peek(ahead);
+    return token.kind == Token::Kind::Symbol && token.text == symbol;
+}
+
+bool TokenStream::acceptKeyword(const char *keyword) {
+    if (isKeyword(keyword)) {
+        next();
+        return true;
+    }
+    return false;
+}
+
+bool TokenStream::acceptSymbol(const char *symbol) {
+    if (isSymbol(symbol)) {
+        next();
+        return true;
+    }
+    return false;
+}
+
+void TokenStream::expectKeyword(const char *keyword) {
+    if (!acceptKeyword(keyword)) {
+        throw error(string("Expected ") + keyword);
+    }
+}
+
+void TokenStream::expectSymbol(const char *symbol) {
+    if (!acceptSymbol(symbol)) {
+        throw error(string("Expected '") + symbol + "'");
+    }
+}
+
+string TokenStream::expectIdentifier(const char *what) {
+    if (peek().kind != Token::Kind::Word) {
+        throw error(string("Expected ") + what);
+    }
+    return next().text;
+}
+
+string TokenStream::expectColumn(const char *what) {
+    string name = expectIdentifier(what);
+    if (isSymbol(".") && peek(1).kind == Token::Kind::Word) {
+        next();
+        name += "." + next().text;
+    }
+    return name;
+}
+
+runtime_error TokenStream::error(const string &message) const {
+    const Token &token = peek();
+    if (token.kind == Token::Kind::End) {
+        return runtime_error("Syntax error: " + message + " at end of query");
+    }
+    return runtime_error("Syntax error: " + message + " near '" + token.text + "' at position " +
+                         to_string(token.offset));
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * @brief A lexical token of a query
+ */
+struct Token {
+    enum class Kind { Word, Number, String, Symbol, Parameter, End };
+
+    Kind kind = Kind::End;
+    std::string text; // strings keep their quotes, symbols are one of ( ) , ; * . = == != <> < <= > >= + - /
+    size_t offset = 0; // position in the query, for error messages
+    size_t parameter = 0; // Parameter only: index of the `?` among the query's placeholders
+};
+
+/**
+ * @brief Splits a query into tokens
+ *
+ * Words are identifiers and keywords; a `-` directly before a number is part of the number
+ * unless it follows a value (so `a-1` is a subtraction and `a = -1` a negative constant).
+ * String literals are delimited by single or double quotes and have no escapes.
+ */
+class Tokenizer {
+public:
+    /**
+     * @throws std::runtime_error on an unterminated string or an unexpected character
+     */
+    static std::vector<Token> tokenize(const std::string &query);
+};
+
+/**
+ * @brief A cursor over the tokens of a query, shared by the statement and expression parsers
+ */
+class TokenStream {
+public:
+    explicit TokenStream(std::vector<Token> tokens);
+
+    const Token &peek(size_t ahead = 0) const;
+
+    const Token &next();
+
+    bool atEnd() const { return peek().kind == Token::Kind::End; }
+
+    /**
+     * @brief Whether the next token is the given keyword, compared case-insensitively
+     */
+    bool isKeyword(const char *keyword, size_t ahead = 0) const;
+
+    bool isSymbol(const char *symbol, size_t ahead = 0) const;
+
+    /**
+     * @brief Consumes the next token if it is the given keyword
+     */
+    bool acceptKeyword(const char *keyword);
+
+    bool acceptSymbol(const char *symbol);
+
+    /**
+     * @throws std::runtime_error if the next token is not the given keyword
+     */
+    void expectKeyword(const char *keyword);
+
+    void expectSymbol(const char *symbol);
+
+    /**
+     * @brief Consumes an identifier
+     * @param what What the identifier names, for the error message (e.g. "table name")
+     * @throws std::runtime_error if the next token is not a word
+     */
+    std::string expectIdentifier(const char *what);
+
+    /**
+     * @brief Consumes a column name, optionally qualified by its table as `table.column`
+     * @throws std::runtime_error if the next token is not a word
+     */
+    std::string expectColumn(const char *what);
+
+    /**
+     * @brief Numbers the following `?` placeholders from zero, so each statement of a script
+     * has its own parameters
+     */
+    void restartParameters() { parameterBase = parametersBefore(); }
+
+    /**
+     * @brief Index of a placeholder token among the placeholders of the current statement
+     */
+    size_t parameterIndex(const Token &token) const { return token.parameter - parameterBase; }
+
+    /**
+     * @brief Number of placeholders consumed since the last restartParameters()
+     */
+    size_t parametersSeen() const { return parametersBefore() - parameterBase; }
+
+    /**
+     * @brief An error pointing at the next token
+     */
+    std::runtime_error error(const std::string &message) const;
+
+private:
+    std::vector<Token> tokens;
+    size_t pos = 0;
+    size_t parameterBase = 0;
+
+    size_t parametersBefore() const;
+};
@@ -0,0 +1,506 @@
+#include "server.h"
+#include "threadPool.h"
+#include "../Operations/Vacuum/vacuum.h"
+#include "../Parser/parser.h"
+#include "../Storage/catalog.h"
+#include "../Storage/metrics.h"
+#include "../Storage/tableCache.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <streambuf>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+using json = nlohmann::json;
+namespace fs = filesystem;
+
+extern bool g_outputJson;
+
+#ifdef _WIN32
+
+void Server::run(const string &, size_t, size_t, double) {
+    throw runtime_error("--serve is not supported on Windows");
+}
+
+#else
+
+namespace {
+    const size_t MAX_QUERY_BYTES = 64u << 20;
+
+    const chrono::seconds COMPACTION_INTERVAL(10);
+
+    volatile sig_atomic_t stopRequested = 0;
+
+    void requestStop(int) {
+        stopRequested = 1;
+    }
+
+    struct Client {
+        int fd;
+        string buffer;
+        bool busy = false; // a query from this connection is running on a worker
+        bool closing = false; // the peer hung up while a query was running
+        Transaction transaction; // dropped with the connection unless committed
+    };
+
+    /**
+     * Queries that finished on a worker, handed back to the poll loop through a pipe
+     */
+    class Completions {
+    public:
+        Completions() {
+            if (pipe(fds) != 0) {
+                throw runtime_error("Failed to create pipe: " + string(strerror(errno)));
+            }
+            for (int fd: fds) {
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+                fcntl(fd, F_SETFD, FD_CLOEXEC);
+            }
+        }
+
+        ~Completions() {
+            close(fds[0]);
+            close(fds[1]);
+        }
+
+        int readFd() const { return fds[0]; }
+
+        void post(int clientFd, bool delivered) {
+            {
+                lock_guard<mutex> guard(doneMutex);
+                done.emplace_back(clientFd, delivered);
+            }
+            char byte = 0;
+            while (write(fds[1], &byte, 1) < 0 && errno == EINTR) {
+            }
+        }
+
+        vector<pair<int, bool> > take() {
+            char drain[256];
+            while (read(fds[0], drain, sizeof(drain)) > 0) {
+            }
+            lock_guard<mutex> guard(doneMutex);
+            vector<pair<int, bool> > finished;
+            finished.swap(done);
+            return finished;
+        }
+
+    private:
+        int fds[2] = {-1, -1};
+        mutex doneMutex;
+        vector<pair<int, bool> > done;
+    };
+
+    /**
+     * Vacuums tables with too many deleted rows every COMPACTION_INTERVAL until stopped
+     */
+    class Compactor {
+    public:
+        explicit Compactor(double threshold) {
+            if (threshold > 0) {
+                worker = thread([this, threshold] { work(threshold); });
+            }
+        }
+
+        ~Compactor() {
+            {
+                lock_guard<mutex> guard(stopMutex);
+                stopping = true;
+            }
+            wake.notify_all();
+            if (worker.joinable()) worker.join();
+        }
+
+    private:
+        mutex stopMutex;
+        condition_variable wake;
+        bool stopping = false;
+        thread worker;
+
+        void work(double threshold) {
+            unique_lock<mutex> guard(stopMutex);
+            while (!wake.wait_for(guard, COMPACTION_INTERVAL, [this] { return stopping; })) {
+                guard.unlock();
+                Vacuum::vacuumDeadTables(threshold);
+                guard.lock();
+            }
+        }
+    };
+
+    bool sendAll(int fd, const string &data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+#ifdef MSG_NOSIGNAL
+            ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+#else
+            ssize_t n = send(fd, data.data() + sent, data.size() - sent, 0);
+#endif
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            sent += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    bool reply(int fd, bool failed, const string &body) {
+        return sendAll(fd, string(failed ? "ERR " : "OK ") + to_string(body.size()) + "\n" + body);
+    }
+
+    /**
+     * The output of one query: sent as a single reply if it stays small, otherwise in MORE
+     * frames while the query is still writing it
+     */
+    class ReplyBuffer : public streambuf {
+    public:
+        explicit ReplyBuffer(int fd) : fd(fd) {
+        }
+
+        /**
+         * Sends what is left as the final OK or ERR frame; false if the client went away
+         */
+        bool finish(bool failed) {
+            bool sent = !broken && reply(fd, failed, pending);
+            pending.clear();
+            return sent;
+        }
+
+    protected:
+        int_type overflow(int_type c) override {
+            if (!traits_type::eq_int_type(c, traits_type::eof())) {
+                pending += traits_type::to_char_type(c);
+                sendIfFull();
+            }
+            return traits_type::not_eof(c);
+        }
+
+        streamsize xsputn(const char *data, streamsize size) override {
+            pending.append(data, static_cast<size_t>(size));
+            sendIfFull();
+            return size;
+        }
+
+    private:
+        int fd;
+        string pending;
+        bool broken = false;
+
+        void sendIfFull() {
+            if (pending.size() < Server::STREAM_CHUNK_BYTES) {
+                return;
+            }
+            // Once the client is gone the rest of the output is dropped
+            broken = broken || !sendAll(fd, "MORE " + to_string(pending.size()) + "\n" + pending);
+            pending.clear();
+        }
+    };
+
+    /**
+     * Runs a query and replies with its output; returns false if the reply could not be sent
+     */
+    bool runQuery(int fd, const string &query, Transaction &transaction) {
+        ReplyBuffer buffer(fd);
+        ostream output(&buffer);
+        bool failed = false;
+        try {
+            ParseQuery::parse(query, output, &transaction);
+        } catch (const exception &e) {
+            failed = true;
+            if (g_outputJson) {
+                output << json{{"status", "error"}, {"message", e.what()}}.dump() << endl;
+            } else {
+                output << "Error: " << e.what() << endl;
+            }
+        }
+        return buffer.finish(failed);
+    }
+
+    /**
+     * Answers an HTTP GET on the query port: the metrics for `/metrics`, 404 for anything else
+     */
+    void serveHttp(int fd, const string &requestLine) {
+        size_t start = requestLine.find(' ') + 1;
+        string target = requestLine.substr(start, requestLine.find_first_of(" \r\n", start) - start);
+        string path = target.substr(0, target.find('?'));
+        bool found = path == "/metrics";
+        string body = found ? Metrics::prometheus() : "Not found\n";
+        sendAll(fd, string(found ? "HTTP/1.0 200 OK" : "HTTP/1.0 404 Not Found") +
+                    "\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8\r\nContent-Length: " +
+                    to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body);
+    }
+
+    string trimmed(const string &text) {
+        size_t first = text.find_first_not_of(" \t\r\n");
+        if (first == string::npos) return "";
+        size_t last = text.find_last_not_of(" \t\r\n");
+        return text.substr(first, last - first + 1);
+    }
+
+    /**
+     * Hands the client's next complete line to a worker, which replies on the socket and then
+     * posts a completion; returns false once the connection should be closed
+     */
+    bool dispatchNext(Client &client, ThreadPool &pool, Completions &completions) {
+        if (client.buffer.compare(0, 4, "GET ") == 0) {
+            // A Prometheus scrape: answered once its headers are in, then the connection closes
+            if (client.buffer.find("\r\n\r\n") == string::npos && client.buffer.find("\n\n") == string::npos) {
+                return client.buffer.size() <= MAX_QUERY_BYTES;
+            }
+            client.busy = true;
+            int fd = client.fd;
+            string requestLine = client.buffer.substr(0, client.buffer.find('\n'));
+            client.buffer.clear();
+            pool.submit([fd, requestLine, &completions] {
+                serveHttp(fd, requestLine);
+                completions.post(fd, false);
+            });
+            return true;
+        }
+        size_t newline;
+        while ((newline = client.buffer.find('\n')) != string::npos) {
+            string query = trimmed(client.buffer.substr(0, newline));
+            client.buffer.erase(0, newline + 1);
+            if (query.empty()) {
+                continue;
+            }
+            if (query == "exit" || query == "EXIT" || query == "quit" || query == "QUIT") {
+                return false;
+            }
+            client.busy = true;
+            int fd = client.fd;
+            // The client stays in the loop's map while busy, so its transaction outlives the query
+            Transaction *transaction = &client.transaction;
+            pool.submit([fd, query, transaction, &completions] {
+                completions.post(fd, runQuery(fd, query, *transaction));
+            });
+            return true;
+        }
+        if (client.buffer.size() > MAX_QUERY_BYTES) {
+            reply(client.fd, true, "Query too long\n");
+            return false;
+        }
+        return true;
+    }
+
+    int listenUnix(const fs::path &socketPath) {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        string pathText = socketPath.string();
+        if (pathText.size() >= sizeof(address.sun_path)) {
+            throw runtime_error("Socket path too long: " + pathText);
+        }
+        memcpy(address.sun_path, pathText.c_str(), pathText.size() + 1);
+
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) {
+            throw runtime_error("Failed to create socket: " + string(strerror(errno)));
+        }
+        if (fs::exists(socketPath)) {
+            // A socket file nobody answers on is left over from a server that died
+            if (connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0) {
+                close(fd);
+                throw runtime_error("Another server is already listening on " + pathText);
+            }
+            fs::remove(socketPath);
+        }
+        fs::create_directories(socketPath.parent_path());
+        if (::bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 || listen(fd, 64) != 0) {
+            string reason = strerror(errno);
+            close(fd);
+            throw runtime_error("Failed to listen on " + pathText + ": " + reason);
+        }
+        return fd;
+    }
+
+    int listenTcp(const string &host, const string &port) {
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_PASSIVE;
+        addrinfo *addresses = nullptr;
+        int status = getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &addresses);
+        if (status != 0) {
+            throw runtime_error("Invalid address " + host + ":" + port + ": " + gai_strerror(status));
+        }
+
+        int fd = -1;
+        string reason = "no usable address";
+        for (addrinfo *address = addresses; address; address = address->ai_next) {
+            fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+            if (fd < 0) continue;
+            int reuse = 1;
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+            if (::bind(fd, address->ai_addr, address->ai_addrlen) == 0 && listen(fd, 64) == 0) {
+                break;
+            }
+            reason = strerror(errno);
+            close(fd);
+            fd = -1;
+        }
+        freeaddrinfo(addresses);
+        if (fd < 0) {
+            throw runtime_error("Failed to listen on " + host + ":" + port + ": " + reason);
+        }
+        return fd;
+    }
+}
+
+/**
+ * @brief Runs the server loop.
+ *
+ * Connections are multiplexed with poll() on this thread, and queries run on a pool of
+ * workers. A connection has at most one query in flight, so its replies come back in the
+ * order it sent the queries, while queries of different connections run in parallel; the
+ * table locks taken by ParseQuery::execute() let readers of a table overlap and serialize
+ * its writers. Workers reply on the socket themselves and post a completion, which wakes
+ * the loop to dispatch that connection's next query.
+ *
+ * @param endpoint Where to listen; see the header for the accepted forms.
+ * @param cacheBytes Memory budget of the table cache.
+ * @param workers Number of worker threads, 0 for one per hardware thread.
+ * @param vacuumThreshold Share of deleted rows from which a background thread vacuums a
+ * table, checked every few seconds; 0 turns it off.
+ * @throws std::runtime_error If the endpoint cannot be bound or polling fails.
+ */
+void Server::run(const string &endpoint, size_t cacheBytes, size_t workers, double vacuumThreshold) {
+    TableCache::configure(cacheBytes);
+
+    fs::path socketPath;
+    int listenFd;
+    bool numeric = !endpoint.empty() && endpoint.find_first_not_of("0123456789") == string::npos;
+    size_t colon = endpoint.rfind(':');
+    if (numeric) {
+        listenFd = listenTcp("127.0.0.1", endpoint);
+    } else if (colon != string::npos && endpoint.find('/') == string::npos) {
+        listenFd = listenTcp(endpoint.substr(0, colon), endpoint.substr(colon + 1));
+    } else {
+        if (endpoint.empty()) {
+            socketPath = Catalog::root() / "mashdb.sock";
+        } else {
+            socketPath = endpoint;
+        }
+        listenFd = listenUnix(socketPath);
+    }
+
+    struct sigaction action{};
+    action.sa_handler = requestStop;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+
+    // Workers inherit a mask without SIGINT and SIGTERM, so the signals interrupt poll()
+    sigset_t stopSignals;
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stopSignals, nullptr);
+    Completions completions;
+    auto pool = make_unique<ThreadPool>(workers);
+    auto compactor = make_unique<Compactor>(vacuumThreshold);
+    pthread_sigmask(SIG_UNBLOCK, &stopSignals, nullptr);
+
+    cout << "MashDB server listening on " << (socketPath.empty() ? endpoint : socketPath.string())
+            << " with " << pool->size() << " worker" << (pool->size() != 1 ? "s" : "") << endl;
+
+    map<int, Client> clients;
+    vector<char> chunk(64 * 1024);
+    auto drop = [&](map<int, Client>::iterator it) {
+        close(it->first);
+        return clients.erase(it);
+    };
+
+    while (!stopRequested) {
+        vector<pollfd> fds;
+        fds.push_back({listenFd, POLLIN, 0});
+        fds.push_back({completions.readFd(), POLLIN, 0});
+        for (const auto &[fd, client]: clients) {
+            if (!client.closing) {
+                fds.push_back({fd, POLLIN, 0});
+            }
+        }
+
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) continue;
+            throw runtime_error("poll failed: " + string(strerror(errno)));
+        }
+
+        for (size_t i = 2; i < fds.size(); ++i) {
+            if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) {
+                continue;
+            }
+            auto it = clients.find(fds[i].fd);
+            Client &client = it->second;
+            ssize_t n = recv(client.fd, chunk.data(), chunk.size(), 0);
+            bool keep = true;
+            if (n > 0) {
+                client.buffer.append(chunk.data(), static_cast<size_t>(n));
+                keep = client.busy || dispatchNext(client, *pool, completions);
+            } else if (n == 0 || errno != EINTR) {
+                keep = false;
+            }
+            if (!keep) {
+                if (client.busy) {
+                    // The worker still writes to the socket; close it once the query is done
+                    client.closing = true;
+                } else {
+                    drop(it);
+                }
+            }
+        }
+
+        if (fds[1].revents & POLLIN) {
+            for (const auto &[fd, delivered]: completions.take()) {
+                auto it = clients.find(fd);
+                Client &client = it->second;
+                client.busy = false;
+                if (!delivered || client.closing || !dispatchNext(client, *pool, completions)) {
+                    drop(it);
+                }
+            }
+        }
+
+        if (fds[0].revents & POLLIN) {
+            int fd = accept(listenFd, nullptr, nullptr);
+            if (fd >= 0) {
+                clients.emplace(fd, Client{fd, "", false, false, {}});
+            }
+        }
+    }
+
+    // Let running queries finish before their sockets go away
+    compactor.reset();
+    pool.reset();
+    for (const auto &[fd, client]: clients) {
+        close(fd);
+    }
+    close(listenFd);
+    if (!socketPath.empty()) {
+        fs::remove(socketPath);
+    }
+}
+
+#endif
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+using namespace std;
+
+/**
+ * @brief Long-running query server (`MashDB --serve`)
+ *
+ * Clients send one query per line. Each reply is a status line `OK <length>` or
+ * `ERR <length>` followed by exactly `<length>` bytes: whatever the query printed, or the
+ * error message. Output that grows past STREAM_CHUNK_BYTES while the query is still running
+ * (a large SELECT) is not held back: it is sent in frames `MORE <length>` + bytes as it is
+ * produced, and the reply ends with the usual `OK` or `ERR` frame holding the rest.
+ * Sending `exit` or `quit` closes the connection. Table schemas and columns
+ * stay cached between queries (see TableCache). A connection that starts with an HTTP
+ * `GET /metrics` request instead is answered with Metrics::prometheus() and closed, so
+ * Prometheus can scrape the query port.
+ *
+ * Queries of different connections run concurrently on worker threads; warnings a query
+ * writes to stderr go to the server's stderr rather than into its reply.
+ */
+class Server {
+public:
+    /**
+     * @brief Output size from which a reply is streamed in MORE frames
+     */
+    static constexpr size_t STREAM_CHUNK_BYTES = 1u << 20;
+
+    /**
+     * @brief Serves queries until the process receives SIGINT or SIGTERM
+     *
+     * @param endpoint A Unix socket path, or `host:port` / `port` for TCP; empty for the
+     * default socket `~/.mashdb/mashdb.sock`
+     * @param cacheBytes Memory budget of the table cache
+     * @param workers Number of threads running queries; 0 for one per hardware thread
+     * @param vacuumThreshold Share of deleted rows (0 to 1) from which a table is vacuumed in
+     * the background; 0 turns background compaction off
+     * @throws std::runtime_error if the endpoint cannot be bound
+     */
+    static void run(const string &endpoint, size_t cacheBytes, size_t workers = 0, double vacuumThreshold = 0);
+};
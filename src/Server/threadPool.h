@@ -0,0 +1,47 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @brief A fixed set of worker threads running queued tasks in submission order
+ */
+class ThreadPool {
+public:
+    /**
+     * @param threads Number of workers; 0 uses one per hardware thread
+     */
+    explicit ThreadPool(size_t threads);
+
+    /**
+     * @brief Runs the tasks still queued, then joins the workers
+     */
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    size_t size() const { return workers.size(); }
+
+    /**
+     * @brief Queues a task; it must not throw
+     */
+    void submit(function<void()> task);
+
+private:
+    mutex queueMutex;
+    condition_variable wake;
+    deque<function<void()> > tasks;
+    bool stopping = false;
+    vector<thread> workers;
+
+    void work();
+};
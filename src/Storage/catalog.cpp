@@ -0,0 +1,175 @@
+#include "catalog.h"
+#include "fileIO.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+
+using namespace std;
+namespace fs = filesystem;
+
+namespace {
+    mutex catalogMutex;
+    unordered_map<string, shared_ptr<const TableSchema> > schemas; // by "database/table"
+
+    bool currentKnown = false;
+    string current;
+    FileIO::FileStamp currentStamp;
+
+    string keyOf(const string &database, const string &table) {
+        return database + "/" + table;
+    }
+
+    fs::path currentDatabaseFile() {
+        return Catalog::root() / "crrtdb.txt";
+    }
+
+    /**
+     * @brief Reads crrtdb.txt, creating it empty if it does not exist yet
+     */
+    string readCurrentDatabase(const fs::path &path) {
+        if (!fs::exists(path) || fs::is_empty(path)) {
+            if (!fs::exists(path.parent_path())) {
+                if (!fs::create_directories(path.parent_path())) {
+                    throw runtime_error("Failed to create directory: " + path.parent_path().string());
+                }
+            }
+
+            ofstream file(path, ios::app);
+            if (!file) {
+                throw runtime_error("Failed to create current database file: " + path.string());
+            }
+            return "";
+        }
+
+        ifstream file(path);
+        if (!file.is_open()) {
+            throw runtime_error("Cannot open current database file: " + path.string());
+        }
+        string content((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+        content.erase(remove(content.begin(), content.end(), '\n'), content.end());
+        content.erase(remove(content.begin(), content.end(), '\r'), content.end());
+        return content;
+    }
+
+    shared_ptr<const TableSchema> loadSchema(const string &database, const string &table) {
+        auto schema = make_shared<TableSchema>();
+        schema->database = database;
+        schema->name = table;
+        schema->directory = Catalog::tableDir(database, table);
+
+        ifstream file(schema->infoFile());
+        if (!file.is_open()) {
+            return nullptr;
+        }
+        auto info = make_shared<json>();
+        try {
+            file >> *info;
+        } catch (const json::exception &e) {
+            throw runtime_error("Invalid Table-info.json: " + string(e.what()));
+        }
+
+        for (auto it = info->begin(); it != info->end(); ++it) {
+            ColumnSchema column;
+            column.name = it.key();
+            column.typeName = it->value("type", "");
+            column.type = ColumnStore::typeFromName(column.typeName);
+            column.unique = it->value("isUnique", false);
+            column.notNull = it->value("notNull", false);
+            schema->columns.push_back(std::move(column));
+        }
+        schema->info = std::move(info);
+        return schema;
+    }
+}
+
+const ColumnSchema *TableSchema::column(const string &columnName) const {
+    for (const auto &column: columns) {
+        if (column.name == columnName) return &column;
+    }
+    return nullptr;
+}
+
+const fs::path &Catalog::root() {
+    static const fs::path directory = [] {
+        const char *home = getenv("HOME");
+        if (!home || !*home) home = getenv("USERPROFILE");
+        return fs::path(home ? home : "") / ".mashdb";
+    }();
+    return directory;
+}
+
+fs::path Catalog::databasesDir() {
+    return root() / "databases";
+}
+
+fs::path Catalog::databaseDir(const string &database) {
+    return databasesDir() / database;
+}
+
+fs::path Catalog::tableDir(const string &database, const string &table) {
+    return databasesDir() / database / table;
+}
+
+/**
+ * @brief Looks up the current database.
+ *
+ * The name is kept along with the stamp of `crrtdb.txt`, which is only read again once the
+ * stamp changed.
+ *
+ * @return The database name with line breaks removed, or an empty string if none is set.
+ * @throws std::runtime_error If the file cannot be read or created.
+ */
+string Catalog::currentDatabase() {
+    fs::path path = currentDatabaseFile();
+    FileIO::FileStamp stamp = FileIO::stampOf(path);
+    lock_guard<mutex> guard(catalogMutex);
+    if (!currentKnown || !(stamp == currentStamp)) {
+        current = readCurrentDatabase(path);
+        currentStamp = FileIO::stampOf(path);
+        currentKnown = true;
+    }
+    return current;
+}
+
+void Catalog::setCurrentDatabase(const string &database) {
+    FileIO::FileStamp stamp = FileIO::stampOf(currentDatabaseFile());
+    lock_guard<mutex> guard(catalogMutex);
+    current = database;
+    currentStamp = stamp;
+    currentKnown = true;
+}
+
+/**
+ * @brief Looks up the schema of a table, reading its Table-info.json on first use.
+ *
+ * @param database The database holding the table.
+ * @param table The table name, as it is spelled on disk.
+ * @return The shared schema, or nullptr if the table has no Table-info.json.
+ * @throws std::runtime_error If Table-info.json exists but cannot be parsed.
+ */
+shared_ptr<const TableSchema> Catalog::find(const string &database, const string &table) {
+    string key = keyOf(database, table);
+    {
+        lock_guard<mutex> guard(catalogMutex);
+        auto it = schemas.find(key);
+        if (it != schemas.end()) {
+            return it->second;
+        }
+    }
+
+    shared_ptr<const TableSchema> schema = loadSchema(database, table);
+    if (!schema) {
+        return nullptr;
+    }
+    lock_guard<mutex> guard(catalogMutex);
+    return schemas.emplace(key, std::move(schema)).first->second;
+}
+
+void Catalog::invalidate(const string &database, const string &table) {
+    lock_guard<mutex> guard(catalogMutex);
+    schemas.erase(keyOf(database, table));
+}
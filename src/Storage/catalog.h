@@ -0,0 +1,88 @@
+#pragma once
+
+#include "columnStore.h"
+
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+using namespace std;
+using json = nlohmann::json;
+
+/**
+ * @brief A column as declared in Table-info.json
+ */
+struct ColumnSchema {
+    string name;
+    string typeName; // as written in CREATE TABLE
+    ColumnType type = ColumnType::Text;
+    bool unique = false;
+    bool notNull = false;
+};
+
+/**
+ * @brief Where a table lives and what its Table-info.json says
+ */
+struct TableSchema {
+    string database;
+    string name;
+    filesystem::path directory;
+    shared_ptr<const json> info;
+    vector<ColumnSchema> columns; // in Table-info.json order
+
+    filesystem::path columnsDir() const { return directory / "Columns"; }
+
+    filesystem::path infoFile() const { return directory / "Table-info.json"; }
+
+    /**
+     * @brief Returns the column with exactly this name, or nullptr
+     */
+    const ColumnSchema *column(const string &columnName) const;
+};
+
+/**
+ * @brief In-process catalog of the database directory and the schemas of its tables
+ *
+ * `~/.mashdb` is resolved once, and each table's Table-info.json is read and checked the
+ * first time a statement uses the table and then served from memory. Only CREATE TABLE
+ * writes that file, and it calls invalidate(); tables that do not exist are not cached, so
+ * one created by another process is found on its next lookup. The current database costs a
+ * stat() of `crrtdb.txt` per lookup, so a CHANGE DATABASE by another process is still seen.
+ */
+class Catalog {
+public:
+    /**
+     * @brief `~/.mashdb`, or `%USERPROFILE%\.mashdb` where HOME is not set
+     */
+    static const filesystem::path &root();
+
+    static filesystem::path databasesDir();
+
+    static filesystem::path databaseDir(const string &database);
+
+    static filesystem::path tableDir(const string &database, const string &table);
+
+    /**
+     * @brief Returns the name of the current database, empty if none was chosen yet
+     * @throws std::runtime_error if `crrtdb.txt` cannot be read or created
+     */
+    static string currentDatabase();
+
+    /**
+     * @brief Records the current database after `crrtdb.txt` was rewritten by this process
+     */
+    static void setCurrentDatabase(const string &database);
+
+    /**
+     * @brief Returns the schema of a table, or nullptr if the table does not exist
+     * @throws std::runtime_error if its Table-info.json cannot be parsed
+     */
+    static shared_ptr<const TableSchema> find(const string &database, const string &table);
+
+    /**
+     * @brief Forgets the schema of a table, after its Table-info.json was written
+     */
+    static void invalidate(const string &database, const string &table);
+};
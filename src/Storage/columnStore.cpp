@@ -0,0 +1,1338 @@
+#include "columnStore.h"
+#include "fileIO.h"
+#include "mappedFile.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <unordered_map>
+
+using namespace std;
+using json = nlohmann::json;
+namespace fs = filesystem;
+
+/*
+ * Column file layout (all integers are stored in host byte order):
+ *
+ *   FileHeader    magic "MCOL", format version, column type
+ *   Segment*      each made of a SegmentHeader followed by its payload
+ *
+ * Segment payload:
+ *   null bitmap   ceil(rowCount / 8) bytes, bit set = NULL
+ *   values        laid out according to the segment's encoding:
+ *
+ *   Plain             Integer: int64[rowCount]   Float: double[rowCount]
+ *                     Boolean: uint8[rowCount]
+ *                     Text:    uint32 offsets[rowCount + 1] followed by the string blob
+ *   Dictionary        Text: uint32 entries, uint8 code width (1, 2 or 4),
+ *                     uint32 offsets[entries + 1], the blob of the entries, codes[rowCount]
+ *   RunLength         Integer: uint32 runs, uint32 ends[runs] (exclusive), int64 values[runs]
+ *   FrameOfReference  Integer: int64 base, uint8 bits, then value - base of every row packed
+ *                     into `bits` bits, least significant bit first
+ *   BitPacked         Boolean: one bit per row, least significant bit first
+ *
+ * Each segment is written with the smallest encoding for its values (floats are always
+ * plain). NULL rows are stored as the default value: 0, false or the empty string.
+ *
+ * Segments are only ever appended, so an incomplete segment at the end of the file is the
+ * remainder of an interrupted append and is ignored by readers. Version 1 files predate
+ * encodings and only ever get plain segments appended, so older builds can still read them.
+ */
+namespace {
+    const char FILE_MAGIC[4] = {'M', 'C', 'O', 'L'};
+    const uint32_t SEGMENT_MAGIC = 0x4745534d; // "MSEG"
+    const uint16_t PLAIN_VERSION = 1;
+    const uint16_t FORMAT_VERSION = 2;
+    const size_t SEGMENT_ROWS = 65536;
+    // Rows of a text segment looked at before a mostly distinct one stops being dictionary-encoded
+    const size_t DICTIONARY_PROBE_ROWS = 1024;
+    // Text files with more distinct values than this are not given codes in memory
+    const size_t MAX_DICTIONARY_ENTRIES = 65536;
+
+    enum class Encoding : uint32_t {
+        Plain = 0,
+        Dictionary = 1,
+        RunLength = 2,
+        FrameOfReference = 3,
+        BitPacked = 4
+    };
+
+#pragma pack(push, 1)
+    struct FileHeader {
+        char magic[4];
+        uint16_t version;
+        uint8_t type;
+        uint8_t reserved;
+    };
+
+    struct SegmentHeader {
+        uint32_t magic;
+        uint32_t rowCount;
+        uint64_t payloadSize;
+        uint32_t checksum;
+        uint32_t encoding;
+    };
+#pragma pack(pop)
+
+    template<typename T>
+    void appendRaw(string &out, const T &value) {
+        out.append(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+
+    template<typename T>
+    T readRaw(const char *data) {
+        T value;
+        memcpy(&value, data, sizeof(T));
+        return value;
+    }
+
+    bool supportedVersion(uint16_t version) {
+        return version == PLAIN_VERSION || version == FORMAT_VERSION;
+    }
+
+    size_t bitmapSize(size_t rows) {
+        return (rows + 7) / 8;
+    }
+
+    /**
+     * Overwrites `bits` bits at bit `position` of a buffer with the low bits of `value`
+     */
+    void packBits(char *out, size_t position, unsigned bits, uint64_t value) {
+        for (unsigned done = 0; done < bits;) {
+            size_t byte = (position + done) / 8;
+            unsigned shift = (position + done) % 8;
+            unsigned take = min(bits - done, 8 - shift);
+            unsigned mask = ((1u << take) - 1) << shift;
+            unsigned part = static_cast<unsigned>(value >> done) << shift & mask;
+            out[byte] = static_cast<char>((static_cast<uint8_t>(out[byte]) & ~mask) | part);
+            done += take;
+        }
+    }
+
+    uint64_t unpackBits(const char *in, size_t position, unsigned bits) {
+        uint64_t value = 0;
+        for (unsigned done = 0; done < bits;) {
+            size_t byte = (position + done) / 8;
+            unsigned shift = (position + done) % 8;
+            unsigned take = min(bits - done, 8 - shift);
+            uint64_t part = static_cast<uint8_t>(in[byte]) >> shift & ((1u << take) - 1);
+            value |= part << done;
+            done += take;
+        }
+        return value;
+    }
+
+    unsigned bitsFor(uint64_t range) {
+        unsigned bits = 0;
+        while (bits < 64 && (range >> bits) != 0) ++bits;
+        return bits;
+    }
+
+    /**
+     * Picks the encoding of an integer segment and appends its values in that encoding
+     */
+    Encoding encodeIntegers(const Column &column, size_t begin, size_t end, bool compress, string &payload) {
+        size_t rows = end - begin;
+        const int64_t *values = column.ints.data() + begin;
+        size_t plainSize = rows * sizeof(int64_t);
+
+        size_t runs = 0;
+        optional<int64_t> low;
+        optional<int64_t> high;
+        for (size_t i = 0; i < rows; ++i) {
+            if (i == 0 || values[i] != values[i - 1]) ++runs;
+            if (!column.nulls[begin + i]) {
+                low = low ? min(*low, values[i]) : values[i];
+                high = high ? max(*high, values[i]) : values[i];
+            }
+        }
+        int64_t base = low.value_or(0);
+        unsigned bits = bitsFor(static_cast<uint64_t>(high.value_or(0)) - static_cast<uint64_t>(base));
+        size_t runLengthSize = sizeof(uint32_t) + runs * (sizeof(uint32_t) + sizeof(int64_t));
+        size_t frameSize = sizeof(int64_t) + sizeof(uint8_t) + (rows * bits + 7) / 8;
+
+        if (!compress || rows == 0 || plainSize <= min(runLengthSize, frameSize)) {
+            payload.append(reinterpret_cast<const char *>(values), plainSize);
+            return Encoding::Plain;
+        }
+        if (runLengthSize <= frameSize) {
+            appendRaw(payload, static_cast<uint32_t>(runs));
+            for (size_t i = 1; i <= rows; ++i) {
+                if (i == rows || values[i] != values[i - 1]) appendRaw(payload, static_cast<uint32_t>(i));
+            }
+            for (size_t i = 0; i < rows; ++i) {
+                if (i == 0 || values[i] != values[i - 1]) appendRaw(payload, values[i]);
+            }
+            return Encoding::RunLength;
+        }
+
+        appendRaw(payload, base);
+        appendRaw(payload, static_cast<uint8_t>(bits));
+        size_t packedAt = payload.size();
+        payload.append((rows * bits + 7) / 8, '\0');
+        for (size_t i = 0; i < rows; ++i) {
+            uint64_t offset = column.nulls[begin + i] ? 0 : static_cast<uint64_t>(values[i]) - static_cast<uint64_t>(base);
+            packBits(payload.data() + packedAt, i * bits, bits, offset);
+        }
+        return Encoding::FrameOfReference;
+    }
+
+    /**
+     * Appends the values of a text segment, dictionary-encoded if that is smaller
+     */
+    Encoding encodeTexts(const Column &column, size_t begin, size_t end, bool compress, string &payload) {
+        size_t rows = end - begin;
+
+        if (compress) {
+            unordered_map<string_view, uint32_t> index;
+            vector<string_view> entries;
+            vector<uint32_t> codes;
+            codes.reserve(rows);
+            size_t plainSize = (rows + 1) * sizeof(uint32_t);
+            size_t entryBytes = 0;
+            // Give up once more than half the rows seen so far had a new value
+            for (size_t i = 0; i < rows && entries.size() <= max<size_t>(i, DICTIONARY_PROBE_ROWS) / 2; ++i) {
+                string_view text = column.texts[begin + i];
+                plainSize += text.size();
+                auto [it, added] = index.emplace(text, static_cast<uint32_t>(entries.size()));
+                if (added) {
+                    entries.push_back(text);
+                    entryBytes += text.size();
+                }
+                codes.push_back(it->second);
+            }
+            size_t width = entries.size() <= 0x100 ? 1 : entries.size() <= 0x10000 ? 2 : 4;
+            size_t dictionarySize = sizeof(uint32_t) + sizeof(uint8_t) + (entries.size() + 1) * sizeof(uint32_t) +
+                                    entryBytes + rows * width;
+
+            if (rows > 0 && codes.size() == rows && entries.size() <= rows / 2 && dictionarySize < plainSize) {
+                appendRaw(payload, static_cast<uint32_t>(entries.size()));
+                appendRaw(payload, static_cast<uint8_t>(width));
+                uint32_t offset = 0;
+                for (const auto &entry: entries) {
+                    appendRaw(payload, offset);
+                    offset += static_cast<uint32_t>(entry.size());
+                }
+                appendRaw(payload, offset);
+                for (const auto &entry: entries) {
+                    payload += entry;
+                }
+                for (uint32_t code: codes) {
+                    payload.append(reinterpret_cast<const char *>(&code), width);
+                }
+                return Encoding::Dictionary;
+            }
+        }
+
+        uint32_t offset = 0;
+        for (size_t i = begin; i < end; ++i) {
+            appendRaw(payload, offset);
+            offset += static_cast<uint32_t>(column.texts[i].size());
+        }
+        appendRaw(payload, offset);
+        for (size_t i = begin; i < end; ++i) {
+            payload += column.texts[i];
+        }
+        return Encoding::Plain;
+    }
+
+    /**
+     * Encodes rows [begin, end) as one segment; without `compress` every value is stored plain
+     */
+    string encodeSegment(const Column &column, size_t begin, size_t end, bool compress) {
+        size_t rows = end - begin;
+        string payload;
+
+        string bitmap(bitmapSize(rows), '\0');
+        for (size_t i = 0; i < rows; ++i) {
+            if (column.nulls[begin + i]) {
+                bitmap[i / 8] = static_cast<char>(bitmap[i / 8] | (1 << (i % 8)));
+            }
+        }
+        payload += bitmap;
+
+        Encoding encoding = Encoding::Plain;
+        switch (column.type) {
+            case ColumnType::Integer:
+                encoding = encodeIntegers(column, begin, end, compress, payload);
+                break;
+            case ColumnType::Float:
+                payload.append(reinterpret_cast<const char *>(column.floats.data() + begin), rows * sizeof(double));
+                break;
+            case ColumnType::Boolean:
+                if (compress) {
+                    size_t packedAt = payload.size();
+                    payload.append(bitmapSize(rows), '\0');
+                    for (size_t i = 0; i < rows; ++i) {
+                        if (column.bools[begin + i]) payload[packedAt + i / 8] |= static_cast<char>(1 << (i % 8));
+                    }
+                    encoding = Encoding::BitPacked;
+                } else {
+                    payload.append(reinterpret_cast<const char *>(column.bools.data() + begin), rows);
+                }
+                break;
+            case ColumnType::Text:
+                encoding = encodeTexts(column, begin, end, compress, payload);
+                break;
+        }
+
+        SegmentHeader header{};
+        header.magic = SEGMENT_MAGIC;
+        header.rowCount = static_cast<uint32_t>(rows);
+        header.payloadSize = payload.size();
+        header.checksum = FileIO::crc32(payload.data(), payload.size());
+        header.encoding = static_cast<uint32_t>(encoding);
+
+        string segment;
+        appendRaw(segment, header);
+        segment += payload;
+        return segment;
+    }
+
+    bool knownEncoding(ColumnType type, uint32_t encoding) {
+        switch (static_cast<Encoding>(encoding)) {
+            case Encoding::Plain:
+                return true;
+            case Encoding::Dictionary:
+                return type == ColumnType::Text;
+            case Encoding::RunLength:
+            case Encoding::FrameOfReference:
+                return type == ColumnType::Integer;
+            case Encoding::BitPacked:
+                return type == ColumnType::Boolean;
+        }
+        return false;
+    }
+
+    /**
+     * Start of the entry offsets, the entry blob and the codes of a dictionary segment
+     */
+    struct DictionaryLayout {
+        uint32_t entries = 0;
+        size_t width = 0;
+        const char *offsets = nullptr;
+        const char *blob = nullptr;
+        const char *codes = nullptr;
+
+        explicit DictionaryLayout(const char *values) {
+            entries = readRaw<uint32_t>(values);
+            width = static_cast<uint8_t>(values[sizeof(uint32_t)]);
+            offsets = values + sizeof(uint32_t) + sizeof(uint8_t);
+            blob = offsets + (entries + 1) * sizeof(uint32_t);
+            codes = blob + readRaw<uint32_t>(offsets + entries * sizeof(uint32_t));
+        }
+
+        uint32_t code(size_t row) const {
+            uint32_t value = 0;
+            memcpy(&value, codes + row * width, width);
+            return value;
+        }
+
+        string_view entry(uint32_t code) const {
+            auto from = readRaw<uint32_t>(offsets + code * sizeof(uint32_t));
+            auto to = readRaw<uint32_t>(offsets + (code + 1) * sizeof(uint32_t));
+            return {blob + from, to - from};
+        }
+    };
+
+    /**
+     * Appends the rows of a segment to a column; `dictionary` collects the codes of text rows
+     */
+    void decodeSegment(Column &column, const SegmentHeader &header, const char *payload, TextDictionary *dictionary) {
+        size_t rows = header.rowCount;
+        const char *bitmap = payload;
+        const char *values = payload + bitmapSize(rows);
+        auto encoding = static_cast<Encoding>(header.encoding);
+
+        size_t firstRow = column.nulls.size();
+        for (size_t i = 0; i < rows; ++i) {
+            column.nulls.push_back((bitmap[i / 8] >> (i % 8)) & 1);
+        }
+
+        switch (column.type) {
+            case ColumnType::Integer: {
+                column.ints.resize(firstRow + rows);
+                int64_t *out = column.ints.data() + firstRow;
+                if (encoding == Encoding::RunLength) {
+                    auto runs = readRaw<uint32_t>(values);
+                    const char *ends = values + sizeof(uint32_t);
+                    const char *runValues = ends + runs * sizeof(uint32_t);
+                    size_t row = 0;
+                    for (uint32_t run = 0; run < runs; ++run) {
+                        size_t runEnd = min<size_t>(rows, readRaw<uint32_t>(ends + run * sizeof(uint32_t)));
+                        fill(out + row, out + max(row, runEnd), readRaw<int64_t>(runValues + run * sizeof(int64_t)));
+                        row = max(row, runEnd);
+                    }
+                } else if (encoding == Encoding::FrameOfReference) {
+                    auto base = readRaw<int64_t>(values);
+                    unsigned bits = static_cast<uint8_t>(values[sizeof(int64_t)]);
+                    const char *packed = values + sizeof(int64_t) + sizeof(uint8_t);
+                    for (size_t i = 0; i < rows; ++i) {
+                        out[i] = column.nulls[firstRow + i]
+                                     ? 0
+                                     : static_cast<int64_t>(static_cast<uint64_t>(base) + unpackBits(packed, i * bits, bits));
+                    }
+                } else {
+                    memcpy(out, values, rows * sizeof(int64_t));
+                }
+                break;
+            }
+            case ColumnType::Float: {
+                column.floats.resize(firstRow + rows);
+                memcpy(column.floats.data() + firstRow, values, rows * sizeof(double));
+                break;
+            }
+            case ColumnType::Boolean:
+                if (encoding == Encoding::BitPacked) {
+                    for (size_t i = 0; i < rows; ++i) {
+                        column.bools.push_back((values[i / 8] >> (i % 8)) & 1);
+                    }
+                } else {
+                    column.bools.insert(column.bools.end(), values, values + rows);
+                }
+                break;
+            case ColumnType::Text: {
+                if (encoding == Encoding::Dictionary) {
+                    DictionaryLayout layout(values);
+                    vector<uint32_t> remap;
+                    if (dictionary) {
+                        remap.reserve(layout.entries);
+                        for (uint32_t code = 0; code < layout.entries; ++code) {
+                            remap.push_back(dictionary->add(layout.entry(code)));
+                        }
+                    }
+                    for (size_t i = 0; i < rows; ++i) {
+                        uint32_t code = layout.code(i);
+                        column.texts.emplace_back(layout.entry(code));
+                        if (dictionary) column.codes.push_back(remap[code]);
+                    }
+                    break;
+                }
+                const char *blob = values + (rows + 1) * sizeof(uint32_t);
+                for (size_t i = 0; i < rows; ++i) {
+                    uint32_t from = readRaw<uint32_t>(values + i * sizeof(uint32_t));
+                    uint32_t to = readRaw<uint32_t>(values + (i + 1) * sizeof(uint32_t));
+                    column.texts.emplace_back(blob + from, to - from);
+                    if (dictionary) column.codes.push_back(dictionary->add(column.texts.back()));
+                }
+                break;
+            }
+        }
+    }
+
+    string encodeHeader(ColumnType type) {
+        FileHeader header{};
+        memcpy(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+        header.version = FORMAT_VERSION;
+        header.type = static_cast<uint8_t>(type);
+        header.reserved = 0;
+
+        string out;
+        appendRaw(out, header);
+        return out;
+    }
+
+    /**
+     * Validates every segment first, so the column can be sized up front and text columns only
+     * collect dictionary codes when at least one segment is dictionary-encoded
+     */
+    Column decodeFile(const char *content, size_t size, const string &filePath) {
+        if (size < sizeof(FileHeader)) {
+            throw runtime_error("Corrupt column file: " + filePath);
+        }
+
+        auto fileHeader = readRaw<FileHeader>(content);
+        if (memcmp(fileHeader.magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0 || !supportedVersion(fileHeader.version)) {
+            throw runtime_error("Unsupported column file format: " + filePath);
+        }
+
+        Column column;
+        column.type = static_cast<ColumnType>(fileHeader.type);
+
+        vector<pair<SegmentHeader, const char *> > segments;
+        size_t rows = 0;
+        bool dictionaryEncoded = false;
+        size_t pos = sizeof(FileHeader);
+        while (pos < size) {
+            if (size - pos < sizeof(SegmentHeader)) {
+                break; // torn append at the end of the file
+            }
+            auto header = readRaw<SegmentHeader>(content + pos);
+            size_t payloadPos = pos + sizeof(SegmentHeader);
+            if (header.magic != SEGMENT_MAGIC) {
+                throw runtime_error("Corrupt segment in column file: " + filePath);
+            }
+            if (size - payloadPos < header.payloadSize) {
+                break; // torn append at the end of the file
+            }
+            if (FileIO::crc32(content + payloadPos, header.payloadSize) != header.checksum) {
+                if (payloadPos + header.payloadSize == size) {
+                    break; // torn append at the end of the file
+                }
+                throw runtime_error("Checksum mismatch in column file: " + filePath);
+            }
+            if (!knownEncoding(column.type, header.encoding)) {
+                throw runtime_error("Unsupported segment encoding in column file: " + filePath);
+            }
+
+            segments.emplace_back(header, content + payloadPos);
+            rows += header.rowCount;
+            dictionaryEncoded = dictionaryEncoded || static_cast<Encoding>(header.encoding) == Encoding::Dictionary;
+            pos = payloadPos + header.payloadSize;
+        }
+
+        shared_ptr<TextDictionary> dictionary;
+        if (dictionaryEncoded) {
+            dictionary = make_shared<TextDictionary>();
+            column.codes.reserve(rows);
+        }
+        column.reserve(rows);
+        for (const auto &[header, payload]: segments) {
+            decodeSegment(column, header, payload, dictionary.get());
+            if (dictionary && dictionary->values.size() > MAX_DICTIONARY_ENTRIES) {
+                dictionary.reset();
+                column.codes = vector<uint32_t>();
+            }
+        }
+        column.dictionary = std::move(dictionary);
+        return column;
+    }
+
+    struct SegmentSpan {
+        uint64_t offset = 0; // of the SegmentHeader
+        size_t firstRow = 0;
+        SegmentHeader header{};
+    };
+
+    struct FileScan {
+        ColumnType type = ColumnType::Text;
+        uint16_t version = FORMAT_VERSION;
+        size_t rows = 0;
+        uint64_t validEnd = 0;
+        vector<SegmentSpan> segments;
+    };
+
+    /**
+     * Reads only the segment headers of a column file. Unless `verifyTail` is off, the
+     * checksum of the last segment is verified so that a torn append is excluded from the row
+     * count and from validEnd.
+     */
+    FileScan scanFile(const fs::path &filePath, bool verifyTail = true) {
+        ifstream file(filePath, ios::binary);
+        if (!file.is_open()) {
+            throw runtime_error("Failed to open column file: " + filePath.string());
+        }
+
+        uint64_t fileSize = fs::file_size(filePath);
+        FileHeader fileHeader{};
+        if (fileSize < sizeof(FileHeader) || !file.read(reinterpret_cast<char *>(&fileHeader), sizeof(FileHeader)) ||
+            memcmp(fileHeader.magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0 || !supportedVersion(fileHeader.version)) {
+            throw runtime_error("Unsupported column file format: " + filePath.string());
+        }
+
+        FileScan scan;
+        scan.type = static_cast<ColumnType>(fileHeader.type);
+        scan.version = fileHeader.version;
+        scan.validEnd = sizeof(FileHeader);
+
+        uint64_t pos = sizeof(FileHeader);
+        while (fileSize - pos >= sizeof(SegmentHeader)) {
+            SegmentHeader header{};
+            file.seekg(static_cast<streamoff>(pos));
+            if (!file.read(reinterpret_cast<char *>(&header), sizeof(SegmentHeader)) || header.magic != SEGMENT_MAGIC) {
+                break;
+            }
+            uint64_t payloadPos = pos + sizeof(SegmentHeader);
+            if (fileSize - payloadPos < header.payloadSize) {
+                break;
+            }
+            if (verifyTail && payloadPos + header.payloadSize == fileSize) {
+                string payload(header.payloadSize, '\0');
+                if (!file.read(payload.data(), static_cast<streamsize>(payload.size())) ||
+                    FileIO::crc32(payload.data(), payload.size()) != header.checksum) {
+                    break;
+                }
+            }
+
+            scan.segments.push_back({pos, scan.rows, header});
+            scan.rows += header.rowCount;
+            pos = payloadPos + header.payloadSize;
+            scan.validEnd = pos;
+        }
+
+        return scan;
+    }
+    /**
+     * Patches the touched segments of a fixed-width column file in memory and returns the
+     * byte ranges to write back, or nullopt (before anything is written) if a value does not
+     * fit the encoding of its segment. See ColumnStore::patchCells().
+     */
+    optional<vector<pair<uint64_t, string> > > planPatch(const fs::path &filePath, const vector<size_t> &rows,
+                                                        const Column &values) {
+        size_t width = ColumnStore::fixedWidth(values.type);
+        if (width == 0) {
+            throw runtime_error("Cannot patch text column in place: " + filePath.string());
+        }
+        FileScan scan = scanFile(filePath, false);
+        if (scan.type != values.type) {
+            throw runtime_error("Column type mismatch while patching: " + filePath.string());
+        }
+        if (!rows.empty() && rows.back() >= scan.rows) {
+            throw runtime_error("Row out of range while patching: " + filePath.string());
+        }
+
+        ifstream file(filePath, ios::binary);
+        if (!file.is_open()) {
+            throw runtime_error("Failed to open column file: " + filePath.string());
+        }
+
+        vector<pair<uint64_t, string> > chunks;
+        size_t next = 0;
+        for (const auto &segment: scan.segments) {
+            size_t segmentRows = segment.header.rowCount;
+            if (next == rows.size()) {
+                break;
+            }
+            if (rows[next] >= segment.firstRow + segmentRows) {
+                continue;
+            }
+
+            auto encoding = static_cast<Encoding>(segment.header.encoding);
+            if (encoding != Encoding::Plain && encoding != Encoding::FrameOfReference && encoding != Encoding::BitPacked) {
+                return nullopt;
+            }
+
+            uint64_t payloadPos = segment.offset + sizeof(SegmentHeader);
+            string payload(segment.header.payloadSize, '\0');
+            file.seekg(static_cast<streamoff>(payloadPos));
+            if (!file.read(payload.data(), static_cast<streamsize>(payload.size()))) {
+                throw runtime_error("Failed to read column file: " + filePath.string());
+            }
+
+            // Byte ranges of the payload that change, merged as rows come in ascending order
+            vector<pair<size_t, size_t> > changedBits;
+            vector<pair<size_t, size_t> > changedValues;
+            auto touch = [](vector<pair<size_t, size_t> > &changed, size_t from, size_t length) {
+                if (!changed.empty() && from <= changed.back().first + changed.back().second) {
+                    auto &last = changed.back();
+                    last.second = max(last.first + last.second, from + length) - last.first;
+                } else {
+                    changed.emplace_back(from, length);
+                }
+            };
+
+            size_t valuesAt = bitmapSize(segmentRows);
+            int64_t base = 0;
+            unsigned frameBits = 0;
+            if (encoding == Encoding::FrameOfReference) {
+                base = readRaw<int64_t>(payload.data() + valuesAt);
+                frameBits = static_cast<uint8_t>(payload[valuesAt + sizeof(int64_t)]);
+                valuesAt += sizeof(int64_t) + sizeof(uint8_t);
+            }
+
+            for (; next < rows.size() && rows[next] < segment.firstRow + segmentRows; ++next) {
+                size_t local = rows[next] - segment.firstRow;
+                char &bits = payload[local / 8];
+                bits = static_cast<char>(values.nulls[next] ? bits | (1 << (local % 8)) : bits & ~(1 << (local % 8)));
+                touch(changedBits, local / 8, 1);
+
+                char *encoded = payload.data() + valuesAt;
+                if (encoding == Encoding::FrameOfReference) {
+                    uint64_t offset = values.nulls[next]
+                                          ? 0
+                                          : static_cast<uint64_t>(values.ints[next]) - static_cast<uint64_t>(base);
+                    if (frameBits < 64 && (offset >> frameBits) != 0) {
+                        return nullopt;
+                    }
+                    if (frameBits > 0) {
+                        size_t position = local * frameBits;
+                        packBits(encoded, position, frameBits, offset);
+                        touch(changedValues, valuesAt + position / 8, (position % 8 + frameBits + 7) / 8);
+                    }
+                    continue;
+                }
+                if (encoding == Encoding::BitPacked) {
+                    packBits(encoded, local, 1, values.bools[next] != 0);
+                    touch(changedValues, valuesAt + local / 8, 1);
+                    continue;
+                }
+
+                char *slot = encoded + local * width;
+                switch (values.type) {
+                    case ColumnType::Integer:
+                        memcpy(slot, &values.ints[next], width);
+                        break;
+                    case ColumnType::Float:
+                        memcpy(slot, &values.floats[next], width);
+                        break;
+                    default:
+                        memcpy(slot, &values.bools[next], width);
+                        break;
+                }
+                touch(changedValues, valuesAt + local * width, width);
+            }
+
+            uint32_t checksum = FileIO::crc32(payload.data(), payload.size());
+            string checksumBytes;
+            appendRaw(checksumBytes, checksum);
+            chunks.emplace_back(segment.offset + offsetof(SegmentHeader, checksum), std::move(checksumBytes));
+            for (const auto *changed: {&changedBits, &changedValues}) {
+                for (const auto &[from, length]: *changed) {
+                    chunks.emplace_back(payloadPos + from, payload.substr(from, length));
+                }
+            }
+        }
+        return chunks;
+    }
+}
+
+optional<uint32_t> TextDictionary::find(const string &value) const {
+    auto it = codes.find(value);
+    if (it == codes.end()) {
+        return nullopt;
+    }
+    return it->second;
+}
+
+uint32_t TextDictionary::add(string_view value) {
+    auto [it, added] = codes.emplace(string(value), static_cast<uint32_t>(values.size()));
+    if (added) {
+        values.push_back(it->first);
+    }
+    return it->second;
+}
+
+json Column::at(size_t row) const {
+    if (nulls[row]) {
+        return nullptr;
+    }
+    switch (type) {
+        case ColumnType::Integer:
+            return ints[row];
+        case ColumnType::Float:
+            return floats[row];
+        case ColumnType::Boolean:
+            return bools[row] != 0;
+        case ColumnType::Text:
+            return texts[row];
+    }
+    return nullptr;
+}
+
+void Column::assignTo(size_t row, json &cell) const {
+    if (type != ColumnType::Text || nulls[row]) {
+        cell = at(row);
+    } else if (cell.is_string()) {
+        cell.get_ref<string &>().assign(texts[row]);
+    } else {
+        cell = texts[row];
+    }
+}
+
+bool Column::accepts(const json &value) const {
+    if (value.is_null()) {
+        return true;
+    }
+    switch (type) {
+        case ColumnType::Integer:
+            return value.is_number_integer();
+        case ColumnType::Float:
+            return value.is_number();
+        case ColumnType::Boolean:
+            return value.is_boolean();
+        case ColumnType::Text:
+            return value.is_string();
+    }
+    return false;
+}
+
+void Column::append(const json &value) {
+    if (!accepts(value)) {
+        throw runtime_error("Type mismatch: cannot store " + value.dump() + " in column");
+    }
+
+    bool isNullValue = value.is_null();
+    nulls.push_back(isNullValue ? 1 : 0);
+    switch (type) {
+        case ColumnType::Integer:
+            ints.push_back(isNullValue ? 0 : value.get<int64_t>());
+            break;
+        case ColumnType::Float:
+            floats.push_back(isNullValue ? 0.0 : value.get<double>());
+            break;
+        case ColumnType::Boolean:
+            bools.push_back(isNullValue ? 0 : value.get<bool>());
+            break;
+        case ColumnType::Text:
+            texts.push_back(isNullValue ? string() : value.get<string>());
+            if (dictionary) {
+                optional<uint32_t> code = isNullValue ? 0 : dictionary->find(texts.back());
+                if (code) codes.push_back(*code);
+                else dropDictionary();
+            }
+            break;
+    }
+}
+
+void Column::set(size_t row, const json &value) {
+    if (!accepts(value)) {
+        throw runtime_error("Type mismatch: cannot store " + value.dump() + " in column");
+    }
+
+    bool isNullValue = value.is_null();
+    nulls[row] = isNullValue ? 1 : 0;
+    switch (type) {
+        case ColumnType::Integer:
+            ints[row] = isNullValue ? 0 : value.get<int64_t>();
+            break;
+        case ColumnType::Float:
+            floats[row] = isNullValue ? 0.0 : value.get<double>();
+            break;
+        case ColumnType::Boolean:
+            bools[row] = isNullValue ? 0 : value.get<bool>();
+            break;
+        case ColumnType::Text:
+            texts[row] = isNullValue ? string() : value.get<string>();
+            if (dictionary) {
+                optional<uint32_t> code = isNullValue ? 0 : dictionary->find(texts[row]);
+                if (code) codes[row] = *code;
+                else dropDictionary();
+            }
+            break;
+    }
+}
+
+void Column::eraseRows(const vector<size_t> &sortedRows) {
+    if (sortedRows.empty()) {
+        return;
+    }
+
+    auto compact = [&sortedRows](auto &values) {
+        size_t out = 0;
+        size_t next = 0;
+        for (size_t i = 0; i < values.size(); ++i) {
+            if (next < sortedRows.size() && sortedRows[next] == i) {
+                ++next;
+                continue;
+            }
+            if (out != i) {
+                values[out] = std::move(values[i]);
+            }
+            ++out;
+        }
+        values.resize(out);
+    };
+
+    compact(nulls);
+    switch (type) {
+        case ColumnType::Integer:
+            compact(ints);
+            break;
+        case ColumnType::Float:
+            compact(floats);
+            break;
+        case ColumnType::Boolean:
+            compact(bools);
+            break;
+        case ColumnType::Text:
+            compact(texts);
+            if (dictionary) compact(codes);
+            break;
+    }
+}
+
+bool Column::less(size_t a, size_t b) const {
+    if (nulls[a] || nulls[b]) {
+        return nulls[a] && !nulls[b];
+    }
+    switch (type) {
+        case ColumnType::Integer:
+            return ints[a] < ints[b];
+        case ColumnType::Float:
+            return floats[a] < floats[b];
+        case ColumnType::Boolean:
+            return bools[a] < bools[b];
+        case ColumnType::Text:
+            return texts[a] < texts[b];
+    }
+    return false;
+}
+
+void Column::reserve(size_t rows) {
+    nulls.reserve(rows);
+    switch (type) {
+        case ColumnType::Integer:
+            ints.reserve(rows);
+            break;
+        case ColumnType::Float:
+            floats.reserve(rows);
+            break;
+        case ColumnType::Boolean:
+            bools.reserve(rows);
+            break;
+        case ColumnType::Text:
+            texts.reserve(rows);
+            if (dictionary) codes.reserve(rows);
+            break;
+    }
+}
+
+void Column::dropDictionary() {
+    dictionary.reset();
+    codes = vector<uint32_t>();
+}
+
+pair<const MappedColumn::Segment *, size_t> MappedColumn::locate(size_t row) const {
+    if (row >= rows) {
+        throw out_of_range("Row " + to_string(row) + " past the end of column file: " + filePath);
+    }
+    auto it = upper_bound(segments.begin(), segments.end(), row,
+                          [](size_t value, const Segment &segment) { return value < segment.firstRow; });
+    const Segment &segment = *(it - 1);
+    call_once(verified[static_cast<size_t>(it - 1 - segments.begin())], [&] {
+        if (FileIO::crc32(segment.payload, segment.payloadSize) != segment.checksum) {
+            throw runtime_error("Checksum mismatch in column file: " + filePath);
+        }
+    });
+    return {&segment, row - segment.firstRow};
+}
+
+bool MappedColumn::isNull(size_t row) const {
+    auto [segment, local] = locate(row);
+    return (segment->payload[local / 8] >> (local % 8) & 1) != 0;
+}
+
+int64_t MappedColumn::integer(size_t row) const {
+    auto [segment, local] = locate(row);
+    const char *values = segment->payload + bitmapSize(segment->rows);
+    switch (static_cast<Encoding>(segment->encoding)) {
+        case Encoding::RunLength: {
+            // The first run ending after the row
+            auto runs = readRaw<uint32_t>(values);
+            const char *ends = values + sizeof(uint32_t);
+            uint32_t low = 0;
+            uint32_t high = runs;
+            while (low < high) {
+                uint32_t middle = low + (high - low) / 2;
+                if (readRaw<uint32_t>(ends + middle * sizeof(uint32_t)) <= local) low = middle + 1;
+                else high = middle;
+            }
+            return readRaw<int64_t>(ends + runs * sizeof(uint32_t) + min(low, runs - 1) * sizeof(int64_t));
+        }
+        case Encoding::FrameOfReference: {
+            auto base = readRaw<int64_t>(values);
+            unsigned bits = static_cast<uint8_t>(values[sizeof(int64_t)]);
+            uint64_t offset = unpackBits(values + sizeof(int64_t) + sizeof(uint8_t), local * bits, bits);
+            return static_cast<int64_t>(static_cast<uint64_t>(base) + offset);
+        }
+        default:
+            return readRaw<int64_t>(values + local * sizeof(int64_t));
+    }
+}
+
+double MappedColumn::real(size_t row) const {
+    auto [segment, local] = locate(row);
+    return readRaw<double>(segment->payload + bitmapSize(segment->rows) + local * sizeof(double));
+}
+
+bool MappedColumn::boolean(size_t row) const {
+    auto [segment, local] = locate(row);
+    const char *values = segment->payload + bitmapSize(segment->rows);
+    if (static_cast<Encoding>(segment->encoding) == Encoding::BitPacked) {
+        return (values[local / 8] >> (local % 8) & 1) != 0;
+    }
+    return values[local] != 0;
+}
+
+string_view MappedColumn::text(size_t row) const {
+    auto [segment, local] = locate(row);
+    const char *values = segment->payload + bitmapSize(segment->rows);
+    if (static_cast<Encoding>(segment->encoding) == Encoding::Dictionary) {
+        DictionaryLayout layout(values);
+        return layout.entry(layout.code(local));
+    }
+    const char *blob = values + (segment->rows + 1) * sizeof(uint32_t);
+    auto from = readRaw<uint32_t>(values + local * sizeof(uint32_t));
+    auto to = readRaw<uint32_t>(values + (local + 1) * sizeof(uint32_t));
+    return {blob + from, to - from};
+}
+
+json MappedColumn::at(size_t row) const {
+    if (isNull(row)) {
+        return nullptr;
+    }
+    switch (columnType) {
+        case ColumnType::Integer:
+            return integer(row);
+        case ColumnType::Float:
+            return real(row);
+        case ColumnType::Boolean:
+            return boolean(row);
+        case ColumnType::Text:
+            return string(text(row));
+    }
+    return nullptr;
+}
+
+void MappedColumn::assignTo(size_t row, json &cell) const {
+    if (columnType != ColumnType::Text || isNull(row)) {
+        cell = at(row);
+    } else if (cell.is_string()) {
+        cell.get_ref<string &>().assign(text(row));
+    } else {
+        cell = string(text(row));
+    }
+}
+
+pair<size_t, size_t> MappedColumn::segmentRows(size_t segment) const {
+    return {segments[segment].firstRow, segments[segment].firstRow + segments[segment].rows};
+}
+
+/**
+ * @brief Decodes a range of rows of a mapped column file.
+ *
+ * Segments that lie inside the range are decoded straight into the result; the ones at its
+ * edges are decoded on their own and only the rows inside the range are copied.
+ *
+ * @param first The first row.
+ * @param last One past the last row; at most size().
+ * @return The rows, without dictionary codes.
+ * @throws std::runtime_error If a segment holding one of the rows fails its checksum.
+ */
+Column MappedColumn::slice(size_t first, size_t last) const {
+    Column result;
+    result.type = columnType;
+    if (first >= last) {
+        return result;
+    }
+    result.reserve(last - first);
+
+    auto it = upper_bound(segments.begin(), segments.end(), first,
+                          [](size_t value, const Segment &segment) { return value < segment.firstRow; }) - 1;
+    for (; it != segments.end() && it->firstRow < last; ++it) {
+        locate(it->firstRow); // verifies the checksum
+        SegmentHeader header{};
+        header.rowCount = static_cast<uint32_t>(it->rows);
+        header.encoding = it->encoding;
+        if (it->firstRow >= first && it->firstRow + it->rows <= last) {
+            decodeSegment(result, header, it->payload, nullptr);
+            continue;
+        }
+
+        Column part;
+        part.type = columnType;
+        decodeSegment(part, header, it->payload, nullptr);
+        size_t from = max(first, it->firstRow) - it->firstRow;
+        size_t to = min(last, it->firstRow + it->rows) - it->firstRow;
+        for (size_t row = from; row < to; ++row) {
+            result.append(part.at(row));
+        }
+    }
+    return result;
+}
+
+uint64_t MappedColumn::payloadBytes(size_t first, size_t last) const {
+    uint64_t bytes = 0;
+    if (first >= last) {
+        return bytes;
+    }
+    auto it = upper_bound(segments.begin(), segments.end(), first,
+                          [](size_t value, const Segment &segment) { return value < segment.firstRow; }) - 1;
+    for (; it != segments.end() && it->firstRow < last; ++it) {
+        bytes += it->payloadSize;
+    }
+    return bytes;
+}
+
+/**
+ * @brief Maps a declared SQL type name to its physical column type.
+ *
+ * The mapping mirrors the type checks performed on INSERT: INT/INTEGER are integers,
+ * FLOAT/DOUBLE/REAL are floating point, BOOL/BOOLEAN are booleans and every other type
+ * is stored as text.
+ *
+ * @param typeName The type name as recorded in Table-info.json.
+ * @return The physical column type.
+ */
+ColumnType ColumnStore::typeFromName(const string &typeName) {
+    string lower = typeName;
+    transform(lower.begin(), lower.end(), lower.begin(),
+              [](unsigned char c) { return tolower(c); });
+
+    if (lower == "int" || lower == "integer") {
+        return ColumnType::Integer;
+    }
+    if (lower == "float" || lower == "double" || lower == "real") {
+        return ColumnType::Float;
+    }
+    if (lower == "bool" || lower == "boolean") {
+        return ColumnType::Boolean;
+    }
+    return ColumnType::Text;
+}
+
+fs::path ColumnStore::columnPath(const fs::path &columnsDir, const string &column) {
+    return columnsDir / (column + ".col");
+}
+
+/**
+ * @brief Loads a column from its binary file, migrating a legacy JSON file if needed.
+ *
+ * @param columnsDir The table's Columns directory.
+ * @param column The name of the column.
+ * @param type The declared type of the column.
+ * @return The decoded column.
+ * @throws std::runtime_error If no column file exists or the file fails validation.
+ */
+Column ColumnStore::loadColumn(const fs::path &columnsDir, const string &column, ColumnType type) {
+    fs::path filePath = columnPath(columnsDir, column);
+
+    if (!fs::exists(filePath) && !migrateLegacyColumn(columnsDir, column, type)) {
+        throw runtime_error("Missing column file: " + column);
+    }
+
+    // Decoded straight from the page cache, without reading the file into a buffer first
+    MappedFile file(filePath);
+    return decodeFile(file.data(), file.size(), filePath.string());
+}
+
+/**
+ * @brief Maps a column file and indexes its segments without decoding or copying values.
+ *
+ * Only the segment headers are read, plus the payload of the last segment: like the other
+ * readers, a view leaves out a torn append at the end of the file.
+ *
+ * @param columnsDir The table's Columns directory.
+ * @param column The name of the column.
+ * @param type The declared type of the column, used when migrating legacy data.
+ * @return The view of the file.
+ * @throws std::runtime_error If no column file exists or its headers fail validation.
+ */
+shared_ptr<const MappedColumn> ColumnStore::mapColumn(const fs::path &columnsDir, const string &column, ColumnType type) {
+    fs::path filePath = columnPath(columnsDir, column);
+    if (!fs::exists(filePath) && !migrateLegacyColumn(columnsDir, column, type)) {
+        throw runtime_error("Missing column file: " + column);
+    }
+
+    auto view = make_shared<MappedColumn>();
+    view->file = make_unique<MappedFile>(filePath);
+    view->filePath = filePath.string();
+    const char *content = view->file->data();
+    size_t size = view->file->size();
+
+    if (size < sizeof(FileHeader)) {
+        throw runtime_error("Corrupt column file: " + view->filePath);
+    }
+    auto fileHeader = readRaw<FileHeader>(content);
+    if (memcmp(fileHeader.magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0 || !supportedVersion(fileHeader.version)) {
+        throw runtime_error("Unsupported column file format: " + view->filePath);
+    }
+    view->columnType = static_cast<ColumnType>(fileHeader.type);
+
+    size_t pos = sizeof(FileHeader);
+    while (size - pos >= sizeof(SegmentHeader)) {
+        auto header = readRaw<SegmentHeader>(content + pos);
+        size_t payloadPos = pos + sizeof(SegmentHeader);
+        if (header.magic != SEGMENT_MAGIC) {
+            throw runtime_error("Corrupt segment in column file: " + view->filePath);
+        }
+        if (size - payloadPos < header.payloadSize) {
+            break; // torn append at the end of the file
+        }
+        if (payloadPos + header.payloadSize == size &&
+            FileIO::crc32(content + payloadPos, header.payloadSize) != header.checksum) {
+            break; // torn append at the end of the file
+        }
+
+        if (!knownEncoding(view->columnType, header.encoding)) {
+            throw runtime_error("Unsupported segment encoding in column file: " + view->filePath);
+        }
+
+        MappedColumn::Segment segment;
+        segment.firstRow = view->rows;
+        segment.rows = header.rowCount;
+        segment.encoding = header.encoding;
+        segment.payload = content + payloadPos;
+        segment.payloadSize = header.payloadSize;
+        segment.checksum = header.checksum;
+        view->segments.push_back(segment);
+        view->rows += header.rowCount;
+        pos = payloadPos + header.payloadSize;
+    }
+    view->verified = make_unique<once_flag[]>(view->segments.size());
+    return view;
+}
+
+/**
+ * @brief Counts the rows stored in a column file without decoding its values.
+ *
+ * @param filePath The column file.
+ * @return The number of rows in all intact segments.
+ * @throws std::runtime_error If the file cannot be opened or has an unknown format.
+ */
+size_t ColumnStore::countRows(const fs::path &filePath) {
+    return scanFile(filePath).rows;
+}
+
+/**
+ * @brief Appends the rows of a column as new segments at the end of a column file.
+ *
+ * A torn segment left behind by an earlier interrupted append is cut off first. The new
+ * segments are not synced; the rows are in the write-ahead log until its next checkpoint
+ * syncs the file. Segments appended to a version 1 file are stored plain.
+ *
+ * @param filePath The column file to extend.
+ * @param column The rows to append; its type must match the file.
+ * @throws std::runtime_error If the file has a different type or cannot be written.
+ */
+void ColumnStore::appendSegment(const fs::path &filePath, const Column &column) {
+    FileScan scan = scanFile(filePath);
+    if (scan.type != column.type) {
+        throw runtime_error("Column type mismatch while appending to: " + filePath.string());
+    }
+    if (scan.validEnd != fs::file_size(filePath)) {
+        fs::resize_file(filePath, scan.validEnd);
+    }
+
+    string data;
+    for (size_t begin = 0; begin < column.size(); begin += SEGMENT_ROWS) {
+        size_t end = min(column.size(), begin + SEGMENT_ROWS);
+        data += encodeSegment(column, begin, end, scan.version != PLAIN_VERSION);
+    }
+    if (!data.empty()) {
+        FileIO::append(filePath, data);
+    }
+}
+
+/**
+ * @brief Serializes a column into the binary format and writes it to disk.
+ *
+ * Rows are split into segments of at most SEGMENT_ROWS rows, each carrying its own
+ * checksum and stored in the smallest encoding for its values.
+ *
+ * @param filePath Destination file; it is truncated first.
+ * @param column The column to write.
+ * @throws std::runtime_error If the file cannot be written.
+ */
+void ColumnStore::writeColumn(const fs::path &filePath, const Column &column) {
+    ofstream out(filePath, ios::binary | ios::trunc);
+    if (!out) {
+        throw runtime_error("Failed to open column file for writing: " + filePath.string());
+    }
+
+    out << encodeHeader(column.type);
+    for (size_t begin = 0; begin < column.size(); begin += SEGMENT_ROWS) {
+        size_t end = min(column.size(), begin + SEGMENT_ROWS);
+        out << encodeSegment(column, begin, end, true);
+    }
+
+    out.close();
+    if (!out) {
+        throw runtime_error("Failed to write column file: " + filePath.string());
+    }
+}
+
+bool ColumnStore::canPatch(const fs::path &filePath, const vector<size_t> &rows, const Column &values) {
+    return fixedWidth(values.type) != 0 && planPatch(filePath, rows, values).has_value();
+}
+
+/**
+ * @brief Overwrites single cells of a fixed-width column file in place.
+ *
+ * Only the segments holding one of the rows are read. Their null bitmap bits and value slots
+ * are patched and their checksum is recomputed over the patched payload, and then just the
+ * changed bytes and the checksum field are written back. The payload is not verified before
+ * patching: writing the same cells again repairs a segment torn by an interrupted patch,
+ * which is how the write-ahead log replays an UPDATE after a crash.
+ *
+ * Plain, frame-of-reference and bit-packed segments are patched in their encoding; a value
+ * outside the frame of its segment, or a row in a run-length segment, is not patchable.
+ *
+ * @param filePath The column file.
+ * @param rows Rows to overwrite, ascending and without duplicates.
+ * @param values The new values, one per row, of the same type as the file.
+ * @throws std::runtime_error If the column is not fixed-width, its type differs from the
+ * file, a row is past the end of the file or cannot be patched in its encoding, or the file
+ * cannot be read or written.
+ */
+void ColumnStore::patchCells(const fs::path &filePath, const vector<size_t> &rows, const Column &values) {
+    optional<vector<pair<uint64_t, string> > > chunks = planPatch(filePath, rows, values);
+    if (!chunks) {
+        throw runtime_error("Values do not fit the encoding of column file: " + filePath.string());
+    }
+    if (!chunks->empty()) {
+        FileIO::writeAt(filePath, *chunks);
+    }
+}
+
+size_t ColumnStore::fixedWidth(ColumnType type) {
+    switch (type) {
+        case ColumnType::Integer:
+            return sizeof(int64_t);
+        case ColumnType::Float:
+            return sizeof(double);
+        case ColumnType::Boolean:
+            return sizeof(uint8_t);
+        case ColumnType::Text:
+            break;
+    }
+    return 0;
+}
+
+void ColumnStore::createColumn(const fs::path &filePath, ColumnType type) {
+    Column empty;
+    empty.type = type;
+    writeColumn(filePath, empty);
+}
+
+/**
+ * @brief Converts a legacy `{"column": [...]}` JSON file into the binary column format.
+ *
+ * The binary file is written next to the JSON file via a temporary file and the JSON file
+ * is removed once the binary file is in place, so the migration runs once per column.
+ *
+ * @param columnsDir The table's Columns directory.
+ * @param column The name of the column.
+ * @param type The declared type of the column.
+ * @return true if a legacy file existed and was migrated, false otherwise.
+ * Values that do not match the declared type are stored as NULL.
+ */
+bool ColumnStore::migrateLegacyColumn(const fs::path &columnsDir, const string &column, ColumnType type) {
+    fs::path legacyPath = columnsDir / (column + ".json");
+    ifstream legacyFile(legacyPath);
+    if (!legacyFile.is_open()) {
+        return false;
+    }
+
+    string content((istreambuf_iterator<char>(legacyFile)), istreambuf_iterator<char>());
+    legacyFile.close();
+
+    Column migrated;
+    migrated.type = type;
+    if (!content.empty()) {
+        json legacy = json::parse(content);
+        if (legacy.contains(column) && legacy[column].is_array()) {
+            const auto &values = legacy[column];
+            migrated.reserve(values.size());
+            for (const auto &value: values) {
+                if (migrated.accepts(value)) {
+                    migrated.append(value);
+                } else {
+                    cerr << "Warning: Dropping value " << value.dump() << " of column " << column
+                            << " that does not match its type" << endl;
+                    migrated.append(nullptr);
+                }
+            }
+        }
+    }
+
+    fs::path finalPath = columnPath(columnsDir, column);
+    fs::path tempPath = finalPath;
+    tempPath += ".tmp";
+    writeColumn(tempPath, migrated);
+    fs::rename(tempPath, finalPath);
+    fs::remove(legacyPath);
+    return true;
+}
@@ -0,0 +1,274 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+#include "mappedFile.h"
+
+using namespace std;
+using json = nlohmann::json;
+
+/**
+ * @brief Physical type of a column, derived from the "type" entry in Table-info.json
+ */
+enum class ColumnType : uint8_t {
+    Integer = 1,
+    Float = 2,
+    Boolean = 3,
+    Text = 4
+};
+
+/**
+ * @brief The distinct values of a text column read from dictionary-encoded segments
+ */
+struct TextDictionary {
+    vector<string> values;
+    unordered_map<string, uint32_t> codes;
+
+    optional<uint32_t> find(const string &value) const;
+
+    /**
+     * @brief Returns the code of a value, adding it if it is new
+     */
+    uint32_t add(string_view value);
+};
+
+/**
+ * @brief In-memory, typed representation of a single column
+ *
+ * Values are kept in the vector matching the column type so that every row has a slot
+ * (NULL rows hold a default value); `nulls` marks which rows are NULL.
+ *
+ * A text column decoded from dictionary-encoded segments also carries the code of every row,
+ * so equality predicates compare integers instead of strings. append(), set() and
+ * eraseRows() keep the codes in step; code that writes `texts` directly must call
+ * dropDictionary() first.
+ */
+struct Column {
+    ColumnType type = ColumnType::Text;
+    vector<uint8_t> nulls;
+    vector<int64_t> ints;
+    vector<double> floats;
+    vector<uint8_t> bools;
+    vector<string> texts;
+    shared_ptr<const TextDictionary> dictionary;
+    vector<uint32_t> codes; // one per row while `dictionary` is set; the code of a NULL row is unspecified
+
+    size_t size() const { return nulls.size(); }
+
+    bool isNull(size_t row) const { return nulls[row] != 0; }
+
+    /**
+     * @brief Returns the value at the given row as JSON (null for NULL rows)
+     */
+    json at(size_t row) const;
+
+    /**
+     * @brief Stores the value at the given row in `cell` like at(), reusing the string
+     * `cell` already holds for text
+     */
+    void assignTo(size_t row, json &cell) const;
+
+    /**
+     * @brief Checks whether a JSON value can be stored in this column (NULL is always accepted)
+     */
+    bool accepts(const json &value) const;
+
+    /**
+     * @brief Appends a value to the end of the column
+     * @throws std::runtime_error if the value does not match the column type
+     */
+    void append(const json &value);
+
+    /**
+     * @brief Overwrites the value at the given row
+     * @throws std::runtime_error if the value does not match the column type
+     */
+    void set(size_t row, const json &value);
+
+    /**
+     * @brief Removes the given rows in a single pass
+     * @param sortedRows Row indices in ascending order, without duplicates
+     */
+    void eraseRows(const vector<size_t> &sortedRows);
+
+    /**
+     * @brief Strict weak ordering of two rows; NULL sorts before every value
+     */
+    bool less(size_t a, size_t b) const;
+
+    void reserve(size_t rows);
+
+    void dropDictionary();
+};
+
+/**
+ * @brief Read-only view of a column file mapped into memory, decoding single cells on demand
+ *
+ * Nothing is copied up front: reading a few rows of a large column touches only the pages
+ * of the segments holding them. A segment's checksum is verified when the first of its rows
+ * is read, so corruption is still reported, just no earlier than it matters. Text cells are
+ * views into the mapping and stay valid as long as the MappedColumn does.
+ *
+ * In-place updates write to the mapped file, so a view must not outlive the table lock it
+ * was opened under.
+ */
+class MappedColumn {
+public:
+    ColumnType type() const { return columnType; }
+
+    size_t size() const { return rows; }
+
+    bool isNull(size_t row) const;
+
+    int64_t integer(size_t row) const;
+
+    double real(size_t row) const;
+
+    bool boolean(size_t row) const;
+
+    string_view text(size_t row) const;
+
+    /**
+     * @brief Returns the value at the given row as JSON (null for NULL rows)
+     */
+    json at(size_t row) const;
+
+    /**
+     * @brief Stores the value at the given row in `cell` like at(), reusing the string
+     * `cell` already holds for text
+     */
+    void assignTo(size_t row, json &cell) const;
+
+    size_t segmentCount() const { return segments.size(); }
+
+    /**
+     * @brief The rows [first, last) of a segment
+     */
+    pair<size_t, size_t> segmentRows(size_t segment) const;
+
+    /**
+     * @brief The stored checksum of a segment, which changes whenever its payload does
+     */
+    uint32_t segmentChecksum(size_t segment) const { return segments[segment].checksum; }
+
+    /**
+     * @brief Decodes rows [first, last) into a column, touching only the segments holding them
+     */
+    Column slice(size_t first, size_t last) const;
+
+    /**
+     * @brief Bytes of the segment payloads slice() decodes for rows [first, last)
+     */
+    uint64_t payloadBytes(size_t first, size_t last) const;
+
+private:
+    friend class ColumnStore;
+
+    struct Segment {
+        size_t firstRow = 0;
+        size_t rows = 0;
+        uint32_t encoding = 0;
+        const char *payload = nullptr;
+        uint64_t payloadSize = 0;
+        uint32_t checksum = 0;
+    };
+
+    unique_ptr<MappedFile> file;
+    string filePath;
+    ColumnType columnType = ColumnType::Text;
+    size_t rows = 0;
+    vector<Segment> segments;
+    unique_ptr<once_flag[]> verified;
+
+    /**
+     * @brief The segment holding a row, checked on first use, and the row's position in it
+     */
+    pair<const Segment *, size_t> locate(size_t row) const;
+};
+
+class ColumnStore {
+public:
+    /**
+     * @brief Maps a declared SQL type name (INT, FLOAT, BOOL, TEXT, ...) to its column type
+     */
+    static ColumnType typeFromName(const string &typeName);
+
+    /**
+     * @brief Path of the binary file backing a column
+     */
+    static filesystem::path columnPath(const filesystem::path &columnsDir, const string &column);
+
+    /**
+     * @brief Loads a column from disk
+     *
+     * If the binary column file does not exist yet but a legacy `<column>.json` file does,
+     * the JSON file is converted to the binary format first and then removed.
+     *
+     * @param columnsDir The table's Columns directory
+     * @param column Name of the column
+     * @param type Declared type of the column, used when migrating legacy data
+     * @throws std::runtime_error if neither file exists or the file is corrupt
+     */
+    static Column loadColumn(const filesystem::path &columnsDir, const string &column, ColumnType type);
+
+    /**
+     * @brief Maps a column file for reading single cells, migrating a legacy JSON file first
+     * @throws std::runtime_error if neither file exists or the segment headers are corrupt
+     */
+    static shared_ptr<const MappedColumn> mapColumn(const filesystem::path &columnsDir, const string &column,
+                                                    ColumnType type);
+
+    /**
+     * @brief Counts the rows of a column file from its segment headers
+     */
+    static size_t countRows(const filesystem::path &filePath);
+
+    /**
+     * @brief Appends rows to a column file as new segments
+     */
+    static void appendSegment(const filesystem::path &filePath, const Column &column);
+
+    /**
+     * @brief Writes a column to the given file, replacing any previous content
+     */
+    static void writeColumn(const filesystem::path &filePath, const Column &column);
+
+    /**
+     * @brief Whether patchCells() can store the values in the file without re-encoding any
+     * segment: the column is fixed-width and each value fits the encoding of its segment
+     */
+    static bool canPatch(const filesystem::path &filePath, const vector<size_t> &rows, const Column &values);
+
+    /**
+     * @brief Overwrites the given rows of a fixed-width column file in place
+     * @param rows Ascending rows to overwrite
+     * @param values Their new values, one per row
+     * @throws std::runtime_error if canPatch() is false for them
+     */
+    static void patchCells(const filesystem::path &filePath, const vector<size_t> &rows, const Column &values);
+
+    /**
+     * @brief Bytes per value of a fixed-width type, or 0 for text
+     */
+    static size_t fixedWidth(ColumnType type);
+
+    /**
+     * @brief Creates an empty column file of the given type
+     */
+    static void createColumn(const filesystem::path &filePath, ColumnType type);
+
+    /**
+     * @brief Converts a legacy `<column>.json` file into the binary format
+     * @return true if a legacy file was found and migrated
+     */
+    static bool migrateLegacyColumn(const filesystem::path &columnsDir, const string &column, ColumnType type);
+};
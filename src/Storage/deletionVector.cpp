@@ -0,0 +1,132 @@
+#include "deletionVector.h"
+#include "fileIO.h"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+namespace fs = filesystem;
+
+namespace {
+    const char DELETION_MAGIC[4] = {'M', 'D', 'E', 'L'};
+    const uint16_t DELETION_VERSION = 1;
+
+#pragma pack(push, 1)
+    struct Header {
+        char magic[4];
+        uint16_t version;
+        uint16_t reserved;
+        uint64_t rows; // bits in the bitmap: one past the highest deleted row
+        uint64_t deleted;
+        uint32_t checksum; // CRC-32 of the bitmap words
+    };
+#pragma pack(pop)
+
+    Header readHeader(ifstream &in, const fs::path &filePath) {
+        Header header{};
+        if (!in.read(reinterpret_cast<char *>(&header), sizeof(Header))) {
+            throw runtime_error("Corrupt deletion file: " + filePath.string());
+        }
+        if (memcmp(header.magic, DELETION_MAGIC, sizeof(DELETION_MAGIC)) != 0 || header.version != DELETION_VERSION) {
+            throw runtime_error("Unsupported deletion file: " + filePath.string());
+        }
+        return header;
+    }
+}
+
+DeletionVector::DeletionVector(fs::path filePath) : path(std::move(filePath)) {
+    ifstream in(path, ios::binary);
+    if (!in.is_open()) {
+        return;
+    }
+    Header header = readHeader(in, path);
+    words.resize((header.rows + 63) / 64);
+    if (!in.read(reinterpret_cast<char *>(words.data()), static_cast<streamsize>(words.size() * sizeof(uint64_t))) ||
+        FileIO::crc32(reinterpret_cast<const char *>(words.data()), words.size() * sizeof(uint64_t)) != header.checksum) {
+        throw runtime_error("Corrupt deletion file: " + path.string());
+    }
+    deleted = header.deleted;
+}
+
+void DeletionVector::add(const vector<size_t> &rows) {
+    for (size_t row: rows) {
+        if (row / 64 >= words.size()) {
+            words.resize(row / 64 + 1, 0);
+        }
+        uint64_t bit = uint64_t(1) << (row % 64);
+        if (!(words[row / 64] & bit)) {
+            words[row / 64] |= bit;
+            ++deleted;
+        }
+    }
+}
+
+void DeletionVector::remove(const vector<size_t> &rows) {
+    for (size_t row: rows) {
+        if (contains(row)) {
+            words[row / 64] &= ~(uint64_t(1) << (row % 64));
+            --deleted;
+        }
+    }
+}
+
+void DeletionVector::dropFrom(vector<size_t> &rows) const {
+    if (deleted == 0) {
+        return;
+    }
+    size_t kept = 0;
+    for (size_t row: rows) {
+        if (!contains(row)) rows[kept++] = row;
+    }
+    rows.resize(kept);
+}
+
+vector<size_t> DeletionVector::rows() const {
+    vector<size_t> result;
+    result.reserve(deleted);
+    for (size_t w = 0; w < words.size(); ++w) {
+        for (uint64_t bits = words[w]; bits != 0; bits &= bits - 1) {
+            result.push_back(w * 64 + static_cast<size_t>(__builtin_ctzll(bits)));
+        }
+    }
+    return result;
+}
+
+void DeletionVector::save() {
+    Header header{};
+    memcpy(header.magic, DELETION_MAGIC, sizeof(DELETION_MAGIC));
+    header.version = DELETION_VERSION;
+    header.rows = words.size() * 64;
+    header.deleted = deleted;
+    header.checksum = FileIO::crc32(reinterpret_cast<const char *>(words.data()), words.size() * sizeof(uint64_t));
+
+    fs::path tempPath = FileIO::temporaryPath(path);
+    {
+        ofstream out(tempPath, ios::binary | ios::trunc);
+        out.write(reinterpret_cast<const char *>(&header), sizeof(Header));
+        out.write(reinterpret_cast<const char *>(words.data()), static_cast<streamsize>(words.size() * sizeof(uint64_t)));
+        if (!out) {
+            out.close();
+            fs::remove(tempPath);
+            throw runtime_error("Failed to write deletion file: " + path.string());
+        }
+    }
+    fs::rename(tempPath, path);
+}
+
+void DeletionVector::clear() {
+    words.clear();
+    deleted = 0;
+    fs::remove(path);
+}
+
+optional<pair<size_t, size_t> > DeletionVector::peek(const fs::path &filePath) {
+    ifstream in(filePath, ios::binary);
+    if (!in.is_open()) {
+        return nullopt;
+    }
+    Header header = readHeader(in, filePath);
+    return make_pair(static_cast<size_t>(header.deleted), static_cast<size_t>(header.rows));
+}
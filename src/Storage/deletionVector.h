@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @brief The rows of a table that were deleted but are still in its column files
+ *
+ * DELETE only sets bits in this bitmap (`deleted.bin` next to Table-info.json), so its cost
+ * does not depend on the width or length of the table; VACUUM later drops the rows from the
+ * column files and clears the bitmap. Row numbers are positions in the column files, which
+ * stay valid until the next VACUUM.
+ *
+ * The file is a small header (including how many bits are set, so the dead ratio can be
+ * read without the bitmap) followed by the bitmap words, and is replaced in one rename.
+ */
+class DeletionVector {
+public:
+    /**
+     * @brief Loads the bitmap of a table; a missing file means no deleted rows
+     * @throws std::runtime_error if the file exists but is corrupt
+     */
+    explicit DeletionVector(filesystem::path filePath);
+
+    bool empty() const { return deleted == 0; }
+
+    /**
+     * @brief Number of deleted rows
+     */
+    size_t count() const { return deleted; }
+
+    bool contains(size_t row) const {
+        return row / 64 < words.size() && (words[row / 64] >> (row % 64) & 1) != 0;
+    }
+
+    /**
+     * @brief Marks rows as deleted; call save() to make it durable
+     */
+    void add(const vector<size_t> &rows);
+
+    /**
+     * @brief Marks rows as not deleted again; call save() to make it durable
+     */
+    void remove(const vector<size_t> &rows);
+
+    /**
+     * @brief Removes the deleted rows from an ascending list of rows
+     */
+    void dropFrom(vector<size_t> &rows) const;
+
+    /**
+     * @brief The deleted rows in ascending order
+     */
+    vector<size_t> rows() const;
+
+    /**
+     * @brief Writes the bitmap to a temporary file and renames it into place
+     * @throws std::runtime_error if the file cannot be written
+     */
+    void save();
+
+    /**
+     * @brief Forgets every deleted row and removes the file, used once the rows are gone
+     */
+    void clear();
+
+    /**
+     * @brief Reads only the header of a table's bitmap: the number of deleted rows and the
+     * number of rows the bitmap covers, or nullopt if the table has no deleted rows
+     */
+    static optional<pair<size_t, size_t> > peek(const filesystem::path &filePath);
+
+private:
+    filesystem::path path;
+    vector<uint64_t> words;
+    size_t deleted = 0;
+};
@@ -0,0 +1,187 @@
+#include "fileIO.h"
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <process.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+namespace fs = filesystem;
+
+namespace FileIO {
+    FileStamp stampOf(const fs::path &filePath) {
+        FileStamp stamp;
+        struct stat info{};
+        if (stat(filePath.string().c_str(), &info) != 0) {
+            return stamp;
+        }
+        stamp.size = static_cast<int64_t>(info.st_size);
+        stamp.inode = static_cast<uint64_t>(info.st_ino);
+#if defined(__APPLE__)
+        stamp.modified = static_cast<int64_t>(info.st_mtimespec.tv_sec) * 1000000000 + info.st_mtimespec.tv_nsec;
+#elif defined(_WIN32)
+        stamp.modified = static_cast<int64_t>(info.st_mtime) * 1000000000;
+#else
+        stamp.modified = static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+        return stamp;
+    }
+
+    uint32_t crc32(const char *data, size_t size) {
+        // Built once, on first use from any thread
+        static const array<uint32_t, 256> table = [] {
+            array<uint32_t, 256> entries{};
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; ++k) {
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                }
+                entries[i] = c;
+            }
+            return entries;
+        }();
+
+        uint32_t crc = 0xFFFFFFFFu;
+        for (size_t i = 0; i < size; ++i) {
+            crc = table[(crc ^ static_cast<uint8_t>(data[i])) & 0xFF] ^ (crc >> 8);
+        }
+        return crc ^ 0xFFFFFFFFu;
+    }
+
+    string readFile(const fs::path &filePath) {
+        ifstream file(filePath, ios::binary);
+        if (!file.is_open()) {
+            throw runtime_error("Failed to open file: " + filePath.string());
+        }
+        return string((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    }
+
+    /**
+     * @brief Names a temporary file next to a target.
+     *
+     * The name includes the process id and a per-process counter, so two writers building the
+     * same file (e.g. two readers rebuilding a stale index at once) never share a temporary.
+     *
+     * @param target The file that the temporary will be renamed to.
+     * @return A path in the same directory as the target.
+     */
+    fs::path temporaryPath(const fs::path &target) {
+        static atomic<uint64_t> counter{0};
+#ifdef _WIN32
+        long long pid = _getpid();
+#else
+        long long pid = getpid();
+#endif
+        fs::path tempPath = target;
+        tempPath += ".tmp." + to_string(pid) + "." + to_string(counter++);
+        return tempPath;
+    }
+
+    /**
+     * @brief Appends data to a file.
+     *
+     * The file is created if it does not exist. The data is handed to the operating system
+     * but not synced.
+     *
+     * @param filePath The file to append to.
+     * @param data The bytes to append.
+     * @throws std::runtime_error If opening or writing the file fails.
+     */
+    void append(const fs::path &filePath, const string &data) {
+        FILE *file = fopen(filePath.string().c_str(), "ab");
+        if (!file) {
+            throw runtime_error("Failed to open file for appending: " + filePath.string());
+        }
+
+        bool ok = fwrite(data.data(), 1, data.size(), file) == data.size();
+        ok = fclose(file) == 0 && ok;
+
+        if (!ok) {
+            throw runtime_error("Failed to append to file: " + filePath.string());
+        }
+    }
+
+    /**
+     * @brief Writes chunks of data at given offsets of an existing file.
+     *
+     * The file is neither created nor truncated, so bytes outside the chunks are untouched.
+     *
+     * @param filePath The file to write to.
+     * @param chunks Offsets and the bytes to write at them.
+     * @throws std::runtime_error If opening or writing the file fails.
+     */
+    void writeAt(const fs::path &filePath, const vector<pair<uint64_t, string> > &chunks) {
+        FILE *file = fopen(filePath.string().c_str(), "r+b");
+        if (!file) {
+            throw runtime_error("Failed to open file for writing: " + filePath.string());
+        }
+
+        bool ok = true;
+        for (const auto &[offset, data]: chunks) {
+#ifdef _WIN32
+            ok = ok && _fseeki64(file, static_cast<long long>(offset), SEEK_SET) == 0;
+#else
+            ok = ok && fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+            ok = ok && fwrite(data.data(), 1, data.size(), file) == data.size();
+        }
+        ok = fclose(file) == 0 && ok;
+
+        if (!ok) {
+            throw runtime_error("Failed to write file: " + filePath.string());
+        }
+    }
+
+    /**
+     * @brief Starts reading a whole file into the page cache without waiting for it.
+     */
+#ifdef POSIX_FADV_WILLNEED
+    void prefetch(const fs::path &filePath) {
+        int fd = open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd >= 0) {
+            posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+            close(fd);
+        }
+    }
+#else
+    void prefetch(const fs::path &) {
+    }
+#endif
+
+    /**
+     * @brief Waits until a file has reached the disk.
+     *
+     * Syncing a directory makes the files created, renamed or removed in it durable. On
+     * Windows files are flushed with _commit and directories are skipped.
+     *
+     * @param path The file or directory.
+     * @throws std::runtime_error If it cannot be opened or synced.
+     */
+    void sync(const fs::path &path) {
+#ifdef _WIN32
+        if (fs::is_directory(path)) {
+            return;
+        }
+        int fd = _open(path.string().c_str(), _O_RDWR | _O_BINARY);
+        bool ok = fd >= 0 && _commit(fd) == 0;
+        if (fd >= 0) _close(fd);
+#else
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        bool ok = fd >= 0 && fsync(fd) == 0;
+        if (fd >= 0) close(fd);
+#endif
+        if (!ok) {
+            throw runtime_error("Failed to sync: " + path.string());
+        }
+    }
+}
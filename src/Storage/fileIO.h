@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace FileIO {
+    /**
+     * @brief Modification time, size and inode of a file, to notice when it was rewritten
+     */
+    struct FileStamp {
+        int64_t modified = 0;
+        int64_t size = -1;
+        uint64_t inode = 0;
+
+        bool operator==(const FileStamp &other) const {
+            return modified == other.modified && size == other.size && inode == other.inode;
+        }
+    };
+
+    /**
+     * @brief Returns the stamp of a file; a missing file has its own stamp, so a cached entry
+     * notices when it appears
+     */
+    FileStamp stampOf(const filesystem::path &filePath);
+
+    /**
+     * @brief Computes the CRC-32 (IEEE) checksum of a buffer
+     */
+    uint32_t crc32(const char *data, size_t size);
+
+    /**
+     * @brief Reads a whole file into memory
+     * @throws std::runtime_error if the file cannot be opened
+     */
+    string readFile(const filesystem::path &filePath);
+
+    /**
+     * @brief Returns a fresh temporary path next to a file, unique across threads and processes
+     */
+    filesystem::path temporaryPath(const filesystem::path &target);
+
+    /**
+     * @brief Appends bytes to a file, creating it if needed
+     *
+     * Nothing is synced; the write-ahead log makes table files durable at its checkpoints.
+     * @throws std::runtime_error if the file cannot be written
+     */
+    void append(const filesystem::path &filePath, const string &data);
+
+    /**
+     * @brief Overwrites byte ranges of an existing file in place, given as (offset, bytes) pairs
+     * @throws std::runtime_error if the file cannot be opened or written
+     */
+    void writeAt(const filesystem::path &filePath, const vector<pair<uint64_t, string> > &chunks);
+
+    /**
+     * @brief Asks the kernel to start reading a whole file into the page cache and returns
+     * without waiting; a no-op where that cannot be asked or the file cannot be opened
+     */
+    void prefetch(const filesystem::path &filePath);
+
+    /**
+     * @brief Flushes a file, or the entries of a directory, to stable storage
+     * @throws std::runtime_error if it cannot be opened or synced
+     */
+    void sync(const filesystem::path &path);
+}
@@ -0,0 +1,316 @@
+#include "filterKernels.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define MASHDB_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+    using FilterKernels::Compare;
+    using FilterKernels::wordsFor;
+
+    int popcount(uint64_t word) {
+#if defined(_MSC_VER)
+        return static_cast<int>(__popcnt64(word));
+#else
+        return __builtin_popcountll(word);
+#endif
+    }
+
+    int lowestBit(uint64_t word) {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward64(&index, word);
+        return static_cast<int>(index);
+#else
+        return __builtin_ctzll(word);
+#endif
+    }
+
+    template<typename T, typename Test>
+    void scalarLoop(const T *values, size_t count, T target, Test test, uint64_t *bitmap) {
+        for (size_t w = 0; w < wordsFor(count); ++w) {
+            const T *block = values + w * 64;
+            size_t rows = min<size_t>(64, count - w * 64);
+            uint64_t word = 0;
+            for (size_t j = 0; j < rows; ++j) {
+                word |= static_cast<uint64_t>(test(block[j], target)) << j;
+            }
+            bitmap[w] = word;
+        }
+    }
+
+    template<typename T>
+    void scalarCompare(const T *values, size_t count, T target, Compare op, uint64_t *bitmap) {
+        switch (op) {
+            case Compare::Equal:
+                return scalarLoop(values, count, target, [](T a, T b) { return a == b; }, bitmap);
+            case Compare::NotEqual:
+                return scalarLoop(values, count, target, [](T a, T b) { return a != b; }, bitmap);
+            case Compare::Less:
+                return scalarLoop(values, count, target, [](T a, T b) { return a < b; }, bitmap);
+            case Compare::LessEqual:
+                return scalarLoop(values, count, target, [](T a, T b) { return a <= b; }, bitmap);
+            case Compare::Greater:
+                return scalarLoop(values, count, target, [](T a, T b) { return a > b; }, bitmap);
+            case Compare::GreaterEqual:
+                return scalarLoop(values, count, target, [](T a, T b) { return a >= b; }, bitmap);
+        }
+    }
+
+#ifdef MASHDB_X86_KERNELS
+    enum class InstructionSet { Scalar, Sse42, Avx2 };
+
+    InstructionSet detect() {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return InstructionSet::Avx2;
+        if (__builtin_cpu_supports("sse4.2")) return InstructionSet::Sse42;
+        return InstructionSet::Scalar;
+    }
+
+    InstructionSet instructionSet() {
+        static const InstructionSet supported = detect();
+        return supported;
+    }
+
+    /*
+     * The vector loops handle whole 64-row words; the remaining rows of a partial last word
+     * go through the scalar loop. Comparisons without a direct instruction are expressed as
+     * the complement of one that has it (a <= b is !(a > b), and so on).
+     */
+    template<Compare Op>
+    __attribute__((target("avx2"))) void avx2Int64(const int64_t *values, size_t words, int64_t target,
+                                                   uint64_t *bitmap) {
+        const __m256i t = _mm256_set1_epi64x(target);
+        for (size_t w = 0; w < words; ++w) {
+            const int64_t *block = values + w * 64;
+            uint64_t word = 0;
+            for (size_t j = 0; j < 16; ++j) {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block + j * 4));
+                __m256i m;
+                if constexpr (Op == Compare::Equal || Op == Compare::NotEqual) m = _mm256_cmpeq_epi64(v, t);
+                else if constexpr (Op == Compare::Greater || Op == Compare::LessEqual) m = _mm256_cmpgt_epi64(v, t);
+                else m = _mm256_cmpgt_epi64(t, v);
+                auto bits = static_cast<uint64_t>(_mm256_movemask_pd(_mm256_castsi256_pd(m)));
+                if constexpr (Op == Compare::NotEqual || Op == Compare::LessEqual || Op == Compare::GreaterEqual) {
+                    bits = ~bits & 0xF;
+                }
+                word |= bits << (j * 4);
+            }
+            bitmap[w] = word;
+        }
+    }
+
+    template<int Predicate>
+    __attribute__((target("avx2"))) void avx2Double(const double *values, size_t words, double target,
+                                                    uint64_t *bitmap) {
+        const __m256d t = _mm256_set1_pd(target);
+        for (size_t w = 0; w < words; ++w) {
+            const double *block = values + w * 64;
+            uint64_t word = 0;
+            for (size_t j = 0; j < 16; ++j) {
+                __m256d v = _mm256_loadu_pd(block + j * 4);
+                auto bits = static_cast<uint64_t>(_mm256_movemask_pd(_mm256_cmp_pd(v, t, Predicate)));
+                word |= bits << (j * 4);
+            }
+            bitmap[w] = word;
+        }
+    }
+
+    template<Compare Op>
+    __attribute__((target("sse4.2"))) void sseInt64(const int64_t *values, size_t words, int64_t target,
+                                                    uint64_t *bitmap) {
+        const __m128i t = _mm_set1_epi64x(target);
+        for (size_t w = 0; w < words; ++w) {
+            const int64_t *block = values + w * 64;
+            uint64_t word = 0;
+            for (size_t j = 0; j < 32; ++j) {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(block + j * 2));
+                __m128i m;
+                if constexpr (Op == Compare::Equal || Op == Compare::NotEqual) m = _mm_cmpeq_epi64(v, t);
+                else if constexpr (Op == Compare::Greater || Op == Compare::LessEqual) m = _mm_cmpgt_epi64(v, t);
+                else m = _mm_cmpgt_epi64(t, v);
+                auto bits = static_cast<uint64_t>(_mm_movemask_pd(_mm_castsi128_pd(m)));
+                if constexpr (Op == Compare::NotEqual || Op == Compare::LessEqual || Op == Compare::GreaterEqual) {
+                    bits = ~bits & 0x3;
+                }
+                word |= bits << (j * 2);
+            }
+            bitmap[w] = word;
+        }
+    }
+
+    template<Compare Op>
+    __attribute__((target("sse4.2"))) void sseDouble(const double *values, size_t words, double target,
+                                                     uint64_t *bitmap) {
+        const __m128d t = _mm_set1_pd(target);
+        for (size_t w = 0; w < words; ++w) {
+            const double *block = values + w * 64;
+            uint64_t word = 0;
+            for (size_t j = 0; j < 32; ++j) {
+                __m128d v = _mm_loadu_pd(block + j * 2);
+                __m128d m;
+                if constexpr (Op == Compare::Equal) m = _mm_cmpeq_pd(v, t);
+                else if constexpr (Op == Compare::NotEqual) m = _mm_cmpneq_pd(v, t);
+                else if constexpr (Op == Compare::Less) m = _mm_cmplt_pd(v, t);
+                else if constexpr (Op == Compare::LessEqual) m = _mm_cmple_pd(v, t);
+                else if constexpr (Op == Compare::Greater) m = _mm_cmpgt_pd(v, t);
+                else m = _mm_cmpge_pd(v, t);
+                word |= static_cast<uint64_t>(_mm_movemask_pd(m)) << (j * 2);
+            }
+            bitmap[w] = word;
+        }
+    }
+
+    template<template<Compare> class Kernel, typename T>
+    void dispatch(Compare op, const T *values, size_t words, T target, uint64_t *bitmap) {
+        switch (op) {
+            case Compare::Equal:
+                return Kernel<Compare::Equal>::run(values, words, target, bitmap);
+            case Compare::NotEqual:
+                return Kernel<Compare::NotEqual>::run(values, words, target, bitmap);
+            case Compare::Less:
+                return Kernel<Compare::Less>::run(values, words, target, bitmap);
+            case Compare::LessEqual:
+                return Kernel<Compare::LessEqual>::run(values, words, target, bitmap);
+            case Compare::Greater:
+                return Kernel<Compare::Greater>::run(values, words, target, bitmap);
+            case Compare::GreaterEqual:
+                return Kernel<Compare::GreaterEqual>::run(values, words, target, bitmap);
+        }
+    }
+
+    template<Compare Op>
+    struct Avx2Int64 {
+        static void run(const int64_t *v, size_t words, int64_t t, uint64_t *b) { avx2Int64<Op>(v, words, t, b); }
+    };
+
+    template<Compare Op>
+    struct SseInt64 {
+        static void run(const int64_t *v, size_t words, int64_t t, uint64_t *b) { sseInt64<Op>(v, words, t, b); }
+    };
+
+    template<Compare Op>
+    struct SseDouble {
+        static void run(const double *v, size_t words, double t, uint64_t *b) { sseDouble<Op>(v, words, t, b); }
+    };
+
+    void avx2DoubleDispatch(Compare op, const double *values, size_t words, double target, uint64_t *bitmap) {
+        switch (op) {
+            case Compare::Equal:
+                return avx2Double<_CMP_EQ_OQ>(values, words, target, bitmap);
+            case Compare::NotEqual:
+                return avx2Double<_CMP_NEQ_UQ>(values, words, target, bitmap);
+            case Compare::Less:
+                return avx2Double<_CMP_LT_OQ>(values, words, target, bitmap);
+            case Compare::LessEqual:
+                return avx2Double<_CMP_LE_OQ>(values, words, target, bitmap);
+            case Compare::Greater:
+                return avx2Double<_CMP_GT_OQ>(values, words, target, bitmap);
+            case Compare::GreaterEqual:
+                return avx2Double<_CMP_GE_OQ>(values, words, target, bitmap);
+        }
+    }
+#endif
+}
+
+namespace FilterKernels {
+    void compareInt64(const int64_t *values, size_t count, int64_t target, Compare op, uint64_t *bitmap) {
+        size_t fullWords = 0;
+#ifdef MASHDB_X86_KERNELS
+        fullWords = count / 64;
+        switch (instructionSet()) {
+            case InstructionSet::Avx2:
+                dispatch<Avx2Int64>(op, values, fullWords, target, bitmap);
+                break;
+            case InstructionSet::Sse42:
+                dispatch<SseInt64>(op, values, fullWords, target, bitmap);
+                break;
+            case InstructionSet::Scalar:
+                fullWords = 0;
+                break;
+        }
+#endif
+        scalarCompare(values + fullWords * 64, count - fullWords * 64, target, op, bitmap + fullWords);
+    }
+
+    void compareDouble(const double *values, size_t count, double target, Compare op, uint64_t *bitmap) {
+        size_t fullWords = 0;
+#ifdef MASHDB_X86_KERNELS
+        fullWords = count / 64;
+        switch (instructionSet()) {
+            case InstructionSet::Avx2:
+                avx2DoubleDispatch(op, values, fullWords, target, bitmap);
+                break;
+            case InstructionSet::Sse42:
+                dispatch<SseDouble>(op, values, fullWords, target, bitmap);
+                break;
+            case InstructionSet::Scalar:
+                fullWords = 0;
+                break;
+        }
+#endif
+        scalarCompare(values + fullWords * 64, count - fullWords * 64, target, op, bitmap + fullWords);
+    }
+
+    void clearNulls(const uint8_t *nulls, size_t count, uint64_t *bitmap) {
+        const uint64_t low7 = 0x7F7F7F7F7F7F7F7Full;
+        for (size_t w = 0; w < wordsFor(count); ++w) {
+            size_t base = w * 64;
+            size_t rows = min<size_t>(64, count - base);
+            uint64_t nullBits = 0;
+            size_t j = 0;
+            for (; j + 8 <= rows; j += 8) {
+                uint64_t bytes;
+                memcpy(&bytes, nulls + base + j, sizeof(bytes));
+                // High bit of each byte set if the byte is non-zero, then gather one bit per byte
+                uint64_t flags = (((bytes & low7) + low7) | bytes) >> 7 & 0x0101010101010101ull;
+                nullBits |= (flags * 0x0102040810204080ull >> 56) << j;
+            }
+            for (; j < rows; ++j) {
+                nullBits |= static_cast<uint64_t>(nulls[base + j] != 0) << j;
+            }
+            bitmap[w] &= ~nullBits;
+        }
+    }
+
+    vector<size_t> selectedRows(const uint64_t *bitmap, size_t count) {
+        size_t selected = 0;
+        for (size_t w = 0; w < wordsFor(count); ++w) {
+            selected += static_cast<size_t>(popcount(bitmap[w]));
+        }
+
+        vector<size_t> rows;
+        rows.reserve(selected);
+        for (size_t w = 0; w < wordsFor(count); ++w) {
+            uint64_t word = bitmap[w];
+            while (word) {
+                rows.push_back(w * 64 + static_cast<size_t>(lowestBit(word)));
+                word &= word - 1;
+            }
+        }
+        return rows;
+    }
+
+    const char *activeInstructionSet() {
+#ifdef MASHDB_X86_KERNELS
+        switch (instructionSet()) {
+            case InstructionSet::Avx2:
+                return "avx2";
+            case InstructionSet::Sse42:
+                return "sse4.2";
+            case InstructionSet::Scalar:
+                break;
+        }
+#endif
+        return "scalar";
+    }
+}
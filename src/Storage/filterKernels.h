@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @brief Batch comparison kernels for numeric column scans
+ *
+ * Each kernel compares a contiguous array against a constant and writes a selection bitmap,
+ * one bit per row (bit i of word i / 64). AVX2 and SSE4.2 versions are chosen at runtime on
+ * x86-64; other targets use the scalar loops.
+ */
+namespace FilterKernels {
+    enum class Compare : uint8_t { Equal, NotEqual, Less, LessEqual, Greater, GreaterEqual };
+
+    /**
+     * @brief Number of bitmap words needed for the given number of rows
+     */
+    inline size_t wordsFor(size_t rows) { return (rows + 63) / 64; }
+
+    void compareInt64(const int64_t *values, size_t count, int64_t target, Compare op, uint64_t *bitmap);
+
+    void compareDouble(const double *values, size_t count, double target, Compare op, uint64_t *bitmap);
+
+    /**
+     * @brief Clears the bits of rows whose null flag byte is non-zero
+     */
+    void clearNulls(const uint8_t *nulls, size_t count, uint64_t *bitmap);
+
+    /**
+     * @brief Returns the indices of the set bits among the first `count` rows, in ascending order
+     */
+    vector<size_t> selectedRows(const uint64_t *bitmap, size_t count);
+
+    /**
+     * @brief Name of the instruction set the kernels use on this machine ("avx2", "sse4.2" or "scalar")
+     */
+    const char *activeInstructionSet();
+}
@@ -0,0 +1,431 @@
+#include "hashIndex.h"
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+using namespace std;
+using json = nlohmann::json;
+namespace fs = filesystem;
+
+/*
+ * Index file layout:
+ *
+ *   Header        magic "MHIX", version, column type, dirty flag, table geometry
+ *   Slot[capacity]
+ *
+ * A slot with rowPlusOne == 0 is empty and one with rowPlusOne == TOMBSTONE held an erased
+ * entry. For integer, float and boolean columns `key` holds the raw 64-bit value; for text
+ * columns it is the offset of a (uint32 length, bytes) entry in the keys file. NULL is not
+ * indexed at all, since any number of rows may hold it; the header's nullRow is always 0.
+ */
+namespace {
+    const char INDEX_MAGIC[4] = {'M', 'H', 'I', 'X'};
+    const uint16_t INDEX_VERSION = 1;
+    const uint64_t INITIAL_CAPACITY = 64;
+    const uint64_t TOMBSTONE = UINT64_MAX;
+
+    uint64_t mix(uint64_t x) {
+        x += 0x9E3779B97F4A7C15ull;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+        return x ^ (x >> 31);
+    }
+
+    uint64_t hashText(const string &text) {
+        uint64_t h = 0xCBF29CE484222325ull;
+        for (unsigned char c: text) {
+            h = (h ^ c) * 0x100000001B3ull;
+        }
+        return mix(h);
+    }
+
+    uint64_t capacityFor(uint64_t entries) {
+        uint64_t capacity = INITIAL_CAPACITY;
+        while (capacity < entries * 4) {
+            capacity *= 2;
+        }
+        return capacity;
+    }
+}
+
+HashIndex::HashIndex(fs::path filePath, ColumnType columnType)
+    : path(std::move(filePath)), type(columnType) {
+    keysPath = path;
+    keysPath.replace_extension(".hkeys");
+    open();
+}
+
+void HashIndex::open() {
+    if (!fs::exists(path)) {
+        fs::create_directories(path.parent_path());
+        create(INITIAL_CAPACITY);
+    }
+    if (!fs::exists(keysPath)) {
+        ofstream(keysPath, ios::binary).close();
+    }
+
+    file.close();
+    file.clear();
+    file.open(path, ios::in | ios::out | ios::binary);
+    keys.close();
+    keys.clear();
+    keys.open(keysPath, ios::in | ios::out | ios::binary);
+    if (!file.is_open() || !keys.is_open()) {
+        throw runtime_error("Failed to open index file: " + path.string());
+    }
+
+    if (!file.read(reinterpret_cast<char *>(&header), sizeof(Header)) ||
+        memcmp(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 || header.version != INDEX_VERSION ||
+        header.type != static_cast<uint8_t>(type) || header.capacity == 0 ||
+        (header.capacity & (header.capacity - 1)) != 0) {
+        throw runtime_error("Corrupt index file: " + path.string());
+    }
+}
+
+/**
+ * @brief Deletes an index file together with its keys file.
+ */
+void HashIndex::remove(const fs::path &filePath) {
+    fs::path keyFile = filePath;
+    keyFile.replace_extension(".hkeys");
+    fs::remove(filePath);
+    fs::remove(keyFile);
+}
+
+/**
+ * @brief Writes a fresh, empty index file with the given capacity.
+ */
+void HashIndex::create(uint64_t capacity) {
+    Header fresh{};
+    memcpy(fresh.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    fresh.version = INDEX_VERSION;
+    fresh.type = static_cast<uint8_t>(type);
+    fresh.capacity = capacity;
+
+    ofstream out(path, ios::binary | ios::trunc);
+    if (!out) {
+        throw runtime_error("Failed to create index file: " + path.string());
+    }
+    out.write(reinterpret_cast<const char *>(&fresh), sizeof(Header));
+    vector<Slot> slots(capacity, Slot{0, 0, 0});
+    out.write(reinterpret_cast<const char *>(slots.data()), static_cast<streamsize>(capacity * sizeof(Slot)));
+}
+
+HashIndex::Key HashIndex::keyOf(const json &value) const {
+    Key key;
+    switch (type) {
+        case ColumnType::Integer: {
+            auto v = value.get<int64_t>();
+            memcpy(&key.bits, &v, sizeof(v));
+            key.hash = mix(key.bits);
+            break;
+        }
+        case ColumnType::Float: {
+            double v = value.get<double>();
+            if (v == 0.0) v = 0.0; // -0.0 and 0.0 are the same value
+            memcpy(&key.bits, &v, sizeof(v));
+            key.hash = mix(key.bits);
+            break;
+        }
+        case ColumnType::Boolean:
+            key.bits = value.get<bool>() ? 1 : 0;
+            key.hash = mix(key.bits);
+            break;
+        case ColumnType::Text:
+            key.text = value.get<string>();
+            key.hash = hashText(key.text);
+            break;
+    }
+    return key;
+}
+
+bool HashIndex::keyMatches(const Slot &slot, const Key &key) {
+    if (slot.hash != key.hash) {
+        return false;
+    }
+    if (type != ColumnType::Text) {
+        return slot.key == key.bits;
+    }
+
+    uint32_t length = 0;
+    keys.clear();
+    keys.seekg(static_cast<streamoff>(slot.key));
+    if (!keys.read(reinterpret_cast<char *>(&length), sizeof(length)) || length != key.text.size()) {
+        return false;
+    }
+    string stored(length, '\0');
+    keys.read(stored.data(), length);
+    return stored == key.text;
+}
+
+uint64_t HashIndex::storeKey(const Key &key) {
+    if (type != ColumnType::Text) {
+        return key.bits;
+    }
+
+    keys.clear();
+    keys.seekp(0, ios::end);
+    auto offset = static_cast<uint64_t>(keys.tellp());
+    auto length = static_cast<uint32_t>(key.text.size());
+    keys.write(reinterpret_cast<const char *>(&length), sizeof(length));
+    keys.write(key.text.data(), length);
+    keys.flush();
+    return offset;
+}
+
+HashIndex::Slot HashIndex::readSlot(uint64_t index) {
+    Slot slot{};
+    file.clear();
+    file.seekg(static_cast<streamoff>(sizeof(Header) + index * sizeof(Slot)));
+    if (!file.read(reinterpret_cast<char *>(&slot), sizeof(Slot))) {
+        throw runtime_error("Failed to read index file: " + path.string());
+    }
+    return slot;
+}
+
+void HashIndex::writeSlot(uint64_t index, const Slot &slot) {
+    file.clear();
+    file.seekp(static_cast<streamoff>(sizeof(Header) + index * sizeof(Slot)));
+    file.write(reinterpret_cast<const char *>(&slot), sizeof(Slot));
+}
+
+void HashIndex::writeHeader() {
+    file.clear();
+    file.seekp(0);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(Header));
+    file.flush();
+    if (!file) {
+        throw runtime_error("Failed to write index file: " + path.string());
+    }
+}
+
+/**
+ * @brief Looks up the row holding a value.
+ *
+ * @param value The value to look up, already converted to the column type.
+ * @return The row index, or nullopt if no row holds the value.
+ */
+optional<size_t> HashIndex::find(const json &value) {
+    if (value.is_null()) {
+        return nullopt;
+    }
+
+    Key key = keyOf(value);
+    uint64_t mask = header.capacity - 1;
+    for (uint64_t i = key.hash & mask, probes = 0; probes < header.capacity; i = (i + 1) & mask, ++probes) {
+        Slot slot = readSlot(i);
+        if (slot.rowPlusOne == 0) {
+            return nullopt;
+        }
+        if (slot.rowPlusOne != TOMBSTONE && keyMatches(slot, key)) {
+            return slot.rowPlusOne - 1;
+        }
+    }
+    return nullopt;
+}
+
+/**
+ * @brief Adds an entry for a value, growing the table when it becomes half full.
+ *
+ * @param value The value stored in the row, already converted to the column type.
+ * @param row The row holding the value.
+ * @throws std::runtime_error If another row already holds the value.
+ */
+void HashIndex::insert(const json &value, size_t row) {
+    if (value.is_null()) {
+        return;
+    }
+
+    if ((header.entries + header.tombstones + 1) * 2 > header.capacity) {
+        grow();
+    }
+
+    Key key = keyOf(value);
+    uint64_t mask = header.capacity - 1;
+    optional<uint64_t> freeSlot;
+    for (uint64_t i = key.hash & mask, probes = 0; probes < header.capacity; i = (i + 1) & mask, ++probes) {
+        Slot slot = readSlot(i);
+        if (slot.rowPlusOne == 0) {
+            if (!freeSlot.has_value()) freeSlot = i;
+            break;
+        }
+        if (slot.rowPlusOne == TOMBSTONE) {
+            if (!freeSlot.has_value()) freeSlot = i;
+            continue;
+        }
+        if (keyMatches(slot, key)) {
+            if (slot.rowPlusOne == row + 1) {
+                return;
+            }
+            throw runtime_error("Duplicate value in unique index: " + value.dump());
+        }
+    }
+
+    Slot slot = readSlot(*freeSlot);
+    if (slot.rowPlusOne == TOMBSTONE) {
+        header.tombstones--;
+    }
+    writeSlot(*freeSlot, Slot{key.hash, row + 1, storeKey(key)});
+    header.entries++;
+    writeHeader();
+}
+
+bool HashIndex::erase(const json &value) {
+    if (value.is_null()) {
+        return false;
+    }
+
+    Key key = keyOf(value);
+    uint64_t mask = header.capacity - 1;
+    for (uint64_t i = key.hash & mask, probes = 0; probes < header.capacity; i = (i + 1) & mask, ++probes) {
+        Slot slot = readSlot(i);
+        if (slot.rowPlusOne == 0) {
+            return false;
+        }
+        if (slot.rowPlusOne != TOMBSTONE && keyMatches(slot, key)) {
+            slot.rowPlusOne = TOMBSTONE;
+            writeSlot(i, slot);
+            header.entries--;
+            header.tombstones++;
+            writeHeader();
+            return true;
+        }
+    }
+    return false;
+}
+
+void HashIndex::setCoveredRows(size_t rows) {
+    header.coveredRows = rows;
+    writeHeader();
+}
+
+void HashIndex::setDirty(bool dirty) {
+    header.dirty = dirty ? 1 : 0;
+    writeHeader();
+}
+
+/**
+ * @brief Rehashes all live entries into a table sized for them, dropping tombstones.
+ *
+ * The new table is written to a temporary file that replaces the index in one rename.
+ */
+void HashIndex::grow() {
+    vector<Slot> slots(header.capacity);
+    file.clear();
+    file.seekg(sizeof(Header));
+    file.read(reinterpret_cast<char *>(slots.data()), static_cast<streamsize>(slots.size() * sizeof(Slot)));
+
+    uint64_t capacity = capacityFor(header.entries + 1);
+    vector<Slot> rehashed(capacity, Slot{0, 0, 0});
+    for (const auto &slot: slots) {
+        if (slot.rowPlusOne == 0 || slot.rowPlusOne == TOMBSTONE) {
+            continue;
+        }
+        uint64_t i = slot.hash & (capacity - 1);
+        while (rehashed[i].rowPlusOne != 0) {
+            i = (i + 1) & (capacity - 1);
+        }
+        rehashed[i] = slot;
+    }
+
+    Header grown = header;
+    grown.capacity = capacity;
+    grown.tombstones = 0;
+
+    fs::path tempPath = path;
+    tempPath += ".tmp";
+    {
+        ofstream out(tempPath, ios::binary | ios::trunc);
+        out.write(reinterpret_cast<const char *>(&grown), sizeof(Header));
+        out.write(reinterpret_cast<const char *>(rehashed.data()), static_cast<streamsize>(capacity * sizeof(Slot)));
+        if (!out) {
+            throw runtime_error("Failed to write index file: " + tempPath.string());
+        }
+    }
+    file.close();
+    fs::rename(tempPath, path);
+    open();
+}
+
+/**
+ * @brief Rebuilds the index from scratch from the full contents of its column.
+ *
+ * The slots are built in memory and written in one pass; afterwards the index covers all
+ * rows of the column and is no longer dirty.
+ *
+ * @param column The indexed column.
+ * @param deleted Rows to leave out because they were deleted, if any.
+ * @throws std::runtime_error If two rows hold the same value.
+ */
+void HashIndex::rebuild(const Column &column, const DeletionVector *deleted) {
+    if (file.is_open()) {
+        setDirty(true);
+    }
+
+    Header fresh{};
+    memcpy(fresh.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    fresh.version = INDEX_VERSION;
+    fresh.type = static_cast<uint8_t>(type);
+    fresh.capacity = capacityFor(column.size() + 1);
+    fresh.coveredRows = column.size();
+
+    vector<Slot> slots(fresh.capacity, Slot{0, 0, 0});
+    string keyData;
+    uint64_t mask = fresh.capacity - 1;
+
+    for (size_t row = 0; row < column.size(); ++row) {
+        if (deleted && deleted->contains(row)) {
+            continue;
+        }
+        if (column.isNull(row)) {
+            continue;
+        }
+
+        Key key = keyOf(column.at(row));
+        uint64_t i = key.hash & mask;
+        while (slots[i].rowPlusOne != 0) {
+            const Slot &other = slots[i];
+            bool same = other.hash == key.hash;
+            if (same && type == ColumnType::Text) {
+                uint32_t length;
+                memcpy(&length, keyData.data() + other.key, sizeof(length));
+                same = keyData.compare(other.key + sizeof(length), length, key.text) == 0;
+            } else if (same) {
+                same = other.key == key.bits;
+            }
+            if (same) {
+                throw runtime_error("Duplicate value in unique index: " + column.at(row).dump());
+            }
+            i = (i + 1) & mask;
+        }
+
+        uint64_t stored = key.bits;
+        if (type == ColumnType::Text) {
+            stored = keyData.size();
+            auto length = static_cast<uint32_t>(key.text.size());
+            keyData.append(reinterpret_cast<const char *>(&length), sizeof(length));
+            keyData += key.text;
+        }
+        slots[i] = Slot{key.hash, row + 1, stored};
+        fresh.entries++;
+    }
+
+    fs::path tempPath = path;
+    tempPath += ".tmp";
+    {
+        ofstream out(tempPath, ios::binary | ios::trunc);
+        out.write(reinterpret_cast<const char *>(&fresh), sizeof(Header));
+        out.write(reinterpret_cast<const char *>(slots.data()), static_cast<streamsize>(slots.size() * sizeof(Slot)));
+        if (!out) {
+            throw runtime_error("Failed to write index file: " + tempPath.string());
+        }
+    }
+    {
+        ofstream keysOut(keysPath, ios::binary | ios::trunc);
+        keysOut << keyData;
+    }
+    file.close();
+    keys.close();
+    fs::rename(tempPath, path);
+    open();
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "columnStore.h"
+#include "deletionVector.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <nlohmann/json.hpp>
+
+using namespace std;
+using json = nlohmann::json;
+
+/**
+ * @brief Persistent hash index mapping the values of a UNIQUE column to their row
+ *
+ * The index is an open-addressing hash table stored in `<column>.hidx`; text keys live in
+ * a side file `<column>.hkeys` so that lookups compare exact values. Lookups and inserts
+ * touch only the probed slots, so they cost O(1) I/O independent of the table size.
+ *
+ * The header records how many table rows the index covers and whether a multi-step
+ * modification was in progress, which lets the owner detect a stale index after a crash.
+ */
+class HashIndex {
+public:
+    /**
+     * @brief Opens an index file, creating an empty one if it does not exist
+     */
+    HashIndex(filesystem::path filePath, ColumnType type);
+
+    /**
+     * @brief Returns the row holding the given value, if any; never one for NULL, which is
+     * not indexed because UNIQUE allows any number of NULLs
+     */
+    optional<size_t> find(const json &value);
+
+    /**
+     * @brief Records that `row` holds `value`; re-inserting the same pair, or NULL, is a no-op
+     * @throws std::runtime_error if the value is already indexed for a different row
+     */
+    void insert(const json &value, size_t row);
+
+    /**
+     * @brief Removes the entry for the given value
+     * @return true if an entry was removed
+     */
+    bool erase(const json &value);
+
+    size_t coveredRows() const { return header.coveredRows; }
+
+    /**
+     * @brief Records how many table rows are reflected in the index
+     */
+    void setCoveredRows(size_t rows);
+
+    bool isDirty() const { return header.dirty != 0; }
+
+    /**
+     * @brief Marks the index as being modified; a dirty index is rebuilt on next open
+     */
+    void setDirty(bool dirty);
+
+    /**
+     * @brief Deletes the files of an index
+     */
+    static void remove(const filesystem::path &filePath);
+
+    /**
+     * @brief Replaces the index with one built from the given column, leaving out deleted rows
+     * @throws std::runtime_error if the column contains duplicate values
+     */
+    void rebuild(const Column &column, const DeletionVector *deleted = nullptr);
+
+#pragma pack(push, 1)
+    struct Header {
+        char magic[4];
+        uint16_t version;
+        uint8_t type;
+        uint8_t dirty;
+        uint64_t capacity;
+        uint64_t entries;
+        uint64_t tombstones;
+        uint64_t coveredRows;
+        uint64_t nullRow; // unused since NULL is not indexed; kept for the file layout
+    };
+
+    struct Slot {
+        uint64_t hash;
+        uint64_t rowPlusOne;
+        uint64_t key;
+    };
+#pragma pack(pop)
+
+private:
+    filesystem::path path;
+    filesystem::path keysPath;
+    ColumnType type;
+    Header header{};
+    fstream file;
+    fstream keys;
+
+    struct Key {
+        uint64_t hash = 0;
+        uint64_t bits = 0;
+        string text;
+    };
+
+    Key keyOf(const json &value) const;
+
+    bool keyMatches(const Slot &slot, const Key &key);
+
+    uint64_t storeKey(const Key &key);
+
+    Slot readSlot(uint64_t index);
+
+    void writeSlot(uint64_t index, const Slot &slot);
+
+    void writeHeader();
+
+    void open();
+
+    void create(uint64_t capacity);
+
+    void grow();
+};
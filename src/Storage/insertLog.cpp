@@ -0,0 +1,308 @@
+#include "insertLog.h"
+#include "fileIO.h"
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+using namespace std;
+using json = nlohmann::json;
+namespace fs = filesystem;
+
+/*
+ * Record framing:
+ *
+ *   uint32 bodyLength | uint32 crc32(body) | body | uint32 bodyLength
+ *
+ * The trailing length allows the last record to be located from the end of the file.
+ *
+ * Body:
+ *   uint64 ordinal | uint32 valueCount | value*
+ *
+ * valueCount is a multiple of the table's column count; a record written by a batch insert
+ * holds all rows of the batch.
+ *
+ * Value: uint8 tag (0 NULL, 1 int64, 2 double, 3 bool, 4 text) followed by the raw value;
+ * text values are a uint32 length and the bytes.
+ */
+namespace {
+    const size_t FRAME_OVERHEAD = 3 * sizeof(uint32_t);
+
+    enum ValueTag : uint8_t {
+        NullTag = 0,
+        IntegerTag = 1,
+        FloatTag = 2,
+        BooleanTag = 3,
+        TextTag = 4
+    };
+
+    template<typename T>
+    void appendRaw(string &out, const T &value) {
+        out.append(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+
+    template<typename T>
+    T readRaw(const char *data) {
+        T value;
+        memcpy(&value, data, sizeof(T));
+        return value;
+    }
+
+    string encodeBody(const LogRecord &record) {
+        string body;
+        appendRaw(body, record.ordinal);
+        appendRaw(body, static_cast<uint32_t>(record.values.size()));
+
+        for (const auto &value: record.values) {
+            if (value.is_null()) {
+                appendRaw(body, static_cast<uint8_t>(NullTag));
+            } else if (value.is_number_integer()) {
+                appendRaw(body, static_cast<uint8_t>(IntegerTag));
+                appendRaw(body, value.get<int64_t>());
+            } else if (value.is_number_float()) {
+                appendRaw(body, static_cast<uint8_t>(FloatTag));
+                appendRaw(body, value.get<double>());
+            } else if (value.is_boolean()) {
+                appendRaw(body, static_cast<uint8_t>(BooleanTag));
+                appendRaw(body, static_cast<uint8_t>(value.get<bool>()));
+            } else if (value.is_string()) {
+                const auto &text = value.get_ref<const string &>();
+                appendRaw(body, static_cast<uint8_t>(TextTag));
+                appendRaw(body, static_cast<uint32_t>(text.size()));
+                body += text;
+            } else {
+                throw runtime_error("Unsupported value in insert log: " + value.dump());
+            }
+        }
+        return body;
+    }
+
+    string encodeRecord(const LogRecord &record) {
+        string body = encodeBody(record);
+        auto length = static_cast<uint32_t>(body.size());
+        string frame;
+        appendRaw(frame, length);
+        appendRaw(frame, FileIO::crc32(body.data(), body.size()));
+        frame += body;
+        appendRaw(frame, length);
+        return frame;
+    }
+
+    LogRecord decodeRecord(const char *body, size_t size) {
+        LogRecord record;
+        size_t pos = 0;
+        auto need = [&](size_t bytes) {
+            if (size - pos < bytes) throw runtime_error("Malformed insert log record");
+        };
+
+        need(sizeof(uint64_t) + sizeof(uint32_t));
+        record.ordinal = readRaw<uint64_t>(body + pos);
+        pos += sizeof(uint64_t);
+        auto count = readRaw<uint32_t>(body + pos);
+        pos += sizeof(uint32_t);
+
+        record.values.reserve(count);
+        for (uint32_t i = 0; i < count; ++i) {
+            need(1);
+            auto tag = static_cast<uint8_t>(body[pos++]);
+            switch (tag) {
+                case NullTag:
+                    record.values.emplace_back(nullptr);
+                    break;
+                case IntegerTag:
+                    need(sizeof(int64_t));
+                    record.values.emplace_back(readRaw<int64_t>(body + pos));
+                    pos += sizeof(int64_t);
+                    break;
+                case FloatTag:
+                    need(sizeof(double));
+                    record.values.emplace_back(readRaw<double>(body + pos));
+                    pos += sizeof(double);
+                    break;
+                case BooleanTag:
+                    need(1);
+                    record.values.emplace_back(body[pos++] != 0);
+                    break;
+                case TextTag: {
+                    need(sizeof(uint32_t));
+                    auto length = readRaw<uint32_t>(body + pos);
+                    pos += sizeof(uint32_t);
+                    need(length);
+                    record.values.emplace_back(string(body + pos, length));
+                    pos += length;
+                    break;
+                }
+                default:
+                    throw runtime_error("Malformed insert log record");
+            }
+        }
+        return record;
+    }
+
+    /**
+     * Validates the frame starting at pos and returns its total size, or 0 if the frame is
+     * torn or corrupt.
+     */
+    size_t checkFrame(const string &content, size_t pos) {
+        if (content.size() - pos < FRAME_OVERHEAD) {
+            return 0;
+        }
+        auto length = readRaw<uint32_t>(content.data() + pos);
+        if (content.size() - pos - FRAME_OVERHEAD < length) {
+            return 0;
+        }
+        auto checksum = readRaw<uint32_t>(content.data() + pos + sizeof(uint32_t));
+        const char *body = content.data() + pos + 2 * sizeof(uint32_t);
+        if (FileIO::crc32(body, length) != checksum || readRaw<uint32_t>(body + length) != length) {
+            return 0;
+        }
+        return length + FRAME_OVERHEAD;
+    }
+
+    string readRange(const fs::path &filePath, uint64_t offset, size_t size) {
+        ifstream file(filePath, ios::binary);
+        string data(size, '\0');
+        file.seekg(static_cast<streamoff>(offset));
+        if (!file.read(data.data(), static_cast<streamsize>(size))) {
+            return {};
+        }
+        return data;
+    }
+}
+
+InsertLog::InsertLog(fs::path filePath, size_t columnCount) : path(std::move(filePath)), columns(columnCount) {
+}
+
+string InsertLog::encode(const LogRecord &record) {
+    return encodeBody(record);
+}
+
+LogRecord InsertLog::decode(const string &body) {
+    return decodeRecord(body.data(), body.size());
+}
+
+pair<uint64_t, size_t> InsertLog::peek(const string &body) {
+    if (body.size() < sizeof(uint64_t) + sizeof(uint32_t)) {
+        throw runtime_error("Malformed insert log record");
+    }
+    return {readRaw<uint64_t>(body.data()), readRaw<uint32_t>(body.data() + sizeof(uint64_t))};
+}
+
+/**
+ * @brief Reads all intact records from the log.
+ *
+ * Reading stops at the first record whose framing or checksum is invalid, which is where a
+ * crash interrupted an append.
+ *
+ * @return The records in the order they were appended.
+ */
+vector<LogRecord> InsertLog::readAll() const {
+    vector<LogRecord> records;
+    if (!fs::exists(path)) {
+        return records;
+    }
+
+    string content = FileIO::readFile(path);
+    size_t pos = 0;
+    while (size_t frameSize = checkFrame(content, pos)) {
+        auto length = readRaw<uint32_t>(content.data() + pos);
+        records.push_back(decodeRecord(content.data() + pos + 2 * sizeof(uint32_t), length));
+        pos += frameSize;
+    }
+    return records;
+}
+
+/**
+ * @brief Returns the ordinals of the first and last records without reading the whole log.
+ *
+ * The last record is located through its trailing length. If the tail turns out to be torn,
+ * the log is scanned from the start instead.
+ *
+ * @return The first and last ordinal, or nullopt if the log holds no intact records.
+ */
+optional<pair<uint64_t, uint64_t> > InsertLog::ordinalRange() const {
+    if (!fs::exists(path)) {
+        return nullopt;
+    }
+    uint64_t size = fs::file_size(path);
+    if (size < FRAME_OVERHEAD) {
+        return nullopt;
+    }
+
+    auto frameOrdinal = [](const string &frame) {
+        return readRaw<uint64_t>(frame.data() + 2 * sizeof(uint32_t));
+    };
+    auto lastRowOrdinal = [this, &frameOrdinal](const string &frame) {
+        auto valueCount = readRaw<uint32_t>(frame.data() + 2 * sizeof(uint32_t) + sizeof(uint64_t));
+        uint64_t rows = columns == 0 ? 0 : valueCount / columns;
+        return frameOrdinal(frame) + (rows == 0 ? 0 : rows - 1);
+    };
+
+    string head = readRange(path, 0, sizeof(uint32_t));
+    auto firstLength = readRaw<uint32_t>(head.data());
+    if (size < firstLength + FRAME_OVERHEAD) {
+        return nullopt;
+    }
+    string first = readRange(path, 0, firstLength + FRAME_OVERHEAD);
+    if (checkFrame(first, 0) == 0) {
+        return nullopt;
+    }
+
+    string tail = readRange(path, size - sizeof(uint32_t), sizeof(uint32_t));
+    auto lastLength = readRaw<uint32_t>(tail.data());
+    if (size >= lastLength + FRAME_OVERHEAD) {
+        string last = readRange(path, size - lastLength - FRAME_OVERHEAD, lastLength + FRAME_OVERHEAD);
+        if (!last.empty() && checkFrame(last, 0) != 0) {
+            return make_pair(frameOrdinal(first), lastRowOrdinal(last));
+        }
+    }
+
+    auto records = readAll();
+    const auto &lastRecord = records.back();
+    uint64_t rows = columns == 0 ? 0 : lastRecord.values.size() / columns;
+    return make_pair(records.front().ordinal, lastRecord.ordinal + (rows == 0 ? 0 : rows - 1));
+}
+
+uint64_t InsertLog::validLength() const {
+    string content = FileIO::readFile(path);
+    size_t pos = 0;
+    while (size_t frameSize = checkFrame(content, pos)) {
+        pos += frameSize;
+    }
+    return pos;
+}
+
+/**
+ * @brief Appends a record.
+ *
+ * If the previous append was interrupted, the torn bytes are removed first so that the new
+ * record directly follows the last intact one. The record is not synced: the statement
+ * logged it in the database's write-ahead log first, which restores it after a crash.
+ *
+ * @param record The record to append.
+ * @throws std::runtime_error If the log cannot be written.
+ */
+void InsertLog::append(const LogRecord &record) {
+    if (fs::exists(path)) {
+        uint64_t size = fs::file_size(path);
+        bool intactTail = size == 0;
+        if (size >= FRAME_OVERHEAD) {
+            string tail = readRange(path, size - sizeof(uint32_t), sizeof(uint32_t));
+            auto lastLength = readRaw<uint32_t>(tail.data());
+            if (size >= lastLength + FRAME_OVERHEAD) {
+                string last = readRange(path, size - lastLength - FRAME_OVERHEAD, lastLength + FRAME_OVERHEAD);
+                intactTail = !last.empty() && checkFrame(last, 0) != 0;
+            }
+        }
+        if (!intactTail) {
+            fs::resize_file(path, validLength());
+        }
+    }
+
+    FileIO::append(path, encodeRecord(record));
+}
+
+void InsertLog::clear() {
+    if (fs::exists(path)) {
+        fs::resize_file(path, 0);
+    }
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+using namespace std;
+using json = nlohmann::json;
+
+/**
+ * @brief Rows appended to a table but not yet folded into its column files
+ *
+ * A record holds one or more consecutive rows starting at `ordinal`; `values` contains
+ * their values row by row in schema column order.
+ */
+struct LogRecord {
+    uint64_t ordinal = 0;
+    vector<json> values;
+};
+
+/**
+ * @brief Append-only, row-oriented log of inserted rows for a single table
+ *
+ * Every insert is written as one checksummed record, so its rows are either fully present
+ * in the log or not at all. Records carry the row ordinal they were inserted at, which lets
+ * readers skip rows that have already been folded into a column file.
+ *
+ * The log is not synced; the same rows are in the database's WriteAheadLog, which puts them
+ * back after a crash.
+ */
+class InsertLog {
+public:
+    /**
+     * @param filePath Location of the log file
+     * @param columnCount Number of columns in the table, used to split records into rows
+     */
+    InsertLog(filesystem::path filePath, size_t columnCount);
+
+    const filesystem::path &filePath() const { return path; }
+
+    /**
+     * @brief Serializes a record without the framing of the log, for the write-ahead log
+     */
+    static string encode(const LogRecord &record);
+
+    /**
+     * @brief Reverses encode()
+     * @throws std::runtime_error if the bytes are not a record
+     */
+    static LogRecord decode(const string &body);
+
+    /**
+     * @brief Reads only the ordinal and the number of values of an encoded record
+     * @throws std::runtime_error if the bytes are not a record
+     */
+    static pair<uint64_t, size_t> peek(const string &body);
+
+    /**
+     * @brief Reads every intact record, stopping at the first torn or corrupt one
+     */
+    vector<LogRecord> readAll() const;
+
+    /**
+     * @brief Returns the ordinals of the first and last logged rows, if any
+     *
+     * Only the first and last records are read, so this is cheap regardless of log size.
+     */
+    optional<pair<uint64_t, uint64_t> > ordinalRange() const;
+
+    /**
+     * @brief Appends a record, cutting off a torn record left by a crash first
+     */
+    void append(const LogRecord &record);
+
+    /**
+     * @brief Removes all records from the log
+     */
+    void clear();
+
+private:
+    filesystem::path path;
+    size_t columns;
+
+    uint64_t validLength() const;
+};
@@ -0,0 +1,64 @@
+#include "mappedFile.h"
+#include "fileIO.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+namespace fs = filesystem;
+
+/**
+ * @brief Maps a file into memory.
+ *
+ * The descriptor is closed right after mapping; the mapping stays valid on its own. An empty
+ * file is not mapped at all, since mmap rejects a zero length.
+ *
+ * @param filePath The file to map.
+ * @throws std::runtime_error If the file cannot be opened, inspected or mapped.
+ */
+MappedFile::MappedFile(const fs::path &filePath) {
+#ifdef _WIN32
+    buffer = FileIO::readFile(filePath);
+    bytes = buffer.data();
+    length = buffer.size();
+#else
+    int fd = open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw runtime_error("Failed to open file: " + filePath.string());
+    }
+    struct stat info{};
+    if (fstat(fd, &info) != 0) {
+        string reason = strerror(errno);
+        close(fd);
+        throw runtime_error("Failed to inspect file " + filePath.string() + ": " + reason);
+    }
+    length = static_cast<size_t>(info.st_size);
+    if (length > 0) {
+        void *address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (address == MAP_FAILED) {
+            string reason = strerror(errno);
+            close(fd);
+            throw runtime_error("Failed to map file " + filePath.string() + ": " + reason);
+        }
+        bytes = static_cast<const char *>(address);
+        mapped = true;
+    }
+    close(fd);
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifndef _WIN32
+    if (mapped) {
+        munmap(const_cast<char *>(bytes), length);
+    }
+#endif
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <string>
+
+using namespace std;
+
+/**
+ * @brief A whole file mapped read-only into memory
+ *
+ * Pages are read from the page cache as they are touched, so a caller that looks at a small
+ * part of a large file never pays for the rest, and the pages it did touch can be dropped by
+ * the kernel under memory pressure. Windows builds read the file into a buffer instead.
+ */
+class MappedFile {
+public:
+    /**
+     * @throws std::runtime_error if the file cannot be opened or mapped
+     */
+    explicit MappedFile(const filesystem::path &filePath);
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const char *data() const { return bytes; }
+
+    size_t size() const { return length; }
+
+private:
+    const char *bytes = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    string buffer;
+#else
+    bool mapped = false;
+#endif
+};
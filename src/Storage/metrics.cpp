@@ -0,0 +1,284 @@
+#include "metrics.h"
+#include "catalog.h"
+#include "tableCache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+
+using namespace std;
+
+namespace {
+    // Queries longer than this are cut in the slow-query log, e.g. a large INSERT
+    const size_t SLOW_QUERY_CHARS = 4096;
+
+    const chrono::steady_clock::time_point started = chrono::steady_clock::now();
+
+    mutex registryMutex;
+    map<string, unique_ptr<Metrics::StatementStats> > statements;
+    map<pair<string, string>, unique_ptr<Metrics::TableStats> > tables; // by (database, table)
+
+    Metrics::Histogram walSyncs;
+    atomic<uint64_t> walBytes{0};
+    atomic<uint64_t> queries{0};
+    atomic<uint64_t> slowQueries{0};
+    atomic<uint64_t> slowThresholdMicros{0};
+    mutex slowLogMutex;
+
+    double rounded(double milliseconds) {
+        return round(milliseconds * 1000) / 1000;
+    }
+
+    string labelValue(const string &text) {
+        string escaped;
+        for (char c: text) {
+            if (c == '\\' || c == '"') escaped += '\\';
+            if (c == '\n') {
+                escaped += "\\n";
+                continue;
+            }
+            escaped += c;
+        }
+        return escaped;
+    }
+
+    /**
+     * @brief Writes the _bucket, _sum and _count series of a histogram in seconds
+     */
+    void writeHistogram(ostream &out, const string &name, const string &labels, const Metrics::Histogram &histogram) {
+        string prefix = labels.empty() ? "" : labels + ",";
+        uint64_t cumulative = 0;
+        for (size_t b = 0; b < Metrics::Histogram::BUCKETS; ++b) {
+            cumulative += histogram.inBucket(b);
+            out << name << "_bucket{" << prefix << "le=\"";
+            if (b + 1 < Metrics::Histogram::BUCKETS) {
+                out << Metrics::Histogram::BOUNDS[b] / 1000;
+            } else {
+                out << "+Inf";
+            }
+            out << "\"} " << cumulative << "\n";
+        }
+        string braces = labels.empty() ? "" : "{" + labels + "}";
+        out << name << "_sum" << braces << " " << histogram.sumMilliseconds() / 1000 << "\n";
+        out << name << "_count" << braces << " " << histogram.count() << "\n";
+    }
+
+    void writeHeader(ostream &out, const char *name, const char *type, const char *help) {
+        out << "# HELP " << name << " " << help << "\n# TYPE " << name << " " << type << "\n";
+    }
+}
+
+void Metrics::Histogram::record(double milliseconds) {
+    size_t bucket = lower_bound(begin(BOUNDS), end(BOUNDS), milliseconds) - begin(BOUNDS);
+    counts[bucket].fetch_add(1, memory_order_relaxed);
+    total.fetch_add(1, memory_order_relaxed);
+    sumMicros.fetch_add(static_cast<uint64_t>(max(0.0, milliseconds) * 1000 + 0.5), memory_order_relaxed);
+}
+
+/**
+ * @brief Estimates a quantile of the recorded samples.
+ *
+ * Samples are assumed to be spread evenly within their bucket, as Prometheus'
+ * histogram_quantile() does; a quantile in the last bucket is reported as its lower bound.
+ *
+ * @param q The quantile, between 0 and 1.
+ * @return The estimate in milliseconds, 0 without samples.
+ */
+double Metrics::Histogram::quantile(double q) const {
+    uint64_t samples = count();
+    if (samples == 0) {
+        return 0;
+    }
+    double rank = q * static_cast<double>(samples);
+    uint64_t below = 0;
+    for (size_t b = 0; b < BUCKETS; ++b) {
+        uint64_t here = inBucket(b);
+        if (here > 0 && static_cast<double>(below + here) >= rank) {
+            double lower = b == 0 ? 0 : BOUNDS[b - 1];
+            if (b + 1 == BUCKETS) {
+                return lower;
+            }
+            return lower + (BOUNDS[b] - lower) * (rank - static_cast<double>(below)) / static_cast<double>(here);
+        }
+        below += here;
+    }
+    return BOUNDS[BUCKETS - 2];
+}
+
+Metrics::StatementStats &Metrics::statement(const string &name) {
+    lock_guard<mutex> guard(registryMutex);
+    unique_ptr<StatementStats> &stats = statements[name];
+    if (!stats) stats = make_unique<StatementStats>();
+    return *stats;
+}
+
+Metrics::TableStats &Metrics::table(const string &database, const string &table) {
+    lock_guard<mutex> guard(registryMutex);
+    unique_ptr<TableStats> &stats = tables[{database, table}];
+    if (!stats) stats = make_unique<TableStats>();
+    return *stats;
+}
+
+Metrics::Histogram &Metrics::walSync() {
+    return walSyncs;
+}
+
+void Metrics::walWritten(uint64_t bytes) {
+    walBytes.fetch_add(bytes, memory_order_relaxed);
+}
+
+void Metrics::setSlowQueryThreshold(double milliseconds) {
+    slowThresholdMicros.store(static_cast<uint64_t>(max(0.0, milliseconds) * 1000), memory_order_relaxed);
+}
+
+/**
+ * @brief Counts a query and appends it to the slow-query log if it reached the threshold.
+ *
+ * Each line holds the UTC time the query finished, its duration and its text on one line.
+ * A log that cannot be written is skipped; the query itself already succeeded or failed.
+ *
+ * @param query The text of the query.
+ * @param milliseconds How long parsing and running it took.
+ */
+void Metrics::finishQuery(const string &query, double milliseconds) {
+    queries.fetch_add(1, memory_order_relaxed);
+    uint64_t threshold = slowThresholdMicros.load(memory_order_relaxed);
+    if (threshold == 0 || milliseconds * 1000 < static_cast<double>(threshold)) {
+        return;
+    }
+    slowQueries.fetch_add(1, memory_order_relaxed);
+
+    string text = query.substr(0, SLOW_QUERY_CHARS);
+    replace(text.begin(), text.end(), '\n', ' ');
+    replace(text.begin(), text.end(), '\r', ' ');
+    if (query.size() > SLOW_QUERY_CHARS) text += " ...";
+
+    lock_guard<mutex> guard(slowLogMutex);
+    time_t now = time(nullptr);
+    ofstream log(Catalog::root() / "slow-queries.log", ios::app);
+    log << put_time(gmtime(&now), "%Y-%m-%dT%H:%M:%SZ") << " " << fixed << setprecision(3) << milliseconds
+            << " ms " << text << "\n";
+}
+
+/**
+ * @brief Lists the metrics that are not zero, for SHOW STATS.
+ *
+ * Latencies are in milliseconds. Statement types and tables are listed by name.
+ *
+ * @return (metric, value) pairs in a fixed order.
+ */
+vector<pair<string, json> > Metrics::summary() {
+    vector<pair<string, json> > rows;
+    double uptime = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    rows.emplace_back("uptime_s", static_cast<uint64_t>(uptime));
+    rows.emplace_back("queries", queries.load(memory_order_relaxed));
+    rows.emplace_back("slow_queries", slowQueries.load(memory_order_relaxed));
+
+    auto latency = [&](const string &prefix, const Histogram &histogram) {
+        rows.emplace_back(prefix + ".mean_ms", rounded(histogram.sumMilliseconds() / histogram.count()));
+        rows.emplace_back(prefix + ".p50_ms", rounded(histogram.quantile(0.5)));
+        rows.emplace_back(prefix + ".p99_ms", rounded(histogram.quantile(0.99)));
+    };
+    {
+        lock_guard<mutex> guard(registryMutex);
+        for (const auto &[name, stats]: statements) {
+            if (stats->latency.count() == 0) continue;
+            string prefix = "statement." + name;
+            rows.emplace_back(prefix + ".count", stats->latency.count());
+            rows.emplace_back(prefix + ".errors", stats->errors.load(memory_order_relaxed));
+            latency(prefix, stats->latency);
+        }
+        for (const auto &[key, stats]: tables) {
+            string prefix = "table." + key.first + "." + key.second;
+            uint64_t read = stats->bytesRead.load(memory_order_relaxed);
+            uint64_t written = stats->bytesWritten.load(memory_order_relaxed);
+            if (read > 0) rows.emplace_back(prefix + ".bytes_read", read);
+            if (written > 0) rows.emplace_back(prefix + ".bytes_written", written);
+        }
+    }
+
+    TableCache::Stats cache = TableCache::stats();
+    if (cache.capacity > 0) {
+        rows.emplace_back("cache.hits", cache.hits);
+        rows.emplace_back("cache.misses", cache.misses);
+        uint64_t lookups = cache.hits + cache.misses;
+        rows.emplace_back("cache.hit_ratio", lookups ? rounded(static_cast<double>(cache.hits) / lookups) : 0.0);
+        rows.emplace_back("cache.bytes", cache.bytes);
+        rows.emplace_back("cache.capacity_bytes", cache.capacity);
+    }
+
+    if (walBytes.load(memory_order_relaxed) > 0) {
+        rows.emplace_back("wal.bytes_written", walBytes.load(memory_order_relaxed));
+    }
+    if (walSyncs.count() > 0) {
+        rows.emplace_back("wal.syncs", walSyncs.count());
+        latency("wal.sync", walSyncs);
+    }
+    return rows;
+}
+
+/**
+ * @brief Renders every metric in the Prometheus text exposition format (version 0.0.4).
+ *
+ * Durations are in seconds, as Prometheus expects; every statement type used so far has a
+ * latency histogram, and every table read or written a pair of byte counters.
+ */
+string Metrics::prometheus() {
+    ostringstream out;
+    writeHeader(out, "mashdb_uptime_seconds", "gauge", "Seconds since the process started.");
+    out << "mashdb_uptime_seconds " << chrono::duration<double>(chrono::steady_clock::now() - started).count()
+            << "\n";
+    writeHeader(out, "mashdb_queries_total", "counter", "Queries run, each possibly of several statements.");
+    out << "mashdb_queries_total " << queries.load(memory_order_relaxed) << "\n";
+    writeHeader(out, "mashdb_slow_queries_total", "counter", "Queries that reached the slow-query threshold.");
+    out << "mashdb_slow_queries_total " << slowQueries.load(memory_order_relaxed) << "\n";
+
+    {
+        lock_guard<mutex> guard(registryMutex);
+        writeHeader(out, "mashdb_statement_duration_seconds", "histogram", "Time to run a statement, by type.");
+        for (const auto &[name, stats]: statements) {
+            writeHistogram(out, "mashdb_statement_duration_seconds", "statement=\"" + labelValue(name) + "\"",
+                           stats->latency);
+        }
+        writeHeader(out, "mashdb_statement_errors_total", "counter", "Statements that failed, by type.");
+        for (const auto &[name, stats]: statements) {
+            out << "mashdb_statement_errors_total{statement=\"" << labelValue(name) << "\"} "
+                    << stats->errors.load(memory_order_relaxed) << "\n";
+        }
+
+        writeHeader(out, "mashdb_table_read_bytes_total", "counter", "Bytes of column files decoded, by table.");
+        for (const auto &[key, stats]: tables) {
+            out << "mashdb_table_read_bytes_total{database=\"" << labelValue(key.first) << "\",table=\""
+                    << labelValue(key.second) << "\"} " << stats->bytesRead.load(memory_order_relaxed) << "\n";
+        }
+        writeHeader(out, "mashdb_table_written_bytes_total", "counter",
+                    "Bytes of log records and rewritten column files, by table.");
+        for (const auto &[key, stats]: tables) {
+            out << "mashdb_table_written_bytes_total{database=\"" << labelValue(key.first) << "\",table=\""
+                    << labelValue(key.second) << "\"} " << stats->bytesWritten.load(memory_order_relaxed) << "\n";
+        }
+    }
+
+    TableCache::Stats cache = TableCache::stats();
+    writeHeader(out, "mashdb_cache_hits_total", "counter", "Column lookups served by the table cache.");
+    out << "mashdb_cache_hits_total " << cache.hits << "\n";
+    writeHeader(out, "mashdb_cache_misses_total", "counter", "Column lookups the table cache had to decode.");
+    out << "mashdb_cache_misses_total " << cache.misses << "\n";
+    writeHeader(out, "mashdb_cache_bytes", "gauge", "Memory held by the table cache.");
+    out << "mashdb_cache_bytes " << cache.bytes << "\n";
+    writeHeader(out, "mashdb_cache_capacity_bytes", "gauge", "Memory budget of the table cache.");
+    out << "mashdb_cache_capacity_bytes " << cache.capacity << "\n";
+
+    writeHeader(out, "mashdb_wal_written_bytes_total", "counter", "Bytes appended to write-ahead logs.");
+    out << "mashdb_wal_written_bytes_total " << walBytes.load(memory_order_relaxed) << "\n";
+    writeHeader(out, "mashdb_wal_sync_duration_seconds", "histogram", "Time of each write-ahead log sync.");
+    writeHistogram(out, "mashdb_wal_sync_duration_seconds", "", walSyncs);
+    return out.str();
+}
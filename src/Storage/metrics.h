@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+using namespace std;
+using json = nlohmann::json;
+
+/**
+ * @brief Process-wide counters for monitoring a server: statement latencies, bytes read and
+ * written per table, WAL sync latency and slow queries
+ *
+ * Counters are relaxed atomics, so recording takes no lock. Looking up the counters of a
+ * statement type or table does, once; callers on hot paths keep the returned reference,
+ * which stays valid for the lifetime of the process. The table cache keeps its own hit and
+ * miss counts (see TableCache::stats()), which the reports include.
+ */
+class Metrics {
+public:
+    /**
+     * @brief Latency histogram with fixed buckets
+     */
+    class Histogram {
+    public:
+        /**
+         * @brief Upper bounds of the buckets in milliseconds; a last one takes the rest
+         */
+        static constexpr double BOUNDS[] = {
+            0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000
+        };
+        static constexpr size_t BUCKETS = sizeof(BOUNDS) / sizeof(BOUNDS[0]) + 1;
+
+        void record(double milliseconds);
+
+        uint64_t count() const { return total.load(memory_order_relaxed); }
+
+        double sumMilliseconds() const { return static_cast<double>(sumMicros.load(memory_order_relaxed)) / 1000; }
+
+        /**
+         * @brief Number of samples in one bucket, not counting the ones below it
+         */
+        uint64_t inBucket(size_t bucket) const { return counts[bucket].load(memory_order_relaxed); }
+
+        /**
+         * @brief Estimates a quantile (0.5 for the median) by interpolating within its bucket
+         */
+        double quantile(double q) const;
+
+    private:
+        atomic<uint64_t> counts[BUCKETS] = {};
+        atomic<uint64_t> total{0};
+        atomic<uint64_t> sumMicros{0};
+    };
+
+    struct StatementStats {
+        Histogram latency;
+        atomic<uint64_t> errors{0};
+
+        void record(double milliseconds, bool failed) {
+            latency.record(milliseconds);
+            if (failed) errors.fetch_add(1, memory_order_relaxed);
+        }
+    };
+
+    struct TableStats {
+        atomic<uint64_t> bytesRead{0};    // column files decoded, segments sliced
+        atomic<uint64_t> bytesWritten{0}; // write-ahead log records, columns rewritten whole
+
+        void read(uint64_t bytes) { bytesRead.fetch_add(bytes, memory_order_relaxed); }
+
+        void written(uint64_t bytes) { bytesWritten.fetch_add(bytes, memory_order_relaxed); }
+    };
+
+    /**
+     * @brief The counters of a statement type, e.g. SELECT
+     */
+    static StatementStats &statement(const string &name);
+
+    static TableStats &table(const string &database, const string &table);
+
+    /**
+     * @brief Time of each sync of a write-ahead log
+     */
+    static Histogram &walSync();
+
+    static void walWritten(uint64_t bytes);
+
+    /**
+     * @brief Queries taking at least this long are appended to `~/.mashdb/slow-queries.log`;
+     * 0 turns the log off
+     */
+    static void setSlowQueryThreshold(double milliseconds);
+
+    /**
+     * @brief Counts a finished query, logging it if it was slow
+     */
+    static void finishQuery(const string &query, double milliseconds);
+
+    /**
+     * @brief Every metric that is not zero as (name, value) pairs, for SHOW STATS
+     */
+    static vector<pair<string, json> > summary();
+
+    /**
+     * @brief Every metric in the Prometheus text exposition format
+     */
+    static string prometheus();
+};
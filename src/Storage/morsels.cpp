@@ -0,0 +1,134 @@
+#include "morsels.h"
+#include "../Server/threadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+using namespace std;
+
+namespace {
+    atomic<size_t> threadLimit{0};
+
+    size_t hardwareThreads() {
+        return max(1u, thread::hardware_concurrency());
+    }
+
+    ThreadPool &helpers() {
+        // Created on the first parallel scan; the caller of each scan is the extra thread
+        static ThreadPool pool(max<size_t>(1, max(Morsels::maxThreads(), hardwareThreads()) - 1));
+        return pool;
+    }
+
+    /**
+     * A batch of tasks claimed one by one by the threads working on it. It is shared with the
+     * helpers, so one that only starts after the batch is done finds nothing left to claim
+     * and never touches the caller's (by then destroyed) task function.
+     */
+    struct Batch {
+        const function<void(size_t)> *task = nullptr;
+        size_t tasks = 0;
+        atomic<size_t> next{0};
+        atomic<bool> failed{false};
+
+        mutex doneMutex;
+        condition_variable allDone;
+        size_t done = 0;
+        exception_ptr error;
+
+        void work() {
+            size_t claimed;
+            while ((claimed = next++) < tasks) {
+                if (!failed) {
+                    try {
+                        (*task)(claimed);
+                    } catch (...) {
+                        lock_guard<mutex> guard(doneMutex);
+                        if (!error) error = current_exception();
+                        failed = true;
+                    }
+                }
+                lock_guard<mutex> guard(doneMutex);
+                if (++done == tasks) allDone.notify_all();
+            }
+        }
+    };
+
+    /**
+     * Runs task(0) ... task(tasks - 1) on the calling thread and up to maxThreads() - 1 helpers
+     */
+    void run(size_t tasks, const function<void(size_t)> &task) {
+        size_t threads = min(Morsels::maxThreads(), tasks);
+        if (threads <= 1) {
+            for (size_t i = 0; i < tasks; ++i) task(i);
+            return;
+        }
+
+        auto batch = make_shared<Batch>();
+        batch->task = &task;
+        batch->tasks = tasks;
+        for (size_t i = 1; i < threads; ++i) {
+            helpers().submit([batch] { batch->work(); });
+        }
+        batch->work();
+
+        unique_lock<mutex> guard(batch->doneMutex);
+        batch->allDone.wait(guard, [&] { return batch->done == batch->tasks; });
+        if (batch->error) {
+            rethrow_exception(batch->error);
+        }
+    }
+
+    size_t morselCount(size_t count) {
+        return (count + Morsels::MORSEL_ROWS - 1) / Morsels::MORSEL_ROWS;
+    }
+}
+
+namespace Morsels {
+    void setMaxThreads(size_t threads) {
+        threadLimit = threads;
+    }
+
+    size_t maxThreads() {
+        size_t limit = threadLimit;
+        return limit == 0 ? hardwareThreads() : limit;
+    }
+
+    void forEach(size_t count, const function<void(size_t first, size_t last)> &body) {
+        run(morselCount(count), [&](size_t morsel) {
+            size_t first = morsel * MORSEL_ROWS;
+            body(first, min(count, first + MORSEL_ROWS));
+        });
+    }
+
+    vector<size_t> collect(size_t count,
+                           const function<void(size_t first, size_t last, vector<size_t> &out)> &scan) {
+        size_t morsels = morselCount(count);
+        if (morsels <= 1) {
+            vector<size_t> rows;
+            scan(0, count, rows);
+            return rows;
+        }
+
+        vector<vector<size_t> > parts(morsels);
+        run(morsels, [&](size_t morsel) {
+            size_t first = morsel * MORSEL_ROWS;
+            scan(first, min(count, first + MORSEL_ROWS), parts[morsel]);
+        });
+
+        size_t total = 0;
+        for (const auto &part: parts) total += part.size();
+        vector<size_t> rows;
+        rows.reserve(total);
+        for (const auto &part: parts) rows.insert(rows.end(), part.begin(), part.end());
+        return rows;
+    }
+
+    void parallelFor(size_t tasks, const function<void(size_t task)> &task) {
+        run(tasks, task);
+    }
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @brief Morsel-driven parallelism for scans over the rows of a table
+ *
+ * A range of rows is cut into fixed-size morsels, and the calling thread plus helpers from a
+ * process-wide pool claim them one at a time from a shared cursor, so a thread that finishes
+ * early simply takes the next morsel instead of idling behind a slow one. Results are kept
+ * per morsel and combined in row order, so callers see the same output as a serial loop.
+ * Ranges of a single morsel run inline on the calling thread.
+ */
+namespace Morsels {
+    /**
+     * @brief Rows per morsel; a multiple of 64, so morsels start on a selection bitmap word
+     */
+    constexpr size_t MORSEL_ROWS = 64 * 1024;
+
+    /**
+     * @brief Caps the number of threads one scan uses, the caller included; 0 uses one per
+     * hardware thread and 1 turns parallel scans off
+     */
+    void setMaxThreads(size_t threads);
+
+    size_t maxThreads();
+
+    /**
+     * @brief Runs `body(first, last)` for every morsel of [0, count)
+     *
+     * Morsels run concurrently and in no particular order. The first exception thrown by a
+     * morsel stops the remaining ones and is rethrown once the running ones have finished.
+     */
+    void forEach(size_t count, const function<void(size_t first, size_t last)> &body);
+
+    /**
+     * @brief Runs `scan(first, last, out)` for every morsel of [0, count) and concatenates
+     * what each one appended to `out`, in morsel order
+     */
+    vector<size_t> collect(size_t count,
+                           const function<void(size_t first, size_t last, vector<size_t> &out)> &scan);
+
+    /**
+     * @brief Runs `task(0)` ... `task(tasks - 1)` concurrently, for work that is not split by rows
+     */
+    void parallelFor(size_t tasks, const function<void(size_t task)> &task);
+
+    /**
+     * @brief Sorts rows by a strict weak ordering: morsels are sorted in parallel and then
+     * merged pairwise; equal rows keep their relative order
+     *
+     * A template so the comparison inlines into the sorting loops.
+     */
+    template<typename Less>
+    void sort(vector<size_t> &rows, const Less &less) {
+        size_t count = rows.size();
+        forEach(count, [&](size_t first, size_t last) {
+            stable_sort(rows.begin() + first, rows.begin() + last, less);
+        });
+        if (count <= MORSEL_ROWS) {
+            return;
+        }
+
+        // Merge sorted runs pairwise, doubling their width each round
+        vector<size_t> buffer(count);
+        vector<size_t> *from = &rows;
+        vector<size_t> *to = &buffer;
+        for (size_t width = MORSEL_ROWS; width < count; width *= 2) {
+            parallelFor((count + 2 * width - 1) / (2 * width), [&](size_t pair) {
+                size_t first = pair * 2 * width;
+                size_t middle = min(count, first + width);
+                size_t last = min(count, first + 2 * width);
+                merge(from->begin() + first, from->begin() + middle, from->begin() + middle,
+                      from->begin() + last, to->begin() + first, less);
+            });
+            swap(from, to);
+        }
+        if (from != &rows) {
+            rows.swap(buffer);
+        }
+    }
+
+    /**
+     * @brief Reduces rows to the first `k` by a strict total order, sorted
+     *
+     * Each morsel keeps its best `k` rows in a bounded heap, and the survivors of all
+     * morsels are sorted once, which costs O(n log k) instead of sorting every row.
+     */
+    template<typename Less>
+    void topK(vector<size_t> &rows, size_t k, const Less &less) {
+        if (k >= rows.size()) {
+            sort(rows, less);
+            return;
+        }
+        vector<size_t> candidates = collect(rows.size(), [&](size_t first, size_t last, vector<size_t> &out) {
+            vector<size_t> heap; // max-heap: the worst kept row is at the front
+            heap.reserve(min(k, last - first));
+            for (size_t i = first; i < last; ++i) {
+                size_t row = rows[i];
+                if (heap.size() < k) {
+                    heap.push_back(row);
+                    push_heap(heap.begin(), heap.end(), less);
+                } else if (k > 0 && less(row, heap.front())) {
+                    pop_heap(heap.begin(), heap.end(), less);
+                    heap.back() = row;
+                    push_heap(heap.begin(), heap.end(), less);
+                }
+            }
+            out.insert(out.end(), heap.begin(), heap.end());
+        });
+        size_t kept = min(k, candidates.size());
+        partial_sort(candidates.begin(), candidates.begin() + kept, candidates.end(), less);
+        candidates.resize(kept);
+        rows = std::move(candidates);
+    }
+}
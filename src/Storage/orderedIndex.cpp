@@ -0,0 +1,314 @@
+#include "orderedIndex.h"
+#include "fileIO.h"
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+
+using namespace std;
+using json = nlohmann::json;
+namespace fs = filesystem;
+
+/*
+ * Index file layout, in PAGE_SIZE pages:
+ *
+ *   page 0              Header
+ *   pages 1..leafPages  leaves: PageHeader + Entry[count], all full except the last
+ *   following pages     internal levels bottom-up: PageHeader + Separator[count]; root last
+ *   keysOffset          text keys as (uint32 length, bytes), referenced by Entry::ref
+ *
+ * Entry::bits is an order-preserving encoding of the value, so most comparisons never look
+ * at the keys area: integers and floats are mapped to unsigned integers with the same order,
+ * and text uses its first eight bytes big-endian. NULL entries have ref == NULL_REF.
+ */
+namespace {
+    const char INDEX_MAGIC[4] = {'M', 'B', 'I', 'X'};
+    const uint16_t INDEX_VERSION = 1;
+    const uint32_t PAGE_SIZE = 4096;
+    const uint64_t NULL_REF = UINT64_MAX;
+    const size_t LEAF_ENTRIES = (PAGE_SIZE - sizeof(OrderedIndex::PageHeader)) / sizeof(OrderedIndex::Entry);
+    const size_t INTERNAL_ENTRIES =
+            (PAGE_SIZE - sizeof(OrderedIndex::PageHeader)) / sizeof(OrderedIndex::Separator);
+
+    uint64_t intBits(int64_t value) {
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return bits ^ (1ull << 63);
+    }
+
+    uint64_t floatBits(double value) {
+        if (value == 0.0) value = 0.0; // -0.0 and 0.0 are the same value
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return (bits >> 63) ? ~bits : bits | (1ull << 63);
+    }
+
+    uint64_t textBits(const string &text) {
+        uint64_t bits = 0;
+        for (size_t i = 0; i < 8; ++i) {
+            bits <<= 8;
+            if (i < text.size()) bits |= static_cast<unsigned char>(text[i]);
+        }
+        return bits;
+    }
+
+    void writePage(ofstream &out, uint32_t level, const void *items, size_t count, size_t itemSize) {
+        vector<char> buffer(PAGE_SIZE, 0);
+        OrderedIndex::PageHeader pageHeader{static_cast<uint32_t>(count), level};
+        memcpy(buffer.data(), &pageHeader, sizeof(pageHeader));
+        memcpy(buffer.data() + sizeof(pageHeader), items, count * itemSize);
+        out.write(buffer.data(), PAGE_SIZE);
+    }
+}
+
+OrderedIndex::OrderedIndex(fs::path filePath, ColumnType columnType)
+    : path(std::move(filePath)), type(columnType), page(PAGE_SIZE) {
+    file.open(path, ios::binary);
+    if (!file.is_open()) {
+        throw runtime_error("Failed to open index file: " + path.string());
+    }
+
+    uintmax_t fileSize = fs::file_size(path);
+    if (!file.read(reinterpret_cast<char *>(&header), sizeof(Header)) ||
+        memcmp(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 || header.version != INDEX_VERSION ||
+        header.type != static_cast<uint8_t>(type) || header.pageSize != PAGE_SIZE ||
+        header.leafPages != (header.entries + LEAF_ENTRIES - 1) / LEAF_ENTRIES ||
+        header.keysOffset + header.keysSize > fileSize) {
+        throw runtime_error("Corrupt index file: " + path.string());
+    }
+}
+
+/**
+ * @brief Bulk-loads an index from a column.
+ *
+ * The rows are sorted once, written as filled leaves, and the internal levels are built on
+ * top of them. The file is written under a temporary name and renamed into place, so a
+ * crash leaves either the old or the new index.
+ *
+ * @param filePath Path of the index file.
+ * @param column The complete column to index.
+ * @throws std::runtime_error If the file cannot be written.
+ */
+void OrderedIndex::build(const fs::path &filePath, const Column &column) {
+    vector<size_t> order(column.size());
+    iota(order.begin(), order.end(), 0);
+    stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return column.less(a, b); });
+
+    Header fresh{};
+    memcpy(fresh.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    fresh.version = INDEX_VERSION;
+    fresh.type = static_cast<uint8_t>(column.type);
+    fresh.pageSize = PAGE_SIZE;
+    fresh.coveredRows = column.size();
+    fresh.entries = order.size();
+
+    vector<Entry> entries;
+    entries.reserve(order.size());
+    string keys;
+    for (size_t row: order) {
+        Entry entry{0, 0, row};
+        if (column.isNull(row)) {
+            entry.ref = NULL_REF;
+            ++fresh.nullCount;
+        } else {
+            switch (column.type) {
+                case ColumnType::Integer:
+                    entry.bits = intBits(column.ints[row]);
+                    break;
+                case ColumnType::Float:
+                    entry.bits = floatBits(column.floats[row]);
+                    break;
+                case ColumnType::Boolean:
+                    entry.bits = column.bools[row] ? 1 : 0;
+                    break;
+                case ColumnType::Text: {
+                    const string &text = column.texts[row];
+                    auto length = static_cast<uint32_t>(text.size());
+                    entry.bits = textBits(text);
+                    entry.ref = keys.size();
+                    keys.append(reinterpret_cast<const char *>(&length), sizeof(length));
+                    keys.append(text);
+                    break;
+                }
+            }
+        }
+        entries.push_back(entry);
+    }
+
+    fs::create_directories(filePath.parent_path());
+    // Readers may rebuild a stale index concurrently; each writes its own temporary
+    fs::path tempPath = FileIO::temporaryPath(filePath);
+    ofstream out(tempPath, ios::binary | ios::trunc);
+    if (!out) {
+        throw runtime_error("Failed to create index file: " + filePath.string());
+    }
+    out.write(vector<char>(PAGE_SIZE, 0).data(), PAGE_SIZE);
+
+    uint64_t nextPage = 1;
+    vector<Separator> level;
+    for (size_t first = 0; first < entries.size(); first += LEAF_ENTRIES) {
+        size_t count = min(LEAF_ENTRIES, entries.size() - first);
+        writePage(out, 0, &entries[first], count, sizeof(Entry));
+        level.push_back(Separator{entries[first], nextPage++});
+    }
+    fresh.leafPages = level.size();
+    fresh.height = level.empty() ? 0 : 1;
+
+    while (level.size() > 1) {
+        vector<Separator> parents;
+        for (size_t first = 0; first < level.size(); first += INTERNAL_ENTRIES) {
+            size_t count = min(INTERNAL_ENTRIES, level.size() - first);
+            writePage(out, fresh.height, &level[first], count, sizeof(Separator));
+            parents.push_back(Separator{level[first].first, nextPage++});
+        }
+        level = std::move(parents);
+        ++fresh.height;
+    }
+    fresh.rootPage = level.empty() ? 0 : level[0].child;
+    fresh.keysOffset = nextPage * PAGE_SIZE;
+    fresh.keysSize = keys.size();
+    out.write(keys.data(), static_cast<streamsize>(keys.size()));
+
+    out.seekp(0);
+    out.write(reinterpret_cast<const char *>(&fresh), sizeof(Header));
+    out.close();
+    if (!out) {
+        fs::remove(tempPath);
+        throw runtime_error("Failed to write index file: " + filePath.string());
+    }
+    fs::rename(tempPath, filePath);
+}
+
+OrderedIndex::Key OrderedIndex::keyOf(const json &value) const {
+    Key key;
+    switch (type) {
+        case ColumnType::Integer:
+            key.bits = intBits(value.get<int64_t>());
+            break;
+        case ColumnType::Float:
+            key.bits = floatBits(value.get<double>());
+            break;
+        case ColumnType::Boolean:
+            key.bits = value.get<bool>() ? 1 : 0;
+            break;
+        case ColumnType::Text:
+            key.text = value.get<string>();
+            key.bits = textBits(key.text);
+            break;
+    }
+    return key;
+}
+
+string OrderedIndex::textAt(uint64_t ref) {
+    uint32_t length = 0;
+    file.clear();
+    file.seekg(static_cast<streamoff>(header.keysOffset + ref));
+    file.read(reinterpret_cast<char *>(&length), sizeof(length));
+    string text(length, '\0');
+    if (!file.read(text.data(), length)) {
+        throw runtime_error("Corrupt index file: " + path.string());
+    }
+    return text;
+}
+
+int OrderedIndex::compare(const Entry &entry, const Key &key) {
+    if (entry.ref == NULL_REF) {
+        return -1;
+    }
+    if (entry.bits != key.bits) {
+        return entry.bits < key.bits ? -1 : 1;
+    }
+    if (type != ColumnType::Text) {
+        return 0;
+    }
+    int result = textAt(entry.ref).compare(key.text);
+    return result < 0 ? -1 : (result > 0 ? 1 : 0);
+}
+
+const char *OrderedIndex::loadPage(uint64_t pageNumber) {
+    if (cachedPage != pageNumber) {
+        file.clear();
+        file.seekg(static_cast<streamoff>(pageNumber * PAGE_SIZE));
+        if (!file.read(page.data(), PAGE_SIZE)) {
+            cachedPage = 0;
+            throw runtime_error("Corrupt index file: " + path.string());
+        }
+        cachedPage = pageNumber;
+    }
+    return page.data();
+}
+
+size_t OrderedIndex::lowerBound(const Key &key, bool inclusive) {
+    if (header.entries == 0) {
+        return 0;
+    }
+    auto satisfies = [&](const Entry &entry) {
+        int result = compare(entry, key);
+        return inclusive ? result >= 0 : result > 0;
+    };
+
+    uint64_t pageNumber = header.rootPage;
+    for (uint32_t level = header.height; level > 1; --level) {
+        const char *data = loadPage(pageNumber);
+        PageHeader pageHeader;
+        memcpy(&pageHeader, data, sizeof(pageHeader));
+        vector<Separator> separators(pageHeader.count);
+        memcpy(separators.data(), data + sizeof(pageHeader), pageHeader.count * sizeof(Separator));
+
+        // The last child whose first entry is still before the key holds the boundary
+        auto it = partition_point(separators.begin(), separators.end(),
+                                  [&](const Separator &separator) { return !satisfies(separator.first); });
+        pageNumber = (it == separators.begin() ? it : prev(it))->child;
+    }
+
+    const char *data = loadPage(pageNumber);
+    PageHeader pageHeader;
+    memcpy(&pageHeader, data, sizeof(pageHeader));
+    vector<Entry> entries(pageHeader.count);
+    memcpy(entries.data(), data + sizeof(pageHeader), pageHeader.count * sizeof(Entry));
+    auto it = partition_point(entries.begin(), entries.end(),
+                              [&](const Entry &entry) { return !satisfies(entry); });
+    return (pageNumber - 1) * LEAF_ENTRIES + static_cast<size_t>(it - entries.begin());
+}
+
+/**
+ * @brief Finds the run of entries with keys between two bounds.
+ *
+ * NULL entries are never part of the result; a missing bound leaves that side open.
+ *
+ * @param lower The lower bound, if any.
+ * @param upper The upper bound, if any.
+ * @return The positions [first, last) of the matching entries, in key order.
+ */
+pair<size_t, size_t> OrderedIndex::range(const optional<Bound> &lower, const optional<Bound> &upper) {
+    size_t first = lower ? lowerBound(keyOf(lower->value), lower->inclusive) : header.nullCount;
+    size_t last = upper ? lowerBound(keyOf(upper->value), !upper->inclusive) : header.entries;
+    first = max<size_t>(first, header.nullCount);
+    return {first, max(first, last)};
+}
+
+OrderedIndex::Entry OrderedIndex::entryAt(size_t position) {
+    if (position >= header.entries) {
+        throw out_of_range("Index position out of range");
+    }
+    const char *data = loadPage(1 + position / LEAF_ENTRIES);
+    Entry entry;
+    memcpy(&entry, data + sizeof(PageHeader) + (position % LEAF_ENTRIES) * sizeof(Entry), sizeof(Entry));
+    return entry;
+}
+
+size_t OrderedIndex::rowAt(size_t position) {
+    return entryAt(position).row;
+}
+
+bool OrderedIndex::sameKey(size_t a, size_t b) {
+    Entry first = entryAt(a);
+    Entry second = entryAt(b);
+    if (first.ref == NULL_REF || second.ref == NULL_REF) {
+        return first.ref == second.ref;
+    }
+    if (first.bits != second.bits) {
+        return false;
+    }
+    return type != ColumnType::Text || textAt(first.ref) == textAt(second.ref);
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "columnStore.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+using namespace std;
+using json = nlohmann::json;
+
+/**
+ * @brief Persistent B+-tree over the values of a column, created with CREATE INDEX
+ *
+ * The tree is bulk-loaded from the column in one pass: leaves hold (key, row) entries in
+ * column order (NULL first, ties by row) and are stored contiguously and completely filled,
+ * so an entry is addressed by its position in that order. Internal pages hold the first key
+ * of each child. A lookup reads one page per level; a range is then a run of positions that
+ * is read leaf by leaf.
+ *
+ * The index covers the first coveredRows() rows of the table. Rows appended later are not
+ * in the tree and must be checked by the caller until the index is rebuilt.
+ */
+class OrderedIndex {
+public:
+    /**
+     * @brief One end of a key range
+     */
+    struct Bound {
+        json value;
+        bool inclusive = true;
+    };
+
+    /**
+     * @brief Opens an existing index file
+     * @throws std::runtime_error if the file is missing or corrupt
+     */
+    OrderedIndex(filesystem::path filePath, ColumnType type);
+
+    /**
+     * @brief Writes an index over the given column, replacing the file atomically
+     */
+    static void build(const filesystem::path &filePath, const Column &column);
+
+    size_t coveredRows() const { return header.coveredRows; }
+
+    /**
+     * @brief Number of entries, including NULL rows
+     */
+    size_t size() const { return header.entries; }
+
+    /**
+     * @brief Number of NULL rows; they occupy positions [0, nullCount())
+     */
+    size_t nullCount() const { return header.nullCount; }
+
+    /**
+     * @brief Returns the positions [first, last) of the non-NULL entries between two bounds
+     */
+    pair<size_t, size_t> range(const optional<Bound> &lower, const optional<Bound> &upper);
+
+    /**
+     * @brief Returns the row stored at a position of the index
+     */
+    size_t rowAt(size_t position);
+
+    /**
+     * @brief Whether the entries at two positions hold the same key; NULL equals NULL
+     */
+    bool sameKey(size_t a, size_t b);
+
+#pragma pack(push, 1)
+    struct Header {
+        char magic[4];
+        uint16_t version;
+        uint8_t type;
+        uint8_t reserved;
+        uint32_t pageSize;
+        uint32_t height;
+        uint64_t coveredRows;
+        uint64_t entries;
+        uint64_t nullCount;
+        uint64_t rootPage;
+        uint64_t leafPages;
+        uint64_t keysOffset;
+        uint64_t keysSize;
+    };
+
+    struct PageHeader {
+        uint32_t count;
+        uint32_t level;
+    };
+
+    struct Entry {
+        uint64_t bits;
+        uint64_t ref;
+        uint64_t row;
+    };
+
+    struct Separator {
+        Entry first;
+        uint64_t child;
+    };
+#pragma pack(pop)
+
+private:
+    filesystem::path path;
+    ColumnType type;
+    Header header{};
+    ifstream file;
+    uint64_t cachedPage = 0;
+    vector<char> page;
+
+    struct Key {
+        uint64_t bits = 0;
+        string text;
+    };
+
+    Key keyOf(const json &value) const;
+
+    int compare(const Entry &entry, const Key &key);
+
+    string textAt(uint64_t ref);
+
+    const char *loadPage(uint64_t pageNumber);
+
+    Entry entryAt(size_t position);
+
+    /**
+     * @brief Position of the first non-NULL entry whose key is >= key (> key if !inclusive)
+     */
+    size_t lowerBound(const Key &key, bool inclusive);
+};
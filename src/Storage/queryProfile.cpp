@@ -0,0 +1,124 @@
+#include "queryProfile.h"
+
+#include <utility>
+
+using namespace std;
+
+namespace {
+    thread_local QueryProfile *activeProfile = nullptr;
+
+    double millisecondsBetween(chrono::steady_clock::time_point from, chrono::steady_clock::time_point to) {
+        return chrono::duration<double, milli>(to - from).count();
+    }
+}
+
+/**
+ * @brief Starts charging time to a phase, pausing the timer that was running on this thread.
+ *
+ * Does nothing when no profile is current, which is the case on morsel threads too.
+ */
+QueryProfile::Timer::Timer(Phase phase) : profile(activeProfile), phase(phase) {
+    if (!profile) {
+        return;
+    }
+    constructed = resumed = chrono::steady_clock::now();
+    outer = profile->active;
+    if (outer) {
+        profile->add(outer->phase, millisecondsBetween(outer->resumed, constructed));
+    }
+    profile->active = this;
+}
+
+QueryProfile::Timer::~Timer() {
+    if (!profile) {
+        return;
+    }
+    auto now = chrono::steady_clock::now();
+    profile->add(phase, millisecondsBetween(resumed, now));
+    profile->active = outer;
+    if (outer) {
+        outer->resumed = now;
+    }
+}
+
+double QueryProfile::Timer::milliseconds() const {
+    return profile ? millisecondsBetween(constructed, chrono::steady_clock::now()) : 0;
+}
+
+QueryProfile::Scope::Scope(QueryProfile &profile) : outer(activeProfile) {
+    activeProfile = &profile;
+}
+
+QueryProfile::Scope::~Scope() {
+    activeProfile = outer;
+}
+
+QueryProfile *QueryProfile::current() {
+    return activeProfile;
+}
+
+bool QueryProfile::planning() {
+    return activeProfile && !activeProfile->analyzing;
+}
+
+void QueryProfile::beginTable(const string &table, size_t rows, size_t deleted) {
+    if (!activeProfile) return;
+    TableAccess access;
+    access.table = table;
+    access.rows = rows;
+    access.deleted = deleted;
+    activeProfile->accessed.push_back(std::move(access));
+    activeProfile->filteringJoin = false;
+}
+
+void QueryProfile::setAccess(const string &access) {
+    if (!activeProfile || activeProfile->accessed.empty()) return;
+    activeProfile->accessed.back().access = access;
+}
+
+void QueryProfile::setMatched(size_t rows) {
+    if (!activeProfile || activeProfile->accessed.empty() || !activeProfile->analyzing) return;
+    activeProfile->accessed.back().matched = rows;
+}
+
+void QueryProfile::beginJoinFilter(const string &join) {
+    if (!activeProfile) return;
+    activeProfile->joined = join;
+    activeProfile->filteringJoin = true;
+}
+
+void QueryProfile::addFilter(FilterStep step) {
+    if (!activeProfile) return;
+    if (activeProfile->filteringJoin || activeProfile->accessed.empty()) {
+        activeProfile->joinSteps.push_back(std::move(step));
+    } else {
+        activeProfile->accessed.back().filters.push_back(std::move(step));
+    }
+}
+
+/**
+ * @brief Adds a read of a column to the entry for the same column and kind of read.
+ */
+void QueryProfile::readColumn(const string &table, const string &column, const char *how, size_t rows,
+                              double milliseconds) {
+    if (!activeProfile) return;
+    for (auto &read: activeProfile->reads) {
+        if (read.table == table && read.column == column && read.how == how) {
+            ++read.reads;
+            read.rows += rows;
+            read.milliseconds += milliseconds;
+            return;
+        }
+    }
+    activeProfile->reads.push_back(ColumnRead{table, column, how, 1, rows, milliseconds});
+}
+
+void QueryProfile::setOrder(const string &order) {
+    if (!activeProfile) return;
+    activeProfile->ordering = order;
+}
+
+void QueryProfile::setResult(size_t rows) {
+    if (!activeProfile || !activeProfile->analyzing) return;
+    activeProfile->resultRows = rows;
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @brief What one statement did and where its time went, collected for EXPLAIN
+ *
+ * A Scope makes a profile current on its thread. The storage layer, the WHERE evaluation and
+ * the operations record into the current profile and skip all of it when there is none, so
+ * other statements pay one thread-local read per event. Work that morsels run on other
+ * threads is timed as a whole by the thread waiting for it.
+ *
+ * A profile that does not analyze is only planned: the operations record how they would
+ * find their rows and return before reading or changing any.
+ */
+class QueryProfile {
+public:
+    enum class Phase { Parse, Load, Filter, Join, Aggregate, Sort, Project, Format, Write, Count };
+
+    /**
+     * @brief One condition of a WHERE clause, in the order they were evaluated
+     */
+    struct FilterStep {
+        string condition;
+        string access;               // how its rows were found
+        size_t segments = 0;         // zone-mapped segments of its column
+        size_t skippedSegments = 0;  // ruled out by their zone maps
+        optional<size_t> rowsChecked;
+        optional<size_t> rowsMatched;
+        double milliseconds = 0;
+    };
+
+    /**
+     * @brief How the rows of one table were found
+     */
+    struct TableAccess {
+        string table;
+        size_t rows = 0;    // deleted rows included
+        size_t deleted = 0;
+        string access;      // set when not implied by the filters
+        vector<FilterStep> filters;
+        optional<size_t> matched;
+    };
+
+    /**
+     * @brief The reads of one column of a table, by how they were served
+     */
+    struct ColumnRead {
+        string table;
+        string column;
+        string how; // decoded, cached, mapped or sliced
+        size_t reads = 0;
+        size_t rows = 0;
+        double milliseconds = 0;
+    };
+
+    /**
+     * @brief Charges the time until destruction to a phase of the current profile, minus the
+     * time of timers started meanwhile
+     */
+    class Timer {
+    public:
+        explicit Timer(Phase phase);
+
+        ~Timer();
+
+        Timer(const Timer &) = delete;
+
+        Timer &operator=(const Timer &) = delete;
+
+        /**
+         * @brief Milliseconds since construction, nested timers included
+         */
+        double milliseconds() const;
+
+    private:
+        QueryProfile *profile;
+        Phase phase;
+        Timer *outer = nullptr;
+        chrono::steady_clock::time_point constructed;
+        chrono::steady_clock::time_point resumed;
+
+        friend class QueryProfile;
+    };
+
+    /**
+     * @brief Makes a profile current on this thread until destruction; scopes nest
+     */
+    class Scope {
+    public:
+        explicit Scope(QueryProfile &profile);
+
+        ~Scope();
+
+        Scope(const Scope &) = delete;
+
+        Scope &operator=(const Scope &) = delete;
+
+    private:
+        QueryProfile *outer;
+    };
+
+    explicit QueryProfile(bool analyze) : analyzing(analyze) {}
+
+    /**
+     * @brief The profile of this thread's statement, or nullptr outside EXPLAIN
+     */
+    static QueryProfile *current();
+
+    /**
+     * @brief Whether this thread's statement is only planned, so it must not read its rows
+     */
+    static bool planning();
+
+    /**
+     * @brief Starts the access of a table; the conditions evaluated next belong to it
+     */
+    static void beginTable(const string &table, size_t rows, size_t deleted);
+
+    /**
+     * @brief Sets how the current table's rows are found, when the filters do not tell
+     */
+    static void setAccess(const string &access);
+
+    /**
+     * @brief Records the rows of the current table left after its WHERE conditions
+     */
+    static void setMatched(size_t rows);
+
+    /**
+     * @brief Sends the conditions evaluated next to the joined rows instead of a table
+     */
+    static void beginJoinFilter(const string &join);
+
+    static void addFilter(FilterStep step);
+
+    static void readColumn(const string &table, const string &column, const char *how, size_t rows,
+                           double milliseconds);
+
+    static void setOrder(const string &order);
+
+    /**
+     * @brief Records the rows the statement returned, or changed for UPDATE and DELETE
+     */
+    static void setResult(size_t rows);
+
+    bool analyze() const { return analyzing; }
+
+    const vector<TableAccess> &tables() const { return accessed; }
+
+    const string &join() const { return joined; }
+
+    const vector<FilterStep> &joinFilters() const { return joinSteps; }
+
+    const vector<ColumnRead> &columns() const { return reads; }
+
+    const string &order() const { return ordering; }
+
+    const optional<size_t> &result() const { return resultRows; }
+
+    double milliseconds(Phase phase) const { return phases[static_cast<size_t>(phase)]; }
+
+    void add(Phase phase, double milliseconds) { phases[static_cast<size_t>(phase)] += milliseconds; }
+
+private:
+    bool analyzing;
+    vector<TableAccess> accessed;
+    string joined;
+    vector<FilterStep> joinSteps;
+    bool filteringJoin = false;
+    vector<ColumnRead> reads;
+    string ordering;
+    optional<size_t> resultRows;
+    double phases[static_cast<size_t>(Phase::Count)] = {};
+    Timer *active = nullptr;
+};
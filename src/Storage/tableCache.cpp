@@ -0,0 +1,170 @@
+#include "tableCache.h"
+#include "fileIO.h"
+
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+using namespace std;
+namespace fs = filesystem;
+using FileIO::FileStamp;
+using FileIO::stampOf;
+
+namespace {
+    vector<FileStamp> stampsOf(const vector<fs::path> &files) {
+        vector<FileStamp> stamps;
+        stamps.reserve(files.size());
+        for (const auto &file: files) {
+            stamps.push_back(stampOf(file));
+        }
+        return stamps;
+    }
+
+    size_t bytesOf(const Column &column) {
+        size_t bytes = sizeof(Column) + column.nulls.capacity() + column.bools.capacity() +
+                       column.ints.capacity() * sizeof(int64_t) + column.floats.capacity() * sizeof(double) +
+                       column.texts.capacity() * sizeof(string) + column.codes.capacity() * sizeof(uint32_t);
+        for (const auto &text: column.texts) {
+            if (text.capacity() > sizeof(string)) bytes += text.capacity();
+        }
+        if (column.dictionary) {
+            // Each value is held twice, once as a key of `codes`
+            for (const auto &value: column.dictionary->values) bytes += 2 * (sizeof(string) + value.size());
+        }
+        return bytes;
+    }
+
+    struct Entry {
+        string key;
+        vector<FileStamp> stamps;
+        shared_ptr<const Column> column;
+        size_t bytes = 0;
+    };
+
+    mutex cacheMutex;
+    size_t capacity = 0;
+    size_t usedBytes = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    list<Entry> entries; // most recently used first
+    unordered_map<string, list<Entry>::iterator> byKey;
+
+    void evictOverCapacity() {
+        while (usedBytes > capacity && !entries.empty()) {
+            usedBytes -= entries.back().bytes;
+            byKey.erase(entries.back().key);
+            entries.pop_back();
+        }
+    }
+
+    void erase(const string &key) {
+        auto it = byKey.find(key);
+        if (it != byKey.end()) {
+            usedBytes -= it->second->bytes;
+            entries.erase(it->second);
+            byKey.erase(it);
+        }
+    }
+
+    /**
+     * Returns the cached entry for the key if its files did not change, moving it to the front
+     */
+    const Entry *lookup(const string &key, const vector<FileStamp> &stamps) {
+        auto it = byKey.find(key);
+        if (it == byKey.end() || !(it->second->stamps == stamps)) {
+            ++misses;
+            return nullptr;
+        }
+        ++hits;
+        entries.splice(entries.begin(), entries, it->second);
+        return &entries.front();
+    }
+
+    void store(Entry entry) {
+        erase(entry.key);
+        if (entry.bytes > capacity) {
+            return;
+        }
+        usedBytes += entry.bytes;
+        entries.push_front(std::move(entry));
+        byKey[entries.front().key] = entries.begin();
+        evictOverCapacity();
+    }
+}
+
+void TableCache::configure(size_t capacityBytes) {
+    lock_guard<mutex> lock(cacheMutex);
+    capacity = capacityBytes;
+    evictOverCapacity();
+}
+
+bool TableCache::enabled() {
+    lock_guard<mutex> lock(cacheMutex);
+    return capacity > 0;
+}
+
+/**
+ * @brief Looks up a column, loading and caching it on a miss.
+ *
+ * The files are stamped before loading, so a write that races with the load leaves an
+ * entry that no longer matches and is reloaded on the next lookup.
+ *
+ * @param sources The files the column is read from: its column file and the insert log.
+ * @param load Loads the column; called without holding the cache lock.
+ * @return The column, shared with the cache.
+ * @throws std::runtime_error Whatever `load` throws.
+ */
+shared_ptr<const Column> TableCache::column(const vector<fs::path> &sources, const function<Column()> &load) {
+    string key = "column:" + sources.front().string();
+    vector<FileStamp> stamps = stampsOf(sources);
+    bool caching;
+    {
+        lock_guard<mutex> lock(cacheMutex);
+        caching = capacity > 0;
+        if (caching) {
+            if (const Entry *entry = lookup(key, stamps)) {
+                return entry->column;
+            }
+        }
+    }
+
+    // Loaded unlocked, so several threads can decode columns at once
+    auto loaded = make_shared<const Column>(load());
+    if (!caching) {
+        return loaded;
+    }
+    Entry entry;
+    entry.key = key;
+    entry.stamps = std::move(stamps);
+    entry.column = loaded;
+    entry.bytes = bytesOf(*loaded);
+
+    lock_guard<mutex> lock(cacheMutex);
+    store(std::move(entry));
+    return loaded;
+}
+
+TableCache::Stats TableCache::stats() {
+    lock_guard<mutex> lock(cacheMutex);
+    Stats current;
+    current.hits = hits;
+    current.misses = misses;
+    current.entries = entries.size();
+    current.bytes = usedBytes;
+    current.capacity = capacity;
+    return current;
+}
+
+void TableCache::clear() {
+    lock_guard<mutex> lock(cacheMutex);
+    entries.clear();
+    byKey.clear();
+    usedBytes = 0;
+}
+
+void TableCache::forget(const fs::path &columnFile) {
+    lock_guard<mutex> lock(cacheMutex);
+    erase("column:" + columnFile.string());
+}
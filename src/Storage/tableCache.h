@@ -0,0 +1,58 @@
+#pragma once
+
+#include "columnStore.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+using namespace std;
+using json = nlohmann::json;
+
+/**
+ * @brief Process-wide LRU cache of decoded columns
+ *
+ * Entries are keyed by file path and remember the modification time, size and inode of the
+ * files they were read from, so a rewrite by this or any other process is noticed on the
+ * next lookup. The cache is off (capacity 0) unless configured, which is what the one-shot
+ * command line wants; the server turns it on.
+ */
+class TableCache {
+public:
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        size_t entries = 0;
+        size_t bytes = 0;
+        size_t capacity = 0;
+    };
+
+    /**
+     * @brief Sets the memory budget in bytes, evicting entries over it; 0 disables the cache
+     */
+    static void configure(size_t capacityBytes);
+
+    static bool enabled();
+
+    /**
+     * @brief Returns a column, loading it with `load` unless a current copy is cached
+     *
+     * @param sources The files the column is built from; the entry is reused only while none
+     * of them changed
+     */
+    static shared_ptr<const Column> column(const vector<filesystem::path> &sources,
+                                           const function<Column()> &load);
+
+    static Stats stats();
+
+    static void clear();
+
+    /**
+     * @brief Drops the cached column read from a column file, for writers that change the
+     * file without changing its size or inode
+     */
+    static void forget(const filesystem::path &columnFile);
+};
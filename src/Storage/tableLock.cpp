@@ -0,0 +1,96 @@
+#include "tableLock.h"
+#include "catalog.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+namespace fs = filesystem;
+
+namespace {
+    mutex registryMutex;
+    unordered_map<string, shared_ptr<shared_mutex> > latches;
+
+    shared_ptr<shared_mutex> latchFor(const string &key) {
+        lock_guard<mutex> guard(registryMutex);
+        shared_ptr<shared_mutex> &latch = latches[key];
+        if (!latch) {
+            latch = make_shared<shared_mutex>();
+        }
+        return latch;
+    }
+}
+
+/**
+ * @brief Locks a table, first against the other threads of this process, then against other processes.
+ *
+ * The lock file lives next to the table directory rather than inside it, so CREATE TABLE can
+ * lock a table that does not exist yet. Nothing is locked across processes if the database
+ * directory is missing; the statement fails on its own in that case.
+ *
+ * @param database The database holding the table.
+ * @param table The name of the table.
+ * @param mode Shared for statements that only read the table, Exclusive for ones that change it.
+ * @throws std::runtime_error If the lock file cannot be opened or locked.
+ */
+TableLock::TableLock(const string &database, const string &table, Mode mode)
+    : latch(latchFor(database + "/" + table)), mode(mode) {
+    if (mode == Mode::Shared) {
+        latch->lock_shared();
+    } else {
+        latch->lock();
+    }
+
+#ifndef _WIN32
+    if (database.empty()) {
+        return;
+    }
+
+    // A database that does not exist has nothing to lock; the statement reports it
+    fs::path lockPath = Catalog::databaseDir(database) / (table + ".lock");
+    fileHandle = open(lockPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fileHandle < 0 && errno == ENOENT) {
+        return;
+    }
+    int status = fileHandle < 0 ? -1 : 0;
+    if (status == 0) {
+        while ((status = flock(fileHandle, mode == Mode::Shared ? LOCK_SH : LOCK_EX)) != 0 && errno == EINTR) {
+        }
+    }
+    if (status != 0) {
+        string reason = strerror(errno);
+        if (fileHandle >= 0) close(fileHandle);
+        if (mode == Mode::Shared) {
+            latch->unlock_shared();
+        } else {
+            latch->unlock();
+        }
+        throw runtime_error("Failed to lock table " + table + ": " + reason);
+    }
+#endif
+}
+
+TableLock::~TableLock() {
+#ifndef _WIN32
+    if (fileHandle >= 0) {
+        // Closing the descriptor releases the flock
+        close(fileHandle);
+    }
+#endif
+    if (mode == Mode::Shared) {
+        latch->unlock_shared();
+    } else {
+        latch->unlock();
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <memory>
+#include <shared_mutex>
+#include <string>
+
+using namespace std;
+
+/**
+ * @brief Reader/writer lock on one table, held for the duration of a statement
+ *
+ * Readers share the table and a writer has it to itself. Within a process the lock is a
+ * shared_mutex per table, so server workers wait for each other without touching the disk;
+ * across processes it is an flock() on `<database>/<table>.lock`, so a command line INSERT
+ * and a server UPDATE of the same table are serialized as well (not on Windows).
+ */
+class TableLock {
+public:
+    enum class Mode { Shared, Exclusive };
+
+    /**
+     * @brief Blocks until the table is locked in the given mode
+     */
+    TableLock(const string &database, const string &table, Mode mode);
+
+    ~TableLock();
+
+    TableLock(const TableLock &) = delete;
+
+    TableLock &operator=(const TableLock &) = delete;
+
+private:
+    shared_ptr<shared_mutex> latch;
+    Mode mode;
+    int fileHandle = -1;
+};
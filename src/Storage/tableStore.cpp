@@ -0,0 +1,972 @@
+#include "tableStore.h"
+#include "fileIO.h"
+#include "morsels.h"
+#include "queryProfile.h"
+#include "tableCache.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_set>
+
+using namespace std;
+using json = nlohmann::json;
+namespace fs = filesystem;
+
+namespace {
+    thread_local TableStore::Journal *activeJournal = nullptr;
+
+    vector<string> columnNamesOf(const json &tableInfo) {
+        vector<string> names;
+        for (auto &el: tableInfo.items()) {
+            names.push_back(el.key());
+        }
+        return names;
+    }
+
+    /**
+     * @brief The size of a file, 0 if it cannot be read
+     */
+    uintmax_t fileBytes(const fs::path &file) {
+        error_code ignored;
+        uintmax_t bytes = fs::file_size(file, ignored);
+        return ignored ? 0 : bytes;
+    }
+}
+
+TableStore::TableStore(fs::path tablePath, json info)
+    : path(std::move(tablePath)),
+      metrics(&Metrics::table(path.parent_path().filename().string(), path.filename().string())),
+      tableInfo(std::move(info)),
+      columns(columnNamesOf(tableInfo)),
+      log(path / "insert.log", columns.size()) {
+}
+
+TableStore::TableStore(const TableSchema &schema) : TableStore(schema.directory, *schema.info) {
+}
+
+fs::path TableStore::columnsDir() const {
+    return path / "Columns";
+}
+
+ColumnType TableStore::columnType(const string &column) const {
+    if (!tableInfo.contains(column)) {
+        throw runtime_error("Column doesn't exist: " + column);
+    }
+    return ColumnStore::typeFromName(tableInfo[column]["type"].get<string>());
+}
+
+bool TableStore::isUnique(const string &column) const {
+    return tableInfo.contains(column) && tableInfo[column].value("isUnique", false);
+}
+
+fs::path TableStore::stagingPath(const string &column) const {
+    fs::path staged = ColumnStore::columnPath(columnsDir(), column);
+    staged += ".tmp";
+    return staged;
+}
+
+WriteAheadLog &TableStore::wal() const {
+    return WriteAheadLog::forDatabase(path.parent_path());
+}
+
+fs::path TableStore::indexPath(const string &column) const {
+    return path / "Indexes" / (column + ".hidx");
+}
+
+fs::path TableStore::orderedIndexPath(const string &indexName) const {
+    return path / "Indexes" / (indexName + ".bidx");
+}
+
+const json &TableStore::indexCatalog() {
+    if (!catalog.has_value()) {
+        catalog = json::object();
+        ifstream catalogFile(path / "Indexes" / "indexes.json");
+        if (catalogFile.is_open()) {
+            catalogFile >> *catalog;
+        }
+    }
+    return *catalog;
+}
+
+optional<string> TableStore::orderedIndexName(const string &column) {
+    for (auto &[name, entry]: indexCatalog().items()) {
+        if (entry.value("column", "") == column) {
+            return name;
+        }
+    }
+    return nullopt;
+}
+
+size_t TableStore::columnIndex(const string &column) const {
+    auto it = find(columns.begin(), columns.end(), column);
+    if (it == columns.end()) {
+        throw runtime_error("Column doesn't exist: " + column);
+    }
+    return static_cast<size_t>(it - columns.begin());
+}
+
+const vector<LogRecord> &TableStore::pendingRows() {
+    if (!pending.has_value()) {
+        pending = log.readAll();
+    }
+    return *pending;
+}
+
+void TableStore::applyPending(Column &data, const string &column, size_t baseRows) {
+    size_t index = columnIndex(column);
+    for (const auto &record: pendingRows()) {
+        size_t rows = record.values.size() / columns.size();
+        for (size_t r = 0; r < rows; ++r) {
+            uint64_t ordinal = record.ordinal + r;
+            if (ordinal < baseRows) {
+                continue;
+            }
+            if (ordinal != baseRows + data.size()) {
+                throw runtime_error("Insert log does not line up with column: " + column);
+            }
+            data.append(record.values[r * columns.size() + index]);
+        }
+    }
+}
+
+Column TableStore::loadColumn(const string &column) {
+    if (!TableCache::enabled()) {
+        QueryProfile::Timer timer(QueryProfile::Phase::Load);
+        Column data = readColumn(column);
+        QueryProfile::readColumn(path.filename().string(), column, "decoded", data.size(), timer.milliseconds());
+        return data;
+    }
+    return *sharedColumn(column);
+}
+
+shared_ptr<const Column> TableStore::sharedColumn(const string &column) {
+    QueryProfile::Timer timer(QueryProfile::Phase::Load);
+    bool decoded = false;
+    shared_ptr<const Column> data = TableCache::column({ColumnStore::columnPath(columnsDir(), column), log.filePath()},
+                                                       [&]() {
+                                                           decoded = true;
+                                                           return readColumn(column);
+                                                       });
+    QueryProfile::readColumn(path.filename().string(), column, decoded ? "decoded" : "cached", data->size(),
+                             timer.milliseconds());
+    return data;
+}
+
+/**
+ * @brief Loads the columns a scan needs together instead of one after the other.
+ *
+ * The kernel is first asked to read ahead every column file, so the device serves all of
+ * them at once rather than one per decode; the columns are then decoded on morsel threads,
+ * each decode overlapping the reads still in flight for the others. A column the cache holds
+ * costs one readahead hint that finds its pages resident.
+ *
+ * @param names The columns needed; duplicates and columns already in `loaded` are skipped.
+ * @param loaded The columns loaded so far, by name.
+ * @throws std::runtime_error If a column does not exist or its files are inconsistent.
+ */
+void TableStore::loadColumns(const vector<string> &names, map<string, shared_ptr<const Column> > &loaded) {
+    vector<string> missing;
+    for (const auto &column: names) {
+        if (loaded.count(column) == 0 && find(missing.begin(), missing.end(), column) == missing.end()) {
+            missing.push_back(column);
+        }
+    }
+    if (missing.size() < 2) {
+        for (const auto &column: missing) loaded.emplace(column, sharedColumn(column));
+        return;
+    }
+
+    QueryProfile::Timer timer(QueryProfile::Phase::Load);
+    pendingRows(); // read once here, the morsel threads only look at it
+    for (const auto &column: missing) {
+        FileIO::prefetch(ColumnStore::columnPath(columnsDir(), column));
+    }
+
+    // Other threads have no profile, so each read is timed here and recorded afterwards
+    vector<shared_ptr<const Column> > columnData(missing.size());
+    vector<char> decoded(missing.size(), 0);
+    vector<double> milliseconds(missing.size(), 0);
+    Morsels::parallelFor(missing.size(), [&](size_t i) {
+        auto started = chrono::steady_clock::now();
+        columnData[i] = TableCache::column({ColumnStore::columnPath(columnsDir(), missing[i]), log.filePath()}, [&]() {
+            decoded[i] = 1;
+            return readColumn(missing[i]);
+        });
+        milliseconds[i] = chrono::duration<double, milli>(chrono::steady_clock::now() - started).count();
+    });
+    for (size_t i = 0; i < missing.size(); ++i) {
+        QueryProfile::readColumn(path.filename().string(), missing[i], decoded[i] ? "decoded" : "cached",
+                                 columnData[i]->size(), milliseconds[i]);
+        loaded.emplace(missing[i], std::move(columnData[i]));
+    }
+}
+
+ColumnCells TableStore::mappedColumn(const string &column) {
+    QueryProfile::Timer timer(QueryProfile::Phase::Load);
+    ColumnCells cells = mapCells(column);
+    QueryProfile::readColumn(path.filename().string(), column, "mapped", cells.size(), timer.milliseconds());
+    return cells;
+}
+
+ColumnCells TableStore::mapCells(const string &column) {
+    ColumnCells cells;
+    cells.file = ColumnStore::mapColumn(columnsDir(), column, columnType(column));
+    cells.logged.type = cells.file->type();
+    applyPending(cells.logged, column, cells.file->size());
+    return cells;
+}
+
+Column TableStore::sliceColumn(const string &column, size_t first, size_t last) {
+    QueryProfile::Timer timer(QueryProfile::Phase::Load);
+    auto it = slicedColumns.find(column);
+    if (it == slicedColumns.end()) {
+        it = slicedColumns.emplace(column, mapCells(column)).first;
+    }
+    const ColumnCells &cells = it->second;
+
+    size_t fileRows = cells.file->size();
+    Column slice = cells.file->slice(min(first, fileRows), min(last, fileRows));
+    metrics->read(cells.file->payloadBytes(min(first, fileRows), min(last, fileRows)));
+    for (size_t row = max(first, fileRows); row < last; ++row) {
+        slice.append(cells.logged.at(row - fileRows));
+    }
+    QueryProfile::readColumn(path.filename().string(), column, "sliced", slice.size(), timer.milliseconds());
+    return slice;
+}
+
+const vector<Zone> &TableStore::zones(const string &column) {
+    auto it = zoneMaps.find(column);
+    if (it == zoneMaps.end()) {
+        QueryProfile::Timer timer(QueryProfile::Phase::Load);
+        auto file = ColumnStore::mapColumn(columnsDir(), column, columnType(column));
+        it = zoneMaps.emplace(column, ZoneMaps::load(path / "Zones" / (column + ".zones"), *file)).first;
+    }
+    return it->second;
+}
+
+/**
+ * @brief Loads a column and appends the logged rows that have not been folded into it yet.
+ *
+ * @param column The name of the column.
+ * @return The complete column.
+ * @throws std::runtime_error If the column does not exist or its files are inconsistent.
+ */
+Column TableStore::readColumn(const string &column) {
+    Column data = ColumnStore::loadColumn(columnsDir(), column, columnType(column));
+    metrics->read(fileBytes(ColumnStore::columnPath(columnsDir(), column)));
+
+    size_t baseRows = data.size();
+    Column logged;
+    logged.type = data.type;
+    applyPending(logged, column, baseRows);
+
+    data.reserve(baseRows + logged.size());
+    for (size_t i = 0; i < logged.size(); ++i) {
+        data.append(logged.at(i));
+    }
+    return data;
+}
+
+/**
+ * @brief Returns the number of rows in the table.
+ *
+ * While the insert log holds rows this only reads its last record; otherwise the segment
+ * headers of the column files are consulted.
+ *
+ * @return The row count.
+ */
+size_t TableStore::rowCount() {
+    if (auto range = log.ordinalRange()) {
+        return range->second + 1;
+    }
+
+    optional<size_t> rows;
+    for (const auto &column: columns) {
+        fs::path filePath = ColumnStore::columnPath(columnsDir(), column);
+        if (!fs::exists(filePath) && !ColumnStore::migrateLegacyColumn(columnsDir(), column, columnType(column))) {
+            throw runtime_error("Missing column file: " + column);
+        }
+        size_t count = ColumnStore::countRows(filePath);
+        rows = rows.has_value() ? min(*rows, count) : count;
+    }
+    return rows.value_or(0);
+}
+
+void TableStore::appendRow(const vector<json> &row) {
+    appendRows({row});
+}
+
+/**
+ * @brief Logs a batch of rows and appends it to the insert log, which is folded once it
+ * grows large enough.
+ *
+ * The whole batch is written as a single record, so it becomes visible atomically: a crash
+ * while appending leaves a torn record that is ignored and overwritten by the next append.
+ * A batch that reaches CHECKPOINT_ROWS on its own while the insert log is empty goes straight
+ * to the column files, so every column file is written once for the batch and the rows are
+ * not copied into the insert log first.
+ *
+ * UNIQUE columns are checked first, against their hash index and within the batch, so that
+ * once the batch is logged updating the indexes cannot fail on a duplicate; NULL is exempt,
+ * as in SQL, and is not indexed.
+ *
+ * @param rows The values of the new rows, each in columnNames() order.
+ * @throws std::runtime_error If a row does not fit the schema, a UNIQUE value is already
+ * taken, or a log cannot be written.
+ */
+void TableStore::appendRows(const vector<vector<json> > &rows) {
+    if (rows.empty() || columns.empty()) {
+        return;
+    }
+
+    LogRecord record;
+    auto range = log.ordinalRange();
+    record.ordinal = range.has_value() ? range->second + 1 : rowCount();
+    record.values.reserve(rows.size() * columns.size());
+    for (const auto &row: rows) {
+        if (row.size() != columns.size()) {
+            throw runtime_error("Row does not match the table schema");
+        }
+        record.values.insert(record.values.end(), row.begin(), row.end());
+    }
+
+    for (size_t c = 0; c < columns.size(); ++c) {
+        if (!isUnique(columns[c])) {
+            continue;
+        }
+        HashIndex &index = uniqueIndex(columns[c]);
+        unordered_set<json> seen;
+        for (const auto &row: rows) {
+            if (!row[c].is_null() && (index.find(row[c]).has_value() || !seen.insert(row[c]).second)) {
+                throw runtime_error("Duplicate value for unique column: " + columns[c]);
+            }
+        }
+    }
+
+    journal(Journal::Change::Kind::Append, {static_cast<size_t>(record.ordinal), rows.size()});
+    {
+        WriteAheadLog::Writer writer(wal());
+        writer.append(WalRecord::insert(path.filename().string(), record));
+
+        bool direct = !range.has_value() && rows.size() >= CHECKPOINT_ROWS;
+        if (direct) {
+            pending = vector<LogRecord>{record};
+            checkpoint();
+        } else {
+            log.append(record);
+            pending.reset();
+        }
+
+        for (size_t c = 0; c < columns.size(); ++c) {
+            if (!isUnique(columns[c])) {
+                continue;
+            }
+            HashIndex &index = uniqueIndex(columns[c]);
+            for (size_t r = 0; r < rows.size(); ++r) {
+                index.insert(rows[r][c], record.ordinal + r);
+            }
+            index.setCoveredRows(max<size_t>(index.coveredRows(), record.ordinal + rows.size()));
+        }
+
+        uint64_t firstLogged = range.has_value() ? range->first : record.ordinal;
+        if (!direct && record.ordinal + rows.size() - firstLogged >= CHECKPOINT_ROWS) {
+            checkpoint();
+        }
+        writer.commit();
+    }
+    wal().checkpointIfFull();
+}
+
+/**
+ * @brief Moves all logged rows into the column files.
+ *
+ * Each column file gets the rows it is missing appended as a new segment, then the log is
+ * emptied. If this is interrupted, the log is still intact and rows already folded into a
+ * column are skipped on the next read thanks to their ordinals. Nothing is synced: the rows
+ * stay in the write-ahead log until its checkpoint syncs the column files.
+ *
+ * @throws std::runtime_error If a column file cannot be written.
+ */
+void TableStore::checkpoint() {
+    if (pendingRows().empty()) {
+        log.clear();
+        return;
+    }
+
+    for (const auto &column: columns) {
+        fs::path filePath = ColumnStore::columnPath(columnsDir(), column);
+        if (!fs::exists(filePath) && !ColumnStore::migrateLegacyColumn(columnsDir(), column, columnType(column))) {
+            throw runtime_error("Missing column file: " + column);
+        }
+
+        Column logged;
+        logged.type = columnType(column);
+        applyPending(logged, column, ColumnStore::countRows(filePath));
+        ColumnStore::appendSegment(filePath, logged);
+    }
+
+    log.clear();
+    pending = vector<LogRecord>();
+}
+
+DeletionVector &TableStore::deletions() {
+    if (!deleted.has_value()) {
+        deleted.emplace(path / "deleted.bin");
+    }
+    return *deleted;
+}
+
+/**
+ * @brief Applies the changes of an UPDATE, all or none of them.
+ *
+ * The staged files are synced before the statement's record is, and the record is synced
+ * before the first of them is renamed, so after a crash the write-ahead log can always
+ * finish the renames; the in-place patches are simply written again. Under a Journal, the
+ * patched cells and the rewritten columns are read first so they can be reverted.
+ *
+ * @param patches The new values per column; text columns are not supported.
+ * @param rewritten Columns whose stagingPath() holds their new contents.
+ * @throws std::runtime_error If the log or a column file cannot be written.
+ */
+void TableStore::updateColumns(const vector<CellPatch> &patches, const vector<string> &rewritten) {
+    if (patches.empty() && rewritten.empty()) {
+        return;
+    }
+    for (const auto &column: rewritten) {
+        WriteAheadLog::syncFile(stagingPath(column));
+        metrics->written(fileBytes(stagingPath(column)));
+    }
+    if (activeJournal) {
+        for (const auto &patch: patches) {
+            ColumnCells current = mappedColumn(patch.column);
+            CellPatch previous;
+            previous.column = patch.column;
+            previous.rows = patch.rows;
+            previous.values.type = columnType(patch.column);
+            for (size_t row: patch.rows) {
+                previous.values.append(current.at(row));
+            }
+            journal(Journal::Change::Kind::Patch, {}, std::move(previous));
+        }
+        for (const auto &column: rewritten) {
+            CellPatch named;
+            named.column = column;
+            journal(Journal::Change::Kind::Rewrite, {}, std::move(named), sharedColumn(column));
+        }
+    }
+
+    {
+        WriteAheadLog::Writer writer(wal());
+        writer.append(WalRecord::update(path.filename().string(), patches, rewritten));
+        if (!rewritten.empty()) {
+            writer.commit(true);
+        }
+        for (const auto &column: rewritten) {
+            fs::rename(stagingPath(column), ColumnStore::columnPath(columnsDir(), column));
+        }
+        applyPatches(patches);
+        writer.commit();
+    }
+    wal().checkpointIfFull();
+}
+
+/**
+ * @brief Puts the columns VACUUM staged in place and forgets the deleted rows.
+ *
+ * Works like updateColumns(). Since the row numbers of older records no longer hold
+ * afterwards, the write-ahead log is checkpointed right away.
+ *
+ * @param rewritten Columns whose stagingPath() holds their new contents.
+ * @throws std::runtime_error If the log or a file cannot be written.
+ */
+void TableStore::replaceColumns(const vector<string> &rewritten) {
+    for (const auto &column: rewritten) {
+        WriteAheadLog::syncFile(stagingPath(column));
+        metrics->written(fileBytes(stagingPath(column)));
+    }
+
+    {
+        WriteAheadLog::Writer writer(wal());
+        writer.append(WalRecord::vacuum(path.filename().string(), rewritten));
+        writer.commit(true);
+        for (const auto &column: rewritten) {
+            fs::rename(stagingPath(column), ColumnStore::columnPath(columnsDir(), column));
+        }
+        deletions().clear();
+    }
+    wal().checkpoint();
+}
+
+/**
+ * @brief Brings the table files up to date with its records of the write-ahead log.
+ *
+ * Inserted rows missing from the table are appended to the insert log again, missing
+ * deletions are added to the bitmap and restored rows are taken out of it again. Staged files of a rewrite are renamed into place;
+ * a VACUUM also clears the bitmap and the insert log, whose later records are replayed
+ * on top. In-place patches are merged in log order, dropping those of a column rewritten
+ * afterwards, and only cells that differ from the final value are written.
+ *
+ * @param records The records of this table, in log order.
+ * @return Whether any file had to be changed.
+ * @throws std::runtime_error If a record refers to rows the table does not have.
+ */
+bool TableStore::replay(const vector<WalRecord> &records) {
+    size_t first = 0;
+    for (size_t i = 0; i < records.size(); ++i) {
+        if (records[i].kind == WalRecord::Kind::Vacuum) {
+            first = i;
+        }
+    }
+
+    bool changed = false;
+    optional<size_t> present; // rowCount(), kept up to date while replaying
+    map<string, map<size_t, json> > cells;
+    for (size_t i = first; i < records.size(); ++i) {
+        const WalRecord &record = records[i];
+        switch (record.kind) {
+            case WalRecord::Kind::Insert: {
+                auto [ordinal, values] = InsertLog::peek(record.payload);
+                size_t end = ordinal + (columns.empty() ? 0 : values / columns.size());
+                if (!present.has_value()) {
+                    present = rowCount();
+                }
+                if (ordinal > *present) {
+                    throw runtime_error("Write-ahead log does not line up with table: " + path.filename().string());
+                }
+                if (end > *present) {
+                    LogRecord rows = record.insertedRows();
+                    rows.values.erase(rows.values.begin(),
+                                      rows.values.begin() + static_cast<ptrdiff_t>((*present - rows.ordinal) * columns.size()));
+                    rows.ordinal = *present;
+                    log.append(rows);
+                    pending.reset();
+                    present = end;
+                    changed = true;
+                }
+                break;
+            }
+            case WalRecord::Kind::Delete: {
+                vector<size_t> missing;
+                for (size_t row: record.deletedRows()) {
+                    if (!deletions().contains(row)) {
+                        missing.push_back(row);
+                    }
+                }
+                if (!missing.empty()) {
+                    deletions().add(missing);
+                    deletions().save();
+                    changed = true;
+                }
+                break;
+            }
+            case WalRecord::Kind::Restore: {
+                vector<size_t> present;
+                for (size_t row: record.deletedRows()) {
+                    if (deletions().contains(row)) {
+                        present.push_back(row);
+                    }
+                }
+                if (!present.empty()) {
+                    deletions().remove(present);
+                    deletions().save();
+                    changed = true;
+                }
+                break;
+            }
+            case WalRecord::Kind::Update:
+            case WalRecord::Kind::Vacuum: {
+                for (const auto &column: record.rewrittenColumns()) {
+                    if (fs::exists(stagingPath(column))) {
+                        fs::rename(stagingPath(column), ColumnStore::columnPath(columnsDir(), column));
+                        changed = true;
+                    }
+                    cells.erase(column);
+                }
+                if (record.kind == WalRecord::Kind::Vacuum) {
+                    deletions().clear();
+                    log.clear();
+                    pending.reset();
+                    present.reset();
+                    changed = true;
+                    break;
+                }
+                for (const auto &patch: record.patches()) {
+                    map<size_t, json> &values = cells[patch.column];
+                    for (size_t p = 0; p < patch.rows.size(); ++p) {
+                        values[patch.rows[p]] = patch.values.at(p);
+                    }
+                }
+                break;
+            }
+        }
+    }
+
+    vector<CellPatch> stale;
+    for (const auto &[column, values]: cells) {
+        ColumnCells current = mappedColumn(column);
+        CellPatch patch;
+        patch.column = column;
+        patch.values.type = columnType(column);
+        for (const auto &[row, value]: values) {
+            if (row >= current.size() || current.at(row) != value) {
+                patch.rows.push_back(row);
+                patch.values.append(value);
+            }
+        }
+        if (!patch.rows.empty()) {
+            stale.push_back(std::move(patch));
+        }
+    }
+    if (!stale.empty()) {
+        checkpoint();
+        applyPatches(stale);
+        changed = true;
+    }
+
+    if (changed) {
+        invalidateIndexes();
+    }
+    return changed;
+}
+
+void TableStore::applyPatches(const vector<CellPatch> &patches) {
+    for (const auto &patch: patches) {
+        fs::path columnFile = ColumnStore::columnPath(columnsDir(), patch.column);
+        ColumnStore::patchCells(columnFile, patch.rows, patch.values);
+        // An in-place write keeps the size and inode and may not move the mtime either
+        TableCache::forget(columnFile);
+    }
+}
+
+/**
+ * @brief Marks rows as deleted without touching the column files.
+ *
+ * The hash indexes of UNIQUE columns are marked dirty while the bitmap is replaced and their
+ * entries for the rows are erased, so a crash in between leaves an index that is rebuilt
+ * without the deleted rows on next use.
+ *
+ * @param rows Rows that are not deleted yet, in any order.
+ * @throws std::runtime_error If the bitmap or an index cannot be written.
+ */
+void TableStore::deleteRows(const vector<size_t> &rows) {
+    if (rows.empty()) {
+        return;
+    }
+
+    // Only the keys of the deleted rows are read, from the column mappings
+    vector<pair<HashIndex *, vector<json> > > unique;
+    for (const auto &column: columns) {
+        if (!isUnique(column)) {
+            continue;
+        }
+        ColumnCells cells = mappedColumn(column);
+        vector<json> keys;
+        keys.reserve(rows.size());
+        for (size_t row: rows) {
+            keys.push_back(cells.at(row));
+        }
+        unique.emplace_back(&uniqueIndex(column), std::move(keys));
+    }
+
+    journal(Journal::Change::Kind::Delete, rows);
+    {
+        WriteAheadLog::Writer writer(wal());
+        writer.append(WalRecord::deletion(path.filename().string(), rows));
+        for (auto &[index, _]: unique) {
+            index->setDirty(true);
+        }
+        deletions().add(rows);
+        deletions().save();
+        for (auto &[index, keys]: unique) {
+            for (const auto &key: keys) {
+                index->erase(key);
+            }
+            index->setDirty(false);
+        }
+        writer.commit();
+    }
+    wal().checkpointIfFull();
+}
+
+void TableStore::restoreRows(const vector<size_t> &rows) {
+    vector<size_t> deletedRows;
+    for (size_t row: rows) {
+        if (deletions().contains(row)) deletedRows.push_back(row);
+    }
+    if (deletedRows.empty()) {
+        return;
+    }
+
+    {
+        WriteAheadLog::Writer writer(wal());
+        writer.append(WalRecord::restoration(path.filename().string(), deletedRows));
+        deletions().remove(deletedRows);
+        deletions().save();
+        writer.commit();
+    }
+    wal().checkpointIfFull();
+}
+
+void TableStore::journal(Journal::Change::Kind kind, vector<size_t> rows, CellPatch previous,
+                         shared_ptr<const Column> before) {
+    if (activeJournal) {
+        activeJournal->changes.push_back({kind, path, tableInfo, std::move(rows), std::move(previous), std::move(before)});
+    }
+}
+
+/**
+ * @brief Undoes one recorded change; the indexes of the table are left to the caller.
+ *
+ * Rows appended by the change are marked deleted, since later rows may follow them in the
+ * files. Cells of an UPDATE are patched back in place when their segments can hold the old
+ * values, and otherwise the column is rewritten: from the copy kept by the Journal for a
+ * column the UPDATE rewrote, followed by any rows appended after it.
+ *
+ * Changes must be undone newest first. A change that failed halfway can be undone as well,
+ * as rows that never made it to the table are skipped and cells are simply written again.
+ *
+ * @param change A change recorded by a Journal for this table.
+ * @throws std::runtime_error If the log or a table file cannot be written.
+ */
+void TableStore::revert(const Journal::Change &change) {
+    switch (change.kind) {
+        case Journal::Change::Kind::Append: {
+            vector<size_t> appended;
+            size_t end = min(change.rows[0] + change.rows[1], rowCount());
+            for (size_t row = change.rows[0]; row < end; ++row) {
+                if (!deletions().contains(row)) appended.push_back(row);
+            }
+            if (appended.empty()) {
+                return;
+            }
+            {
+                WriteAheadLog::Writer writer(wal());
+                writer.append(WalRecord::deletion(path.filename().string(), appended));
+                deletions().add(appended);
+                deletions().save();
+                writer.commit();
+            }
+            wal().checkpointIfFull();
+            return;
+        }
+        case Journal::Change::Kind::Delete:
+            restoreRows(change.rows);
+            return;
+        case Journal::Change::Kind::Patch:
+        case Journal::Change::Kind::Rewrite:
+            break;
+    }
+
+    checkpoint();
+    const CellPatch &previous = change.previous;
+    Column values;
+    if (change.kind == Journal::Change::Kind::Patch) {
+        if (ColumnStore::canPatch(ColumnStore::columnPath(columnsDir(), previous.column), previous.rows,
+                                  previous.values)) {
+            updateColumns({previous});
+            return;
+        }
+        values = loadColumn(previous.column);
+        values.dropDictionary();
+        for (size_t p = 0; p < previous.rows.size(); ++p) {
+            values.set(previous.rows[p], previous.values.at(p));
+        }
+    } else {
+        values = *change.before;
+        values.dropDictionary();
+        size_t rows = rowCount();
+        if (rows > values.size()) {
+            Column appended = sliceColumn(previous.column, values.size(), rows);
+            for (size_t row = 0; row < appended.size(); ++row) {
+                values.append(appended.at(row));
+            }
+        }
+    }
+    ColumnStore::writeColumn(stagingPath(previous.column), values);
+    updateColumns({}, {previous.column});
+}
+
+TableStore::Journal::Journal() : outer(activeJournal) {
+    activeJournal = this;
+}
+
+TableStore::Journal::~Journal() {
+    activeJournal = outer;
+}
+
+/**
+ * @brief Puts the recorded tables back as they were when the Journal was created.
+ *
+ * The indexes of every table involved are deleted first, so a crash during the rollback
+ * leaves them to be rebuilt on next use, and are rebuilt once every change is undone. The
+ * undoing changes are not recorded, and neither is anything after the rollback.
+ *
+ * @throws std::runtime_error If a table file cannot be written; the changes not undone yet
+ * stay applied.
+ */
+void TableStore::Journal::rollback() {
+    if (activeJournal == this) {
+        activeJournal = outer;
+    }
+    vector<Change> undo = std::move(changes);
+    changes.clear();
+
+    map<fs::path, json> tables;
+    for (const auto &change: undo) {
+        tables.emplace(change.table, change.info);
+    }
+    for (const auto &[table, info]: tables) {
+        TableStore(table, info).invalidateIndexes();
+    }
+    for (auto it = undo.rbegin(); it != undo.rend(); ++it) {
+        TableStore(it->table, it->info).revert(*it);
+    }
+    for (const auto &[table, info]: tables) {
+        TableStore(table, info).rebuildIndexes();
+    }
+}
+
+/**
+ * @brief Opens the hash index of a UNIQUE column and makes sure it reflects every row.
+ *
+ * @param column The name of a UNIQUE column.
+ * @return The open index, cached for the lifetime of this TableStore.
+ * @throws std::runtime_error If the column is not UNIQUE or holds duplicate values.
+ */
+HashIndex &TableStore::uniqueIndex(const string &column) {
+    auto it = indexes.find(column);
+    if (it != indexes.end()) {
+        return *it->second;
+    }
+    if (!isUnique(column)) {
+        throw runtime_error("Column is not UNIQUE: " + column);
+    }
+
+    fs::path filePath = indexPath(column);
+    unique_ptr<HashIndex> index;
+    try {
+        index = make_unique<HashIndex>(filePath, columnType(column));
+    } catch (const exception &) {
+        HashIndex::remove(filePath);
+        index = make_unique<HashIndex>(filePath, columnType(column));
+    }
+
+    size_t rows = rowCount();
+    size_t covered = index->coveredRows();
+    if (index->isDirty() || covered > rows || (covered == 0 && rows > 0)) {
+        index->rebuild(loadColumn(column), &deletions());
+    } else if (covered < rows) {
+        Column data = loadColumn(column);
+        for (size_t row = covered; row < data.size(); ++row) {
+            if (!deletions().contains(row)) {
+                index->insert(data.at(row), row);
+            }
+        }
+        index->setCoveredRows(data.size());
+    }
+
+    return *indexes.emplace(column, std::move(index)).first->second;
+}
+
+/**
+ * @brief Registers an ordered index in Indexes/indexes.json and builds it.
+ *
+ * @param indexName Name of the new index.
+ * @param column The column to index.
+ * @throws std::runtime_error If the column does not exist, the name is already used, or the
+ * column already has an ordered index.
+ */
+void TableStore::createIndex(const string &indexName, const string &column) {
+    columnIndex(column);
+    json updated = indexCatalog();
+    if (updated.contains(indexName)) {
+        throw runtime_error("Index already exists: " + indexName);
+    }
+    if (auto existing = orderedIndexName(column)) {
+        throw runtime_error("Column '" + column + "' already has an index: " + *existing);
+    }
+
+    OrderedIndex::build(orderedIndexPath(indexName), loadColumn(column));
+
+    updated[indexName] = {{"column", column}};
+    fs::path catalogPath = path / "Indexes" / "indexes.json";
+    fs::path tempPath = catalogPath;
+    tempPath += ".tmp";
+    {
+        ofstream out(tempPath, ios::trunc);
+        if (!out) {
+            throw runtime_error("Failed to write index catalog: " + catalogPath.string());
+        }
+        out << updated.dump(4);
+    }
+    fs::rename(tempPath, catalogPath);
+    catalog = std::move(updated);
+}
+
+/**
+ * @brief Opens the ordered index on a column, rebuilding it when it cannot be used as is.
+ *
+ * An index that covers more rows than the table has is stale after a rewrite, and one that
+ * is missing a large number of appended rows would make every query check them one by one;
+ * both are rebuilt from the column.
+ *
+ * @param column The name of the column.
+ * @return The open index, cached for the lifetime of this TableStore, or nullptr.
+ */
+OrderedIndex *TableStore::orderedIndex(const string &column) {
+    auto it = orderedIndexes.find(column);
+    if (it != orderedIndexes.end()) {
+        return it->second.get();
+    }
+    optional<string> name = orderedIndexName(column);
+    if (!name.has_value()) {
+        return nullptr;
+    }
+
+    fs::path filePath = orderedIndexPath(*name);
+    size_t rows = rowCount();
+    unique_ptr<OrderedIndex> index;
+    try {
+        index = make_unique<OrderedIndex>(filePath, columnType(column));
+    } catch (const exception &) {
+    }
+
+    if (!index || index->coveredRows() > rows ||
+        rows - index->coveredRows() > max<size_t>(CHECKPOINT_ROWS, index->coveredRows() / 8)) {
+        index.reset();
+        OrderedIndex::build(filePath, loadColumn(column));
+        index = make_unique<OrderedIndex>(filePath, columnType(column));
+    }
+
+    return orderedIndexes.emplace(column, std::move(index)).first->second.get();
+}
+
+void TableStore::invalidateIndexes() {
+    for (const auto &column: columns) {
+        if (isUnique(column)) {
+            indexes.erase(column);
+            HashIndex::remove(indexPath(column));
+        }
+        invalidateOrderedIndex(column);
+    }
+}
+
+void TableStore::invalidateOrderedIndex(const string &column) {
+    orderedIndexes.erase(column);
+    if (auto name = orderedIndexName(column)) {
+        fs::remove(orderedIndexPath(*name));
+    }
+}
+
+void TableStore::rebuildIndexes() {
+    for (const auto &column: columns) {
+        if (isUnique(column)) {
+            uniqueIndex(column);
+        }
+        if (auto name = orderedIndexName(column)) {
+            orderedIndexes.erase(column);
+            OrderedIndex::build(orderedIndexPath(*name), loadColumn(column));
+        }
+    }
+}
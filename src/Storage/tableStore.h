@@ -0,0 +1,336 @@
+#pragma once
+
+#include "catalog.h"
+#include "columnStore.h"
+#include "deletionVector.h"
+#include "hashIndex.h"
+#include "insertLog.h"
+#include "metrics.h"
+#include "orderedIndex.h"
+#include "writeAheadLog.h"
+#include "zoneMap.h"
+
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+using namespace std;
+using json = nlohmann::json;
+
+/**
+ * @brief Single cells of a column read on demand: rows of the column file come from its
+ * memory mapping, rows still in the insert log from a small decoded tail
+ */
+struct ColumnCells {
+    shared_ptr<const MappedColumn> file;
+    Column logged;
+
+    size_t size() const { return file->size() + logged.size(); }
+
+    json at(size_t row) const { return row < file->size() ? file->at(row) : logged.at(row - file->size()); }
+
+    void assignTo(size_t row, json &cell) const {
+        if (row < file->size()) {
+            file->assignTo(row, cell);
+        } else {
+            logged.assignTo(row - file->size(), cell);
+        }
+    }
+};
+
+/**
+ * @brief Storage access for a single table: its column files plus the pending insert log
+ *
+ * Inserted rows go to the table's insert log first and are folded into the column files in
+ * batches. Readers see the union of both, so callers never deal with the log directly.
+ * Operations that rewrite column files must call checkpoint() before loading them.
+ *
+ * UNIQUE columns are backed by a hash index under `Indexes/`, which appendRows() keeps up
+ * to date. Ordered indexes created with CREATE INDEX are listed in `Indexes/indexes.json`
+ * and cover a prefix of the rows; they are rebuilt once too many rows were appended after
+ * them. Operations that move rows must bracket their rewrite with invalidateIndexes() and
+ * rebuildIndexes(); ones that change values of an indexed column call invalidateOrderedIndex().
+ *
+ * Every change goes to the database's WriteAheadLog before the table files, which are not
+ * synced themselves. UPDATE overwrites cells of fixed-width columns in place and rewrites
+ * other columns to their stagingPath(), both of which updateColumns() applies in one step.
+ *
+ * Zone maps under `Zones/` summarize each segment of a column file and are brought up to date
+ * when they are read, so nothing that writes column files has to maintain them.
+ *
+ * Deleted rows stay in the column files until VACUUM and are listed in the table's
+ * DeletionVector. Row numbers, rowCount() and loadColumn() include them; readers drop them
+ * with deletions(). Hash indexes never hold deleted rows, ordered indexes may.
+ */
+class TableStore {
+public:
+    /**
+     * @brief Number of logged rows after which they are folded into the column files
+     */
+    static constexpr size_t CHECKPOINT_ROWS = 1024;
+
+    /**
+     * @brief Remembers the changes TableStores make on this thread, so they can be reverted
+     *
+     * COMMIT runs its statements under one Journal and rolls it back when one of them fails.
+     * Appended rows are reverted by deleting them, deleted rows are restored and updated
+     * cells get their previous values back, each logged like any other change. A column
+     * rewritten by an UPDATE is kept in memory until the Journal goes away.
+     */
+    class Journal {
+    public:
+        Journal();
+
+        ~Journal();
+
+        Journal(const Journal &) = delete;
+
+        Journal &operator=(const Journal &) = delete;
+
+        /**
+         * @brief Reverts the recorded changes, newest first, and rebuilds the indexes of
+         * their tables
+         * @throws std::runtime_error if a table file cannot be written
+         */
+        void rollback();
+
+    private:
+        struct Change {
+            enum class Kind { Append, Delete, Patch, Rewrite };
+
+            Kind kind;
+            filesystem::path table;
+            json info;
+            vector<size_t> rows;             // Append: the first row and how many; Delete: the rows
+            CellPatch previous;              // Patch: the cells before the change
+            shared_ptr<const Column> before; // Rewrite: the column named by previous.column before
+        };
+
+        Journal *outer;
+        vector<Change> changes;
+
+        friend class TableStore;
+    };
+
+    /**
+     * @param tablePath Directory of the table (the one holding Table-info.json)
+     * @param tableInfo Parsed contents of Table-info.json
+     */
+    TableStore(filesystem::path tablePath, json tableInfo);
+
+    explicit TableStore(const TableSchema &schema);
+
+    const vector<string> &columnNames() const { return columns; }
+
+    const json &info() const { return tableInfo; }
+
+    filesystem::path columnsDir() const;
+
+    ColumnType columnType(const string &column) const;
+
+    bool isUnique(const string &column) const;
+
+    /**
+     * @brief Loads a column including rows that are still in the insert log
+     */
+    Column loadColumn(const string &column);
+
+    /**
+     * @brief Like loadColumn(), but shares the column with the TableCache instead of copying
+     * it; for callers that only read the values
+     */
+    shared_ptr<const Column> sharedColumn(const string &column);
+
+    /**
+     * @brief Adds the columns that `loaded` does not hold yet with sharedColumn(), reading and
+     * decoding them concurrently
+     */
+    void loadColumns(const vector<string> &names, map<string, shared_ptr<const Column> > &loaded);
+
+    /**
+     * @brief Maps a column instead of decoding it, for callers that read only some of its rows
+     */
+    ColumnCells mappedColumn(const string &column);
+
+    /**
+     * @brief Decodes rows [first, last) of a column, logged rows included, reading only the
+     * segments of its file that hold them
+     */
+    Column sliceColumn(const string &column, size_t first, size_t last);
+
+    /**
+     * @brief The zone maps of a column file, loaded once per TableStore; logged rows come
+     * after the last zone and are not covered
+     */
+    const vector<Zone> &zones(const string &column);
+
+    /**
+     * @brief Number of rows in the table, including logged rows
+     */
+    size_t rowCount();
+
+    /**
+     * @brief Durably appends one row; values are given in columnNames() order
+     */
+    void appendRow(const vector<json> &row);
+
+    /**
+     * @brief Durably and atomically appends a batch of rows
+     *
+     * Like the other changes below, it is durable once the statement commits (see
+     * WriteAheadLog::CommitScope).
+     */
+    void appendRows(const vector<vector<json> > &rows);
+
+    /**
+     * @brief Folds all logged rows into the column files and empties the insert log
+     */
+    void checkpoint();
+
+    /**
+     * @brief Where a column rewritten as a whole is written before updateColumns() or
+     * replaceColumns() renames it into place
+     */
+    filesystem::path stagingPath(const string &column) const;
+
+    /**
+     * @brief Durably and atomically overwrites cells of fixed-width columns in place and
+     * renames the staged files of rewritten columns over theirs
+     *
+     * Row numbers refer to the column files, so checkpoint() must have been called first.
+     * Indexes are not touched.
+     */
+    void updateColumns(const vector<CellPatch> &patches, const vector<string> &rewritten = {});
+
+    /**
+     * @brief Durably and atomically renames the staged files of all columns into place and
+     * clears the deletion bitmap, for VACUUM; indexes are not touched
+     */
+    void replaceColumns(const vector<string> &rewritten);
+
+    /**
+     * @brief Re-applies the changes of write-ahead log records of this table that the table
+     * files are missing
+     *
+     * Rows of an Insert record the table already has, rows already deleted and cells that
+     * already hold the new value are skipped, and a staged file that is gone was renamed
+     * already, so replaying the same records again changes nothing. Records before the
+     * last VACUUM are ignored since their row numbers no longer hold.
+     *
+     * @return Whether anything had to be repaired; the indexes are dropped then
+     * @throws std::runtime_error if the records do not fit the table
+     */
+    bool replay(const vector<WalRecord> &records);
+
+    /**
+     * @brief The rows deleted since the last VACUUM
+     */
+    DeletionVector &deletions();
+
+    /**
+     * @brief Durably marks rows as deleted and removes them from the hash indexes
+     */
+    void deleteRows(const vector<size_t> &rows);
+
+    /**
+     * @brief Returns the hash index of a UNIQUE column, bringing it up to date first
+     *
+     * A missing, corrupt or dirty index is rebuilt from the column; one that is behind the
+     * table (e.g. after a crash between appending rows and indexing them) is caught up.
+     */
+    HashIndex &uniqueIndex(const string &column);
+
+    /**
+     * @brief Creates an ordered index on a column and builds it from the current rows
+     * @throws std::runtime_error if the name is taken or the column already has an index
+     */
+    void createIndex(const string &indexName, const string &column);
+
+    /**
+     * @brief Returns the ordered index on a column, or nullptr if the column has none
+     *
+     * A missing or corrupt index file is rebuilt, as is one that lags too far behind the
+     * table. Rows from coveredRows() on are not in the returned index.
+     */
+    OrderedIndex *orderedIndex(const string &column);
+
+    /**
+     * @brief Deletes the hash and ordered indexes so they are rebuilt, used before row positions change
+     */
+    void invalidateIndexes();
+
+    /**
+     * @brief Deletes the ordered index file of a column, used before its values are rewritten
+     */
+    void invalidateOrderedIndex(const string &column);
+
+    /**
+     * @brief Rebuilds the hash indexes of all UNIQUE columns and all ordered indexes
+     */
+    void rebuildIndexes();
+
+private:
+    filesystem::path path;
+    Metrics::TableStats *metrics;
+    json tableInfo;
+    vector<string> columns;
+    InsertLog log;
+    optional<vector<LogRecord> > pending;
+    map<string, unique_ptr<HashIndex> > indexes;
+    map<string, unique_ptr<OrderedIndex> > orderedIndexes;
+    optional<json> catalog;
+    optional<DeletionVector> deleted;
+    map<string, vector<Zone> > zoneMaps;
+    map<string, ColumnCells> slicedColumns;
+
+    filesystem::path indexPath(const string &column) const;
+
+    filesystem::path orderedIndexPath(const string &indexName) const;
+
+    /**
+     * @brief Returns the contents of Indexes/indexes.json, mapping index names to their column
+     */
+    const json &indexCatalog();
+
+    /**
+     * @brief Returns the name of the ordered index on a column, if there is one
+     */
+    optional<string> orderedIndexName(const string &column);
+
+    const vector<LogRecord> &pendingRows();
+
+    WriteAheadLog &wal() const;
+
+    void applyPatches(const vector<CellPatch> &patches);
+
+    /**
+     * @brief Adds a change of this table to the active Journal, if there is one
+     */
+    void journal(Journal::Change::Kind kind, vector<size_t> rows, CellPatch previous = {},
+                 shared_ptr<const Column> before = nullptr);
+
+    /**
+     * @brief Undoes one change recorded by a Journal
+     */
+    void revert(const Journal::Change &change);
+
+    /**
+     * @brief Durably clears the deletion bits of rows, for a Journal rollback
+     */
+    void restoreRows(const vector<size_t> &rows);
+
+    Column readColumn(const string &column);
+
+    ColumnCells mapCells(const string &column);
+
+    size_t columnIndex(const string &column) const;
+
+    /**
+     * @brief Appends the logged rows a column file does not contain yet to the column
+     */
+    void applyPending(Column &data, const string &column, size_t baseRows);
+};
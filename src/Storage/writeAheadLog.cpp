@@ -0,0 +1,713 @@
+#include "writeAheadLog.h"
+#include "catalog.h"
+#include "fileIO.h"
+#include "metrics.h"
+#include "tableStore.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <thread>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+using json = nlohmann::json;
+namespace fs = filesystem;
+
+/*
+ * Log layout: a sequence of frames
+ *
+ *   char magic[4] "MWAL" | uint32 bodyLength | uint32 crc32(body) | body
+ *
+ * Body: uint8 kind | uint32 tableLength | table | payload, where the payload is
+ *
+ *   Insert  the record as encoded by InsertLog::encode()
+ *   Delete  uint64 rowCount | uint64 rows[rowCount]
+ *   Restore like Delete
+ *   Update  columns | uint32 patchCount | patch*
+ *   Vacuum  columns
+ *
+ * with columns being uint32 count | (uint32 nameLength | name)*, the rewritten columns, and
+ * each patch
+ *
+ *   uint32 nameLength | name | uint8 column type | uint64 rowCount
+ *   uint64 rows[rowCount] | uint8 nulls[rowCount] | values[rowCount]
+ *
+ * where the values are int64, double or uint8 depending on the column type. A frame torn by
+ * a crash is skipped by searching for the next magic.
+ */
+namespace {
+    const char FRAME_MAGIC[4] = {'M', 'W', 'A', 'L'};
+    const size_t HEADER_SIZE = sizeof(FRAME_MAGIC) + 2 * sizeof(uint32_t);
+
+    template<typename T>
+    void appendRaw(string &out, const T &value) {
+        out.append(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+
+    template<typename T>
+    void appendArray(string &out, const vector<T> &values) {
+        out.append(reinterpret_cast<const char *>(values.data()), values.size() * sizeof(T));
+    }
+
+    void appendText(string &out, const string &text) {
+        appendRaw(out, static_cast<uint32_t>(text.size()));
+        out += text;
+    }
+
+    /**
+     * Reads fixed-size values from a payload, failing on one that ends too early
+     */
+    class PayloadReader {
+    public:
+        explicit PayloadReader(const string &payload) : payload(payload) {
+        }
+
+        template<typename T>
+        T value() {
+            T result;
+            take(&result, sizeof(T));
+            return result;
+        }
+
+        template<typename T>
+        void array(vector<T> &out, size_t count) {
+            if (count > (payload.size() - pos) / sizeof(T)) {
+                throw runtime_error("Malformed write-ahead log record");
+            }
+            out.resize(count);
+            take(out.data(), count * sizeof(T));
+        }
+
+        string text() {
+            auto length = value<uint32_t>();
+            if (length > payload.size() - pos) {
+                throw runtime_error("Malformed write-ahead log record");
+            }
+            string result = payload.substr(pos, length);
+            pos += length;
+            return result;
+        }
+
+    private:
+        const string &payload;
+        size_t pos = 0;
+
+        void take(void *out, size_t size) {
+            if (size > payload.size() - pos) {
+                throw runtime_error("Malformed write-ahead log record");
+            }
+            memcpy(out, payload.data() + pos, size);
+            pos += size;
+        }
+    };
+
+    void appendColumns(string &out, const vector<string> &columns) {
+        appendRaw(out, static_cast<uint32_t>(columns.size()));
+        for (const auto &column: columns) {
+            appendText(out, column);
+        }
+    }
+
+    vector<string> readColumns(PayloadReader &reader) {
+        vector<string> columns(reader.value<uint32_t>());
+        for (auto &column: columns) {
+            column = reader.text();
+        }
+        return columns;
+    }
+
+    string encodeFrame(const WalRecord &record) {
+        string body;
+        appendRaw(body, static_cast<uint8_t>(record.kind));
+        appendText(body, record.table);
+        body += record.payload;
+
+        string frame(FRAME_MAGIC, sizeof(FRAME_MAGIC));
+        appendRaw(frame, static_cast<uint32_t>(body.size()));
+        appendRaw(frame, FileIO::crc32(body.data(), body.size()));
+        frame += body;
+        return frame;
+    }
+
+    int openLog(const fs::path &filePath) {
+#ifdef _WIN32
+        return _open(filePath.string().c_str(), _O_WRONLY | _O_APPEND | _O_CREAT | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+        return open(filePath.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+#endif
+    }
+
+    bool writeAll(int fd, const string &data) {
+        size_t done = 0;
+        while (done < data.size()) {
+#ifdef _WIN32
+            int n = _write(fd, data.data() + done, static_cast<unsigned>(data.size() - done));
+#else
+            ssize_t n = ::write(fd, data.data() + done, data.size() - done);
+            if (n < 0 && errno == EINTR) continue;
+#endif
+            if (n <= 0) return false;
+            done += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    bool syncHandle(int fd) {
+#ifdef _WIN32
+        return _commit(fd) == 0;
+#else
+        return fsync(fd) == 0;
+#endif
+    }
+
+    /**
+     * Locks `<database>/wal.lock` shared (writers) or exclusively (checkpoints) and returns
+     * the descriptor holding the lock, -1 where flock() does not exist
+     */
+    int lockLog(const fs::path &directory, bool exclusive) {
+#ifdef _WIN32
+        return -1;
+#else
+        fs::path lockPath = directory / "wal.lock";
+        int fd = open(lockPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        int status = fd < 0 ? -1 : 0;
+        if (status == 0) {
+            while ((status = flock(fd, exclusive ? LOCK_EX : LOCK_SH)) != 0 && errno == EINTR) {
+            }
+        }
+        if (status != 0) {
+            string reason = strerror(errno);
+            if (fd >= 0) close(fd);
+            throw runtime_error("Failed to lock the write-ahead log of " + directory.string() + ": " + reason);
+        }
+        return fd;
+#endif
+    }
+
+    void unlockLog(int fd) {
+#ifndef _WIN32
+        if (fd >= 0) {
+            // Closing the descriptor releases the flock
+            close(fd);
+        }
+#endif
+    }
+
+    /**
+     * Syncs everything a record of a table may have written: the column files, the insert log,
+     * the deletion bitmap, and the directories they were renamed in
+     */
+    void syncTable(const fs::path &tableDir) {
+        fs::path columnsDir = tableDir / "Columns";
+        if (fs::is_directory(columnsDir)) {
+            for (const auto &entry: fs::directory_iterator(columnsDir)) {
+                if (entry.is_regular_file()) {
+                    FileIO::sync(entry.path());
+                }
+            }
+            FileIO::sync(columnsDir);
+        }
+        for (const char *name: {"insert.log", "deleted.bin"}) {
+            if (fs::exists(tableDir / name)) {
+                FileIO::sync(tableDir / name);
+            }
+        }
+        FileIO::sync(tableDir);
+    }
+
+    mutex registryMutex;
+    map<string, unique_ptr<WriteAheadLog> > logs;
+    SyncPolicy currentPolicy;
+    thread_local WriteAheadLog::CommitScope *activeScope = nullptr;
+
+    /**
+     * Syncs all logs of the process every interval of the Interval policy, and once more
+     * when the process exits
+     */
+    class Flusher {
+    public:
+        explicit Flusher(chrono::milliseconds interval) : worker([this, interval] { work(interval); }) {
+        }
+
+        ~Flusher() {
+            {
+                lock_guard<mutex> guard(stopMutex);
+                stopping = true;
+            }
+            wake.notify_all();
+            worker.join();
+            try {
+                WriteAheadLog::syncAll();
+            } catch (const exception &e) {
+                cerr << "Warning: " << e.what() << endl;
+            }
+        }
+
+    private:
+        mutex stopMutex;
+        condition_variable wake;
+        bool stopping = false;
+        thread worker;
+
+        void work(chrono::milliseconds interval) {
+            unique_lock<mutex> guard(stopMutex);
+            while (!wake.wait_for(guard, interval, [this] { return stopping; })) {
+                guard.unlock();
+                try {
+                    WriteAheadLog::syncAll();
+                } catch (const exception &e) {
+                    cerr << "Warning: " << e.what() << endl;
+                }
+                guard.lock();
+            }
+        }
+    };
+
+    // Declared after the logs, so it is destroyed (and syncs them a last time) before they are
+    unique_ptr<Flusher> flusher;
+}
+
+optional<SyncPolicy> SyncPolicy::parse(const string &text) {
+    SyncPolicy policy;
+    if (text == "commit") {
+        return policy;
+    }
+    if (text == "off") {
+        policy.mode = Mode::Off;
+        return policy;
+    }
+    if (text.empty() || text.find_first_not_of("0123456789") != string::npos) {
+        return nullopt;
+    }
+    try {
+        policy.interval = chrono::milliseconds(stoul(text));
+    } catch (const exception &) {
+        return nullopt;
+    }
+    if (policy.interval.count() == 0) {
+        return nullopt;
+    }
+    policy.mode = Mode::Interval;
+    return policy;
+}
+
+WalRecord WalRecord::insert(const string &table, const LogRecord &rows) {
+    return {Kind::Insert, table, InsertLog::encode(rows)};
+}
+
+WalRecord WalRecord::deletion(const string &table, const vector<size_t> &rows) {
+    WalRecord record{Kind::Delete, table, {}};
+    appendRaw(record.payload, static_cast<uint64_t>(rows.size()));
+    for (size_t row: rows) {
+        appendRaw(record.payload, static_cast<uint64_t>(row));
+    }
+    return record;
+}
+
+WalRecord WalRecord::restoration(const string &table, const vector<size_t> &rows) {
+    WalRecord record = deletion(table, rows);
+    record.kind = Kind::Restore;
+    return record;
+}
+
+WalRecord WalRecord::update(const string &table, const vector<CellPatch> &patches, const vector<string> &rewritten) {
+    WalRecord record{Kind::Update, table, {}};
+    string &out = record.payload;
+    appendColumns(out, rewritten);
+    appendRaw(out, static_cast<uint32_t>(patches.size()));
+    for (const auto &patch: patches) {
+        if (ColumnStore::fixedWidth(patch.values.type) == 0) {
+            throw runtime_error("Cannot log text column for in-place update: " + patch.column);
+        }
+        appendText(out, patch.column);
+        appendRaw(out, static_cast<uint8_t>(patch.values.type));
+        appendRaw(out, static_cast<uint64_t>(patch.rows.size()));
+        for (size_t row: patch.rows) {
+            appendRaw(out, static_cast<uint64_t>(row));
+        }
+        appendArray(out, patch.values.nulls);
+        switch (patch.values.type) {
+            case ColumnType::Integer:
+                appendArray(out, patch.values.ints);
+                break;
+            case ColumnType::Float:
+                appendArray(out, patch.values.floats);
+                break;
+            default:
+                appendArray(out, patch.values.bools);
+                break;
+        }
+    }
+    return record;
+}
+
+WalRecord WalRecord::vacuum(const string &table, const vector<string> &rewritten) {
+    WalRecord record{Kind::Vacuum, table, {}};
+    appendColumns(record.payload, rewritten);
+    return record;
+}
+
+LogRecord WalRecord::insertedRows() const {
+    return InsertLog::decode(payload);
+}
+
+vector<size_t> WalRecord::deletedRows() const {
+    PayloadReader reader(payload);
+    vector<uint64_t> rows;
+    reader.array(rows, static_cast<size_t>(reader.value<uint64_t>()));
+    return {rows.begin(), rows.end()};
+}
+
+vector<CellPatch> WalRecord::patches() const {
+    PayloadReader reader(payload);
+    readColumns(reader);
+
+    vector<CellPatch> patches(reader.value<uint32_t>());
+    for (auto &patch: patches) {
+        patch.column = reader.text();
+        patch.values.type = static_cast<ColumnType>(reader.value<uint8_t>());
+        auto rows = static_cast<size_t>(reader.value<uint64_t>());
+
+        vector<uint64_t> rowNumbers;
+        reader.array(rowNumbers, rows);
+        patch.rows.assign(rowNumbers.begin(), rowNumbers.end());
+        reader.array(patch.values.nulls, rows);
+        switch (patch.values.type) {
+            case ColumnType::Integer:
+                reader.array(patch.values.ints, rows);
+                break;
+            case ColumnType::Float:
+                reader.array(patch.values.floats, rows);
+                break;
+            case ColumnType::Boolean:
+                reader.array(patch.values.bools, rows);
+                break;
+            default:
+                throw runtime_error("Malformed write-ahead log record");
+        }
+    }
+    return patches;
+}
+
+vector<string> WalRecord::rewrittenColumns() const {
+    PayloadReader reader(payload);
+    return readColumns(reader);
+}
+
+WriteAheadLog::WriteAheadLog(fs::path databaseDir)
+    : directory(std::move(databaseDir)), path(directory / "wal.log") {
+}
+
+WriteAheadLog::Writer::Writer(WriteAheadLog &log) : log(log), fileHandle(lockLog(log.directory, false)) {
+}
+
+WriteAheadLog::Writer::~Writer() {
+    unlockLog(fileHandle);
+}
+
+void WriteAheadLog::Writer::append(const WalRecord &record) {
+    string frame = encodeFrame(record);
+    sequence = log.write(frame);
+    Metrics::walWritten(frame.size());
+    Metrics::table(log.directory.filename().string(), record.table).written(frame.size());
+}
+
+/**
+ * @brief Commits the records appended so far.
+ *
+ * Under the Commit policy the wait is deferred to the innermost CommitScope of the thread if
+ * there is one. Under Interval the background flusher syncs the records, and under Off
+ * nobody does; a forced commit syncs them right away under both Commit and Interval.
+ *
+ * @param now Whether to sync before returning regardless of scope and interval.
+ * @throws std::runtime_error If the log cannot be synced.
+ */
+void WriteAheadLog::Writer::commit(bool now) {
+    SyncPolicy::Mode mode = policy().mode;
+    if (sequence == 0 || mode == SyncPolicy::Mode::Off) {
+        return;
+    }
+    if (!now && mode == SyncPolicy::Mode::Interval) {
+        return;
+    }
+    if (!now && activeScope != nullptr) {
+        activeScope->deferred.emplace_back(&log, sequence);
+        return;
+    }
+    log.waitDurable(sequence);
+}
+
+WriteAheadLog::CommitScope::CommitScope() : outer(activeScope) {
+    activeScope = this;
+}
+
+WriteAheadLog::CommitScope::~CommitScope() {
+    activeScope = outer;
+}
+
+void WriteAheadLog::CommitScope::wait() {
+    for (const auto &[log, sequence]: deferred) {
+        log->waitDurable(sequence);
+    }
+    deferred.clear();
+}
+
+void WriteAheadLog::configure(const SyncPolicy &policy) {
+    flusher.reset();
+    currentPolicy = policy;
+    if (policy.mode == SyncPolicy::Mode::Interval) {
+        flusher = make_unique<Flusher>(policy.interval);
+    }
+}
+
+SyncPolicy WriteAheadLog::policy() {
+    return currentPolicy;
+}
+
+WriteAheadLog &WriteAheadLog::forDatabase(const fs::path &databaseDir) {
+    lock_guard<mutex> guard(registryMutex);
+    unique_ptr<WriteAheadLog> &log = logs[databaseDir.lexically_normal().string()];
+    if (!log) {
+        log.reset(new WriteAheadLog(databaseDir));
+    }
+    return *log;
+}
+
+/**
+ * @brief Replays the logs left behind by earlier processes, before this one changes anything.
+ */
+void WriteAheadLog::recoverAll() {
+    fs::path databasesDir = Catalog::databasesDir();
+    if (!fs::is_directory(databasesDir)) {
+        return;
+    }
+
+    for (const auto &database: fs::directory_iterator(databasesDir)) {
+        error_code ignored;
+        if (!database.is_directory() || fs::file_size(database.path() / "wal.log", ignored) == 0 || ignored) {
+            continue;
+        }
+        try {
+            forDatabase(database.path()).recover();
+        } catch (const exception &e) {
+            cerr << "Warning: could not replay the write-ahead log of " << database.path().filename().string()
+                    << ": " << e.what() << endl;
+        }
+    }
+}
+
+void WriteAheadLog::syncAll() {
+    vector<WriteAheadLog *> open;
+    {
+        lock_guard<mutex> guard(registryMutex);
+        for (const auto &[_, log]: logs) {
+            open.push_back(log.get());
+        }
+    }
+    for (WriteAheadLog *log: open) {
+        log->syncWritten();
+    }
+}
+
+void WriteAheadLog::syncFile(const fs::path &filePath) {
+    if (policy().mode != SyncPolicy::Mode::Off) {
+        FileIO::sync(filePath);
+    }
+}
+
+uint64_t WriteAheadLog::write(const string &frame) {
+    lock_guard<mutex> guard(stateMutex);
+    if (fileHandle < 0) {
+        fileHandle = openLog(path);
+        if (fileHandle < 0) {
+            throw runtime_error("Failed to open write-ahead log: " + path.string());
+        }
+    }
+    if (!writeAll(fileHandle, frame)) {
+        throw runtime_error("Failed to append to write-ahead log: " + path.string());
+    }
+    return ++written;
+}
+
+/**
+ * @brief Group commit: one thread syncs the log for everybody waiting.
+ *
+ * The first thread to arrive syncs everything appended up to then; threads arriving while it
+ * syncs wait for it and, if their record came too late for that sync, the next one of them
+ * syncs for the rest. A busy server thus needs one sync per round instead of one per statement.
+ *
+ * @param sequence The number write() returned for the record.
+ * @throws std::runtime_error If syncing fails.
+ */
+void WriteAheadLog::waitDurable(uint64_t sequence) {
+    unique_lock<mutex> guard(stateMutex);
+    while (durable < sequence) {
+        if (syncing) {
+            syncDone.wait(guard);
+            continue;
+        }
+        syncing = true;
+        uint64_t target = written;
+        guard.unlock();
+        auto started = chrono::steady_clock::now();
+        bool ok = syncHandle(fileHandle);
+        Metrics::walSync().record(chrono::duration<double, milli>(chrono::steady_clock::now() - started).count());
+        guard.lock();
+        syncing = false;
+        if (ok) {
+            durable = max(durable, target);
+        }
+        syncDone.notify_all();
+        if (!ok) {
+            throw runtime_error("Failed to sync write-ahead log: " + path.string());
+        }
+    }
+}
+
+void WriteAheadLog::syncWritten() {
+    uint64_t target;
+    {
+        lock_guard<mutex> guard(stateMutex);
+        target = written;
+    }
+    waitDurable(target);
+}
+
+/**
+ * @brief Reads the intact records of the log in order.
+ *
+ * A frame with a bad length or checksum is where a writer was interrupted; other processes
+ * may have appended after it, so reading resumes at the next magic instead of stopping.
+ *
+ * @return The records, empty if there is no log.
+ */
+vector<WalRecord> WriteAheadLog::readAll() const {
+    vector<WalRecord> records;
+    if (!fs::exists(path)) {
+        return records;
+    }
+
+    string content = FileIO::readFile(path);
+    const string magic(FRAME_MAGIC, sizeof(FRAME_MAGIC));
+    size_t pos = content.find(magic);
+    while (pos != string::npos && content.size() - pos >= HEADER_SIZE) {
+        uint32_t length, checksum;
+        memcpy(&length, content.data() + pos + sizeof(FRAME_MAGIC), sizeof(uint32_t));
+        memcpy(&checksum, content.data() + pos + sizeof(FRAME_MAGIC) + sizeof(uint32_t), sizeof(uint32_t));
+        const char *body = content.data() + pos + HEADER_SIZE;
+        if (content.size() - pos - HEADER_SIZE < length || FileIO::crc32(body, length) != checksum) {
+            pos = content.find(magic, pos + 1);
+            continue;
+        }
+
+        string frameBody(body, length);
+        PayloadReader reader(frameBody);
+        WalRecord record;
+        record.kind = static_cast<WalRecord::Kind>(reader.value<uint8_t>());
+        record.table = reader.text();
+        record.payload = frameBody.substr(sizeof(uint8_t) + sizeof(uint32_t) + record.table.size());
+        records.push_back(std::move(record));
+        pos += HEADER_SIZE + length;
+    }
+    return records;
+}
+
+/**
+ * @brief Replays the log while no statement can write to the database.
+ *
+ * The records are handed to their tables in order; tables that no longer exist are skipped.
+ *
+ * @throws std::runtime_error If a table cannot be repaired, in which case the log is kept.
+ */
+void WriteAheadLog::recover() {
+    int lock = lockLog(directory, true);
+    try {
+        map<string, vector<WalRecord> > byTable;
+        for (auto &record: readAll()) {
+            byTable[record.table].push_back(std::move(record));
+        }
+
+        bool repaired = false;
+        for (const auto &[table, records]: byTable) {
+            fs::path tableDir = directory / table;
+            fs::path infoFile = tableDir / "Table-info.json";
+            if (!fs::exists(infoFile)) {
+                continue;
+            }
+            TableStore store(tableDir, json::parse(FileIO::readFile(infoFile)));
+            repaired = store.replay(records) || repaired;
+        }
+
+        error_code ignored;
+        if (repaired || byTable.empty() || fs::file_size(path, ignored) >= CHECKPOINT_BYTES) {
+            checkpointLocked();
+        }
+    } catch (...) {
+        unlockLog(lock);
+        throw;
+    }
+    unlockLog(lock);
+}
+
+void WriteAheadLog::checkpoint() {
+    int lock = lockLog(directory, true);
+    try {
+        checkpointLocked();
+    } catch (...) {
+        unlockLog(lock);
+        throw;
+    }
+    unlockLog(lock);
+}
+
+void WriteAheadLog::checkpointIfFull() {
+    error_code ignored;
+    uint64_t size = fs::file_size(path, ignored);
+    if (!ignored && size >= CHECKPOINT_BYTES) {
+        checkpoint();
+    }
+}
+
+/**
+ * @brief Makes the changes of every logged record durable in the table files, then drops
+ * the records.
+ *
+ * Under the Off policy nothing is synced and the log is only emptied.
+ *
+ * @throws std::runtime_error If a table file cannot be synced; the log is kept then.
+ */
+void WriteAheadLog::checkpointLocked() {
+    if (!fs::exists(path)) {
+        return;
+    }
+    if (policy().mode != SyncPolicy::Mode::Off) {
+        set<string> tables;
+        for (const auto &record: readAll()) {
+            tables.insert(record.table);
+        }
+        for (const auto &table: tables) {
+            if (fs::is_directory(directory / table)) {
+                syncTable(directory / table);
+            }
+        }
+    }
+    fs::resize_file(path, 0);
+
+    lock_guard<mutex> guard(stateMutex);
+    durable = written;
+}
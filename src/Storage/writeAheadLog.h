@@ -0,0 +1,273 @@
+#pragma once
+
+#include "columnStore.h"
+#include "insertLog.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @brief New values for some rows of one fixed-width column
+ */
+struct CellPatch {
+    string column;
+    vector<size_t> rows; // ascending
+    Column values;       // one value per row
+};
+
+/**
+ * @brief When a commit waits for its log records to reach the disk
+ *
+ * Commit syncs the log before every statement returns, batching statements that commit at
+ * the same time. Interval syncs it in the background every `interval`, so a crash of the
+ * machine loses at most that much; Off leaves it to the operating system. A crash of the
+ * process alone never loses a committed statement.
+ */
+struct SyncPolicy {
+    enum class Mode { Commit, Interval, Off };
+
+    Mode mode = Mode::Commit;
+    chrono::milliseconds interval{0};
+
+    /**
+     * @brief Parses `commit`, `off` or a number of milliseconds
+     */
+    static optional<SyncPolicy> parse(const string &text);
+};
+
+/**
+ * @brief One change of one table, as written to the write-ahead log
+ *
+ * Rewritten columns are named rather than their files: their new contents are staged at
+ * TableStore::stagingPath() and renamed into place once the record is durable.
+ */
+struct WalRecord {
+    enum class Kind : uint8_t { Insert = 1, Delete = 2, Update = 3, Vacuum = 4, Restore = 5 };
+
+    Kind kind = Kind::Insert;
+    string table;
+    string payload;
+
+    static WalRecord insert(const string &table, const LogRecord &rows);
+
+    static WalRecord deletion(const string &table, const vector<size_t> &rows);
+
+    /**
+     * @brief Deleted rows brought back by the rollback of a COMMIT
+     */
+    static WalRecord restoration(const string &table, const vector<size_t> &rows);
+
+    /**
+     * @brief An UPDATE: cells overwritten in place and columns rewritten as a whole
+     * @throws std::runtime_error if a patch is for a text column
+     */
+    static WalRecord update(const string &table, const vector<CellPatch> &patches,
+                            const vector<string> &rewritten);
+
+    /**
+     * @brief A VACUUM: every column rewritten without the deleted rows
+     */
+    static WalRecord vacuum(const string &table, const vector<string> &rewritten);
+
+    /**
+     * @brief The rows of an Insert record
+     */
+    LogRecord insertedRows() const;
+
+    /**
+     * @brief The rows of a Delete or Restore record
+     */
+    vector<size_t> deletedRows() const;
+
+    /**
+     * @brief The in-place patches of an Update record
+     */
+    vector<CellPatch> patches() const;
+
+    /**
+     * @brief The columns an Update or Vacuum record rewrites
+     */
+    vector<string> rewrittenColumns() const;
+};
+
+/**
+ * @brief Redo log of one database, `<database>/wal.log`, that makes statements durable
+ *
+ * Every change to a table is logged as one checksummed record before the table files are
+ * written, and the table files themselves are not synced. A statement commits by syncing
+ * the log as the SyncPolicy says; statements of several server connections that commit at
+ * once share one sync. Records that did not make it to the table files are re-applied by
+ * recover() the next time a process starts, which also finishes the renames of a rewrite
+ * that was interrupted, so multi-file changes such as an UPDATE of several columns or a
+ * VACUUM happen completely or not at all.
+ *
+ * A checkpoint syncs the files of every table in the log and empties it. It runs once the
+ * log reaches CHECKPOINT_BYTES, and waits for statements that are between logging their
+ * first record and applying their last change (a Writer), in this and other processes.
+ */
+class WriteAheadLog {
+public:
+    /**
+     * @brief Size of the log from which a statement checkpoints it when it is done
+     */
+    static constexpr uint64_t CHECKPOINT_BYTES = 1 << 20;
+
+    /**
+     * @brief Logs the records of one change and keeps checkpoints away until it is applied
+     *
+     * Holds an flock() on `<database>/wal.lock` shared with other writers, which a
+     * checkpoint takes exclusively.
+     */
+    class Writer {
+    public:
+        explicit Writer(WriteAheadLog &log);
+
+        ~Writer();
+
+        Writer(const Writer &) = delete;
+
+        Writer &operator=(const Writer &) = delete;
+
+        /**
+         * @brief Appends a record to the log; it is durable once commit() returns
+         */
+        void append(const WalRecord &record);
+
+        /**
+         * @brief Waits for the appended records as the sync policy says, or leaves that to
+         * the CommitScope of the thread
+         *
+         * @param now Syncs the records before returning unless the policy is Off, even
+         * under a CommitScope: for changes that must not reach the disk before their record
+         */
+        void commit(bool now = false);
+
+    private:
+        WriteAheadLog &log;
+        int fileHandle = -1;
+        uint64_t sequence = 0;
+    };
+
+    /**
+     * @brief Defers the commits made on this thread until wait()
+     *
+     * ParseQuery::execute() waits only after releasing its table locks, so writers of the same
+     * table queue up behind each other's syncs instead of one sync each. Scopes nest.
+     */
+    class CommitScope {
+    public:
+        CommitScope();
+
+        ~CommitScope();
+
+        CommitScope(const CommitScope &) = delete;
+
+        CommitScope &operator=(const CommitScope &) = delete;
+
+        /**
+         * @brief Waits for every commit deferred to this scope
+         * @throws std::runtime_error if the log cannot be synced
+         */
+        void wait();
+
+    private:
+        CommitScope *outer;
+        vector<pair<WriteAheadLog *, uint64_t> > deferred;
+
+        friend class Writer;
+    };
+
+    /**
+     * @brief Sets the sync policy of all logs; call before the first statement
+     */
+    static void configure(const SyncPolicy &policy);
+
+    static SyncPolicy policy();
+
+    /**
+     * @brief Returns the log of a database, shared by all threads of the process
+     */
+    static WriteAheadLog &forDatabase(const filesystem::path &databaseDir);
+
+    /**
+     * @brief Runs recover() for every database that has a non-empty log
+     *
+     * A database whose log cannot be replayed is reported on stderr and keeps its log.
+     */
+    static void recoverAll();
+
+    /**
+     * @brief Syncs what this process appended to each of its logs, used by the Interval policy
+     */
+    static void syncAll();
+
+    /**
+     * @brief Syncs a file unless the policy is Off, for files a record refers to
+     * @throws std::runtime_error if the file cannot be synced
+     */
+    static void syncFile(const filesystem::path &filePath);
+
+    /**
+     * @brief Re-applies logged changes that are missing from the table files
+     *
+     * Replaying is idempotent (see TableStore::replay()), so a log whose changes all reached
+     * the tables is only read. The log is checkpointed if anything had to be repaired or it
+     * is full.
+     *
+     * @throws std::runtime_error if a table cannot be repaired; its log is kept
+     */
+    void recover();
+
+    /**
+     * @brief Syncs the files of every table in the log and empties it
+     */
+    void checkpoint();
+
+    /**
+     * @brief Checkpoints once the log has reached CHECKPOINT_BYTES; must not be called
+     * while this thread has a Writer on the log
+     */
+    void checkpointIfFull();
+
+private:
+    filesystem::path directory;
+    filesystem::path path;
+
+    mutex stateMutex;
+    condition_variable syncDone;
+    int fileHandle = -1;
+    uint64_t written = 0; // records appended by this process
+    uint64_t durable = 0; // of those, records known to be on disk
+    bool syncing = false;
+
+    explicit WriteAheadLog(filesystem::path databaseDir);
+
+    /**
+     * @brief Appends one framed record and returns its sequence number in this process
+     */
+    uint64_t write(const string &frame);
+
+    /**
+     * @brief Returns once the record with the given sequence number is on disk, syncing the
+     * log unless another thread already does
+     */
+    void waitDurable(uint64_t sequence);
+
+    void syncWritten();
+
+    vector<WalRecord> readAll() const;
+
+    /**
+     * @brief Checkpoints while the exclusive lock is already held
+     */
+    void checkpointLocked();
+};
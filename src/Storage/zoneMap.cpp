@@ -0,0 +1,265 @@
+#include "zoneMap.h"
+#include "fileIO.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <system_error>
+
+using namespace std;
+namespace fs = filesystem;
+
+/*
+ * Zone file layout (host byte order):
+ *
+ *   Header   magic "MZON", version, column type, zone count, CRC-32 of the zones
+ *   Zone*    uint32 rows, uint32 nulls, uint32 segment checksum, uint8 bounded, then
+ *            Integer/Boolean: int64 min, int64 max   Float: double min, double max
+ *            Text: uint32 length + bytes of min, uint32 length + bytes of max
+ */
+namespace {
+    const char ZONE_MAGIC[4] = {'M', 'Z', 'O', 'N'};
+    const uint16_t ZONE_VERSION = 1;
+
+#pragma pack(push, 1)
+    struct Header {
+        char magic[4];
+        uint16_t version;
+        uint8_t type;
+        uint8_t reserved;
+        uint32_t zones;
+        uint32_t checksum;
+    };
+#pragma pack(pop)
+
+    template<typename T>
+    void appendRaw(string &out, const T &value) {
+        out.append(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+
+    /**
+     * Reads fixed-size values and length-prefixed strings from a buffer, failing once it runs out
+     */
+    struct Reader {
+        const string &data;
+        size_t pos = 0;
+        bool ok = true;
+
+        template<typename T>
+        T raw() {
+            T value{};
+            if (data.size() - pos < sizeof(T)) {
+                ok = false;
+                return value;
+            }
+            memcpy(&value, data.data() + pos, sizeof(T));
+            pos += sizeof(T);
+            return value;
+        }
+
+        string text() {
+            auto length = raw<uint32_t>();
+            if (!ok || data.size() - pos < length) {
+                ok = false;
+                return {};
+            }
+            pos += length;
+            return data.substr(pos - length, length);
+        }
+    };
+
+    string encode(const vector<Zone> &zones, ColumnType type) {
+        string body;
+        for (const auto &zone: zones) {
+            appendRaw(body, static_cast<uint32_t>(zone.rows));
+            appendRaw(body, static_cast<uint32_t>(zone.nulls));
+            appendRaw(body, zone.checksum);
+            appendRaw(body, static_cast<uint8_t>(zone.bounded));
+            switch (type) {
+                case ColumnType::Float:
+                    appendRaw(body, zone.minReal);
+                    appendRaw(body, zone.maxReal);
+                    break;
+                case ColumnType::Text:
+                    appendRaw(body, static_cast<uint32_t>(zone.minText.size()));
+                    body += zone.minText;
+                    appendRaw(body, static_cast<uint32_t>(zone.maxText.size()));
+                    body += zone.maxText;
+                    break;
+                default:
+                    appendRaw(body, zone.minInteger);
+                    appendRaw(body, zone.maxInteger);
+                    break;
+            }
+        }
+
+        Header header{};
+        memcpy(header.magic, ZONE_MAGIC, sizeof(ZONE_MAGIC));
+        header.version = ZONE_VERSION;
+        header.type = static_cast<uint8_t>(type);
+        header.zones = static_cast<uint32_t>(zones.size());
+        header.checksum = FileIO::crc32(body.data(), body.size());
+
+        string out;
+        appendRaw(out, header);
+        return out + body;
+    }
+
+    /**
+     * Parses a zone file; anything unreadable yields no zones, which are then recomputed
+     */
+    vector<Zone> decode(const string &data, ColumnType type) {
+        Reader in{data};
+        auto header = in.raw<Header>();
+        if (!in.ok || memcmp(header.magic, ZONE_MAGIC, sizeof(ZONE_MAGIC)) != 0 || header.version != ZONE_VERSION ||
+            header.type != static_cast<uint8_t>(type) ||
+            FileIO::crc32(data.data() + in.pos, data.size() - in.pos) != header.checksum) {
+            return {};
+        }
+
+        vector<Zone> zones;
+        size_t firstRow = 0;
+        for (uint32_t i = 0; i < header.zones && in.ok; ++i) {
+            Zone zone;
+            zone.firstRow = firstRow;
+            zone.rows = in.raw<uint32_t>();
+            zone.nulls = in.raw<uint32_t>();
+            zone.checksum = in.raw<uint32_t>();
+            zone.bounded = in.raw<uint8_t>() != 0;
+            switch (type) {
+                case ColumnType::Float:
+                    zone.minReal = in.raw<double>();
+                    zone.maxReal = in.raw<double>();
+                    break;
+                case ColumnType::Text:
+                    zone.minText = in.text();
+                    zone.maxText = in.text();
+                    break;
+                default:
+                    zone.minInteger = in.raw<int64_t>();
+                    zone.maxInteger = in.raw<int64_t>();
+                    break;
+            }
+            firstRow += zone.rows;
+            zones.push_back(std::move(zone));
+        }
+        if (!in.ok) {
+            return {};
+        }
+        return zones;
+    }
+}
+
+namespace ZoneMaps {
+    /**
+     * @brief Computes the zone of a range of rows.
+     *
+     * @param column The column holding the rows.
+     * @param first The first row.
+     * @param last One past the last row.
+     * @return The zone, with firstRow and checksum left for the caller to fill in.
+     */
+    Zone compute(const Column &column, size_t first, size_t last) {
+        Zone zone;
+        zone.rows = last - first;
+
+        bool seen = false;
+        bool unbounded = false;
+        for (size_t row = first; row < last; ++row) {
+            if (column.nulls[row]) {
+                ++zone.nulls;
+                continue;
+            }
+            switch (column.type) {
+                case ColumnType::Integer:
+                case ColumnType::Boolean: {
+                    int64_t value = column.type == ColumnType::Integer ? column.ints[row] : column.bools[row];
+                    zone.minInteger = seen ? min(zone.minInteger, value) : value;
+                    zone.maxInteger = seen ? max(zone.maxInteger, value) : value;
+                    break;
+                }
+                case ColumnType::Float: {
+                    double value = column.floats[row];
+                    unbounded = unbounded || std::isnan(value);
+                    zone.minReal = seen ? min(zone.minReal, value) : value;
+                    zone.maxReal = seen ? max(zone.maxReal, value) : value;
+                    break;
+                }
+                case ColumnType::Text: {
+                    const string &value = column.texts[row];
+                    if (!seen || value < zone.minText) zone.minText = value;
+                    if (!seen || value > zone.maxText) zone.maxText = value;
+                    break;
+                }
+            }
+            seen = true;
+        }
+
+        if (zone.minText.size() > MAX_TEXT_BOUND || zone.maxText.size() > MAX_TEXT_BOUND) {
+            unbounded = true;
+        }
+        zone.bounded = seen && !unbounded;
+        if (!zone.bounded) {
+            zone.minText.clear();
+            zone.maxText.clear();
+        }
+        return zone;
+    }
+
+    /**
+     * @brief Loads the zone maps of a column file.
+     *
+     * Stored zones are reused for the leading segments whose row count and checksum still
+     * match; every other segment is decoded on its own and summarized again, and the file is
+     * rewritten if anything changed. Failing to write it is not an error, the zones are just
+     * computed again next time.
+     *
+     * @param zonesPath The zone file of the column.
+     * @param column The mapped column file.
+     * @return One zone per segment, in row order.
+     * @throws std::runtime_error If a segment that has to be summarized fails its checksum.
+     */
+    vector<Zone> load(const fs::path &zonesPath, const MappedColumn &column) {
+        vector<Zone> stored;
+        if (ifstream in{zonesPath, ios::binary}) {
+            string data((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+            stored = decode(data, column.type());
+        }
+
+        vector<Zone> zones;
+        zones.reserve(column.segmentCount());
+        bool changed = stored.size() != column.segmentCount();
+        for (size_t segment = 0; segment < column.segmentCount(); ++segment) {
+            auto [first, last] = column.segmentRows(segment);
+            uint32_t checksum = column.segmentChecksum(segment);
+            if (segment < stored.size() && stored[segment].firstRow == first &&
+                stored[segment].rows == last - first && stored[segment].checksum == checksum) {
+                zones.push_back(std::move(stored[segment]));
+                continue;
+            }
+
+            Zone zone = compute(column.slice(first, last), 0, last - first);
+            zone.firstRow = first;
+            zone.checksum = checksum;
+            zones.push_back(std::move(zone));
+            changed = true;
+        }
+
+        if (changed) {
+            error_code ignored;
+            fs::create_directories(zonesPath.parent_path(), ignored);
+            fs::path tempPath = FileIO::temporaryPath(zonesPath);
+            ofstream out(tempPath, ios::binary | ios::trunc);
+            out << encode(zones, column.type());
+            out.close();
+            if (out) {
+                fs::rename(tempPath, zonesPath, ignored);
+            }
+            if (!out || ignored) {
+                fs::remove(tempPath, ignored);
+            }
+        }
+        return zones;
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "columnStore.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @brief Statistics of one segment of a column file, used to skip segments a predicate
+ * cannot match
+ */
+struct Zone {
+    size_t firstRow = 0;
+    size_t rows = 0;
+    size_t nulls = 0;
+    uint32_t checksum = 0; // of the segment payload the statistics were computed from
+    // Whether min and max are known: false if every row is NULL, a float is NaN, or a text
+    // bound is longer than MAX_TEXT_BOUND
+    bool bounded = false;
+    int64_t minInteger = 0; // integer and boolean columns
+    int64_t maxInteger = 0;
+    double minReal = 0;
+    double maxReal = 0;
+    string minText;
+    string maxText;
+};
+
+/**
+ * @brief Zone maps: the min, max and NULL count of every segment of a column file
+ *
+ * They are kept under `Zones/<column>.zones` next to Table-info.json. Every zone records the
+ * checksum of the segment it describes, so the writers of column files never update them:
+ * a zone whose segment was appended, patched or rewritten since no longer matches and is
+ * recomputed from that segment alone the next time the zones are loaded. A stale or damaged
+ * file can therefore cost a recomputation but never a wrong answer.
+ */
+namespace ZoneMaps {
+    constexpr size_t MAX_TEXT_BOUND = 64;
+
+    /**
+     * @brief Returns a zone for every segment of a mapped column file, reading the stored ones
+     * and recomputing (and storing) those that are missing or out of date
+     */
+    vector<Zone> load(const filesystem::path &zonesPath, const MappedColumn &column);
+
+    /**
+     * @brief Computes the statistics of rows [first, last) of a column
+     */
+    Zone compute(const Column &column, size_t first, size_t last);
+}
@@ -1,8 +1,16 @@
 #include "Parser/parser.h"
+#include "Operations/Vacuum/vacuum.h"
+#include "Server/server.h"
+#include "Storage/metrics.h"
+#include "Storage/morsels.h"
+#include "Storage/writeAheadLog.h"
+#include "Operations/Selection/ResultFormatter.hpp"
 #include <iostream>
+#include <optional>
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <utility>
 
 using namespace std;
 
@@ -11,6 +19,7 @@ void runInteractive() {
     cout << "Type your SQL-like commands (type 'exit;' to quit)\n\n";
 
     string query;
+    Transaction transaction;
 
     while (true) {
         cout << "mashdb> ";
@@ -23,27 +32,106 @@ void runInteractive() {
             continue;
 
         if (query == "exit" || query == "EXIT") {
+            if (transaction.active()) {
+                cout << "Rolled back the open transaction.\n";
+            }
             cout << "Exiting MashDB console.\n";
             break;
         }
 
         try {
-            ParseQuery::parse(query);
+            ParseQuery::parse(query, cout, &transaction);
         } catch (const exception &e) {
             cerr << "Error: " << e.what() << endl;
         }
     }
 }
 
+/**
+ * Removes `flag <number>` from the arguments and stores the number; returns false after
+ * printing an error if the number is missing or invalid
+ */
+bool takeNumber(vector<string> &args, const string &flag, const string &what, size_t &value) {
+    auto it = find(args.begin(), args.end(), flag);
+    if (it == args.end()) {
+        return true;
+    }
+    if (next(it) == args.end()) {
+        cerr << "Error: " << flag << " needs " << what << endl;
+        return false;
+    }
+    try {
+        value = stoul(*next(it));
+    } catch (const exception &) {
+        cerr << "Error: invalid " << flag << " value: " << *next(it) << endl;
+        return false;
+    }
+    args.erase(it, next(it, 2));
+    return true;
+}
+
 bool g_outputJson = false;
+Selection::OutputFormat g_outputFormat = Selection::OutputFormat::Table;
 
 int main(int argc, char *argv[]) {
     vector<string> args(argv + 1, argv + argc);
 
-    auto jsonIt = find(args.begin(), args.end(), "--json");
-    if (jsonIt != args.end()) {
-        g_outputJson = true;
-        args.erase(jsonIt);
+    // Output format of SELECT results; errors are reported as JSON except with --csv
+    for (auto [flag, format]: {pair{"--json", Selection::OutputFormat::Json},
+                               pair{"--ndjson", Selection::OutputFormat::NdJson},
+                               pair{"--csv", Selection::OutputFormat::Csv}}) {
+        auto it = find(args.begin(), args.end(), flag);
+        if (it != args.end()) {
+            g_outputFormat = format;
+            g_outputJson = g_outputJson || format != Selection::OutputFormat::Csv;
+            args.erase(it);
+        }
+    }
+
+    size_t cacheMegabytes = 256;
+    size_t workerThreads = 0;
+    size_t scanThreads = 0;
+    size_t vacuumPercent = static_cast<size_t>(Vacuum::DEFAULT_THRESHOLD * 100);
+    size_t slowQueryMilliseconds = 0;
+    if (!takeNumber(args, "--cache-mb", "a size in megabytes", cacheMegabytes) ||
+        !takeNumber(args, "--threads", "a number of worker threads", workerThreads) ||
+        !takeNumber(args, "--scan-threads", "a number of threads per scan", scanThreads) ||
+        !takeNumber(args, "--vacuum-percent", "a percentage of deleted rows", vacuumPercent) ||
+        !takeNumber(args, "--slow-query-ms", "a number of milliseconds", slowQueryMilliseconds)) {
+        return 1;
+    }
+    Morsels::setMaxThreads(scanThreads);
+    Metrics::setSlowQueryThreshold(static_cast<double>(slowQueryMilliseconds));
+
+    // When commits sync the write-ahead log: `commit` (default), every N milliseconds, or `off`
+    auto syncIt = find(args.begin(), args.end(), "--sync");
+    if (syncIt != args.end()) {
+        optional<SyncPolicy> policy;
+        if (next(syncIt) != args.end()) {
+            policy = SyncPolicy::parse(*next(syncIt));
+        }
+        if (!policy) {
+            cerr << "Error: --sync needs commit, off or a number of milliseconds" << endl;
+            return 1;
+        }
+        WriteAheadLog::configure(*policy);
+        args.erase(syncIt, next(syncIt, 2));
+    }
+    WriteAheadLog::recoverAll();
+
+    auto serveIt = find(args.begin(), args.end(), "--serve");
+    if (serveIt != args.end()) {
+        string endpoint;
+        if (next(serveIt) != args.end() && next(serveIt)->rfind("--", 0) != 0) {
+            endpoint = *next(serveIt);
+        }
+        try {
+            Server::run(endpoint, cacheMegabytes << 20, workerThreads, vacuumPercent / 100.0);
+        } catch (const exception &e) {
+            cerr << "Error: " << e.what() << endl;
+            return 1;
+        }
+        return 0;
     }
 
     if (!args.empty()) {
@@ -0,0 +1,400 @@
+#include "../src/Parser/parser.h"
+#include "../src/Operations/Selection/ResultFormatter.hpp"
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+#include <unistd.h>
+
+using namespace std;
+namespace fs = filesystem;
+using json = nlohmann::json;
+
+// The engine reads these from the command line front end
+bool g_outputJson = false;
+Selection::OutputFormat g_outputFormat = Selection::OutputFormat::NdJson;
+
+namespace {
+    fs::path g_home;
+
+    /**
+     * @brief Runs one statement, discarding what it prints.
+     * @throws std::runtime_error If the statement fails.
+     */
+    void run(const string &query, Transaction *session = nullptr) {
+        ostringstream out;
+        ParseQuery::parse(query, out, session);
+    }
+
+    /**
+     * @brief Runs a SELECT and returns its rows, one JSON object per row.
+     * @throws std::runtime_error If the statement fails.
+     */
+    vector<json> rows(const string &query) {
+        ostringstream out;
+        ParseQuery::parse(query, out);
+        vector<json> result;
+        istringstream lines(out.str());
+        string line;
+        while (getline(lines, line)) {
+            if (!line.empty()) {
+                result.push_back(json::parse(line));
+            }
+        }
+        return result;
+    }
+
+    /**
+     * @return The message of the error `query` fails with, or "" if it succeeds
+     */
+    string error(const string &query, Transaction *session = nullptr) {
+        try {
+            run(query, session);
+        } catch (const exception &e) {
+            return e.what();
+        }
+        return "";
+    }
+
+    /**
+     * @brief Runs EXPLAIN ANALYZE on a statement and returns its report.
+     * @throws std::runtime_error If the statement fails.
+     */
+    json explain(const string &query) {
+        ostringstream out;
+        g_outputJson = true;
+        try {
+            ParseQuery::parse("EXPLAIN ANALYZE " + query, out);
+        } catch (...) {
+            g_outputJson = false;
+            throw;
+        }
+        g_outputJson = false;
+        return json::parse(out.str()).at("explain");
+    }
+
+    /**
+     * @return How EXPLAIN ANALYZE says a column was read ("decoded", "mapped", ...), or ""
+     */
+    string howRead(const json &report, const string &column) {
+        for (const auto &read: report.at("columns")) {
+            if (read.at("column") == column) return read.at("how").get<string>();
+        }
+        return "";
+    }
+
+    /**
+     * @return The access path of the first WHERE condition in an EXPLAIN ANALYZE report
+     */
+    string access(const json &report) {
+        return report.at("tables").at(0).at("filters").at(0).at("access").get<string>();
+    }
+
+    void check(bool condition, const string &what) {
+        if (!condition) {
+            throw runtime_error("check failed: " + what);
+        }
+    }
+
+    /**
+     * Creates database `name` and makes it the current one
+     */
+    void useDatabase(const string &name) {
+        run("CREATE DATABASE " + name);
+        run("CHANGE DATABASE " + name);
+    }
+
+    void omittedUniqueColumnRepeats() {
+        useDatabase("omitted_unique");
+        run("CREATE TABLE u (k INT UNIQUE, n TEXT)");
+        run("INSERT INTO u (n) VALUES ('a')");
+        run("INSERT INTO u (n) VALUES ('b')");
+        run("INSERT INTO u (k, n) VALUES (NULL, 'c'), (NULL, 'd')");
+
+        fs::path csv = g_home / "omitted.csv";
+        ofstream(csv) << "n\ne\nf\n";
+        run("LOAD DATA '" + csv.string() + "' INTO u");
+
+        check(rows("SELECT n FROM u WHERE k IS NULL").size() == 6, "six rows with k NULL");
+        run("UPDATE u SET k = 1 WHERE n = 'a'");
+        check(rows("SELECT n FROM u WHERE k = 1") == vector<json>{{{"n", "a"}}}, "k = 1 finds a");
+        check(rows("SELECT n FROM u WHERE k IS NULL").size() == 5, "five rows with k NULL");
+        run("DELETE FROM u WHERE n = 'b'");
+        check(rows("SELECT n FROM u").size() == 5, "the table stays usable");
+    }
+
+    void duplicateUniqueValueIsRejected() {
+        useDatabase("duplicate_unique");
+        run("CREATE TABLE u (k INT UNIQUE, n TEXT)");
+        run("INSERT INTO u (k, n) VALUES (1, 'a'), (2, 'b')");
+        check(!error("INSERT INTO u (k, n) VALUES (1, 'c')").empty(), "duplicate of a stored value");
+        check(!error("INSERT INTO u (k, n) VALUES (3, 'd'), (3, 'e')").empty(), "duplicate within a batch");
+        check(!error("UPDATE u SET k = 1 WHERE n = 'b'").empty(), "update to a taken value");
+
+        check(rows("SELECT n FROM u").size() == 2, "rejected rows leave no trace");
+        check(rows("SELECT n FROM u WHERE k = 2") == vector<json>{{{"n", "b"}}}, "k = 2 still finds b");
+        run("INSERT INTO u (k, n) VALUES (3, 'f')");
+        check(rows("SELECT n FROM u WHERE k = 3") == vector<json>{{{"n", "f"}}}, "k = 3 finds f");
+    }
+
+    const vector<json> STARTING_ROWS = json::parse(R"([
+        {"k": 1, "n": "a", "v": 10},
+        {"k": 2, "n": "b", "v": 20}
+    ])").get<vector<json> >();
+
+    void commitFailureOnSecondStatementLeavesNoTrace() {
+        useDatabase("commit_second");
+        run("CREATE TABLE u (k INT UNIQUE, n TEXT, v INT)");
+        run("INSERT INTO u (k, n, v) VALUES (1, 'a', 10), (2, 'b', 20)");
+
+        Transaction session;
+        run("BEGIN", &session);
+        run("INSERT INTO u (k, n, v) VALUES (3, 'c', 30)", &session);
+        run("UPDATE u SET k = 1 WHERE k = 2", &session);
+        check(error("COMMIT", &session).find("rolled back") != string::npos, "COMMIT fails on the UPDATE");
+        check(!session.active(), "the transaction is closed");
+
+        check(rows("SELECT * FROM u") == STARTING_ROWS, "the INSERT left no rows");
+        check(rows("SELECT * FROM u WHERE k = 3").empty(), "the INSERT left no index entry");
+        run("INSERT INTO u (k, n, v) VALUES (3, 'c', 30)");
+        check(rows("SELECT n FROM u WHERE k = 3") == vector<json>{{{"n", "c"}}}, "k = 3 can be inserted");
+    }
+
+    void commitFailureRevertsEveryKindOfChange() {
+        useDatabase("commit_revert");
+        run("CREATE TABLE u (k INT UNIQUE, n TEXT, v INT)");
+        run("INSERT INTO u (k, n, v) VALUES (1, 'a', 10), (2, 'b', 20)");
+
+        Transaction session;
+        run("BEGIN", &session);
+        run("INSERT INTO u (k, n, v) VALUES (3, 'c', 30)", &session);
+        run("UPDATE u SET v = v + 1, n = 'changed' WHERE k < 3", &session);
+        run("DELETE FROM u WHERE k = 1", &session);
+        run("UPDATE u SET k = 4 WHERE k = 2", &session);
+        // Enough rows to reach the column files, after the rewrite of n above
+        fs::path csv = g_home / "many.csv";
+        {
+            ofstream file(csv);
+            file << "k,n\n";
+            for (int k = 100; k < 2100; ++k) file << k << ",row" << k << "\n";
+        }
+        run("LOAD DATA '" + csv.string() + "' INTO u", &session);
+        // Only a duplicate of a row inserted within the transaction
+        run("INSERT INTO u (k, n) VALUES (3, 'd')", &session);
+        check(!error("COMMIT", &session).empty(), "COMMIT fails on the last INSERT");
+
+        check(rows("SELECT * FROM u") == STARTING_ROWS, "every change is reverted");
+        check(rows("SELECT n FROM u WHERE k = 1") == vector<json>{{{"n", "a"}}}, "k = 1 is indexed again");
+        check(rows("SELECT n FROM u WHERE k = 4").empty(), "k = 4 is not indexed");
+        check(rows("SELECT n FROM u WHERE k = 100").empty(), "k = 100 is not indexed");
+        run("INSERT INTO u (k, n, v) VALUES (4, 'e', 40)");
+        check(rows("SELECT * FROM u").size() == 3, "the table stays usable");
+    }
+
+    void commitAppliesEveryStatement() {
+        useDatabase("commit_applies");
+        run("CREATE TABLE u (k INT UNIQUE, n TEXT, v INT)");
+        run("INSERT INTO u (k, n, v) VALUES (1, 'a', 10), (2, 'b', 20)");
+
+        Transaction session;
+        run("BEGIN", &session);
+        run("INSERT INTO u (k, n, v) VALUES (3, 'c', 30)", &session);
+        run("DELETE FROM u WHERE k = 1", &session);
+        run("UPDATE u SET k = 1, n = 'moved' WHERE k = 2", &session);
+        run("COMMIT", &session);
+
+        check(rows("SELECT * FROM u") == json::parse(R"([
+            {"k": 1, "n": "moved", "v": 20},
+            {"k": 3, "n": "c", "v": 30}
+        ])").get<vector<json> >(), "every statement is applied");
+    }
+
+    /**
+     * Creates table t (id INT UNIQUE, s TEXT, a INT) of `count` rows, with an ordered index
+     * on s: row i holds id i, s 's<i>' and a i % 7
+     */
+    void createIndexedTable(size_t count) {
+        run("CREATE TABLE t (id INT UNIQUE, s TEXT, a INT)");
+        fs::path csv = g_home / "indexed.csv";
+        {
+            ofstream file(csv);
+            file << "id,s,a\n";
+            for (size_t i = 0; i < count; ++i) file << i << ",s" << i << "," << i % 7 << "\n";
+        }
+        run("LOAD DATA '" + csv.string() + "' INTO t");
+        run("CREATE INDEX t_s ON t (s)");
+    }
+
+    void indexLookupDecodesNoColumn() {
+        useDatabase("index_lookup");
+        createIndexedTable(2000);
+
+        json report = explain("SELECT * FROM t WHERE id = 500");
+        check(access(report) == "index lookup", "id = 500 uses the hash index");
+        check(howRead(report, "id") != "decoded", "the hash hit is not checked on the decoded column");
+
+        report = explain("SELECT * FROM t WHERE s = 's500' AND a = 3");
+        check(access(report) == "index lookup", "s = 's500' uses the ordered index");
+        check(howRead(report, "s") != "decoded", "the ordered index candidates are checked on their cells");
+        check(howRead(report, "a") != "decoded", "the remaining row is checked on its cell");
+
+        check(rows("SELECT a FROM t WHERE id = 500") == vector<json>{{{"a", 3}}}, "id = 500 finds its row");
+        check(rows("SELECT id FROM t WHERE s = 's500' AND a = 3") == vector<json>{{{"id", 500}}},
+              "s = 's500' AND a = 3 finds its row");
+        check(rows("SELECT id FROM t WHERE s = 's500' AND a = 2").empty(), "a = 2 rules the row out");
+        check(rows("SELECT id FROM t WHERE id = 500.5").empty(), "a fractional key matches no integer");
+    }
+
+    void updateAndDeleteUseIndexes() {
+        useDatabase("write_indexes");
+        createIndexedTable(2000);
+
+        check(access(explain("UPDATE t SET a = 100 WHERE s = 's600'")) == "index lookup",
+              "UPDATE on s uses the ordered index");
+        check(access(explain("DELETE FROM t WHERE id = 700")) == "index lookup", "DELETE on id uses the hash index");
+        check(access(explain("UPDATE t SET s = 'moved' WHERE id = 10")) == "index lookup",
+              "UPDATE on id uses the hash index");
+
+        check(rows("SELECT id FROM t WHERE a = 100") == vector<json>{{{"id", 600}}}, "the UPDATE on s hit row 600");
+        check(rows("SELECT id FROM t WHERE id >= 699 AND id <= 701") == json::parse(R"([{"id": 699}, {"id": 701}])")
+              .get<vector<json> >(), "the DELETE on id removed row 700 only");
+        check(rows("SELECT id FROM t WHERE s = 's10'").empty(), "the ordered index forgets the old value");
+        check(rows("SELECT id FROM t WHERE s = 'moved'") == vector<json>{{{"id", 10}}},
+              "the ordered index finds the new value");
+        check(access(explain("DELETE FROM t WHERE s = 'moved'")) == "index lookup", "DELETE on s uses the ordered index");
+        check(rows("SELECT id FROM t WHERE id = 10").empty(), "the DELETE on s removed row 10");
+        check(rows("SELECT id FROM t").size() == 1998, "no other row changed");
+    }
+
+    /**
+     * @return The values of column `id` in the rows of a SELECT, in order
+     */
+    vector<int> ids(const string &query) {
+        vector<int> result;
+        for (const auto &row: rows(query)) {
+            result.push_back(row.at("id").get<int>());
+        }
+        return result;
+    }
+
+    void orderByIndexKeepsTiesInRowOrder() {
+        useDatabase("index_ties");
+        run("CREATE TABLE t (id INT, v INT)");
+        run("INSERT INTO t (id, v) VALUES (1, 5), (2, 5), (3, 9), (4, 1), (5, 5), (6, NULL), (7, NULL)");
+
+        const vector<string> queries{
+            "SELECT id FROM t ORDER BY v DESC",
+            "SELECT id FROM t ORDER BY v DESC LIMIT 3",
+            "SELECT id FROM t ORDER BY v ASC",
+            "SELECT id FROM t WHERE v >= 5 ORDER BY v DESC LIMIT 2",
+        };
+        vector<vector<int> > sorted;
+        for (const auto &query: queries) sorted.push_back(ids(query));
+        check(sorted[0] == vector<int>{3, 1, 2, 5, 4, 6, 7}, "DESC without an index keeps ties in row order");
+
+        run("CREATE INDEX t_v ON t (v)");
+        for (size_t q = 0; q < queries.size(); ++q) {
+            check(ids(queries[q]) == sorted[q], "the index gives the same rows for: " + queries[q]);
+        }
+
+        // Rows the index does not cover yet are merged in, after the indexed rows of equal keys
+        run("INSERT INTO t (id, v) VALUES (8, 5), (9, 9)");
+        check(ids("SELECT id FROM t ORDER BY v DESC") == vector<int>{3, 9, 1, 2, 5, 8, 4, 6, 7},
+              "appended rows are merged in row order");
+    }
+
+    void deleteReadsOnlyDeletedKeys() {
+        useDatabase("delete_keys");
+        createIndexedTable(2000);
+
+        json report = explain("DELETE FROM t WHERE id = 600");
+        check(howRead(report, "id") != "decoded", "the deleted key is read without decoding the column");
+        check(rows("SELECT id FROM t WHERE id = 600").empty(), "row 600 is gone");
+        run("INSERT INTO t (id, s, a) VALUES (600, 'again', 1)");
+        check(rows("SELECT s FROM t WHERE id = 600") == vector<json>{{{"s", "again"}}},
+              "the hash index forgot the deleted key");
+    }
+
+    void updateReadsOnlyUpdatedCells() {
+        useDatabase("update_cells");
+        createIndexedTable(2000);
+
+        json report = explain("UPDATE t SET a = a + 1 WHERE id = 500");
+        check(howRead(report, "a") != "decoded", "the updated cell is read without decoding the column");
+        report = explain("UPDATE t SET id = id + 5000 WHERE id = 501");
+        check(howRead(report, "id") != "decoded", "the UNIQUE cell is read without decoding the column");
+        run("UPDATE t SET s = 'moved' WHERE id = 502");
+        run("UPDATE t SET a = a + 10 WHERE a = 0");
+
+        check(rows("SELECT a FROM t WHERE id = 500") == vector<json>{{{"a", 4}}}, "a = a + 1 reads the old value");
+        check(rows("SELECT s FROM t WHERE id = 5501") == vector<json>{{{"s", "s501"}}},
+              "the hash index finds the moved key");
+        check(rows("SELECT id FROM t WHERE id = 501").empty(), "the hash index forgets the old key");
+        check(rows("SELECT a FROM t WHERE s = 'moved'") == vector<json>{{{"a", 502 % 7}}},
+              "the rewritten text column keeps its other rows");
+        check(rows("SELECT id FROM t WHERE a = 10").size() == 286 && rows("SELECT id FROM t WHERE a = 0").empty(),
+              "an UPDATE of many rows reads their whole column");
+    }
+
+    const map<string, function<void()> > TESTS{
+        {"omitted_unique_column_repeats", omittedUniqueColumnRepeats},
+        {"duplicate_unique_value_is_rejected", duplicateUniqueValueIsRejected},
+        {"commit_failure_on_second_statement_leaves_no_trace", commitFailureOnSecondStatementLeavesNoTrace},
+        {"commit_failure_reverts_every_kind_of_change", commitFailureRevertsEveryKindOfChange},
+        {"commit_applies_every_statement", commitAppliesEveryStatement},
+        {"index_lookup_decodes_no_column", indexLookupDecodesNoColumn},
+        {"update_and_delete_use_indexes", updateAndDeleteUseIndexes},
+        {"order_by_index_keeps_ties_in_row_order", orderByIndexKeepsTiesInRowOrder},
+        {"delete_reads_only_deleted_keys", deleteReadsOnlyDeletedKeys},
+        {"update_reads_only_updated_cells", updateReadsOnlyUpdatedCells},
+    };
+}
+
+/**
+ * Runs the named test, or every test without an argument, each against a fresh database
+ * in a temporary home directory. CTest runs each one as its own process.
+ */
+int main(int argc, char *argv[]) {
+    vector<string> names;
+    for (int i = 1; i < argc; ++i) {
+        if (!TESTS.count(argv[i])) {
+            cerr << "Error: unknown test " << argv[i] << endl;
+            return 1;
+        }
+        names.push_back(argv[i]);
+    }
+    if (names.empty()) {
+        for (const auto &test: TESTS) {
+            names.push_back(test.first);
+        }
+    }
+
+    g_home = fs::temp_directory_path() / ("mashdb-tests-" + to_string(getpid()));
+    fs::create_directories(g_home);
+    // Must happen before the engine first resolves ~/.mashdb
+    setenv("HOME", g_home.c_str(), 1);
+
+    int status = 0;
+    for (const auto &name: names) {
+        try {
+            TESTS.at(name)();
+            cout << "ok   " << name << endl;
+        } catch (const exception &e) {
+            cout << "FAIL " << name << ": " << e.what() << endl;
+            status = 1;
+        }
+    }
+
+    error_code ignored;
+    fs::remove_all(g_home, ignored);
+    return status;
+}